@@ -0,0 +1,97 @@
+#version 430 core
+
+/**
+ * Downsample-Stufe der Bloom-Mip-Kette.
+ * Es werden 13 Samples in einem 4x4 Texel grossen Bereich der Quelltextur
+ * genommen und in fuenf ueberlappenden 2x2 Boxen gewichtet, wie in
+ * "Next Generation Post Processing in Call of Duty: Advanced Warfare"
+ * beschrieben. Das verhindert Aliasing und Flackern beim Verkleinern.
+ * In der ersten Stufe wird zusaetzlich der Threshhold direkt auf dem
+ * Final- und Emission-Attachment berechnet, sodass kein eigener
+ * Threshhold-Pass mehr noetig ist.
+ */
+
+layout (location = 0) out vec3 downsample;
+
+uniform sampler2D srcTexture;
+// Nur in der ersten Stufe: Karis-Average gegen einzelne sehr helle Pixel
+uniform bool useKarisAverage;
+
+// Nur in der ersten Stufe: Threshhold beim Lesen anwenden
+uniform bool fuseThreshhold;
+uniform sampler2D finalTex;
+uniform sampler2D emissionTex;
+uniform float colorWeight;
+uniform float emissionWeight;
+uniform float threshholdValue;
+
+in vec2 outTexCoord;
+
+//Gewichtung nach der Helligkeit, um "Fireflies" zu unterdruecken
+float karisWeight(vec3 c)
+{
+    float luma = dot(c, vec3(0.2126, 0.7152, 0.0722));
+    return 1.0 / (1.0 + luma);
+}
+
+//Liest ein Sample, in der ersten Stufe wie im Threshhold-Shader
+vec3 fetch(vec2 uv)
+{
+    if(!fuseThreshhold){
+        return texture(srcTexture, uv).rgb;
+    }
+    vec3 bloomColor =
+        texture(finalTex, uv).rgb * colorWeight +
+        texture(emissionTex, uv).rgb * emissionWeight;
+    float brightness = dot(bloomColor, vec3(0.299, 0.587, 0.114));
+    return brightness > threshholdValue ? bloomColor : vec3(0.0);
+}
+
+//Mittelwert einer 2x2 Box, optional mit Karis-Gewichtung
+vec3 boxAverage(vec3 a, vec3 b, vec3 c, vec3 d)
+{
+    if(!useKarisAverage){
+        return (a + b + c + d) * 0.25;
+    }
+    float wa = karisWeight(a);
+    float wb = karisWeight(b);
+    float wc = karisWeight(c);
+    float wd = karisWeight(d);
+    return (a * wa + b * wb + c * wc + d * wd) / (wa + wb + wc + wd);
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(fuseThreshhold ? textureSize(finalTex, 0) : textureSize(srcTexture, 0));
+    float x = texel.x;
+    float y = texel.y;
+
+    // a - b - c
+    // - j - k -
+    // d - e - f
+    // - l - m -
+    // g - h - i
+    vec3 a = fetch(outTexCoord + vec2(-2.0 * x,  2.0 * y));
+    vec3 b = fetch(outTexCoord + vec2( 0.0,      2.0 * y));
+    vec3 c = fetch(outTexCoord + vec2( 2.0 * x,  2.0 * y));
+    vec3 d = fetch(outTexCoord + vec2(-2.0 * x,  0.0));
+    vec3 e = fetch(outTexCoord);
+    vec3 f = fetch(outTexCoord + vec2( 2.0 * x,  0.0));
+    vec3 g = fetch(outTexCoord + vec2(-2.0 * x, -2.0 * y));
+    vec3 h = fetch(outTexCoord + vec2( 0.0,     -2.0 * y));
+    vec3 i = fetch(outTexCoord + vec2( 2.0 * x, -2.0 * y));
+    vec3 j = fetch(outTexCoord + vec2(-x,  y));
+    vec3 k = fetch(outTexCoord + vec2( x,  y));
+    vec3 l = fetch(outTexCoord + vec2(-x, -y));
+    vec3 m = fetch(outTexCoord + vec2( x, -y));
+
+    //Die zentrale Box erhaelt 0.5, die vier aeusseren Boxen je 0.125
+    downsample  = boxAverage(j, k, l, m) * 0.5;
+    downsample += boxAverage(a, b, d, e) * 0.125;
+    downsample += boxAverage(b, c, e, f) * 0.125;
+    downsample += boxAverage(d, e, g, h) * 0.125;
+    downsample += boxAverage(e, f, h, i) * 0.125;
+
+    //Keine negativen Werte in die Kette geben
+    downsample = max(downsample, 0.0001);
+}
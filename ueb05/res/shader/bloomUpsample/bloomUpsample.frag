@@ -0,0 +1,40 @@
+#version 430 core
+
+/**
+ * Upsample-Stufe der Bloom-Mip-Kette.
+ * Die kleinere Stufe wird mit einem 3x3 Tent-Filter vergroessert und
+ * additiv auf die naechstgroessere Stufe geblendet.
+ */
+
+layout (location = 0) out vec3 upsample;
+
+uniform sampler2D srcTexture;
+// Radius des Tent-Filters in Texturkoordinaten
+uniform vec2 filterRadius;
+
+in vec2 outTexCoord;
+
+void main()
+{
+    float x = filterRadius.x;
+    float y = filterRadius.y;
+
+    // a - b - c
+    // d - e - f
+    // g - h - i
+    vec3 a = texture(srcTexture, outTexCoord + vec2(-x,  y)).rgb;
+    vec3 b = texture(srcTexture, outTexCoord + vec2( 0,  y)).rgb;
+    vec3 c = texture(srcTexture, outTexCoord + vec2( x,  y)).rgb;
+    vec3 d = texture(srcTexture, outTexCoord + vec2(-x,  0)).rgb;
+    vec3 e = texture(srcTexture, outTexCoord).rgb;
+    vec3 f = texture(srcTexture, outTexCoord + vec2( x,  0)).rgb;
+    vec3 g = texture(srcTexture, outTexCoord + vec2(-x, -y)).rgb;
+    vec3 h = texture(srcTexture, outTexCoord + vec2( 0, -y)).rgb;
+    vec3 i = texture(srcTexture, outTexCoord + vec2( x, -y)).rgb;
+
+    //Gewichte 1-2-1 / 2-4-2 / 1-2-1
+    upsample  = e * 4.0;
+    upsample += (b + d + f + h) * 2.0;
+    upsample += (a + c + g + i);
+    upsample *= 1.0 / 16.0;
+}
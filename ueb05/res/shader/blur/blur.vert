@@ -1,10 +1,3 @@
 #version 430 core
-layout (location = 0) in vec3 position;
-layout (location = 3) in vec2 texCoord;
 
-out vec2 outTexCoord;
-
-void main(){
-    outTexCoord = texCoord;
-    gl_Position = vec4(position, 1.0);
-}
\ No newline at end of file
+#include "shader/include/fullscreenQuad.glsl"
@@ -0,0 +1,27 @@
+#version 430 core
+
+/**
+ * Fragment-Shader fuer den Depth Pre-Pass.
+ * Es wird nur die Tiefe geschrieben. Damit der anschliessende G-Buffer-Pass
+ * mit GL_EQUAL die gleichen Fragmente trifft, muss der Alpha-Test aus
+ * model.frag hier nachgebildet werden. Er entfaellt ohne MATERIAL_DIFFUSE_MAP.
+ */
+
+#include "shader/include/modelVaryings.glsl"
+
+in VS_OUT { MODEL_VARYINGS } fs_in;
+
+// Nur der Teil des Materials, der fuer den Alpha-Test benoetigt wird.
+struct Material {
+    sampler2D diffuseMap;
+};
+uniform Material material;
+
+void main()
+{
+#ifdef MATERIAL_DIFFUSE_MAP
+    if(texture(material.diffuseMap, fs_in.TexCoords).a < 0.1f) {
+        discard;
+    }
+#endif
+}
@@ -2,9 +2,20 @@
 layout (location = 0) in vec3 position;
 
 uniform mat4 lightSpaceMat;
-uniform mat4 modelMat;
+uniform int instanceBase;
+
+//Weltmatrizen aller Instanzen der Szene
+layout (std430, binding = 8) readonly buffer InstanceBuffer {
+    mat4 instanceMatrices[];
+};
+
+//Sichtbare Instanzen aller Listen des Frames
+layout (std430, binding = 9) readonly buffer VisibleBuffer {
+    uint visibleInstances[];
+};
 
 void main() {
+    mat4 modelMat = instanceMatrices[visibleInstances[instanceBase + gl_InstanceID]];
     //Szene aus sicht des Richtungslichtes rendern
     //Tiefeninformationen in Textur speichern
     gl_Position = lightSpaceMat * modelMat * vec4(position, 1.0);
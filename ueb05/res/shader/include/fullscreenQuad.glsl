@@ -0,0 +1,15 @@
+/**
+ * Vertex-Shader fuer ein bildschirmfuellendes Quad, dessen Positionen
+ * bereits in Clip-Koordinaten vorliegen. Alle Passes, die nur ueber den
+ * Bildschirm laufen, binden diese Datei direkt hinter #version ein.
+ */
+
+layout (location = 0) in vec3 position;
+layout (location = 3) in vec2 texCoord;
+
+out vec2 outTexCoord;
+
+void main() {
+    outTexCoord = texCoord;
+    gl_Position = vec4(position, 1.0);
+}
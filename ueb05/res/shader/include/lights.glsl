@@ -0,0 +1,22 @@
+/**
+ * Lichtquellen der Beleuchtungs-Passes. Die Felder werden einzeln ueber
+ * Uniforms gesetzt (z.B. "dirLight.dir"), die Namen muessen daher mit
+ * defferedShader.c uebereinstimmen.
+ */
+
+struct DirLight {
+    vec3 dir;
+    vec3 amb;
+    vec3 diff;
+    vec3 spec;
+};
+
+struct PointLight {
+    vec3 pos;
+    vec3 amb;
+    vec3 diff;
+    vec3 spec;
+    float constant;
+    float linear;
+    float quadratic;
+};
@@ -0,0 +1,13 @@
+/**
+ * Attribute, die die Stufen der Modelle untereinander weitergeben.
+ * Jede Stufe deklariert damit ihre Bloecke als
+ * "in/out VS_OUT { MODEL_VARYINGS } name;", sodass Vertex-, Tessellation-
+ * und Fragment-Shader nicht auseinanderlaufen koennen.
+ */
+
+#define MODEL_VARYINGS \
+    vec3 FragPos;      \
+    vec2 TexCoords;    \
+    vec3 Normal;       \
+    vec3 Tangent;      \
+    vec3 Bitangent;
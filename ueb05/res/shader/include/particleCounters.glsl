@@ -0,0 +1,29 @@
+/**
+ * Zaehler und indirekte Kommandos des Partikelsystems.
+ * Wird per #include eingebunden und nur einmal je Shader eingefuegt.
+ */
+
+// Zaehler und indirekte Kommandos, muss mit ParticleCounters uebereinstimmen
+layout (std430, binding = 5) buffer CounterBuffer {
+    uint deadCount;
+    uint aliveCount;
+    uint emitCount;
+    uint emitDispatch[3];
+    uint simDispatch[3];
+    uint drawCount;
+    uint drawInstanceCount;
+    uint drawFirst;
+    uint drawBaseInstance;
+    uint quadVertexCount;
+    uint quadInstanceCount;
+    uint quadFirst;
+    uint quadBaseInstance;
+    uint alphaCount;
+    uint sortCount;
+    uint sortSize;
+    uint sortDispatch[3];
+    uint sortedVertexCount;
+    uint sortedInstanceCount;
+    uint sortedFirst;
+    uint sortedBaseInstance;
+};
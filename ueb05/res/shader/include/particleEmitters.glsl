@@ -0,0 +1,27 @@
+/**
+ * Parameter aller Emitter des Partikelsystems.
+ * Wird per #include eingebunden und nur einmal je Shader eingefuegt.
+ */
+
+// Parameter eines Emitters, muss mit ParticleEmitterParams uebereinstimmen
+struct Emitter {
+    vec3 position;
+    float startSize;
+    vec3 direction;
+    float directionRand;
+    vec3 startColor;
+    float endSize;
+    vec3 endColor;
+    float textureLayer;
+    float lifeTime;
+    float lifeTimeRand;
+    uint emitOffset;
+    uint emitCount;
+    float softness;
+    uint alphaBlend;
+};
+
+// Alle Emitter der Szene
+layout (std430, binding = 6) buffer EmitterBuffer {
+    Emitter emitters[];
+};
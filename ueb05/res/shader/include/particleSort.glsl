@@ -0,0 +1,16 @@
+/**
+ * Puffer der Tiefensortierung des Partikelsystems.
+ * Wird per #include eingebunden und nur einmal je Shader eingefuegt.
+ */
+
+// Eintrag der Tiefensortierung
+struct SortEntry {
+    float key;
+    uint index;
+};
+
+// Partikel mit Alpha-Blending: die Simulation traegt die Indizes ein, die
+// Sortierung ordnet sie von hinten nach vorne
+layout (std430, binding = 7) buffer SortBuffer {
+    SortEntry sortEntries[];
+};
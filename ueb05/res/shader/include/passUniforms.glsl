@@ -0,0 +1,13 @@
+/**
+ * Konstanten eines Geometry-Passes, die fuer alle Programme des Passes
+ * gleich sind. Sie werden einmal pro Pass in den Stream Buffer geschrieben,
+ * statt bei jedem Programmwechsel einzeln gesetzt zu werden.
+ * Die Bindung muss mit RENDERING_PASS_UNIFORM_BINDING uebereinstimmen.
+ */
+
+layout (std140, binding = 1) uniform PassUniforms {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 camPos;
+    float viewportHeight;
+};
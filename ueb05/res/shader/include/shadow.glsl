@@ -0,0 +1,39 @@
+/**
+ * Hilfsfunktionen zum Auslesen der Shadow Maps. Die Shadow Map wird als
+ * Parameter uebergeben, damit gerichtete Lichter und Punktlichter dieselben
+ * Funktionen verwenden koennen.
+ */
+
+//Liest Textur Wert aus der ShadowMap aus und vergleicht ihn mit
+//dem übergebenen wert
+float sampleShadowMap(sampler2D shadowMap, vec2 coords, float compare) {
+    return step(texture(shadowMap, coords).r, compare);
+}
+
+//Wie oben fuer eine Cube Map, deren Tiefen auf [0,1] normiert sind
+float sampleShadowMap(samplerCube shadowMap, vec3 coords, float compare, float farPlane) {
+    return step(texture(shadowMap, coords).r * farPlane, compare);
+}
+
+//bilineares Filtering der Schattenwerte
+float sampleShadowMapLinear(sampler2D shadowMap, vec2 coords, float compare, vec2 texelSize) {
+    //Position des Pixels in der Textur
+    vec2 pixelPos = coords / texelSize + vec2(0.5);
+    //Nachkommastellen
+    vec2 fracPart = fract(pixelPos);
+    //Position links oberhalb unseres eigentlichen Fragments
+    vec2 start = (pixelPos - fracPart) * texelSize;
+
+    //4 Punkte im Quadrat aus der ShadowMap samplen
+    float botLeft = sampleShadowMap(shadowMap, start, compare);
+    float botRight = sampleShadowMap(shadowMap, start + vec2(texelSize.x, 0.0), compare);
+    float topLeft = sampleShadowMap(shadowMap, start + vec2(0.0, texelSize.y), compare);
+    float topRight = sampleShadowMap(shadowMap, start + texelSize, compare);
+
+    //Zuerst in y Richtung interpolieren
+    float a = mix(botLeft, topLeft, fracPart.y);
+    float b = mix(botRight, topRight, fracPart.y);
+
+    //Ergebnis in x Richtung interpolieren
+    return mix(a, b, fracPart.x);
+}
@@ -2,6 +2,9 @@
 
 /**
  * 3D Modell Shader.
+ * Welche Texturen gelesen werden und ob Normal- und Parallaxmapping
+ * stattfinden, legen die Defines der Permutation fest (MATERIAL_*_MAP,
+ * MODEL_NORMAL_MAPPING, MODEL_PARALLAX).
  * 
  * Copyright (C) 2020, FH Wedel
  * Autor: Nicolas Hollmann
@@ -13,13 +16,9 @@ layout (location = 2) out vec4 gAlbedoSpec;
 layout (location = 3) out vec3 gEmission;
 
 // Eigenschaften, die von dem Vertextshader weitergegeben wurden.
-in VS_OUT {
-    vec3 FragPos;
-    vec2 TexCoords;
-    vec3 Normal;
-    vec3 Tangent;
-    vec3 Bitangent;
-} fs_in;
+#include "shader/include/modelVaryings.glsl"
+
+in VS_OUT { MODEL_VARYINGS } fs_in;
 
 // Struktur für Materialeigenschaften.
 struct Material {
@@ -29,31 +28,20 @@ struct Material {
     vec3 emission;
     float shininess;
 
-    bool useDiffuseMap;
     sampler2D diffuseMap;
-
-    bool useSpecularMap;
     sampler2D specularMap;
-
-    bool useNormalMap;
     sampler2D normalMap;
-
-    bool useEmissionMap;
     sampler2D emissionMap;
-
-    bool useHeightMap;
-    sampler2D heightMap;
 };
 // Aktives material.
 uniform Material material;
 
-uniform bool useParallaxMapping;
 uniform float heightScale;
 uniform sampler2D depthMap;
 
-uniform bool useNormalMapping;
-uniform vec3 camPos;
+#include "shader/include/passUniforms.glsl"
 
+#ifdef MODEL_PARALLAX
 vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 { 
     // number of depth layers
@@ -95,6 +83,7 @@ vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 
     return finalTexCoords;
 }
+#endif
 
 /**
  * Hauptfunktion des Fragment-Shaders.
@@ -102,46 +91,54 @@ vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 void main()
 {
     mat3 TBN = mat3(fs_in.Tangent, fs_in.Bitangent, fs_in.Normal);
-    // offset texture coordinates with Parallax Mapping
-    vec3 viewDir = transpose(TBN) * normalize(camPos - fs_in.FragPos);
-    viewDir.y *= -1.0;
     vec2 texCoords = fs_in.TexCoords;
 
     //Parallaxmapping
-    if(useParallaxMapping){
-        texCoords = ParallaxMapping(fs_in.TexCoords,  viewDir);       
-        if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
-            discard;
-    }
+#ifdef MODEL_PARALLAX
+    // offset texture coordinates with Parallax Mapping
+    vec3 viewDir = transpose(TBN) * normalize(camPos - fs_in.FragPos);
+    viewDir.y *= -1.0;
+    texCoords = ParallaxMapping(fs_in.TexCoords,  viewDir);       
+    if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
+        discard;
+#endif
 
     vec3 normal;
     //Normal mapping
-    if(material.useNormalMap && useNormalMapping){
-        normal = texture(material.normalMap, texCoords).rgb;
-		normal.b = sqrt(1 - pow(normal.r, 2) - pow(normal.g, 2));
-        normal = normal * 2.0 - 1.0;
-        normal = TBN * normal;
-        normal = normalize(normal);
-    } else {
-        normal = normalize(fs_in.Normal);
-    }
+#if defined(MATERIAL_NORMAL_MAP) && defined(MODEL_NORMAL_MAPPING)
+    normal = texture(material.normalMap, texCoords).rgb;
+    normal.b = sqrt(1 - pow(normal.r, 2) - pow(normal.g, 2));
+    normal = normal * 2.0 - 1.0;
+    normal = TBN * normal;
+    normal = normalize(normal);
+#else
+    normal = normalize(fs_in.Normal);
+#endif
 
     // store the fragment position vector in the first gbuffer texture
     gPosition = fs_in.FragPos;
     // also store the per-fragment normals into the gbuffer
     gNormal = normal;
     // and the diffuse per-fragment color
-    if(material.useDiffuseMap){
-        vec4 diffTex = texture(material.diffuseMap, texCoords);
-        gAlbedoSpec.rgb = diffTex.rgb * material.diffuse;
-        if(diffTex.a < 0.1f) {
-            discard;
-        }
-    } else {
-        gAlbedoSpec.rgb = material.diffuse;
+#ifdef MATERIAL_DIFFUSE_MAP
+    vec4 diffTex = texture(material.diffuseMap, texCoords);
+    gAlbedoSpec.rgb = diffTex.rgb * material.diffuse;
+    if(diffTex.a < 0.1f) {
+        discard;
     }
+#else
+    gAlbedoSpec.rgb = material.diffuse;
+#endif
     // store specular intensity in gAlbedoSpec's alpha component
-    gAlbedoSpec.a = material.useSpecularMap ? texture(material.specularMap, texCoords).b * material.specular.r: material.specular.r;
+#ifdef MATERIAL_SPECULAR_MAP
+    gAlbedoSpec.a = texture(material.specularMap, texCoords).b * material.specular.r;
+#else
+    gAlbedoSpec.a = material.specular.r;
+#endif
     ///store the emission per-fragment color
-    gEmission = material.useEmissionMap ? texture(material.emissionMap, texCoords).rgb * material.emission: material.emission;
+#ifdef MATERIAL_EMISSION_MAP
+    gEmission = texture(material.emissionMap, texCoords).rgb * material.emission;
+#else
+    gEmission = material.emission;
+#endif
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 /**
  * 3D Modell Shader.
+ * Ist MODEL_NO_TESSELLATION definiert, entfallen die Tessellation-Stufen.
+ * Der Vertex-Shader uebernimmt dann das Displacement und die Projektion,
+ * die sonst im Evaluation-Shader stattfinden.
  * 
  * Copyright (C) 2020, FH Wedel
  * Autor: Nicolas Hollmann
@@ -12,19 +15,38 @@ layout (location = 1) in vec3 normal;
 layout (location = 2) in vec3 tangent;
 layout (location = 3) in vec2 texCoord;
 
+#include "shader/include/modelVaryings.glsl"
+
 // Eigenschaften, die an den Fragmentshader weitergegeben werden sollen.
-out VS_OUT  {
-    vec3 FragPos;
-    vec2 TexCoords;
-    vec3 Normal;
-    vec3 Tangent;
-    vec3 Bitangent;
-} vs_out;
+out VS_OUT { MODEL_VARYINGS } vs_out;
 
 // Model-View-Projection Matrix.
-uniform mat4 projectionMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 modelMatrix;
+#include "shader/include/passUniforms.glsl"
+
+// Weltmatrizen aller Instanzen der Szene, muss mit SCENE_INSTANCE_BINDING
+// uebereinstimmen.
+layout (std430, binding = 8) readonly buffer InstanceBuffer {
+    mat4 instanceMatrices[];
+};
+
+// Sichtbare Instanzen aller Listen des Frames, muss mit
+// SCENE_VISIBLE_BINDING uebereinstimmen.
+layout (std430, binding = 9) readonly buffer VisibleBuffer {
+    uint visibleInstances[];
+};
+
+// Erster Eintrag des aktuellen Drawcalls in der Liste der sichtbaren Instanzen.
+uniform int instanceBase;
+
+#ifdef MODEL_NO_TESSELLATION
+uniform sampler2D depthMap;
+uniform float displacementFactor;
+uniform bool useDisplacement;
+
+// Die Position muss im Depth Pre-Pass und im G-Buffer-Pass bitgenau
+// uebereinstimmen, damit der Tiefentest mit GL_EQUAL funktioniert.
+invariant gl_Position;
+#endif
 
 /**
  * Hauptfunktion des Vertex-Shaders.
@@ -32,6 +54,8 @@ uniform mat4 modelMatrix;
  */
 void main()
 {
+    mat4 modelMatrix = instanceMatrices[visibleInstances[instanceBase + gl_InstanceID]];
+
     vs_out.TexCoords = texCoord;
 
     //neue FragPos + Normalen mit Rotation berechenen
@@ -50,4 +74,14 @@ void main()
     vs_out.Normal = N;
     vs_out.Bitangent = B;
     vs_out.Tangent = T;
+
+#ifdef MODEL_NO_TESSELLATION
+    //Wie im Evaluation-Shader entlang der normierten Normale verschieben
+    if(useDisplacement){
+        float Displacement = texture(depthMap, texCoord).x;
+        vs_out.FragPos += normalize(N) * Displacement * displacementFactor;
+    }
+
+    gl_Position = projectionMatrix * viewMatrix * vec4(vs_out.FragPos, 1.0);
+#endif
 }
@@ -0,0 +1,40 @@
+#version 430 core
+
+/**
+ * Partikel-Anzeige-Shader fuer die CPU-Simulation.
+ * Die CPU-Simulation bestimmt Farbe, Groesse und Texturebene bereits beim
+ * Hochladen aus dem Emitter jedes Partikels, weil ohne Shader Storage
+ * Buffer kein Zugriff auf die Emitter besteht.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Henrik Patjens, Jonas Sorgenfrei, Nicolas Hollmann
+ */
+
+// -----------------------------------------------------------------------------
+// Attribute
+// -----------------------------------------------------------------------------
+
+// Die lebenden Partikel liegen dicht gepackt im Stream Buffer der
+// CPU-Simulation.
+layout (location = 0) in vec4 positionSize; // w enthaelt die Groesse
+layout (location = 1) in vec4 colorLayer; // w enthaelt die Texturebene
+layout (location = 2) in float softness;
+
+out vec4 vsColor;
+out float vsSize;
+out float vsLayer;
+out float vsSoftness;
+
+/**
+ * Hauptfunktion des Vertex-Shaders.
+ * Hier werden die Daten weitergereicht.
+ */
+void main()
+{
+    gl_Position = vec4(positionSize.xyz, 1.0f);
+
+    vsColor = vec4(colorLayer.rgb, 1.0f);
+    vsSize = positionSize.w;
+    vsLayer = colorLayer.w;
+    vsSoftness = softness;
+}
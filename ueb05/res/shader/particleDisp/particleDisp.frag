@@ -2,6 +2,9 @@
 
 /**
  * Partikel-Anzeige-Shader.
+ * Partikel werden vor der Szenengeometrie weich ausgeblendet, statt hart
+ * an ihr abgeschnitten zu werden. Dafuer wird die Position aus dem
+ * G-Buffer gelesen.
  * 
  * Copyright (C) 2020, FH Wedel
  * Autor: Henrik Patjens, Jonas Sorgenfrei, Nicolas Hollmann, Mario Da Graca, Christopher Ploog
@@ -12,17 +15,47 @@
 // -----------------------------------------------------------------------------
 
 out vec4 fragColor;
-in float currLifeTime;
-in float outTotalMaxLifeTime;
+in vec4 particleColor;
+in float particleLayer;
+in float particleSoftness;
+in vec3 particleWorldPos;
 in vec2 TexCoord;
 
 // -----------------------------------------------------------------------------
 // Uniforms
 // -----------------------------------------------------------------------------
 
-uniform sampler2D partTexture;
-uniform vec3 startColor;
-uniform vec3 endColor;
+// Texturen aller Emitter, eine Ebene pro Textur
+uniform sampler2DArray partTextures;
+
+// Position und Normale der Szenengeometrie
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform vec3 camPos;
+
+/**
+ * Bestimmt, wie weit das Partikel vor der Szenengeometrie ausgeblendet
+ * wird. Pixel ohne Geometrie enthalten die Clear-Color statt einer
+ * normierten Normale und blenden nicht aus.
+ *
+ * @return 1 fuer voll sichtbar, 0 fuer komplett ausgeblendet
+ */
+float softFade()
+{
+    if (particleSoftness <= 0.0f) {
+        return 1.0f;
+    }
+
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 normal = texelFetch(gNormal, pixel, 0).xyz;
+    if (abs(dot(normal, normal) - 1.0f) > 0.01f) {
+        return 1.0f;
+    }
+
+    float sceneDistance = distance(camPos, texelFetch(gPosition, pixel, 0).xyz);
+    float particleDistance = distance(camPos, particleWorldPos);
+    return clamp((sceneDistance - particleDistance) / particleSoftness, 0.0f, 1.0f);
+}
 
 /**
  * Hauptfunktion des Fragment-Shaders.
@@ -30,6 +63,7 @@ uniform vec3 endColor;
  */
 void main()
 {
-    //Farbe ergibt sich aus Textur und einer Intapolation aus Start und End-Color mittels Lebenszeit 
-    fragColor = texture(partTexture, TexCoord) * vec4(mix(endColor,startColor, currLifeTime / outTotalMaxLifeTime),1);
+    //Farbe ergibt sich aus der Textur des Emitters und der ueber die Lebenszeit interpolierten Farbe
+    fragColor = texture(partTextures, vec3(TexCoord, particleLayer)) * particleColor;
+    fragColor.a *= softFade();
 }
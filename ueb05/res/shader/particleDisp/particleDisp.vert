@@ -2,6 +2,7 @@
 
 /**
  * Partikel-Anzeige-Shader.
+ * Farbe, Groesse und Texturebene kommen aus dem Emitter des Partikels.
  * 
  * Copyright (C) 2020, FH Wedel
  * Autor: Henrik Patjens, Jonas Sorgenfrei, Nicolas Hollmann
@@ -11,16 +12,55 @@
 // Attribute
 // -----------------------------------------------------------------------------
 
-layout (location = 0) in vec4 position;
-layout (location = 2) in float lifeLeftArray;
+// Die Partikel werden ohne Vertex-Attribute direkt aus den Buffern der
+// Simulation gelesen. gl_VertexID indiziert die Liste der lebenden Partikel.
+layout (std430, binding = 0) buffer PositionBuffer {
+    vec4 positions[];
+};
+
+layout (std430, binding = 1) buffer VelocitiesBuffer {
+    vec4 velocities[];
+};
+
+layout (std430, binding = 3) buffer AliveListBuffer {
+    uint aliveList[];
+};
+
+#include "shader/include/particleEmitters.glsl"
+
+out vec4 vsColor;
+out float vsSize;
+out float vsLayer;
+out float vsSoftness;
+
+/**
+ * Bestimmt das Aussehen eines Partikels aus seinem Emitter.
+ *
+ * @param index der Index des Partikels
+ * @param lifeLeft die Restlebenszeit des Partikels
+ */
+void applyEmitter(uint index, float lifeLeft)
+{
+    // Ungueltige Kennungen (z.B. im Benchmark) auf den letzten Emitter legen.
+    uint emitterId = min(uint(velocities[index].w), uint(emitters.length()) - 1u);
+    Emitter emitter = emitters[emitterId];
+
+    // Groesse und Farbe werden ueber die Lebenszeit interpoliert
+    float t = lifeLeft / (emitter.lifeTime + emitter.lifeTimeRand);
+    vsColor = vec4(mix(emitter.endColor, emitter.startColor, t), 1.0f);
+    vsSize = mix(emitter.endSize, emitter.startSize, t);
+    vsLayer = emitter.textureLayer;
+    vsSoftness = emitter.softness;
+}
 
-out float lifeLeft;
 /**
  * Hauptfunktion des Vertex-Shaders.
  * Hier werden die Daten weitergereicht.
  */
 void main()
 {
+    uint index = aliveList[gl_VertexID];
+    vec4 position = positions[index];
     gl_Position = vec4(position.xyz, 1.0f);
-    lifeLeft = lifeLeftArray;
+    applyEmitter(index, position.w);
 }
@@ -0,0 +1,100 @@
+#version 430 core
+
+/**
+ * Partikel-Anzeige-Shader fuer instanzierte Quads.
+ * Ersetzt Vertex- und Geometrie-Shader des Punkt-Pfades: Jede Instanz ist
+ * ein lebendes Partikel, gl_VertexID waehlt die Ecke des Quads, das als
+ * Triangle Strip gezeichnet wird. Die Ecken entsprechen denen aus
+ * particleDisp.geom. Farbe, Groesse und Texturebene kommen aus dem
+ * Emitter des Partikels. Partikel mit Alpha-Blending werden in der
+ * Reihenfolge des Sortier-Buffers gezeichnet.
+ * 
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Henrik Patjens, Jonas Sorgenfrei, Nicolas Hollmann, Mario Da Graca, Christopher Ploog
+ */
+
+// -----------------------------------------------------------------------------
+// Attribute
+// -----------------------------------------------------------------------------
+
+layout (std430, binding = 0) buffer PositionBuffer {
+    vec4 positions[];
+};
+
+layout (std430, binding = 1) buffer VelocitiesBuffer {
+    vec4 velocities[];
+};
+
+layout (std430, binding = 3) buffer AliveListBuffer {
+    uint aliveList[];
+};
+
+#include "shader/include/particleSort.glsl"
+
+#include "shader/include/particleEmitters.glsl"
+
+out vec2 TexCoord;
+out vec3 particleWorldPos;
+out vec4 particleColor;
+out float particleSize;
+out float particleLayer;
+out float particleSoftness;
+
+// -----------------------------------------------------------------------------
+// Uniforms
+// -----------------------------------------------------------------------------
+uniform mat4 vpMat;
+uniform vec3 camPos;
+
+// true: Instanzen aus dem Sortier-Buffer, false: aus der Liste der
+// additiven Partikel
+uniform bool sorted;
+
+/**
+ * Bestimmt das Aussehen eines Partikels aus seinem Emitter.
+ *
+ * @param index der Index des Partikels
+ * @param lifeLeft die Restlebenszeit des Partikels
+ */
+void applyEmitter(uint index, float lifeLeft)
+{
+    // Ungueltige Kennungen (z.B. im Benchmark) auf den letzten Emitter legen.
+    uint emitterId = min(uint(velocities[index].w), uint(emitters.length()) - 1u);
+    Emitter emitter = emitters[emitterId];
+
+    // Groesse und Farbe werden ueber die Lebenszeit interpoliert
+    float t = lifeLeft / (emitter.lifeTime + emitter.lifeTimeRand);
+    particleColor = vec4(mix(emitter.endColor, emitter.startColor, t), 1.0f);
+    particleSize = mix(emitter.endSize, emitter.startSize, t);
+    particleLayer = emitter.textureLayer;
+    particleSoftness = emitter.softness;
+}
+
+/**
+ * Hauptfunktion des Vertex-Shaders.
+ * Berechnet die Ecke des Quads fuer das aktuelle Partikel.
+ */
+void main()
+{
+    uint index = sorted ? sortEntries[gl_InstanceID].index : aliveList[gl_InstanceID];
+    vec4 position = positions[index];
+
+    //Groesse des Partikels mit Lebenszeit skaliert
+    applyEmitter(index, position.w);
+    float sizeFactor = particleSize;
+
+    //Ecke im Strip: (0,0), (0,1), (1,0), (1,1)
+    vec2 corner = vec2(gl_VertexID >> 1, gl_VertexID & 1);
+
+    //Vektoren zum Aufspannen der Flaeche
+    vec3 toCamera = normalize(camPos - position.xyz);
+    vec3 up = vec3(0.0, 1.0, 0.0);
+    vec3 right = cross(toCamera, up) * sizeFactor;
+
+    vec3 Pos = position.xyz + right * (corner.x - 0.5);
+    Pos.y += corner.y * sizeFactor;
+
+    gl_Position = vpMat * vec4(Pos, 1.0);
+    TexCoord = corner;
+    particleWorldPos = Pos;
+}
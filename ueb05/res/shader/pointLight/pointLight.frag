@@ -1,17 +1,15 @@
 #version 430 core
 
+/**
+ * Punktlicht-Pass des Deferred Shading.
+ * Schatten und PCF werden ueber die Defines der Permutation (LIGHT_SHADOWS,
+ * LIGHT_PCF) gewaehlt.
+ */
+
 layout (location = 0) out vec4 gFinal;
 
-struct PointLight
-{
-    vec3 pos;
-    vec3 amb;
-    vec3 diff;
-    vec3 spec;
-    float constant;
-    float linear;
-    float quadratic;
-};
+#include "shader/include/lights.glsl"
+#include "shader/include/shadow.glsl"
 
 uniform PointLight pointLight;
 
@@ -27,10 +25,7 @@ uniform int viewPortHeight;
 uniform float farPlane;
 uniform mat4 lightMVP;
 
-uniform bool useShadows;
-uniform bool usePCF;
 uniform int PCFAmount;
-uniform bool useBilinearFiltering;
 
 //20 zufaellige komplett unterschiedliche Richtungen
 vec3 sampleOffsetDirections[20] = vec3[]
@@ -42,12 +37,6 @@ vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
 vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
 ); 
 
-//Liest Textur Wert aus der ShadowMap aus und vergleicht ihn mit
-//dem übergebenen wert
-float sampleShadowMap(vec3 coords, float compare, float farPlane) {
-	return step(texture(gShadowCube, coords).r * farPlane, compare);
-}
-
 float calcShadow(vec3 fragPos)
 {
     // get vector between fragment position and light position
@@ -65,20 +54,20 @@ float calcShadow(vec3 fragPos)
     //Entspricht der Anzahl an zufaelligen Richtungen
     int samples = 20;
 
-    if(usePCF){ 
-        float viewDistance = length(camPos - fragPos);
-        //Radius in dem gesampled werden soll
-        float diskRadius = (1.0 + (viewDistance / farPlane)) / (25.0f / PCFAmount);
-
-        for(int i = 0; i < samples; ++i)
-        {
-            shadow += sampleShadowMap(fragToLight + sampleOffsetDirections[i] * diskRadius, currentDepth - bias, farPlane);
-        }
-        //Mittelwert bilden
-        shadow /= float(samples); 
-    } else {
-        shadow = step(closestDepth, currentDepth - bias);
+#ifdef LIGHT_PCF
+    float viewDistance = length(camPos - fragPos);
+    //Radius in dem gesampled werden soll
+    float diskRadius = (1.0 + (viewDistance / farPlane)) / (25.0f / PCFAmount);
+
+    for(int i = 0; i < samples; ++i)
+    {
+        shadow += sampleShadowMap(gShadowCube, fragToLight + sampleOffsetDirections[i] * diskRadius, currentDepth - bias, farPlane);
     }
+    //Mittelwert bilden
+    shadow /= float(samples); 
+#else
+    shadow = step(closestDepth, currentDepth - bias);
+#endif
 
     return shadow;
     //return closestDepth / farPlane;
@@ -115,9 +104,9 @@ vec4 calcPointLight()
 
     //Schatten berechnen
     float shadow = 0.0f;
-    if(useShadows){
-        shadow = calcShadow(pos);
-    }                      
+#ifdef LIGHT_SHADOWS
+    shadow = calcShadow(pos);
+#endif                      
     return vec4(((1.0 - shadow) * (diffuse + specular)), 1.0);
     //return vec4(vec3(shadow), 1.0);
 }
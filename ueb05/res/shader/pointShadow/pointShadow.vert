@@ -1,9 +1,20 @@
 #version 430 core
 layout (location = 0) in vec3 position;
 
-uniform mat4 model;
+uniform int instanceBase;
+
+//Weltmatrizen aller Instanzen der Szene
+layout (std430, binding = 8) readonly buffer InstanceBuffer {
+    mat4 instanceMatrices[];
+};
+
+//Sichtbare Instanzen aller Listen des Frames
+layout (std430, binding = 9) readonly buffer VisibleBuffer {
+    uint visibleInstances[];
+};
 
 void main()
 {
+    mat4 model = instanceMatrices[visibleInstances[instanceBase + gl_InstanceID]];
     gl_Position = model * vec4(position, 1.0);
 }  
\ No newline at end of file
@@ -0,0 +1,856 @@
+/**
+ * Modul für eine Bounding Volume Hierarchy über achsenparallele Boxen.
+ * Der Baum wird mit der Surface Area Heuristic über Bins aufgebaut und in
+ * Tiefensuche-Reihenfolge abgelegt. Jeder Knoten kennt den Index hinter
+ * seinem Teilbaum, sodass alle Abfragen ohne Stack in einer einfachen
+ * Schleife über das Knotenarray laufen. Bewegte Primitive werden durch
+ * Anpassen der Boxen (Refit) übernommen, ohne den Baum neu aufzubauen.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "bvh.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+// Der Frustum-Test prüft mit SSE vier Ebenen gleichzeitig. SSE ist auf
+// x86-64 immer vorhanden, andernfalls wird skalar getestet.
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define BVH_HAS_SSE
+#include <xmmintrin.h>
+#endif
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Maximale Anzahl an Primitiven in einem Blatt.
+#define BVH_MAX_LEAF_SIZE 4
+
+// Anzahl der Bins pro Achse beim Aufbau.
+#define BVH_BINS 16
+
+// Anzahl der Ebenen im Frustum-Test, auf ein Vielfaches von vier aufgefüllt.
+#define BVH_PLANES 8
+
+// Ab diesem Anteil bewegter Primitive wird der gesamte Baum angepasst.
+#define BVH_FULL_REFIT_DIVISOR 16
+
+// Ergebnisse der Volumentests.
+#define BVH_OUTSIDE 0
+#define BVH_INTERSECTS 1
+#define BVH_INSIDE 2
+
+// Parameter des Benchmarks.
+#define BVH_BENCHMARK_COUNT 100000
+#define BVH_BENCHMARK_MOVED 1000
+#define BVH_BENCHMARK_RAYS 10000
+#define BVH_BENCHMARK_LINEAR_RAYS 100
+#define BVH_BENCHMARK_WORLD 1000.0f
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Ein Knoten der BVH. Das linke Kind liegt direkt hinter dem Knoten, das
+// rechte Kind am escape-Index des linken Kindes. Ein Knoten ist ein Blatt,
+// wenn sein escape-Index direkt auf ihn folgt.
+struct BvhNode
+{
+    float min[4];  // Nur xyz benutzt, 16 Byte für SIMD-Zugriffe
+    float max[4];
+    int escape;    // Erster Knoten hinter dem Teilbaum
+    int primStart; // Erstes Primitiv des Teilbaums in prims
+    int primCount; // Anzahl der Primitive im gesamten Teilbaum
+    int parent;    // Elternknoten oder -1
+};
+typedef struct BvhNode BvhNode;
+
+// Datenstruktur für eine Bounding Volume Hierarchy.
+struct Bvh
+{
+    BvhNode* nodes;
+    int nodeCount;
+
+    int* prims;            // Primitive in der Reihenfolge der Blätter
+    BvhBounds* primBounds; // Boxen der Primitive in derselben Reihenfolge
+    int* primLeaf;         // Blatt jedes Primitivs
+    int count;
+};
+
+// Zwischendaten beim Aufbau.
+struct BvhBuilder
+{
+    Bvh* bvh;
+    const BvhBounds* bounds;
+    vec3* centroids;
+};
+typedef struct BvhBuilder BvhBuilder;
+
+// Ein Bin beim Auswerten der Surface Area Heuristic.
+struct BvhBin
+{
+    vec3 min;
+    vec3 max;
+    int count;
+};
+typedef struct BvhBin BvhBin;
+
+// Frustum-Ebenen als Structure of Arrays für den SIMD-Test.
+struct BvhPlanes
+{
+    float nx[BVH_PLANES];
+    float ny[BVH_PLANES];
+    float nz[BVH_PLANES];
+    float d[BVH_PLANES];
+    float ax[BVH_PLANES]; // Beträge der Normalen
+    float ay[BVH_PLANES];
+    float az[BVH_PLANES];
+};
+typedef struct BvhPlanes BvhPlanes;
+
+// Genauer Schnitttest des Benchmarks.
+struct BvhBenchmarkRay
+{
+    const BvhBounds* bounds;
+};
+typedef struct BvhBenchmarkRay BvhBenchmarkRay;
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Leert eine Box, sodass jede Vereinigung sie überschreibt.
+ *
+ * @param min minimale Ecke
+ * @param max maximale Ecke
+ */
+static void bvh_emptyBox(vec3 min, vec3 max)
+{
+    min[0] = min[1] = min[2] = FLT_MAX;
+    max[0] = max[1] = max[2] = -FLT_MAX;
+}
+
+/**
+ * Erweitert eine Box um eine andere Box.
+ *
+ * @param min minimale Ecke der Zielbox
+ * @param max maximale Ecke der Zielbox
+ * @param otherMin minimale Ecke der hinzuzufügenden Box
+ * @param otherMax maximale Ecke der hinzuzufügenden Box
+ */
+static void bvh_growBox(float* min, float* max, const float* otherMin,
+                        const float* otherMax)
+{
+    for (int a = 0; a < 3; a++)
+    {
+        min[a] = otherMin[a] < min[a] ? otherMin[a] : min[a];
+        max[a] = otherMax[a] > max[a] ? otherMax[a] : max[a];
+    }
+}
+
+/**
+ * Berechnet die halbe Oberfläche einer Box.
+ *
+ * @param min minimale Ecke
+ * @param max maximale Ecke
+ * @return die halbe Oberfläche, 0 für leere Boxen
+ */
+static float bvh_halfArea(const float* min, const float* max)
+{
+    float dx = max[0] - min[0];
+    float dy = max[1] - min[1];
+    float dz = max[2] - min[2];
+    if (dx < 0.0f || dy < 0.0f || dz < 0.0f)
+    {
+        return 0.0f;
+    }
+    return dx * dy + dy * dz + dz * dx;
+}
+
+/**
+ * Berechnet die Box eines Knotens aus seinen Primitiven bzw. Kindern neu.
+ *
+ * @param bvh die BVH
+ * @param bounds die Boxen der Primitive
+ * @param index der Knoten
+ */
+static void bvh_refitNode(Bvh* bvh, const BvhBounds* bounds, int index)
+{
+    BvhNode* node = &bvh->nodes[index];
+    bvh_emptyBox(node->min, node->max);
+
+    if (node->escape == index + 1)
+    {
+        // Die Boxen der Primitive werden für die Tests in den Blättern
+        // zusammenhängend kopiert.
+        for (int i = node->primStart; i < node->primStart + node->primCount; i++)
+        {
+            bvh->primBounds[i] = bounds[bvh->prims[i]];
+            bvh_growBox(node->min, node->max, bvh->primBounds[i].min,
+                        bvh->primBounds[i].max);
+        }
+    }
+    else
+    {
+        BvhNode* left = &bvh->nodes[index + 1];
+        BvhNode* right = &bvh->nodes[left->escape];
+        bvh_growBox(node->min, node->max, left->min, left->max);
+        bvh_growBox(node->min, node->max, right->min, right->max);
+    }
+}
+
+/**
+ * Baut einen Teilbaum über einen Bereich der Primitive rekursiv auf.
+ * Der Knoten wird vor seinen Kindern angelegt, sodass die Knoten in
+ * Tiefensuche-Reihenfolge im Array liegen.
+ *
+ * @param b die Zwischendaten des Aufbaus
+ * @param parent der Elternknoten oder -1
+ * @param begin erstes Primitiv des Bereichs
+ * @param end Ende des Bereichs
+ */
+static void bvh_buildNode(BvhBuilder* b, int parent, int begin, int end)
+{
+    Bvh* bvh = b->bvh;
+    int index = bvh->nodeCount++;
+    BvhNode* node = &bvh->nodes[index];
+    int count = end - begin;
+
+    node->parent = parent;
+    node->primStart = begin;
+    node->primCount = count;
+
+    // Box des Knotens und der Mittelpunkte bestimmen.
+    vec3 cMin, cMax;
+    bvh_emptyBox(node->min, node->max);
+    bvh_emptyBox(cMin, cMax);
+    for (int i = begin; i < end; i++)
+    {
+        int prim = bvh->prims[i];
+        bvh_growBox(node->min, node->max, b->bounds[prim].min, b->bounds[prim].max);
+        bvh_growBox(cMin, cMax, b->centroids[prim], b->centroids[prim]);
+    }
+
+    if (count <= BVH_MAX_LEAF_SIZE)
+    {
+        node->escape = index + 1;
+        for (int i = begin; i < end; i++)
+        {
+            bvh->primLeaf[bvh->prims[i]] = index;
+            bvh->primBounds[i] = b->bounds[bvh->prims[i]];
+        }
+        return;
+    }
+
+    // Beste Teilung über alle Achsen mit der Surface Area Heuristic suchen.
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    int bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = cMax[axis] - cMin[axis];
+        if (extent <= 0.0f)
+        {
+            continue;
+        }
+
+        BvhBin bins[BVH_BINS];
+        for (int k = 0; k < BVH_BINS; k++)
+        {
+            bvh_emptyBox(bins[k].min, bins[k].max);
+            bins[k].count = 0;
+        }
+
+        float scale = BVH_BINS / extent;
+        for (int i = begin; i < end; i++)
+        {
+            int prim = bvh->prims[i];
+            int k = (int)((b->centroids[prim][axis] - cMin[axis]) * scale);
+            k = k < BVH_BINS - 1 ? k : BVH_BINS - 1;
+            bins[k].count++;
+            bvh_growBox(bins[k].min, bins[k].max, b->bounds[prim].min, b->bounds[prim].max);
+        }
+
+        // Von rechts die Flächen und Anzahlen aufsummieren, danach von
+        // links alle Teilungen bewerten.
+        float rightArea[BVH_BINS];
+        int rightCount[BVH_BINS];
+        vec3 rMin, rMax;
+        bvh_emptyBox(rMin, rMax);
+        int n = 0;
+        for (int k = BVH_BINS - 1; k > 0; k--)
+        {
+            bvh_growBox(rMin, rMax, bins[k].min, bins[k].max);
+            n += bins[k].count;
+            rightArea[k] = bvh_halfArea(rMin, rMax);
+            rightCount[k] = n;
+        }
+
+        vec3 lMin, lMax;
+        bvh_emptyBox(lMin, lMax);
+        n = 0;
+        for (int k = 0; k < BVH_BINS - 1; k++)
+        {
+            bvh_growBox(lMin, lMax, bins[k].min, bins[k].max);
+            n += bins[k].count;
+            float cost = bvh_halfArea(lMin, lMax) * n
+                       + rightArea[k + 1] * rightCount[k + 1];
+            if (n > 0 && rightCount[k + 1] > 0 && cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = k + 1;
+            }
+        }
+    }
+
+    // Primitive nach der gewählten Teilung aufteilen. Liegen alle
+    // Mittelpunkte aufeinander, wird in der Mitte geteilt.
+    int mid = begin + count / 2;
+    if (bestAxis >= 0)
+    {
+        float scale = BVH_BINS / (cMax[bestAxis] - cMin[bestAxis]);
+        int i = begin;
+        int j = end - 1;
+        while (i <= j)
+        {
+            int k = (int)((b->centroids[bvh->prims[i]][bestAxis] - cMin[bestAxis]) * scale);
+            k = k < BVH_BINS - 1 ? k : BVH_BINS - 1;
+            if (k < bestSplit)
+            {
+                i++;
+            }
+            else
+            {
+                int tmp = bvh->prims[i];
+                bvh->prims[i] = bvh->prims[j];
+                bvh->prims[j] = tmp;
+                j--;
+            }
+        }
+        if (i > begin && i < end)
+        {
+            mid = i;
+        }
+    }
+
+    bvh_buildNode(b, index, begin, mid);
+    bvh_buildNode(b, index, mid, end);
+
+    // Das Array kann sich nicht verschieben, da es vorab reserviert wurde.
+    node->escape = bvh->nodeCount;
+}
+
+/**
+ * Bereitet die Frustum-Ebenen für den SIMD-Test vor. Die zusätzlichen
+ * Ebenen werden so gewählt, dass jede Box vollständig innen liegt.
+ *
+ * @param planes die sechs Ebenen
+ * @param p Ziel für die aufbereiteten Ebenen
+ */
+static void bvh_preparePlanes(vec4 planes[6], BvhPlanes* p)
+{
+    for (int k = 0; k < BVH_PLANES; k++)
+    {
+        bool used = k < 6;
+        p->nx[k] = used ? planes[k][0] : 0.0f;
+        p->ny[k] = used ? planes[k][1] : 0.0f;
+        p->nz[k] = used ? planes[k][2] : 0.0f;
+        p->d[k] = used ? planes[k][3] : 1.0f;
+        p->ax[k] = fabsf(p->nx[k]);
+        p->ay[k] = fabsf(p->ny[k]);
+        p->az[k] = fabsf(p->nz[k]);
+    }
+}
+
+/**
+ * Testet eine Box gegen das Frustum. Für jede Ebene werden der Abstand des
+ * Mittelpunkts und der auf die Normale projizierte Radius verglichen.
+ *
+ * @param p die aufbereiteten Ebenen
+ * @param min minimale Ecke der Box
+ * @param max maximale Ecke der Box
+ * @return BVH_OUTSIDE, BVH_INTERSECTS oder BVH_INSIDE
+ */
+static int bvh_testFrustum(const BvhPlanes* p, const float* min, const float* max)
+{
+    float cx = (min[0] + max[0]) * 0.5f;
+    float cy = (min[1] + max[1]) * 0.5f;
+    float cz = (min[2] + max[2]) * 0.5f;
+    float ex = (max[0] - min[0]) * 0.5f;
+    float ey = (max[1] - min[1]) * 0.5f;
+    float ez = (max[2] - min[2]) * 0.5f;
+
+#ifdef BVH_HAS_SSE
+    __m128 vcx = _mm_set1_ps(cx), vcy = _mm_set1_ps(cy), vcz = _mm_set1_ps(cz);
+    __m128 vex = _mm_set1_ps(ex), vey = _mm_set1_ps(ey), vez = _mm_set1_ps(ez);
+    __m128 zero = _mm_setzero_ps();
+    int outside = 0;
+    int intersects = 0;
+    for (int k = 0; k < BVH_PLANES; k += 4)
+    {
+        __m128 d = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&p->nx[k]), vcx),
+                       _mm_mul_ps(_mm_loadu_ps(&p->ny[k]), vcy)),
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&p->nz[k]), vcz),
+                       _mm_loadu_ps(&p->d[k])));
+        __m128 r = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&p->ax[k]), vex),
+                       _mm_mul_ps(_mm_loadu_ps(&p->ay[k]), vey)),
+            _mm_mul_ps(_mm_loadu_ps(&p->az[k]), vez));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(d, r), zero));
+        intersects |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(d, r), zero));
+    }
+#else
+    bool outside = false;
+    bool intersects = false;
+    for (int k = 0; k < BVH_PLANES; k++)
+    {
+        float d = p->nx[k] * cx + p->ny[k] * cy + p->nz[k] * cz + p->d[k];
+        float r = p->ax[k] * ex + p->ay[k] * ey + p->az[k] * ez;
+        outside |= d + r < 0.0f;
+        intersects |= d - r < 0.0f;
+    }
+#endif
+
+    if (outside)
+    {
+        return BVH_OUTSIDE;
+    }
+    return intersects ? BVH_INTERSECTS : BVH_INSIDE;
+}
+
+/**
+ * Testet eine Box gegen eine Kugel.
+ *
+ * @param center der Mittelpunkt der Kugel
+ * @param radius2 das Quadrat des Radius
+ * @param min minimale Ecke der Box
+ * @param max maximale Ecke der Box
+ * @return BVH_OUTSIDE, BVH_INTERSECTS oder BVH_INSIDE
+ */
+static int bvh_testSphere(const float* center, float radius2,
+                          const float* min, const float* max)
+{
+    // Abstand zum nächsten und zum entferntesten Punkt der Box.
+    float nearDist = 0.0f;
+    float farDist = 0.0f;
+    for (int a = 0; a < 3; a++)
+    {
+        float toMin = center[a] - min[a];
+        float toMax = max[a] - center[a];
+        float outside = fmaxf(0.0f, fmaxf(-toMin, -toMax));
+        float farthest = fmaxf(fabsf(toMin), fabsf(toMax));
+        nearDist += outside * outside;
+        farDist += farthest * farthest;
+    }
+
+    if (nearDist > radius2)
+    {
+        return BVH_OUTSIDE;
+    }
+    return farDist <= radius2 ? BVH_INSIDE : BVH_INTERSECTS;
+}
+
+/**
+ * Schneidet einen Strahl mit einer Box (Slab-Test).
+ *
+ * @param origin der Ursprung des Strahls
+ * @param invDir die Kehrwerte der Richtung
+ * @param min minimale Ecke der Box
+ * @param max maximale Ecke der Box
+ * @param maxT maximale Entfernung
+ * @param tNear Ausgabe für die Eintrittsentfernung
+ * @return true, wenn die Box vor maxT getroffen wird
+ */
+static bool bvh_testRay(const float* origin, const float* invDir,
+                        const float* min, const float* max, float maxT,
+                        float* tNear)
+{
+    float t0 = 0.0f;
+    float t1 = maxT;
+    for (int a = 0; a < 3; a++)
+    {
+        float ta = (min[a] - origin[a]) * invDir[a];
+        float tb = (max[a] - origin[a]) * invDir[a];
+        t0 = fmaxf(t0, fminf(ta, tb));
+        t1 = fminf(t1, fmaxf(ta, tb));
+    }
+    *tNear = t0;
+    return t0 <= t1;
+}
+
+/**
+ * Schnitttest des Benchmarks: der Strahl wird mit der Box geschnitten.
+ */
+static bool bvh_benchmarkRayFunc(void* arg, int prim, vec3 origin, vec3 dir,
+                                 float maxT, float* t)
+{
+    BvhBenchmarkRay* ray = arg;
+    vec3 invDir = {1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2]};
+    return bvh_testRay(origin, invDir, ray->bounds[prim].min,
+                       ray->bounds[prim].max, maxT, t);
+}
+
+/**
+ * Erzeugt eine Zufallszahl zwischen 0 und 1.
+ *
+ * @param state der Zustand des Generators
+ * @return die Zufallszahl
+ */
+static float bvh_random(unsigned int* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (float)(*state >> 8) / 16777216.0f;
+}
+
+/**
+ * Erzeugt eine zufällige Box innerhalb der Benchmark-Welt.
+ *
+ * @param state der Zustand des Generators
+ * @param b Ziel für die Box
+ */
+static void bvh_randomBox(unsigned int* state, BvhBounds* b)
+{
+    for (int a = 0; a < 3; a++)
+    {
+        float center = (bvh_random(state) - 0.5f) * BVH_BENCHMARK_WORLD;
+        float half = 0.25f + bvh_random(state) * 1.5f;
+        b->min[a] = center - half;
+        b->max[a] = center + half;
+    }
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+Bvh* bvh_build(const BvhBounds* bounds, int count)
+{
+    Bvh* bvh = malloc(sizeof(Bvh));
+    memset(bvh, 0, sizeof(Bvh));
+    bvh->count = count;
+
+    // Ein binärer Baum mit n Blättern hat höchstens 2n - 1 Knoten.
+    bvh->nodes = malloc(sizeof(BvhNode) * (2 * count + 1));
+    bvh->prims = malloc(sizeof(int) * (count + 1));
+    bvh->primBounds = malloc(sizeof(BvhBounds) * (count + 1));
+    bvh->primLeaf = malloc(sizeof(int) * (count + 1));
+    if (!bvh->nodes || !bvh->prims || !bvh->primBounds || !bvh->primLeaf)
+    {
+        fprintf(stderr, "Error: Could not allocate BVH!\n");
+        bvh_deleteBvh(bvh);
+        return NULL;
+    }
+
+    if (count == 0)
+    {
+        return bvh;
+    }
+
+    BvhBuilder builder;
+    builder.bvh = bvh;
+    builder.bounds = bounds;
+    builder.centroids = malloc(sizeof(vec3) * count);
+    for (int i = 0; i < count; i++)
+    {
+        bvh->prims[i] = i;
+        glm_vec3_add((float*)bounds[i].min, (float*)bounds[i].max, builder.centroids[i]);
+        glm_vec3_scale(builder.centroids[i], 0.5f, builder.centroids[i]);
+    }
+
+    bvh_buildNode(&builder, -1, 0, count);
+    free(builder.centroids);
+
+    return bvh;
+}
+
+void bvh_refit(Bvh* bvh, const BvhBounds* bounds, const int* moved,
+               int movedCount)
+{
+    if (bvh == NULL || bvh->nodeCount == 0)
+    {
+        return;
+    }
+
+    // Bei vielen bewegten Primitiven ist ein Durchlauf über alle Knoten
+    // günstiger. Kinder liegen immer hinter ihren Eltern.
+    if (moved == NULL || movedCount > bvh->count / BVH_FULL_REFIT_DIVISOR)
+    {
+        for (int i = bvh->nodeCount - 1; i >= 0; i--)
+        {
+            bvh_refitNode(bvh, bounds, i);
+        }
+        return;
+    }
+
+    for (int m = 0; m < movedCount; m++)
+    {
+        int index = bvh->primLeaf[moved[m]];
+        while (index >= 0)
+        {
+            bvh_refitNode(bvh, bounds, index);
+            index = bvh->nodes[index].parent;
+        }
+    }
+}
+
+int bvh_queryFrustum(const Bvh* bvh, vec4 planes[6], int* out)
+{
+    BvhPlanes p;
+    bvh_preparePlanes(planes, &p);
+
+    int found = 0;
+    int i = 0;
+    while (i < bvh->nodeCount)
+    {
+        const BvhNode* node = &bvh->nodes[i];
+        int result = bvh_testFrustum(&p, node->min, node->max);
+
+        // Vollständig sichtbare Teilbäume werden ohne weitere Tests
+        // übernommen, da ihre Primitive zusammenhängend liegen.
+        if (result == BVH_INSIDE)
+        {
+            memcpy(&out[found], &bvh->prims[node->primStart],
+                   sizeof(int) * node->primCount);
+            found += node->primCount;
+        }
+        else if (result == BVH_INTERSECTS && node->escape == i + 1)
+        {
+            for (int k = node->primStart; k < node->primStart + node->primCount; k++)
+            {
+                if (bvh_testFrustum(&p, bvh->primBounds[k].min,
+                                    bvh->primBounds[k].max) != BVH_OUTSIDE)
+                {
+                    out[found++] = bvh->prims[k];
+                }
+            }
+        }
+        i = result == BVH_INTERSECTS ? i + 1 : node->escape;
+    }
+
+    return found;
+}
+
+int bvh_querySphere(const Bvh* bvh, vec3 center, float radius, int* out)
+{
+    float radius2 = radius * radius;
+    int found = 0;
+    int i = 0;
+    while (i < bvh->nodeCount)
+    {
+        const BvhNode* node = &bvh->nodes[i];
+        int result = bvh_testSphere(center, radius2, node->min, node->max);
+
+        if (result == BVH_INSIDE)
+        {
+            memcpy(&out[found], &bvh->prims[node->primStart],
+                   sizeof(int) * node->primCount);
+            found += node->primCount;
+        }
+        else if (result == BVH_INTERSECTS && node->escape == i + 1)
+        {
+            for (int k = node->primStart; k < node->primStart + node->primCount; k++)
+            {
+                if (bvh_testSphere(center, radius2, bvh->primBounds[k].min,
+                                   bvh->primBounds[k].max) != BVH_OUTSIDE)
+                {
+                    out[found++] = bvh->prims[k];
+                }
+            }
+        }
+        i = result == BVH_INTERSECTS ? i + 1 : node->escape;
+    }
+
+    return found;
+}
+
+int bvh_raycast(const Bvh* bvh, vec3 origin, vec3 dir, BvhRayFunction func,
+                void* arg, float* t)
+{
+    vec3 invDir = {1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2]};
+    float bestT = FLT_MAX;
+    int bestPrim = -1;
+
+    int i = 0;
+    while (i < bvh->nodeCount)
+    {
+        const BvhNode* node = &bvh->nodes[i];
+        float tNear;
+        if (!bvh_testRay(origin, invDir, node->min, node->max, bestT, &tNear))
+        {
+            i = node->escape;
+            continue;
+        }
+
+        if (node->escape == i + 1)
+        {
+            for (int k = node->primStart; k < node->primStart + node->primCount; k++)
+            {
+                float primT;
+                if (bvh_testRay(origin, invDir, bvh->primBounds[k].min,
+                                bvh->primBounds[k].max, bestT, &primT)
+                    && func(arg, bvh->prims[k], origin, dir, bestT, &primT)
+                    && primT < bestT)
+                {
+                    bestT = primT;
+                    bestPrim = bvh->prims[k];
+                }
+            }
+        }
+        i++;
+    }
+
+    *t = bestT;
+    return bestPrim;
+}
+
+int bvh_getCount(const Bvh* bvh)
+{
+    return bvh->count;
+}
+
+void bvh_benchmark(void)
+{
+    printf("BVH-Benchmark (%d Instanzen):\n", BVH_BENCHMARK_COUNT);
+
+    unsigned int seed = 12345u;
+    BvhBounds* bounds = malloc(sizeof(BvhBounds) * BVH_BENCHMARK_COUNT);
+    int* result = malloc(sizeof(int) * BVH_BENCHMARK_COUNT);
+    int* moved = malloc(sizeof(int) * BVH_BENCHMARK_MOVED);
+    bool* hit = malloc(sizeof(bool) * BVH_BENCHMARK_COUNT);
+    for (int i = 0; i < BVH_BENCHMARK_COUNT; i++)
+    {
+        bvh_randomBox(&seed, &bounds[i]);
+    }
+
+    // Aufbau
+    double start = glfwGetTime();
+    Bvh* bvh = bvh_build(bounds, BVH_BENCHMARK_COUNT);
+    double buildTime = (glfwGetTime() - start) * 1e3;
+
+    // Frustum einer Kamera in der Mitte der Welt.
+    mat4 proj, view, viewProj;
+    vec4 planes[6];
+    vec3 eye = {0.0f, 0.0f, 0.0f};
+    vec3 center = {1.0f, 0.2f, 0.5f};
+    vec3 up = {0.0f, 1.0f, 0.0f};
+    glm_perspective(glm_rad(60.0f), 16.0f / 9.0f, 0.1f, 300.0f, proj);
+    glm_lookat(eye, center, up, view);
+    glm_mat4_mul(proj, view, viewProj);
+    glm_frustum_planes(viewProj, planes);
+
+    start = glfwGetTime();
+    int bvhCount = bvh_queryFrustum(bvh, planes, result);
+    double frustumTime = (glfwGetTime() - start) * 1e3;
+
+    BvhPlanes p;
+    bvh_preparePlanes(planes, &p);
+    start = glfwGetTime();
+    int linearCount = 0;
+    for (int i = 0; i < BVH_BENCHMARK_COUNT; i++)
+    {
+        hit[i] = bvh_testFrustum(&p, bounds[i].min, bounds[i].max) != BVH_OUTSIDE;
+        linearCount += hit[i];
+    }
+    double linearTime = (glfwGetTime() - start) * 1e3;
+
+    // Jede linear gefundene Instanz muss auch in der BVH gefunden werden.
+    int missing = linearCount;
+    for (int i = 0; i < bvhCount; i++)
+    {
+        missing -= hit[result[i]];
+        hit[result[i]] = false;
+    }
+
+    // Strahlen durch die Welt.
+    BvhBenchmarkRay rayArg = {bounds};
+    vec3* origins = malloc(sizeof(vec3) * BVH_BENCHMARK_RAYS);
+    vec3* dirs = malloc(sizeof(vec3) * BVH_BENCHMARK_RAYS);
+    for (int r = 0; r < BVH_BENCHMARK_RAYS; r++)
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            origins[r][a] = (bvh_random(&seed) - 0.5f) * BVH_BENCHMARK_WORLD;
+            dirs[r][a] = bvh_random(&seed) - 0.5f;
+        }
+        glm_vec3_normalize(dirs[r]);
+    }
+
+    start = glfwGetTime();
+    int rayHits = 0;
+    for (int r = 0; r < BVH_BENCHMARK_RAYS; r++)
+    {
+        float t;
+        rayHits += bvh_raycast(bvh, origins[r], dirs[r], bvh_benchmarkRayFunc, &rayArg, &t) >= 0;
+    }
+    double rayTime = (glfwGetTime() - start) * 1e6 / BVH_BENCHMARK_RAYS;
+
+    start = glfwGetTime();
+    int rayMismatches = 0;
+    for (int r = 0; r < BVH_BENCHMARK_LINEAR_RAYS; r++)
+    {
+        float bestT = FLT_MAX;
+        for (int i = 0; i < BVH_BENCHMARK_COUNT; i++)
+        {
+            float t;
+            if (bvh_benchmarkRayFunc(&rayArg, i, origins[r], dirs[r], bestT, &t) && t < bestT)
+            {
+                bestT = t;
+            }
+        }
+
+        float bvhT;
+        bvh_raycast(bvh, origins[r], dirs[r], bvh_benchmarkRayFunc, &rayArg, &bvhT);
+        rayMismatches += bvhT != bestT;
+    }
+    double linearRayTime = (glfwGetTime() - start) * 1e6 / BVH_BENCHMARK_LINEAR_RAYS;
+
+    // Einige Instanzen leicht verschieben und nur ihre Pfade anpassen.
+    for (int m = 0; m < BVH_BENCHMARK_MOVED; m++)
+    {
+        moved[m] = (int)(bvh_random(&seed) * (BVH_BENCHMARK_COUNT - 1));
+        for (int a = 0; a < 3; a++)
+        {
+            float offset = bvh_random(&seed) - 0.5f;
+            bounds[moved[m]].min[a] += offset;
+            bounds[moved[m]].max[a] += offset;
+        }
+    }
+    start = glfwGetTime();
+    bvh_refit(bvh, bounds, moved, BVH_BENCHMARK_MOVED);
+    double movedTime = (glfwGetTime() - start) * 1e3;
+
+    start = glfwGetTime();
+    bvh_refit(bvh, bounds, NULL, 0);
+    double refitTime = (glfwGetTime() - start) * 1e3;
+
+    printf("  Aufbau (SAH):           %8.2f ms\n", buildTime);
+    printf("  Refit (%d bewegt):    %8.3f ms\n", BVH_BENCHMARK_MOVED, movedTime);
+    printf("  Refit (alle):           %8.3f ms\n", refitTime);
+    printf("  Frustum BVH:            %8.3f ms (%d Instanzen)\n", frustumTime, bvhCount);
+    printf("  Frustum linear:         %8.3f ms (%d Instanzen)\n", linearTime, linearCount);
+    printf("  Strahl BVH:             %8.2f us (%d Treffer)\n", rayTime, rayHits);
+    printf("  Strahl linear:          %8.2f us\n", linearRayTime);
+    printf("  Pruefung: %s\n",
+           missing == 0 && rayMismatches == 0 ? "ok" : "FEHLER");
+
+    free(origins);
+    free(dirs);
+    bvh_deleteBvh(bvh);
+    free(hit);
+    free(moved);
+    free(result);
+    free(bounds);
+}
+
+void bvh_deleteBvh(Bvh* bvh)
+{
+    if (bvh == NULL)
+    {
+        return;
+    }
+
+    free(bvh->nodes);
+    free(bvh->prims);
+    free(bvh->primBounds);
+    free(bvh->primLeaf);
+    free(bvh);
+}
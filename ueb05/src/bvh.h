@@ -0,0 +1,120 @@
+/**
+ * Modul für eine Bounding Volume Hierarchy über achsenparallele Boxen.
+ * Der Baum wird mit der Surface Area Heuristic über Bins aufgebaut und in
+ * Tiefensuche-Reihenfolge abgelegt. Jeder Knoten kennt den Index hinter
+ * seinem Teilbaum, sodass alle Abfragen ohne Stack in einer einfachen
+ * Schleife über das Knotenarray laufen. Bewegte Primitive werden durch
+ * Anpassen der Boxen (Refit) übernommen, ohne den Baum neu aufzubauen.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "common.h"
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Achsenparallele Box eines Primitivs.
+struct BvhBounds
+{
+    vec3 min;
+    vec3 max;
+};
+typedef struct BvhBounds BvhBounds;
+
+// Datenstruktur für eine Bounding Volume Hierarchy.
+struct Bvh;
+typedef struct Bvh Bvh;
+
+// Funktion für den genauen Schnitttest eines Strahls mit einem Primitiv.
+// Liefert true und die Entfernung, wenn der Strahl das Primitiv vor maxT
+// trifft.
+typedef bool (*BvhRayFunction)(void* arg, int prim, vec3 origin, vec3 dir,
+                               float maxT, float* t);
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Baut eine neue BVH über die übergebenen Boxen auf.
+ *
+ * @param bounds die Boxen der Primitive
+ * @param count die Anzahl der Primitive
+ * @return die neue BVH
+ */
+Bvh* bvh_build(const BvhBounds* bounds, int count);
+
+/**
+ * Passt die Boxen der BVH an geänderte Primitive an. Die Struktur des
+ * Baums bleibt dabei erhalten. Bei wenigen bewegten Primitiven werden nur
+ * ihre Pfade zur Wurzel angepasst, sonst der gesamte Baum.
+ *
+ * @param bvh die BVH
+ * @param bounds die aktuellen Boxen aller Primitive
+ * @param moved die Indizes der bewegten Primitive oder NULL für alle
+ * @param movedCount die Anzahl der bewegten Primitive
+ */
+void bvh_refit(Bvh* bvh, const BvhBounds* bounds, const int* moved,
+               int movedCount);
+
+/**
+ * Sucht alle Primitive, deren Box das Frustum schneidet.
+ *
+ * @param bvh die BVH
+ * @param planes die sechs Ebenen des Frustums, Normalen zeigen nach innen
+ * @param out Ziel für die Indizes, muss Platz für alle Primitive haben
+ * @return die Anzahl der gefundenen Primitive
+ */
+int bvh_queryFrustum(const Bvh* bvh, vec4 planes[6], int* out);
+
+/**
+ * Sucht alle Primitive, deren Box eine Kugel schneidet.
+ *
+ * @param bvh die BVH
+ * @param center der Mittelpunkt der Kugel
+ * @param radius der Radius der Kugel
+ * @param out Ziel für die Indizes, muss Platz für alle Primitive haben
+ * @return die Anzahl der gefundenen Primitive
+ */
+int bvh_querySphere(const Bvh* bvh, vec3 center, float radius, int* out);
+
+/**
+ * Sucht das nächste Primitiv entlang eines Strahls. Für jedes Primitiv,
+ * dessen Box getroffen wird, wird der genaue Schnitttest aufgerufen.
+ *
+ * @param bvh die BVH
+ * @param origin der Ursprung des Strahls
+ * @param dir die Richtung des Strahls
+ * @param func der genaue Schnitttest
+ * @param arg das Argument des Schnitttests
+ * @param t Ausgabe für die Entfernung des Treffers
+ * @return der Index des getroffenen Primitivs oder -1
+ */
+int bvh_raycast(const Bvh* bvh, vec3 origin, vec3 dir, BvhRayFunction func,
+                void* arg, float* t);
+
+/**
+ * Liefert die Anzahl der Primitive einer BVH.
+ *
+ * @param bvh die BVH
+ * @return die Anzahl der Primitive
+ */
+int bvh_getCount(const Bvh* bvh);
+
+/**
+ * Misst Aufbau, Refit und Abfragen mit 100.000 zufälligen Instanzen und
+ * vergleicht sie mit einer linearen Suche. Das Ergebnis wird auf der
+ * Konsole ausgegeben.
+ */
+void bvh_benchmark(void);
+
+/**
+ * Löscht eine BVH.
+ *
+ * @param bvh die zu löschende BVH
+ */
+void bvh_deleteBvh(Bvh* bvh);
+
+#endif // BVH_H
@@ -188,3 +188,8 @@ void camera_deleteCamera(Camera* camera)
 vec3* camera_getCameraPos(Camera* camera){
     return &(camera->position);
 }
+
+vec3* camera_getCameraFront(Camera* camera)
+{
+    return &(camera->front);
+}
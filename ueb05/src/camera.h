@@ -100,4 +100,12 @@ void camera_processMouseZoom(Camera* camera, float offset);
 void camera_deleteCamera(Camera* camera);
 
 vec3* camera_getCameraPos(Camera* camera);
+
+/**
+ * Liefert die normierte Blickrichtung einer Kamera.
+ * 
+ * @param camera die Kamera
+ * @return die Blickrichtung
+ */
+vec3* camera_getCameraFront(Camera* camera);
 #endif // CAMERA_H
@@ -0,0 +1,541 @@
+/**
+ * Modul für Screenshots und Aufnahmen des Fensterinhalts.
+ * Der Backbuffer wird am Ende jedes Frames mit glReadPixels in einen Ring
+ * aus Pixel Buffer Objects gelesen, ohne auf die GPU zu warten. Erst wenn
+ * der Fence eines Buffers einige Frames später erreicht ist, wird er
+ * gemappt und das Bild an einen eigenen Schreib-Thread übergeben. Dieser
+ * kodiert PNG Dateien über das Job-System oder hängt die Bilder an ein
+ * Rohvideo an.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "capture.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sesp/stb_image.h>
+
+#include "thread.h"
+#include "jobs.h"
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Anzahl der Pixel Buffer im Ring. So viele Frames darf das Auslesen
+// hinter dem Zeichnen liegen, bevor gewartet werden muss.
+#define CAPTURE_RING_SIZE 4
+
+// Maximale Anzahl an Bildern, die auf den Schreib-Thread warten.
+#define CAPTURE_MAX_QUEUED 8
+
+// Wartezeit auf einen Fence, wenn der Ring voll ist (Nanosekunden).
+#define CAPTURE_FENCE_TIMEOUT 1000000000
+
+// Länge der Dateinamen inklusive Nullterminator.
+#define CAPTURE_FILENAME_SIZE 64
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Wozu ein ausgelesenes Bild verwendet wird.
+enum CaptureKind
+{
+    CAPTURE_KIND_SCREENSHOT,
+    CAPTURE_KIND_PNG,
+    CAPTURE_KIND_VIDEO,
+    CAPTURE_KIND_VIDEO_END // Schließt das Rohvideo, enthält keine Pixel
+};
+typedef enum CaptureKind CaptureKind;
+
+// Ein Pixel Buffer im Ring.
+struct CaptureSlot
+{
+    GLuint buffer;
+    GLsizeiptr size;
+    GLsync fence;
+    CaptureKind kind;
+    int width;
+    int height;
+    char filename[CAPTURE_FILENAME_SIZE];
+};
+typedef struct CaptureSlot CaptureSlot;
+
+// Ein Bild in der Warteschlange des Schreib-Threads.
+struct CaptureFrame
+{
+    CaptureKind kind;
+    int width;
+    int height;
+    unsigned char* pixels; // Zeilen von unten nach oben, wie von OpenGL
+    char filename[CAPTURE_FILENAME_SIZE];
+    struct CaptureFrame* next;
+};
+typedef struct CaptureFrame CaptureFrame;
+
+// Datentyp für alle persistenten Daten des Moduls.
+struct CaptureData
+{
+    // Nur im Hauptthread benutzt.
+    CaptureSlot ring[CAPTURE_RING_SIZE];
+    int first; // Ältester ausstehender Slot
+    int count; // Anzahl ausstehender Slots
+    bool screenshotRequested;
+    bool recording;
+    CaptureMode mode;
+    int frames;
+    int width;
+    int height;
+    double startTime;
+    char name[CAPTURE_FILENAME_SIZE]; // Dateiname ohne Nummer und Endung
+
+    // Durch den Mutex geschützt.
+    Thread* thread;
+    Mutex* mutex;
+    Condition* changed; // Neue Bilder oder freier Platz in der Warteschlange
+    CaptureFrame* queueFirst;
+    CaptureFrame* queueLast;
+    int queued;
+    bool quit;
+
+    // Nur im Schreib-Thread benutzt.
+    FILE* video;
+};
+typedef struct CaptureData CaptureData;
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Schreibt ein Bild als PNG Datei. Wird als Job ausgeführt.
+ *
+ * @param arg das Bild
+ */
+static void capture_writePngJob(void* arg)
+{
+    CaptureFrame* frame = arg;
+    if (!stbi_write_png(frame->filename, frame->width, frame->height, 3, frame->pixels, 0))
+    {
+        fprintf(stderr, "Error: Could not write capture file \"%s\"!\n", frame->filename);
+    }
+}
+
+/**
+ * Hängt ein Bild an das Rohvideo an und öffnet es beim ersten Bild. Die
+ * Zeilen werden dabei von oben nach unten geschrieben.
+ *
+ * @param data die Daten des Moduls
+ * @param frame das Bild
+ */
+static void capture_writeVideo(CaptureData* data, CaptureFrame* frame)
+{
+    if (frame->kind == CAPTURE_KIND_VIDEO_END)
+    {
+        if (data->video)
+        {
+            fclose(data->video);
+            data->video = NULL;
+        }
+        return;
+    }
+
+    if (!data->video)
+    {
+        data->video = fopen(frame->filename, "wb");
+        if (!data->video)
+        {
+            fprintf(stderr, "Error: Could not open capture file \"%s\"!\n", frame->filename);
+            return;
+        }
+    }
+
+    size_t rowSize = (size_t)frame->width * 3;
+    for (int y = frame->height - 1; y >= 0; y--)
+    {
+        fwrite(frame->pixels + y * rowSize, 1, rowSize, data->video);
+    }
+}
+
+/**
+ * Einstiegspunkt des Schreib-Threads. Übernimmt immer alle wartenden Bilder
+ * auf einmal, damit PNG Dateien parallel kodiert werden können. Das
+ * Rohvideo wird in der Reihenfolge der Frames geschrieben.
+ *
+ * @param arg die Daten des Moduls
+ */
+static void capture_threadMain(void* arg)
+{
+    CaptureData* data = arg;
+
+    thread_lockMutex(data->mutex);
+    while (true)
+    {
+        while (!data->queueFirst && !data->quit)
+        {
+            thread_waitCondition(data->changed, data->mutex);
+        }
+        if (!data->queueFirst)
+        {
+            break;
+        }
+
+        CaptureFrame* frames = data->queueFirst;
+        data->queueFirst = NULL;
+        data->queueLast = NULL;
+        thread_unlockMutex(data->mutex);
+
+        JobCounter counter;
+        jobs_initCounter(&counter);
+        int count = 0;
+        for (CaptureFrame* frame = frames; frame; frame = frame->next)
+        {
+            if (frame->kind == CAPTURE_KIND_SCREENSHOT || frame->kind == CAPTURE_KIND_PNG)
+            {
+                jobs_run(&counter, capture_writePngJob, frame);
+            }
+            else
+            {
+                capture_writeVideo(data, frame);
+            }
+            count++;
+        }
+        jobs_wait(&counter);
+
+        while (frames)
+        {
+            CaptureFrame* next = frames->next;
+            free(frames->pixels);
+            free(frames);
+            frames = next;
+        }
+
+        thread_lockMutex(data->mutex);
+        data->queued -= count;
+        thread_broadcastCondition(data->changed);
+    }
+    thread_unlockMutex(data->mutex);
+
+    if (data->video)
+    {
+        fclose(data->video);
+        data->video = NULL;
+    }
+}
+
+/**
+ * Übergibt ein Bild an den Schreib-Thread. Ist die Warteschlange voll,
+ * wird gewartet, bis wieder Platz ist.
+ *
+ * @param data die Daten des Moduls
+ * @param frame das Bild, gehört danach dem Schreib-Thread
+ */
+static void capture_enqueue(CaptureData* data, CaptureFrame* frame)
+{
+    frame->next = NULL;
+
+    thread_lockMutex(data->mutex);
+    while (data->queued >= CAPTURE_MAX_QUEUED)
+    {
+        thread_waitCondition(data->changed, data->mutex);
+    }
+    if (data->queueLast)
+    {
+        data->queueLast->next = frame;
+    }
+    else
+    {
+        data->queueFirst = frame;
+    }
+    data->queueLast = frame;
+    data->queued++;
+    thread_broadcastCondition(data->changed);
+    thread_unlockMutex(data->mutex);
+}
+
+/**
+ * Holt fertig ausgelesene Bilder aus dem Ring ab, immer beginnend beim
+ * ältesten, damit die Reihenfolge erhalten bleibt.
+ *
+ * @param data die Daten des Moduls
+ * @param waitCount Anzahl an Slots, auf die notfalls gewartet wird
+ */
+static void capture_collect(CaptureData* data, int waitCount)
+{
+    while (data->count > 0)
+    {
+        CaptureSlot* slot = &data->ring[data->first];
+
+        bool wait = waitCount > 0;
+        GLenum result = glClientWaitSync(slot->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                         wait ? CAPTURE_FENCE_TIMEOUT : 0);
+        if (result == GL_TIMEOUT_EXPIRED && !wait)
+        {
+            break;
+        }
+        waitCount--;
+
+        glDeleteSync(slot->fence);
+        slot->fence = NULL;
+        data->first = (data->first + 1) % CAPTURE_RING_SIZE;
+        data->count--;
+
+        if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+        {
+            fprintf(stderr, "Error: Capture readback did not finish, frame dropped!\n");
+            continue;
+        }
+
+        CaptureFrame* frame = malloc(sizeof(CaptureFrame));
+        frame->kind = slot->kind;
+        frame->width = slot->width;
+        frame->height = slot->height;
+        frame->pixels = malloc((size_t)slot->width * slot->height * 3);
+        memcpy(frame->filename, slot->filename, CAPTURE_FILENAME_SIZE);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+        void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                        (GLsizeiptr)slot->width * slot->height * 3,
+                                        GL_MAP_READ_BIT);
+        if (mapped)
+        {
+            memcpy(frame->pixels, mapped, (size_t)slot->width * slot->height * 3);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (!mapped)
+        {
+            fprintf(stderr, "Error: Could not map capture buffer, frame dropped!\n");
+            free(frame->pixels);
+            free(frame);
+            continue;
+        }
+
+        capture_enqueue(data, frame);
+    }
+}
+
+/**
+ * Startet das Auslesen des Backbuffers in den nächsten freien Slot. Ist der
+ * Ring voll, wird vorher auf den ältesten Slot gewartet.
+ *
+ * @param data die Daten des Moduls
+ * @param kind wozu das Bild verwendet wird
+ * @param width Breite des Framebuffers
+ * @param height Höhe des Framebuffers
+ * @param filename Name der Zieldatei
+ */
+static void capture_readBackbuffer(CaptureData* data, CaptureKind kind, int width, int height,
+                                   const char* filename)
+{
+    if (data->count == CAPTURE_RING_SIZE)
+    {
+        capture_collect(data, 1);
+    }
+
+    CaptureSlot* slot = &data->ring[(data->first + data->count) % CAPTURE_RING_SIZE];
+    slot->kind = kind;
+    slot->width = width;
+    slot->height = height;
+    strncpy(slot->filename, filename, CAPTURE_FILENAME_SIZE - 1);
+    slot->filename[CAPTURE_FILENAME_SIZE - 1] = '\0';
+
+    // Der Buffer wächst nur, bei kleineren Fenstern wird er weiterbenutzt.
+    GLsizeiptr size = (GLsizeiptr)width * height * 3;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+    if (size > slot->size)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        slot->size = size;
+    }
+
+    // Ohne Padding auslesen, die Daten landen im Buffer statt im
+    // Hauptspeicher, deshalb kehrt glReadPixels sofort zurück.
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    data->count++;
+}
+
+/**
+ * Setzt einen Dateinamen aus Präfix und aktueller Uhrzeit zusammen.
+ *
+ * @param buffer Ziel für den Namen, CAPTURE_FILENAME_SIZE Zeichen
+ * @param format Format für strftime
+ */
+static void capture_timestampName(char* buffer, const char* format)
+{
+    time_t now = time(NULL);
+    strftime(buffer, CAPTURE_FILENAME_SIZE - 1, format, localtime(&now));
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+void capture_init(ProgContext* ctx)
+{
+    ctx->capture = malloc(sizeof(CaptureData));
+    CaptureData* data = ctx->capture;
+    memset(data, 0, sizeof(CaptureData));
+
+    for (int i = 0; i < CAPTURE_RING_SIZE; i++)
+    {
+        glGenBuffers(1, &data->ring[i].buffer);
+    }
+
+    // Die Spiegelung ist nötig, da OpenGL ein anderes Koordinatensystem als
+    // PNG bzw. stb_image_write verwendet. Die Einstellung ist global und
+    // wird deshalb einmal vor dem Start der Jobs gesetzt.
+    stbi_flip_vertically_on_write(true);
+
+    data->mutex = thread_createMutex();
+    data->changed = thread_createCondition();
+    data->thread = thread_create(capture_threadMain, data);
+    if (data->thread == NULL)
+    {
+        fprintf(stderr, "Error: Could not start capture thread!\n");
+    }
+}
+
+void capture_requestScreenshot(ProgContext* ctx)
+{
+    ctx->capture->screenshotRequested = true;
+}
+
+void capture_startRecording(ProgContext* ctx, CaptureMode mode)
+{
+    CaptureData* data = ctx->capture;
+    if (data->recording || data->thread == NULL)
+    {
+        return;
+    }
+
+    data->recording = true;
+    data->mode = mode;
+    data->frames = 0;
+    data->width = ctx->winData->width;
+    data->height = ctx->winData->height;
+    data->startTime = glfwGetTime();
+    capture_timestampName(data->name, "capture_%Y-%m-%d_%H-%M-%S");
+}
+
+void capture_stopRecording(ProgContext* ctx)
+{
+    CaptureData* data = ctx->capture;
+    if (!data->recording)
+    {
+        return;
+    }
+    data->recording = false;
+
+    // Alle ausstehenden Frames gehören noch zur Aufnahme.
+    capture_collect(data, CAPTURE_RING_SIZE);
+
+    double elapsed = glfwGetTime() - data->startTime;
+    printf("Aufnahme beendet: %d Frames in %.1f s\n", data->frames, elapsed);
+
+    if (data->mode == CAPTURE_MODE_VIDEO)
+    {
+        CaptureFrame* end = calloc(1, sizeof(CaptureFrame));
+        end->kind = CAPTURE_KIND_VIDEO_END;
+        capture_enqueue(data, end);
+
+        printf("  Umwandeln mit: ffmpeg -f rawvideo -pixel_format rgb24 -video_size %dx%d "
+               "-framerate %.0f -i %s.rgb %s.mp4\n",
+               data->width, data->height, elapsed > 0.0 ? data->frames / elapsed : 60.0,
+               data->name, data->name);
+    }
+}
+
+void capture_update(ProgContext* ctx)
+{
+    CaptureData* data = ctx->capture;
+    int width = ctx->winData->width;
+    int height = ctx->winData->height;
+
+    // Zuerst fertige Readbacks abholen, dann den neuen Frame auslesen.
+    capture_collect(data, 0);
+
+    if (width <= 0 || height <= 0 || data->thread == NULL)
+    {
+        data->screenshotRequested = false;
+        return;
+    }
+
+    if (data->recording && data->mode == CAPTURE_MODE_VIDEO
+        && (width != data->width || height != data->height))
+    {
+        fprintf(stderr, "Error: Window size changed, video capture stopped!\n");
+        capture_stopRecording(ctx);
+    }
+
+    if (data->recording)
+    {
+        char filename[CAPTURE_FILENAME_SIZE];
+        if (data->mode == CAPTURE_MODE_VIDEO)
+        {
+            snprintf(filename, CAPTURE_FILENAME_SIZE, "%s.rgb", data->name);
+            capture_readBackbuffer(data, CAPTURE_KIND_VIDEO, width, height, filename);
+        }
+        else
+        {
+            snprintf(filename, CAPTURE_FILENAME_SIZE, "%s_%05d.png", data->name, data->frames);
+            capture_readBackbuffer(data, CAPTURE_KIND_PNG, width, height, filename);
+        }
+        data->frames++;
+    }
+
+    if (data->screenshotRequested)
+    {
+        char filename[CAPTURE_FILENAME_SIZE];
+        capture_timestampName(filename, "screenshot_%Y-%m-%d_%H-%M-%S.png");
+        capture_readBackbuffer(data, CAPTURE_KIND_SCREENSHOT, width, height, filename);
+        data->screenshotRequested = false;
+    }
+}
+
+void capture_getStatus(ProgContext* ctx, CaptureStatus* status)
+{
+    CaptureData* data = ctx->capture;
+
+    status->recording = data->recording;
+    status->mode = data->mode;
+    status->frames = data->frames;
+    status->elapsed = data->recording ? glfwGetTime() - data->startTime : 0.0;
+
+    thread_lockMutex(data->mutex);
+    status->queued = data->queued + data->count;
+    thread_unlockMutex(data->mutex);
+}
+
+void capture_cleanup(ProgContext* ctx)
+{
+    CaptureData* data = ctx->capture;
+
+    capture_stopRecording(ctx);
+    capture_collect(data, CAPTURE_RING_SIZE);
+
+    // Der Schreib-Thread arbeitet die Warteschlange vor dem Beenden ab.
+    if (data->thread)
+    {
+        thread_lockMutex(data->mutex);
+        data->quit = true;
+        thread_broadcastCondition(data->changed);
+        thread_unlockMutex(data->mutex);
+        thread_join(data->thread);
+    }
+
+    for (int i = 0; i < CAPTURE_RING_SIZE; i++)
+    {
+        glDeleteBuffers(1, &data->ring[i].buffer);
+    }
+
+    thread_deleteMutex(data->mutex);
+    thread_deleteCondition(data->changed);
+
+    free(ctx->capture);
+    ctx->capture = NULL;
+}
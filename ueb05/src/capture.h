@@ -0,0 +1,104 @@
+/**
+ * Modul für Screenshots und Aufnahmen des Fensterinhalts.
+ * Der Backbuffer wird am Ende jedes Frames mit glReadPixels in einen Ring
+ * aus Pixel Buffer Objects gelesen, ohne auf die GPU zu warten. Erst wenn
+ * der Fence eines Buffers einige Frames später erreicht ist, wird er
+ * gemappt und das Bild an einen eigenen Schreib-Thread übergeben. Dieser
+ * kodiert PNG Dateien über das Job-System oder hängt die Bilder an ein
+ * Rohvideo an.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "common.h"
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Art einer fortlaufenden Aufnahme.
+enum CaptureMode
+{
+    CAPTURE_MODE_PNG,  // Eine PNG Datei pro Frame
+    CAPTURE_MODE_VIDEO // Ein Rohvideo (RGB, 8 Bit je Kanal, von oben nach unten)
+};
+typedef enum CaptureMode CaptureMode;
+
+// Zustand der Aufnahme für die Anzeige.
+struct CaptureStatus
+{
+    bool recording;   // true, solange aufgenommen wird
+    CaptureMode mode; // Art der laufenden Aufnahme
+    int frames;       // Bisher aufgenommene Frames
+    int queued;       // Bilder, die noch geschrieben werden müssen
+    double elapsed;   // Dauer der Aufnahme in Sekunden
+};
+typedef struct CaptureStatus CaptureStatus;
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Initialisiert das Aufnahme-Modul und startet den Schreib-Thread.
+ *
+ * @param ctx Programmkontext.
+ */
+void capture_init(ProgContext* ctx);
+
+/**
+ * Fordert einen Screenshot am Ende des aktuellen Frames an. Der Dateiname
+ * lautet screenshot_yyyy-MM-dd_hh-mm-ss.png, wobei das aktuelle Datum und
+ * die aktuelle Uhrzeit eingesetzt werden.
+ *
+ * @param ctx Programmkontext.
+ */
+void capture_requestScreenshot(ProgContext* ctx);
+
+/**
+ * Startet eine fortlaufende Aufnahme jedes Frames. Die Dateien heißen
+ * capture_yyyy-MM-dd_hh-mm-ss_nnnnn.png bzw. capture_yyyy-MM-dd_hh-mm-ss.rgb.
+ * Kommt der Schreib-Thread nicht hinterher, wartet der Hauptthread, damit
+ * kein Frame verloren geht. Ändert sich während eines Rohvideos die
+ * Fenstergröße, wird die Aufnahme beendet.
+ *
+ * @param ctx Programmkontext.
+ * @param mode die Art der Aufnahme
+ */
+void capture_startRecording(ProgContext* ctx, CaptureMode mode);
+
+/**
+ * Beendet eine laufende Aufnahme. Noch ausstehende Frames werden
+ * abgeholt, bei einem Rohvideo wird der Aufruf für ffmpeg ausgegeben.
+ *
+ * @param ctx Programmkontext.
+ */
+void capture_stopRecording(ProgContext* ctx);
+
+/**
+ * Liest den fertigen Frame aus, falls ein Screenshot oder eine Aufnahme
+ * aktiv ist, und übergibt abgeschlossene Readbacks an den Schreib-Thread.
+ * Muss einmal pro Frame nach dem Zeichnen und vor dem Tauschen der Buffer
+ * aufgerufen werden.
+ *
+ * @param ctx Programmkontext.
+ */
+void capture_update(ProgContext* ctx);
+
+/**
+ * Liefert den Zustand der Aufnahme.
+ *
+ * @param ctx Programmkontext.
+ * @param status Ziel für den Zustand
+ */
+void capture_getStatus(ProgContext* ctx, CaptureStatus* status);
+
+/**
+ * Beendet eine laufende Aufnahme, schreibt alle ausstehenden Bilder und
+ * gibt das Modul frei.
+ *
+ * @param ctx Programmkontext.
+ */
+void capture_cleanup(ProgContext* ctx);
+
+#endif // CAPTURE_H
@@ -25,6 +25,9 @@ ProgContext* common_createContext(void)
     ctx->rendering = NULL;
     ctx->gui = NULL;
     ctx->particles = NULL;
+    ctx->instrumentation = NULL;
+    ctx->loader = NULL;
+    ctx->capture = NULL;
 
     return ctx;
 }
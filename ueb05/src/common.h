@@ -29,6 +29,9 @@
 struct RenderingData;
 struct GuiData;
 struct InputData;
+struct InstrumentationData;
+struct LoaderData;
+struct CaptureData;
 
 // Datentyp der allgemeine Informationen über das Fenster enthält.
 struct WindowData {
@@ -57,6 +60,9 @@ struct ProgContext {
     struct GuiData* gui;
     struct InputData* input;
     struct ParticleData* particles;
+    struct InstrumentationData* instrumentation;
+    struct LoaderData* loader;
+    struct CaptureData* capture;
 };
 typedef struct ProgContext ProgContext;
 
@@ -6,9 +6,12 @@
 #include "light.h"
 #include "rendering.h"
 
-void deferredShader_doGeometryPass(ProgContext *ctx, mat4 *modelMatrix, mat4 *projectionMatrix, mat4 *viewMatrix);
+void deferredShader_doGeometryPass(ProgContext *ctx, int list, Occlusion *occlusion,
+                                   mat4 *projectionMatrix, mat4 *viewMatrix);
 
-void deferredShader_doStencilPass(ProgContext *ctx, PointLight *currPtLight, mat4 projectionMatrix, mat4 viewMatrix, mat4 *lightMVP);
+void deferredShader_calcLightVolumeMVP(PointLight *ptLight, mat4 viewProjMatrix, mat4 lightMVP);
+
+void deferredShader_doStencilPass(ProgContext *ctx, mat4 *lightMVP);
 
 void deferredShader_doPointPass(ProgContext *ctx, mat4 *lightMVP, PointLight* currPointLight);
 
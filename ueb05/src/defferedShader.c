@@ -1,24 +1,86 @@
 #include "deferredShader.h"
+
+#include <string.h>
+
 #include "framebuffer.h"
 #include "shader.h"
 #include "rendering.h"
 #include "input.h"
 #include "scene.h"
+#include "instrumentation.h"
+
+// Daten, die beim Aktivieren eines Programms im Geometry-Pass benoetigt werden.
+struct GeometryPassData
+{
+    ProgContext *ctx;
+};
+typedef struct GeometryPassData GeometryPassData;
+
+// Konstanten des Geometry-Passes im Layout des Uniform Blocks PassUniforms
+// (std140), siehe res/shader/include/passUniforms.glsl.
+struct PassUniforms
+{
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec3 camPos;
+    float viewportHeight;
+};
+typedef struct PassUniforms PassUniforms;
+
+/**
+ * Setzt alle passabhaengigen Uniforms fuer den Geometry-Pass. Wird von der
+ * Render Queue aufgerufen, sobald ein neues Programm aktiviert wurde.
+ * 
+ * @param shader das aktivierte Programm
+ * @param userData Zeiger auf die GeometryPassData
+ */
+static void deferredShader_setupGeometryShader(Shader *shader, void *userData)
+{
+    GeometryPassData *pass = userData;
+    InputData *input = pass->ctx->input;
+
+    //Daten fuer die Tessellation an Shader uebergeben
+    shader_setBool(shader, "useTessellation", input->tessellation.useTessellation);
+    shader_setFloat(shader, "innerTessellation", input->tessellation.innerTessellation);
+    shader_setFloat(shader, "outerTessellation", input->tessellation.outerTessellation);
+    shader_setBool(shader, "useDistanceTessellation", input->tessellation.useDistanceTessellation);
+    shader_setFloat(shader, "tessellationAmount", input->tessellation.tessellationAmount);
+    shader_setBool(shader, "useScreenSpaceTessellation", input->tessellation.useScreenSpaceTessellation);
+    shader_setFloat(shader, "pixelsPerEdge", input->tessellation.pixelsPerEdge);
+
+    //Ohne Face Culling duerfen abgewandte Patches nicht verworfen werden
+    shader_setBool(shader, "cullBackPatches", !input->showWireframe);
+
+    //Displacement Daten an Shader schicken
+    shader_setInt(shader, "depthMap", 5);
+    shader_setFloat(shader, "displacementFactor", input->mapping.displacementFactor);
+    shader_setBool(shader, "useDisplacement", input->mapping.useDisplacement);
+
+    //Parallaxmapping Daten an Shader schicken
+    shader_setFloat(shader, "heightScale", input->mapping.heightScale);
+}
 
 /**
- * Fuehrt den Geometry-Pass im deferred Shading aus
+ * Fuehrt den Geometry-Pass im deferred Shading aus. Die Weltmatrizen der
+ * Instanzen muessen bereits im Instanzbuffer der Szene liegen.
+ * Mit Occlusion Culling wird zuerst die fruehe Liste gezeichnet, danach die
+ * Pyramide aus der neuen Tiefe aufgebaut und die spaete Liste der gerade
+ * sichtbar gewordenen Instanzen nachgezeichnet.
  * 
  * @param ctx Programmkontext
- * @param modelMatrix ModelMatrix des zu zeichnenden Models
+ * @param list Sichtbarkeitsliste der Kamera
+ * @param occlusion Occlusion Culling der Kamera oder NULL
  * @param projectionMatrix ProjektionsMatrix der Szene
  * @param viewMatrix ViewMatrix der Szene
  * 
  */
-void deferredShader_doGeometryPass(ProgContext *ctx, mat4 *modelMatrix, mat4 *projectionMatrix, mat4 *viewMatrix)
+void deferredShader_doGeometryPass(ProgContext *ctx, int list, Occlusion *occlusion,
+                                   mat4 *projectionMatrix, mat4 *viewMatrix)
 {
     // ---------------------- MODEL - SHADER ---------------------------------- //
     RenderingData *data = ctx->rendering;
     InputData *input = ctx->input;
+    Scene *scene = input->rendering.userScene;
 
     // Tiefentest aktivieren.
     glDepthMask(GL_TRUE);
@@ -29,39 +91,120 @@ void deferredShader_doGeometryPass(ProgContext *ctx, mat4 *modelMatrix, mat4 *pr
     glDrawBuffers(GBUFFER_NUM_COLORATTACH, data->fb.attachments);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    //Position, Normal, AlbedoSpec und Emissions-Attachment beschreiben
-    glDrawBuffers(4, data->fb.attachments);
+    //Parallaxmapping verwirft Fragmente an den Silhouetten. Diese Verwerfungen
+    //kann der Pre-Pass nicht guenstig nachbilden, daher entfaellt er dann.
+    bool usePrePass = input->rendering.useDepthPrePass && !input->mapping.useParallax;
 
-    // Shader vorbereiten.
-    shader_useShader(data->modelShader);
+    //Merkmale der Permutationen aus den Einstellungen bestimmen, die Texturen
+    //der Materialien ergaenzt die Szene pro Mesh. Ohne Tessellation entfallen
+    //Control- und Evaluation-Shader vollstaendig.
+    bool tessellate = input->tessellation.useTessellation ||
+                      input->tessellation.useDistanceTessellation ||
+                      input->tessellation.useScreenSpaceTessellation;
+    unsigned int features = 0;
+    features |= input->mapping.useNormalMapping ? MODEL_FEATURE_NORMAL_MAPPING : 0;
+    features |= input->mapping.useParallax ? MODEL_FEATURE_PARALLAX : 0;
+    features |= tessellate ? 0 : MODEL_FEATURE_NO_TESSELLATION;
 
-    //Matrizen an Vertex-Shader schicken
-    shader_setMat4(data->modelShader, "projectionMatrix", projectionMatrix);
-    shader_setMat4(data->modelShader, "modelMatrix", modelMatrix);
-    shader_setMat4(data->modelShader, "viewMatrix", viewMatrix);
+    //Drawcalls sammeln und nach Programm, Texturen, Material und Tiefe sortieren.
+    //Die spaete Liste steht schon fest und wird nur noch von der GPU gefuellt.
+    RenderQueue *queue = data->renderQueue;
+    vec3 *camPos = camera_getCameraPos(input->mainCamera);
+    int lateList = occlusion ? occlusion_getLateList(occlusion) : -1;
+    renderQueue_clear(queue);
+    if (usePrePass)
+    {
+        scene_enqueueScene(scene, list, queue, RENDERQUEUE_PASS_DEPTH,
+                           data->depthPrePass, features, 0, *camPos, RENDERING_FAR_PLANE);
+        if (lateList >= 0)
+        {
+            scene_enqueueScene(scene, lateList, queue, RENDERQUEUE_PASS_DEPTH_LATE,
+                               data->depthPrePass, features, 0, *camPos, RENDERING_FAR_PLANE);
+        }
+    }
+    scene_enqueueScene(scene, list, queue, RENDERQUEUE_PASS_OPAQUE,
+                       data->modelShader, features, 0, *camPos, RENDERING_FAR_PLANE);
+    if (lateList >= 0)
+    {
+        //Nach einem Pre-Pass steht die Tiefe bereits vollstaendig fest, die
+        //spaete Liste wird dann zusammen mit der fruehen schattiert.
+        scene_enqueueScene(scene, lateList, queue,
+                           usePrePass ? RENDERQUEUE_PASS_OPAQUE : RENDERQUEUE_PASS_OPAQUE_LATE,
+                           data->modelShader, features, 0, *camPos, RENDERING_FAR_PLANE);
+    }
+    renderQueue_sort(queue);
 
-    //Daten fuer die Tessellation an Shader uebergeben
-    shader_setBool(data->modelShader, "useTessellation", input->tessellation.useTessellation);
-    shader_setFloat(data->modelShader, "innerTessellation", input->tessellation.innerTessellation);
-    shader_setFloat(data->modelShader, "outerTessellation", input->tessellation.outerTessellation);
-    shader_setBool(data->modelShader, "useDistanceTessellation", input->tessellation.useDistanceTessellation);
-    shader_setFloat(data->modelShader, "tessellationAmount", input->tessellation.tessellationAmount);
-    shader_setVec3(data->modelShader, "camPos", camera_getCameraPos(input->mainCamera));
+    GeometryPassData pass = {ctx};
 
-    //Displacement Daten an Shader schicken
-    shader_setInt(data->modelShader, "depthMap", 5);
-    shader_setFloat(data->modelShader, "displacementFactor", input->mapping.displacementFactor);
-    shader_setBool(data->modelShader, "useDisplacement", input->mapping.useDisplacement);
+    //Konstanten des Passes einmal in den Stream Buffer schreiben, statt sie
+    //bei jedem Programmwechsel einzeln zu setzen
+    StreamAllocation passUniforms;
+    streamBuffer_alloc(data->streamBuffer, sizeof(PassUniforms), &passUniforms);
+    PassUniforms *uniforms = passUniforms.memory;
+    memcpy(uniforms->projectionMatrix, *projectionMatrix, sizeof(mat4));
+    memcpy(uniforms->viewMatrix, *viewMatrix, sizeof(mat4));
+    glm_vec3_copy(*camPos, uniforms->camPos);
+    uniforms->viewportHeight = (float)data->fbHeight;
+    streamBuffer_bindRange(data->streamBuffer, &passUniforms,
+                           GL_UNIFORM_BUFFER, RENDERING_PASS_UNIFORM_BINDING);
 
-    //Normalmapping
-    shader_setBool(data->modelShader, "useNormalMapping", input->mapping.useNormalMapping);
+    mat4 viewProjMatrix;
+    glm_mat4_mul(*projectionMatrix, *viewMatrix, viewProjMatrix);
 
-    //Parallaxmapping Daten an Shader schicken
-    shader_setBool(data->modelShader, "useParallaxMapping", input->mapping.useParallax);
-    shader_setFloat(data->modelShader, "heightScale", input->mapping.heightScale);
+    //Depth Pre-Pass: nur Tiefe schreiben, keine Farbattachments
+    if (usePrePass)
+    {
+        glDrawBuffer(GL_NONE);
+        instrumentation_beginQuery(ctx, INSTRUMENTATION_PREPASS_SAMPLES);
+        renderQueue_draw(queue, RENDERQUEUE_PASS_DEPTH,
+                         deferredShader_setupGeometryShader, &pass);
+
+        if (occlusion)
+        {
+            occlusion_buildPyramid(occlusion, &data->hiz, data->fb.depthTexture,
+                                   data->fbWidth, data->fbHeight, viewProjMatrix);
+            occlusion_cullLate(occlusion, scene, &data->hiz);
+            renderQueue_draw(queue, RENDERQUEUE_PASS_DEPTH_LATE,
+                             deferredShader_setupGeometryShader, &pass);
+        }
+        instrumentation_endQuery(ctx, INSTRUMENTATION_PREPASS_SAMPLES);
+
+        //Im G-Buffer-Pass nur noch die sichtbaren Fragmente schattieren
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    //Position, Normal, AlbedoSpec und Emissions-Attachment beschreiben
+    glDrawBuffers(4, data->fb.attachments);
 
     // Modell zeichnen
-    model_drawModel(input->rendering.userScene->model, data->modelShader);
+    instrumentation_beginQuery(ctx, INSTRUMENTATION_GEOMETRY_SAMPLES);
+    renderQueue_draw(queue, RENDERQUEUE_PASS_OPAQUE,
+                     deferredShader_setupGeometryShader, &pass);
+
+    if (occlusion && !usePrePass)
+    {
+        occlusion_buildPyramid(occlusion, &data->hiz, data->fb.depthTexture,
+                               data->fbWidth, data->fbHeight, viewProjMatrix);
+        occlusion_cullLate(occlusion, scene, &data->hiz);
+        renderQueue_draw(queue, RENDERQUEUE_PASS_OPAQUE_LATE,
+                         deferredShader_setupGeometryShader, &pass);
+    }
+    instrumentation_endQuery(ctx, INSTRUMENTATION_GEOMETRY_SAMPLES);
+
+    if (usePrePass)
+    {
+        glDepthFunc(GL_LESS);
+
+        //Anteil der Fragmente, die durch den Pre-Pass nicht schattiert wurden
+        double prePassSamples = instrumentation_getValue(ctx, INSTRUMENTATION_PREPASS_SAMPLES);
+        if (prePassSamples > 0.0)
+        {
+            double geometrySamples = instrumentation_getValue(ctx, INSTRUMENTATION_GEOMETRY_SAMPLES);
+            instrumentation_setValue(ctx, INSTRUMENTATION_OVERDRAW_SAVED,
+                                     100.0 * (1.0 - geometrySamples / prePassSamples));
+        }
+    }
 
     //Schreiben auf Depth-Buffer deaktivieren
     glDepthMask(GL_FALSE);
@@ -82,17 +225,33 @@ static float rendering_calcLightVolumeRadius(PointLight *ptLight)
     return ((-linear + sqrtf(linear * linear - 4 * quadratic * (constant - (255.0f / 5.0f) * (float)lightMax))) / (2.0f * quadratic));
 }
 
+/**
+ * Berechnet die MVP-Matrix des Light-Volumes eines Punktlichtes.
+ * Greift nicht auf OpenGL zu und kann daher in Jobs laufen.
+ * 
+ * @param ptLight das Punktlicht
+ * @param viewProjMatrix View-Projection-Matrix der Szene
+ * @param lightMVP Ziel fuer die MVP-Matrix
+ */
+void deferredShader_calcLightVolumeMVP(PointLight *ptLight, mat4 viewProjMatrix, mat4 lightMVP)
+{
+    //Light-Volume erstellen, skalieren und translatieren
+    float radius = rendering_calcLightVolumeRadius(ptLight);
+    mat4 modelMat;
+    glm_mat4_identity(modelMat);
+    glm_translate(modelMat, ptLight->position);
+    glm_scale_uni(modelMat, radius);
+    glm_mat4_mul(viewProjMatrix, modelMat, lightMVP);
+}
+
 /**
  * Fuehrt den Stencil-Pass des Deferred Shading durch
  * 
  * @param ctx Programmkontext
- * @param currPtLight aktuelles Punktlicht
- * @param projectionMatrix ProjektionsMatrix der Szene
- * @param viewMatrix ViewMatrix der Szene
  * @param lightMVP MVP-Matrix des aktuellen Punktlichtes
  * 
  */
-void deferredShader_doStencilPass(ProgContext *ctx, PointLight *currPtLight, mat4 projectionMatrix, mat4 viewMatrix, mat4 *lightMVP)
+void deferredShader_doStencilPass(ProgContext *ctx, mat4 *lightMVP)
 {
     // ---------------------- NULL - SHADER ---------------------------------- //
     RenderingData *data = ctx->rendering;
@@ -116,15 +275,6 @@ void deferredShader_doStencilPass(ProgContext *ctx, PointLight *currPtLight, mat
     //Face-Culling deaktivieren
     glDisable(GL_CULL_FACE);
 
-    //Light-Volume erstellen, skalieren und translatieren
-    float radius = rendering_calcLightVolumeRadius(currPtLight);
-    mat4 modelMat;
-    glm_mat4_identity(modelMat);
-    glm_translate(modelMat, currPtLight->position);
-    glm_scale_uni(modelMat, radius);
-    mat4 temp;
-    glm_mat4_mul(projectionMatrix, viewMatrix, temp);
-    glm_mat4_mul(temp, modelMat, *lightMVP);
     shader_setMat4(data->null, "lightMVP", lightMVP);
     
     //Sphere mit Light-Volume Radius rendern
@@ -144,12 +294,22 @@ void deferredShader_doPointPass(ProgContext *ctx, mat4 *lightMVP, PointLight *cu
     RenderingData *data = ctx->rendering;
     InputData *input = ctx->input;
 
+    //Permutation passend zu den Schatteneinstellungen waehlen
+    unsigned int features = 0;
+    features |= input->shadows.showPointShadows ? LIGHT_FEATURE_SHADOWS : 0;
+    features |= input->shadows.usePCF ? LIGHT_FEATURE_PCF : 0;
+    Shader *shader = shader_getPermutation(data->pointLight, features);
+    if (shader == NULL)
+    {
+        return;
+    }
+
     //Gbuffer binden
     glBindFramebuffer(GL_FRAMEBUFFER, data->fb.fbo);
     //Ergebnis in das Final-Attachment schreiben
     glDrawBuffer(data->fb.attachments[GBUFFER_COLORATTACH_FINAL]);
     //Point-Light-Shader aktivieren
-    shader_useShader(data->pointLight);
+    shader_useShader(shader);
     //Stencil Function umsetzen
     glStencilMask(0xFF);
     glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
@@ -164,26 +324,24 @@ void deferredShader_doPointPass(ProgContext *ctx, mat4 *lightMVP, PointLight *cu
     glCullFace(GL_FRONT);
 
     //MVP-Matrix senden
-    shader_setMat4(data->pointLight, "lightMVP", lightMVP);
+    shader_setMat4(shader, "lightMVP", lightMVP);
 
     //Texturen binden und an shader schicken
-    shader_setInt(data->pointLight, "gPosition", 1);
-    shader_setInt(data->pointLight, "gNormal", 2);
-    shader_setInt(data->pointLight, "gAlbedoSpec", 3);
-    shader_setInt(data->pointLight, "gShadowCube", 5);
+    shader_setInt(shader, "gPosition", 1);
+    shader_setInt(shader, "gNormal", 2);
+    shader_setInt(shader, "gAlbedoSpec", 3);
+    shader_setInt(shader, "gShadowCube", 5);
     //Kamera-Position und Punktlicht senden
-    shader_setVec3(data->pointLight, "camPos", camera_getCameraPos(ctx->input->mainCamera));
-    light_activatePointLight(currPointLight, data->pointLight);
-    shader_setInt(data->pointLight, "viewPortWidth", ctx->winData->width);
-    shader_setInt(data->pointLight, "viewPortHeight", ctx->winData->height);
-
-    shader_setFloat(data->pointLight, "farPlane", 25.0f);
-    shader_setBool(data->pointLight, "useShadows", input->shadows.showPointShadows);
-    shader_setBool(data->pointLight, "usePCF", input->shadows.usePCF);
-    shader_setInt(data->pointLight, "PCFAmount", input->shadows.PCFAmount);
+    shader_setVec3(shader, "camPos", camera_getCameraPos(ctx->input->mainCamera));
+    light_activatePointLight(currPointLight, shader);
+    shader_setInt(shader, "viewPortWidth", ctx->winData->width);
+    shader_setInt(shader, "viewPortHeight", ctx->winData->height);
+
+    shader_setFloat(shader, "farPlane", 25.0f);
+    shader_setInt(shader, "PCFAmount", input->shadows.PCFAmount);
     
     //LightVolume rendern
-    model_drawModelTris(input->lighting.lightVolSphere, data->pointLight);
+    model_drawModelTris(input->lighting.lightVolSphere, shader);
 
     //Back-Face Culling aktivieren
     glEnable(GL_CULL_FACE);
@@ -204,6 +362,17 @@ void deferredShader_doDirLightPass(ProgContext *ctx, mat4 *lightSpaceMat)
     RenderingData *data = ctx->rendering;
     InputData *input = ctx->input;
 
+    //Permutation passend zu den Schatteneinstellungen waehlen
+    unsigned int features = 0;
+    features |= input->shadows.showDirShadows ? LIGHT_FEATURE_SHADOWS : 0;
+    features |= input->shadows.usePCF ? LIGHT_FEATURE_PCF : 0;
+    features |= input->shadows.usePCF && input->shadows.useBilinearFiltering ? LIGHT_FEATURE_BILINEAR : 0;
+    Shader *shader = shader_getPermutation(data->dirLight, features);
+    if (shader == NULL)
+    {
+        return;
+    }
+
     //GBuffer binden
     glBindFramebuffer(GL_FRAMEBUFFER, data->fb.fbo);
     //Ergebnis in das Final-Attachment schreiben
@@ -213,23 +382,20 @@ void deferredShader_doDirLightPass(ProgContext *ctx, mat4 *lightSpaceMat)
     glEnable(GL_BLEND);
     glBlendFunc(GL_ONE, GL_ONE);
     //Directional Light shader aktivieren
-    shader_useShader(data->dirLight);
+    shader_useShader(shader);
     //Texturen binden und an shader schicken
-    shader_setInt(data->dirLight, "gPosition", 1);
-    shader_setInt(data->dirLight, "gNormal", 2);
-    shader_setInt(data->dirLight, "gAlbedoSpec", 3);
-    shader_setInt(data->dirLight, "gShadowMap", 4);
-    shader_setMat4(data->dirLight, "lightSpaceMatrix", lightSpaceMat);
+    shader_setInt(shader, "gPosition", 1);
+    shader_setInt(shader, "gNormal", 2);
+    shader_setInt(shader, "gAlbedoSpec", 3);
+    shader_setInt(shader, "gShadowMap", 4);
+    shader_setMat4(shader, "lightSpaceMatrix", lightSpaceMat);
     //Kamera-Position senden
-    shader_setVec3(data->dirLight, "camPos", camera_getCameraPos(ctx->input->mainCamera));
-    light_activateDirLight(&input->lighting.dirLight, data->dirLight);
+    shader_setVec3(shader, "camPos", camera_getCameraPos(ctx->input->mainCamera));
+    light_activateDirLight(&input->lighting.dirLight, shader);
 
-    shader_setBool(data->dirLight, "useShadows", input->shadows.showDirShadows);
-    shader_setBool(data->dirLight, "usePCF", input->shadows.usePCF);
-    shader_setInt(data->dirLight, "PCFAmount", input->shadows.PCFAmount);
-    shader_setBool(data->dirLight, "useBilinearFiltering", input->shadows.useBilinearFiltering);
+    shader_setInt(shader, "PCFAmount", input->shadows.PCFAmount);
     //Viewport füllendes Quad rendern
-    mesh_drawMeshTris(data->displayQuad, data->dirLight);
+    mesh_drawMeshTris(data->displayQuad, shader);
     //Blending deaktivieren
     glDisable(GL_BLEND);
 }
@@ -276,5 +442,5 @@ void deferredShader_activateTexturesFinalRender(RenderingData *data)
     glActiveTexture(GL_TEXTURE15);
     glBindTexture(GL_TEXTURE_2D, data->fb.textures[GBUFFER_COLORATTACH_FINAL]);
     glActiveTexture(GL_TEXTURE16);
-    glBindTexture(GL_TEXTURE_2D, data->pingPong.buffer[0]);
+    glBindTexture(GL_TEXTURE_2D, data->bloomResult);
 }
\ No newline at end of file
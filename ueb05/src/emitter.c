@@ -0,0 +1,57 @@
+/**
+ * Modul für das Speichern von Partikel-Emittern.
+ * 
+ * Ein Emitter beschreibt, wo und wie schnell neue Partikel entstehen und
+ * wie sie während ihrer Lebenszeit aussehen. Alle Emitter einer Szene
+ * teilen sich die Partikel der Simulation.
+ * 
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "emitter.h"
+
+#include <string.h>
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+ParticleEmitter* emitter_createEmitter(void)
+{
+    ParticleEmitter* emitter = malloc(sizeof(ParticleEmitter));
+    memset(emitter, 0, sizeof(ParticleEmitter));
+
+    emitter->direction[1] = 5.0f;
+    emitter->directionRand = 1.0f;
+
+    emitter->rate = 200.0f;
+    emitter->lifeTime = 5.0f;
+    emitter->lifeTimeRand = 1.0f;
+
+    glm_vec3_one(emitter->startColor);
+    glm_vec3_one(emitter->endColor);
+    emitter->startSize = 1.0f;
+    emitter->endSize = 1.0f;
+
+    emitter->alphaBlend = false;
+    emitter->softness = 0.5f;
+
+    return emitter;
+}
+
+void emitter_setTexture(ParticleEmitter* emitter, const char* texture)
+{
+    free(emitter->texture);
+    emitter->texture = NULL;
+
+    if (texture)
+    {
+        emitter->texture = malloc(strlen(texture) + 1);
+        strcpy(emitter->texture, texture);
+    }
+}
+
+void emitter_deleteEmitter(ParticleEmitter* emitter)
+{
+    free(emitter->texture);
+    free(emitter);
+}
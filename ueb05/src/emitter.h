@@ -0,0 +1,72 @@
+/**
+ * Modul für das Speichern von Partikel-Emittern.
+ * 
+ * Ein Emitter beschreibt, wo und wie schnell neue Partikel entstehen und
+ * wie sie während ihrer Lebenszeit aussehen. Alle Emitter einer Szene
+ * teilen sich die Partikel der Simulation.
+ * 
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include "common.h"
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Ein Partikel-Emitter.
+struct ParticleEmitter
+{
+    vec3 position;
+    vec3 direction;
+    float directionRand;
+
+    float rate;
+    float lifeTime;
+    float lifeTimeRand;
+
+    vec3 startColor;
+    vec3 endColor;
+    float startSize;
+    float endSize;
+
+    // Alpha-Blending statt additiver Überlagerung. Solche Partikel werden
+    // vor dem Zeichnen nach ihrer Tiefe sortiert.
+    bool alphaBlend;
+    // Tiefenbereich, in dem Partikel vor der Szenengeometrie ausgeblendet
+    // werden, 0 schaltet das Ausblenden ab
+    float softness;
+
+    // Pfad der Partikeltextur oder NULL für die Standardtextur
+    char* texture;
+};
+typedef struct ParticleEmitter ParticleEmitter;
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Erzeugt einen neuen Emitter mit Standardwerten. Diese entsprechen den
+ * Startwerten des Partikelmenüs.
+ * 
+ * @return ein neuer Emitter
+ */
+ParticleEmitter* emitter_createEmitter(void);
+
+/**
+ * Setzt die Partikeltextur eines Emitters. Der Pfad wird kopiert.
+ * 
+ * @param emitter der Emitter
+ * @param texture der Pfad der Textur oder NULL für die Standardtextur
+ */
+void emitter_setTexture(ParticleEmitter* emitter, const char* texture);
+
+/**
+ * Löscht einen Emitter.
+ * 
+ * @param emitter der zu löschende Emitter
+ */
+void emitter_deleteEmitter(ParticleEmitter* emitter);
+
+#endif // EMITTER_H
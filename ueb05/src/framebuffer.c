@@ -1,5 +1,7 @@
 #include "framebuffer.h"
 
+#include "utils.h"
+
 /**
  * Erstellt ein Framebuffer Color-Attachment und bindet es an den aktuellen Framebuffer
  * 
@@ -59,18 +61,26 @@ void framebuffer_initFramebuffer(Framebuffer *fb, int width, int height)
         fb->attachments[i] = GL_COLOR_ATTACHMENT0 + i;
     }
 
-    // Depth-Renderbuffer-Object
+    // Depth-Stencil-Textur
     ////////////////////////////
 
-    glGenRenderbuffers(1, &fb->depthRbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, fb->depthRbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    // Als Textur statt als Renderbuffer, damit die Tiefe im Compute-Shader
+    // fuer die HiZ-Pyramide gelesen werden kann.
+    glGenTextures(1, &fb->depthTexture);
+    glBindTexture(GL_TEXTURE_2D, fb->depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0,
+                 GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_DEPTH_STENCIL_TEXTURE_MODE, GL_DEPTH_COMPONENT);
 
-    // Das RBO an den Framebuffer binden.
-    glFramebufferRenderbuffer(
+    // Die Textur an den Framebuffer binden.
+    glFramebufferTexture2D(
         GL_FRAMEBUFFER,
         GL_DEPTH_STENCIL_ATTACHMENT,
-        GL_RENDERBUFFER, fb->depthRbo);
+        GL_TEXTURE_2D, fb->depthTexture, 0);
 
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
     {
@@ -111,6 +121,47 @@ void framebuffer_initPingPongBuffer(PingPong *fbo, int width, int height)
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+/**
+ * Initialisiert die Bloom-Kette. Jede Stufe hat die halbe Aufloesung der
+ * vorherigen, die erste Stufe die halbe Aufloesung des Bildschirms.
+ * 
+ * @param chain zu initialisierende Bloom-Kette
+ * @param width die Breite des Bildschirms
+ * @param height die Höhe des Bildschirms
+ */
+void framebuffer_initBloomChain(BloomChain *chain, int width, int height)
+{
+    glGenFramebuffers(1, &chain->fbo);
+    glGenTextures(BLOOM_MIP_COUNT, chain->mips);
+
+    for (int i = 0; i < BLOOM_MIP_COUNT; i++)
+    {
+        width = utils_maxInt(width / 2, 1);
+        height = utils_maxInt(height / 2, 1);
+        chain->widths[i] = width;
+        chain->heights[i] = height;
+
+        // Fuer Bloom reicht ein kompaktes HDR Format ohne Alpha.
+        glBindTexture(GL_TEXTURE_2D, chain->mips[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height,
+                     0, GL_RGB, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // Das Attachment wird beim Rendern je Stufe neu gesetzt.
+    glBindFramebuffer(GL_FRAMEBUFFER, chain->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, chain->mips[0], 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        fprintf(stderr, "Error: Bloom-Framebuffer incomplete!\n");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
 void framebuffer_initDepthCubeFBO(depthCubeFBO *fb, mat4 pointLightProj)
 {
     glGenFramebuffers(1, &fb->fbo);
@@ -190,12 +241,14 @@ void framebuffer_initDepthFBO(depthFBO *fb)
  * @param width die Breite des Framebuffers
  * @param height die Höhe des Framebuffers
  */
-void framebuffer_resizeFramebuffer(PingPong *PPfbo, Framebuffer *fbo, int width, int height)
+void framebuffer_resizeFramebuffer(PingPong *PPfbo, Framebuffer *fbo, BloomChain *chain, int width, int height)
 {
     framebuffer_deleteFrameBuffer(fbo);
     framebuffer_deletePingPongBuffer(PPfbo);
+    framebuffer_deleteBloomChain(chain);
     framebuffer_initFramebuffer(fbo, width, height);
     framebuffer_initPingPongBuffer(PPfbo, width, height);
+    framebuffer_initBloomChain(chain, width, height);
 }
 
 /**
@@ -206,7 +259,7 @@ void framebuffer_resizeFramebuffer(PingPong *PPfbo, Framebuffer *fbo, int width,
 void framebuffer_deleteFrameBuffer(Framebuffer *fb)
 {
     glDeleteFramebuffers(1, &fb->fbo);
-    glDeleteRenderbuffers(1, &fb->depthRbo);
+    glDeleteTextures(1, &fb->depthTexture);
     glDeleteTextures(GBUFFER_NUM_COLORATTACH, fb->textures);
 }
 
@@ -222,6 +275,17 @@ void framebuffer_deletePingPongBuffer(PingPong *fb)
     glDeleteRenderbuffers(1, &fb->depthRbo);
 }
 
+/**
+ * Löscht die Bloom-Kette
+ * 
+ * @param chain zu löschende Bloom-Kette
+ */
+void framebuffer_deleteBloomChain(BloomChain *chain)
+{
+    glDeleteFramebuffers(1, &chain->fbo);
+    glDeleteTextures(BLOOM_MIP_COUNT, chain->mips);
+}
+
 void framebuffer_deleteDepthFrameBuffer(depthFBO *fb)
 {
     glDeleteFramebuffers(1, &fb->fbo);
@@ -4,6 +4,8 @@
 
 #define SHADOW_WIDTH 1024
 #define SHADOW_HEIGHT 1024
+// Anzahl der Stufen der Bloom-Kette (1/2, 1/4 und 1/8 Aufloesung)
+#define BLOOM_MIP_COUNT 3
 // Aufzählungstyp für die unterschiedlichen Color Attachments des GBuffers.
 typedef enum {
     GBUFFER_COLORATTACH_POSITION,
@@ -12,7 +14,6 @@ typedef enum {
     GBUFFER_COLORATTACH_EMISSION,
     GBUFFER_COLORATTACH_FINAL,
     GBUFFER_COLORATTACH_BRIGHTNESS,
-    GBUFFER_COLORATTACH_RESULT,
 
     GBUFFER_NUM_COLORATTACH
 } GBUFFER_TEXTURE_TYPE;
@@ -22,7 +23,7 @@ typedef struct Framebuffer
 {
     GLuint fbo;
     GLuint textures[GBUFFER_NUM_COLORATTACH];
-    GLuint depthRbo;
+    GLuint depthTexture; // Tiefe und Stencil, lesbar fuer die HiZ-Pyramide
     GLuint attachments[GBUFFER_NUM_COLORATTACH];
 } Framebuffer;
 
@@ -34,6 +35,15 @@ typedef struct PingPong
     GLuint depthRbo;
 } PingPong;
 
+// Datenrepräsentation der Bloom-Kette mit immer kleiner werdenden Stufen.
+typedef struct BloomChain
+{
+    GLuint fbo;
+    GLuint mips[BLOOM_MIP_COUNT];
+    int widths[BLOOM_MIP_COUNT];
+    int heights[BLOOM_MIP_COUNT];
+} BloomChain;
+
 typedef struct depthFBO
 {
     GLuint fbo;
@@ -54,7 +64,10 @@ void framebuffer_deleteFrameBuffer(Framebuffer *fb);
 void framebuffer_initPingPongBuffer(PingPong *fbo, int width, int height);
 void framebuffer_deletePingPongBuffer(PingPong *fb);
 
-void framebuffer_resizeFramebuffer(PingPong *PPfbo, Framebuffer *fbo, int width, int height);
+void framebuffer_initBloomChain(BloomChain *chain, int width, int height);
+void framebuffer_deleteBloomChain(BloomChain *chain);
+
+void framebuffer_resizeFramebuffer(PingPong *PPfbo, Framebuffer *fbo, BloomChain *chain, int width, int height);
 
 void framebuffer_initDepthFBO(depthFBO *fb);
 void framebuffer_initDepthCubeFBO(depthCubeFBO *fb, mat4 pointLightProj);
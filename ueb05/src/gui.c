@@ -13,19 +13,29 @@
 #include "window.h"
 #include "input.h"
 #include "rendering.h"
+#include "instrumentation.h"
+#include "postProcessing.h"
+#include "loader.h"
+#include "capture.h"
 
 ////////////////////////////////// KONSTANTEN //////////////////////////////////
 
-#define MAX_VERTEX_BUFFER 512 * 1024
-#define MAX_ELEMENT_BUFFER 128 * 1024
+#define MAX_VERTEX_BUFFER (512 * 1024)
+#define MAX_ELEMENT_BUFFER (128 * 1024)
 
 #define STATS_WIDTH (80)
 #define STATS_HEIGHT (30)
+#define STATS_COUNTER_WIDTH (240)
+#define STATS_COUNTER_HEIGHT (20)
+
+#define LOADING_WIDTH (320)
+#define LOADING_HEIGHT (110)
 
 // Definitionen der Fenster IDs
 #define GUI_WINDOW_HELP "window_help"
 #define GUI_WINDOW_MENU "window_menu"
 #define GUI_WINDOW_STATS "window_stats"
+#define GUI_WINDOW_LOADING "window_loading"
 
 ////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
 
@@ -37,6 +47,15 @@ struct GuiData
 };
 typedef struct GuiData GuiData;
 
+// Vertex der GUI, muss dem Layout des Nuklear Backends entsprechen.
+struct GuiVertex
+{
+    float position[2];
+    float uv[2];
+    nk_byte col[4];
+};
+typedef struct GuiVertex GuiVertex;
+
 vec3 g_DirLightCol = {1.0f, 1.0f, 1.0f};
 vec3 g_DirLightDir = {1.0f, 1.0f, 1.0f};
 /////////////////////////////// LOKALE CALLBACKS ///////////////////////////////
@@ -359,6 +378,7 @@ static void gui_renderHelp(ProgContext *ctx, struct nk_context *nk)
             HELP_LINE("Menü umschalten", "F4");
             HELP_LINE("Statistiken umschalten", "F5");
             HELP_LINE("Screenshot anfertigen", "F6");
+            HELP_LINE("Videoaufnahme umschalten", "Shift+F6");
             HELP_LINE("Shader neu kompilieren", "F7");
             HELP_LINE("Debug-Modus umschalten", "F8");
             HELP_LINE("Kamera vorwärst", "W");
@@ -442,6 +462,52 @@ static void gui_renderMenu(ProgContext *ctx, struct nk_context *nk)
                     rendering_reRenderShaders(ctx);
                 }
 
+                //Verteilen von Jobs vermessen, Ergebnis auf der Konsole
+                nk_layout_row_dynamic(nk, 25, 1);
+                if (nk_button_label(nk, "Job-Benchmark"))
+                {
+                    input->runJobBenchmark = true;
+                }
+
+                //BVH mit 100.000 Instanzen vermessen, Ergebnis auf der Konsole
+                if (nk_button_label(nk, "BVH-Benchmark"))
+                {
+                    input->runBvhBenchmark = true;
+                }
+
+                //Laden von DDS Dateien pruefen und vermessen, Ergebnis auf der Konsole
+                if (nk_button_label(nk, "DDS-Benchmark"))
+                {
+                    input->runDdsBenchmark = true;
+                }
+
+                //Jeden Frame aufnehmen, z.B. für Referenzvideos von Benchmarks
+                CaptureStatus capture;
+                capture_getStatus(ctx, &capture);
+                if (capture.recording)
+                {
+                    char line[64];
+                    snprintf(line, sizeof(line), "Aufnahme: %d Frames, %.1f s, %d offen",
+                             capture.frames, capture.elapsed, capture.queued);
+                    nk_label(nk, line, NK_TEXT_LEFT);
+                    if (nk_button_label(nk, "Aufnahme beenden"))
+                    {
+                        capture_stopRecording(ctx);
+                    }
+                }
+                else
+                {
+                    nk_layout_row_dynamic(nk, 25, 2);
+                    if (nk_button_label(nk, "PNG-Aufnahme"))
+                    {
+                        capture_startRecording(ctx, CAPTURE_MODE_PNG);
+                    }
+                    if (nk_button_label(nk, "Video-Aufnahme"))
+                    {
+                        capture_startRecording(ctx, CAPTURE_MODE_VIDEO);
+                    }
+                }
+
                 nk_tree_pop(nk);
             }
 
@@ -465,6 +531,46 @@ static void gui_renderMenu(ProgContext *ctx, struct nk_context *nk)
                 //Model Rotation
                 gui_widgetVec3(nk, "Model Rotation:", input->rendering.modelRotation);
 
+                //Depth Pre-Pass
+                nk_layout_row_dynamic(nk, 25, 1);
+                nk_bool depthPrePass = input->rendering.useDepthPrePass;
+                if (nk_checkbox_label(nk, "Depth Pre-Pass", &depthPrePass))
+                {
+                    input->rendering.useDepthPrePass = depthPrePass;
+                }
+
+                //Frustum Culling ueber die BVH der Szene
+                nk_bool frustumCulling = input->rendering.useFrustumCulling;
+                if (nk_checkbox_label(nk, "Frustum Culling", &frustumCulling))
+                {
+                    input->rendering.useFrustumCulling = frustumCulling;
+                }
+
+                //Occlusion Culling ueber die Tiefenpyramide des letzten Frames
+                nk_bool occlusionCulling = input->rendering.useOcclusionCulling;
+                if (nk_checkbox_label(nk, "Occlusion Culling (HiZ)", &occlusionCulling))
+                {
+                    input->rendering.useOcclusionCulling = occlusionCulling;
+                }
+
+                //Detailstufen der Meshes nach projiziertem Fehler
+                nk_bool useLod = input->rendering.useLod;
+                if (nk_checkbox_label(nk, "Mesh-LODs", &useLod))
+                {
+                    input->rendering.useLod = useLod;
+                }
+                nk_property_float(nk, "LOD-Fehler (px):", 0.1f, &input->rendering.lodPixelError, 16.0f, 0.1f, 0.05f);
+
+                //Grafikspeicher fuer gestreamte Mipmaps
+                nk_property_int(nk, "Textur-Budget (MiB):", 16, &input->rendering.textureBudget, 4096, 16, 4.0f);
+
+                //Per Rechtsklick gewaehlte Instanz
+                if (input->rendering.pickedNode >= 0)
+                {
+                    nk_labelf(nk, NK_TEXT_LEFT, "Auswahl: Knoten %i, Instanz %i",
+                              input->rendering.pickedNode, input->rendering.pickedInstance);
+                }
+
                 nk_tree_pop(nk);
             }
 
@@ -519,6 +625,7 @@ static void gui_renderMenu(ProgContext *ctx, struct nk_context *nk)
                     if (useTessellation)
                     {
                         input->tessellation.useDistanceTessellation = false;
+                        input->tessellation.useScreenSpaceTessellation = false;
                     }
                 }
                 //Innere Tesselation einstellen
@@ -535,11 +642,26 @@ static void gui_renderMenu(ProgContext *ctx, struct nk_context *nk)
                     if (useDistTessellation)
                     {
                         input->tessellation.useTessellation = false;
+                        input->tessellation.useScreenSpaceTessellation = false;
                     }
                 }
                 //Tessellation Amount einstellen
                 nk_property_float(nk, "LoD:", 1.0f, &input->tessellation.tessellationAmount, 128.0f, 0.5f, 0.5f);
 
+                //Tessellation anhand der Kantenlaenge auf dem Bildschirm
+                nk_bool useScreenTessellation = input->tessellation.useScreenSpaceTessellation;
+                if (nk_checkbox_label(nk, "Screen-Space-Tessellation", &useScreenTessellation))
+                {
+                    input->tessellation.useScreenSpaceTessellation = useScreenTessellation;
+                    if (useScreenTessellation)
+                    {
+                        input->tessellation.useTessellation = false;
+                        input->tessellation.useDistanceTessellation = false;
+                    }
+                }
+                //Angestrebte Kantenlaenge einstellen
+                nk_property_float(nk, "Pixel pro Kante:", 1.0f, &input->tessellation.pixelsPerEdge, 64.0f, 1.0f, 0.5f);
+
                 //Displacement An/Aus schlaten
                 nk_bool displacement = input->mapping.useDisplacement;
                 if (nk_checkbox_label(nk, "Displacement", &displacement))
@@ -565,8 +687,33 @@ static void gui_renderMenu(ProgContext *ctx, struct nk_context *nk)
                 nk_property_float(nk, "Bloom color weight:", 0.0f, &input->postProcessing.colorWeight, 15.0f, 0.01f, 0.01f);
                 //Emission-Weight einstellen
                 nk_property_float(nk, "Bloom emission weight:", 0.0f, &input->postProcessing.emissionWeight, 15.0f, 0.01f, 0.01f);
-                //Blur-Iterationen einstellen
-                nk_property_int(nk, "Blur Iterationen:", 0, &input->postProcessing.blurIterations, 10, 1, 1);
+                //Bloom-Verfahren auswaehlen
+                static const char *bloomModes[BLOOM_NUM_MODES] = {"Gauss (Ping-Pong)", "Gauss (Compute)", "Mip-Kette"};
+                nk_layout_row_dynamic(nk, 25, 1);
+                input->postProcessing.bloomMode = nk_combo(nk, bloomModes, BLOOM_NUM_MODES,
+                                                           input->postProcessing.bloomMode, 25,
+                                                           nk_vec2(nk_widget_width(nk), 200));
+                if (input->postProcessing.bloomMode == BLOOM_MODE_MIPCHAIN)
+                {
+                    //Radius des Upsample-Filters einstellen
+                    nk_property_float(nk, "Bloom Radius:", 0.1f, &input->postProcessing.bloomFilterRadius, 4.0f, 0.1f, 0.05f);
+                }
+                else if (input->postProcessing.bloomMode == BLOOM_MODE_GAUSSIAN_COMPUTE)
+                {
+                    //Radius des Compute-Blurs einstellen
+                    nk_property_int(nk, "Blur Radius:", 1, &input->postProcessing.blurRadius, BLUR_MAX_RADIUS, 1, 1);
+                }
+                else
+                {
+                    //Blur-Iterationen einstellen
+                    nk_property_int(nk, "Blur Iterationen:", 0, &input->postProcessing.blurIterations, 10, 1, 1);
+                }
+
+                //Alle Verfahren vermessen, Ergebnis auf der Konsole
+                if (nk_button_label(nk, "Blur-Benchmark"))
+                {
+                    input->postProcessing.runBlurBenchmark = true;
+                }
                 //Gamma-Value einstellen
                 nk_property_float(nk, "Gamma value:", 0.0f, &input->postProcessing.gamma, 10.0f, 0.01f, 0.01f);
                 //Exposure-Value einstellen
@@ -614,6 +761,9 @@ static void gui_renderMenu(ProgContext *ctx, struct nk_context *nk)
 
                 nk_property_int(nk, "PCF Amount:", 1, &input->shadows.PCFAmount, 10, 1, 1);
 
+                //Schatten mit groeberen Detailstufen als die Kamera zeichnen
+                nk_property_int(nk, "Schatten-LOD-Offset:", 0, &input->shadows.lodBias, MESH_MAX_LODS - 1, 1, 1);
+
                 //PCF aktivieren
                 nk_bool useBilinearFiltering = input->shadows.useBilinearFiltering;
                 if (nk_checkbox_label(nk, "Use Bilinear Filtering", &useBilinearFiltering))
@@ -634,6 +784,44 @@ static void gui_renderMenu(ProgContext *ctx, struct nk_context *nk)
                     input->particles.pauseSim = pausePart;
                 }
 
+                //Kapazitaet des Partikelsystems, wird erst per Knopf uebernommen
+                nk_property_int(nk, "Kapazitaet:", 1000, &input->particles.requestedCapacity, INPUT_PARTICLE_MAX_CAPACITY, 10000, 1000);
+                if (nk_button_label(nk, "Kapazitaet anwenden"))
+                {
+                    input->particles.capacity = input->particles.requestedCapacity;
+                }
+                //Neue Partikel pro Sekunde einstellen
+                nk_property_float(nk, "Emissionsrate:", 0.0f, &input->particles.emissionRate, 1000000.0f, 100.0f, 10.0f);
+
+                //Render-Pfad waehlen
+                nk_bool instancedQuads = input->particles.useInstancedQuads;
+                if (nk_checkbox_label(nk, "Instanzierte Quads", &instancedQuads))
+                {
+                    input->particles.useInstancedQuads = instancedQuads;
+                }
+                //Beide Render-Pfade vermessen, Ergebnis auf der Konsole
+                if (nk_button_label(nk, "Partikel-Benchmark"))
+                {
+                    input->particles.runBenchmark = true;
+                }
+                //Simulation auf der CPU statt mit Compute Shadern
+                nk_bool forceCpu = input->particles.forceCpuSimulation;
+                if (nk_checkbox_label(nk, "CPU-Simulation erzwingen", &forceCpu))
+                {
+                    input->particles.forceCpuSimulation = forceCpu;
+                }
+                //AVX2-, skalare und GPU-Simulation vergleichen, Details auf der Konsole
+                if (nk_button_label(nk, "Paritaet pruefen"))
+                {
+                    input->particles.runParityCheck = true;
+                }
+                if (input->particles.parityResult != 0)
+                {
+                    nk_label(nk, input->particles.parityResult > 0 ? "Paritaet: bestanden"
+                                                                   : "Paritaet: FEHLGESCHLAGEN",
+                             NK_TEXT_LEFT);
+                }
+
                 //Lebenszeit-Value einstellen
                 nk_property_float(nk, "Lebenszeit:", 2.0f, &input->particles.lifeTime, 15.0f, 0.1f, 0.1f);
                 //LZZufall-Value einstellen
@@ -661,6 +849,15 @@ static void gui_renderMenu(ProgContext *ctx, struct nk_context *nk)
                 //EndSize-Value einstellen
                 nk_property_float(nk, "Endgrosse:", 0.0f, &input->particles.endSize, 1.0f, 0.1f, 0.1f);
 
+                //Alpha-Blending mit Tiefensortierung statt additiver Ueberlagerung
+                nk_bool alphaBlend = input->particles.alphaBlend;
+                if (nk_checkbox_label(nk, "Alpha-Blending (sortiert)", &alphaBlend))
+                {
+                    input->particles.alphaBlend = alphaBlend;
+                }
+                //Weiches Ausblenden vor der Szenengeometrie
+                nk_property_float(nk, "Weichheit:", 0.0f, &input->particles.softness, 5.0f, 0.1f, 0.01f);
+
                 nk_tree_pop(nk);
             }
 
@@ -683,11 +880,30 @@ static void gui_renderStats(ProgContext *ctx, struct nk_context *nk)
     // Prüfen, ob das Menü überhaupt angezeigt werden soll.
     if (input->showStats)
     {
-        float x = (float)win->realWidth - STATS_WIDTH;
+        // Zuerst alle aktiven Zähler formatieren, um die Größe des
+        // Fensters bestimmen zu können.
+        char counterStrings[INSTRUMENTATION_NUM_COUNTERS][64];
+        int counterCount = 0;
+        for (int i = 0; i < INSTRUMENTATION_NUM_COUNTERS; i++)
+        {
+            if (instrumentation_formatCounter(ctx, i, counterStrings[counterCount],
+                                              sizeof(counterStrings[0])))
+            {
+                counterCount++;
+            }
+        }
+
+        float width = counterCount > 0 ? STATS_COUNTER_WIDTH : STATS_WIDTH;
+        float height = STATS_HEIGHT + counterCount * STATS_COUNTER_HEIGHT;
+        float x = (float)win->realWidth - width;
+
+        // Die Größe muss jeden Frame angepasst werden, da sich die Anzahl
+        // der aktiven Zähler ändern kann.
+        nk_window_set_bounds(nk, GUI_WINDOW_STATS, nk_rect(x, 0, width, height));
 
         // Fenster öffnen.
         if (nk_begin(nk, GUI_WINDOW_STATS,
-                     nk_rect(x, 0, STATS_WIDTH, STATS_HEIGHT),
+                     nk_rect(x, 0, width, height),
                      NK_WINDOW_NO_SCROLLBAR | NK_WINDOW_BACKGROUND |
                          NK_WINDOW_NO_INPUT))
         {
@@ -696,11 +912,167 @@ static void gui_renderStats(ProgContext *ctx, struct nk_context *nk)
             char fpsString[15];
             snprintf(fpsString, 14, "FPS: %d", win->fps);
             nk_label(nk, fpsString, NK_TEXT_LEFT);
+
+            // Aktive Zähler anzeigen
+            nk_layout_row_dynamic(nk, STATS_COUNTER_HEIGHT - 5, 1);
+            for (int i = 0; i < counterCount; i++)
+            {
+                nk_label(nk, counterStrings[i], NK_TEXT_LEFT);
+            }
         }
         nk_end(nk);
     }
 }
 
+/**
+ * Zeigt den Fortschritt einer im Hintergrund ladenden Szene an.
+ * 
+ * @param ctx Programmkontext
+ * @param nk Nuklear Kontext
+ */
+static void gui_renderLoading(ProgContext *ctx, struct nk_context *nk)
+{
+    WindowData *win = ctx->winData;
+
+    LoaderStatus status;
+    loader_getStatus(ctx, &status);
+    if (!status.active)
+    {
+        return;
+    }
+
+    // Unten mittig anzeigen, die Größe kann sich mit dem Fenster ändern.
+    float x = ((float)win->realWidth - LOADING_WIDTH) / 2.0f;
+    float y = (float)win->realHeight - LOADING_HEIGHT - 15.0f;
+    nk_window_set_bounds(nk, GUI_WINDOW_LOADING, nk_rect(x, y, LOADING_WIDTH, LOADING_HEIGHT));
+
+    if (nk_begin(nk, GUI_WINDOW_LOADING,
+                 nk_rect(x, y, LOADING_WIDTH, LOADING_HEIGHT),
+                 NK_WINDOW_BORDER | NK_WINDOW_NO_SCROLLBAR | NK_WINDOW_NO_INPUT))
+    {
+        char line[LOADER_MAX_NAME + 32];
+        nk_layout_row_dynamic(nk, 20, 1);
+        snprintf(line, sizeof(line), "Lade %s (%.1f s)", status.name, status.elapsed);
+        nk_label(nk, line, NK_TEXT_LEFT);
+        nk_label(nk, status.stage, NK_TEXT_LEFT);
+
+        nk_prog(nk, (nk_size)(status.progress * 100.0f), 100, nk_false);
+    }
+    nk_end(nk);
+}
+
+/**
+ * Zeichnet die aufgebaute GUI. Entspricht nk_glfw3_render, die Vertices und
+ * Indizes werden aber direkt in den Stream Buffer konvertiert, statt den
+ * Buffer des Backends jeden Frame neu anzulegen und zu mappen.
+ * 
+ * @param ctx Programmkontext
+ * @param glfw Nuklear GLFW Backend
+ */
+static void gui_drawGeometry(ProgContext *ctx, struct nk_glfw *glfw)
+{
+    struct nk_glfw_device *dev = &glfw->ogl;
+    StreamBuffer *stream = ctx->rendering->streamBuffer;
+
+    GLfloat ortho[4][4] = {
+        {2.0f, 0.0f, 0.0f, 0.0f},
+        {0.0f, -2.0f, 0.0f, 0.0f},
+        {0.0f, 0.0f, -1.0f, 0.0f},
+        {-1.0f, 1.0f, 0.0f, 1.0f},
+    };
+    ortho[0][0] /= (GLfloat)glfw->width;
+    ortho[1][1] /= (GLfloat)glfw->height;
+
+    //Indizes und Vertices liegen in einem Bereich, die Indizes zuerst. So
+    //kann der ungenutzte Rest hinter den Vertices zurueckgegeben werden.
+    StreamAllocation allocation;
+    streamBuffer_alloc(stream, MAX_ELEMENT_BUFFER + MAX_VERTEX_BUFFER, &allocation);
+    char *elements = allocation.memory;
+    char *vertices = elements + MAX_ELEMENT_BUFFER;
+
+    struct nk_convert_config config;
+    static const struct nk_draw_vertex_layout_element vertexLayout[] = {
+        {NK_VERTEX_POSITION, NK_FORMAT_FLOAT, NK_OFFSETOF(GuiVertex, position)},
+        {NK_VERTEX_TEXCOORD, NK_FORMAT_FLOAT, NK_OFFSETOF(GuiVertex, uv)},
+        {NK_VERTEX_COLOR, NK_FORMAT_R8G8B8A8, NK_OFFSETOF(GuiVertex, col)},
+        {NK_VERTEX_LAYOUT_END}};
+    memset(&config, 0, sizeof(config));
+    config.vertex_layout = vertexLayout;
+    config.vertex_size = sizeof(GuiVertex);
+    config.vertex_alignment = NK_ALIGNOF(GuiVertex);
+    config.null = dev->null;
+    config.circle_segment_count = 22;
+    config.curve_segment_count = 22;
+    config.arc_segment_count = 22;
+    config.global_alpha = 1.0f;
+    config.shape_AA = NK_ANTI_ALIASING_ON;
+    config.line_AA = NK_ANTI_ALIASING_ON;
+
+    struct nk_buffer vbuf, ebuf;
+    nk_buffer_init_fixed(&vbuf, vertices, MAX_VERTEX_BUFFER);
+    nk_buffer_init_fixed(&ebuf, elements, MAX_ELEMENT_BUFFER);
+    nk_convert(&glfw->ctx, &dev->cmds, &vbuf, &ebuf, &config);
+
+    streamBuffer_trim(stream, &allocation, MAX_ELEMENT_BUFFER + (GLsizeiptr)vbuf.allocated);
+    streamBuffer_commit(stream, &allocation);
+
+    //Globalen Zustand fuer die GUI setzen
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUseProgram(dev->prog);
+    glUniform1i(dev->uniform_tex, 0);
+    glUniformMatrix4fv(dev->uniform_proj, 1, GL_FALSE, &ortho[0][0]);
+    glViewport(0, 0, (GLsizei)glfw->display_width, (GLsizei)glfw->display_height);
+
+    //Attribute des VAOs auf den Bereich im Stream Buffer setzen
+    GLsizei stride = sizeof(GuiVertex);
+    GLintptr vertexOffset = allocation.offset + MAX_ELEMENT_BUFFER;
+    glBindVertexArray(dev->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, allocation.buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, allocation.buffer);
+    glVertexAttribPointer((GLuint)dev->attrib_pos, 2, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(vertexOffset + offsetof(GuiVertex, position)));
+    glVertexAttribPointer((GLuint)dev->attrib_uv, 2, GL_FLOAT, GL_FALSE, stride,
+                          (void *)(vertexOffset + offsetof(GuiVertex, uv)));
+    glVertexAttribPointer((GLuint)dev->attrib_col, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          (void *)(vertexOffset + offsetof(GuiVertex, col)));
+
+    //Alle Drawcommands mit ihrem Clip-Rechteck zeichnen
+    const struct nk_draw_command *cmd;
+    GLintptr elementOffset = allocation.offset;
+    nk_draw_foreach(cmd, &glfw->ctx, &dev->cmds)
+    {
+        if (!cmd->elem_count)
+        {
+            continue;
+        }
+        glBindTexture(GL_TEXTURE_2D, (GLuint)cmd->texture.id);
+        glScissor(
+            (GLint)(cmd->clip_rect.x * glfw->fb_scale.x),
+            (GLint)((glfw->height - (GLint)(cmd->clip_rect.y + cmd->clip_rect.h)) * glfw->fb_scale.y),
+            (GLint)(cmd->clip_rect.w * glfw->fb_scale.x),
+            (GLint)(cmd->clip_rect.h * glfw->fb_scale.y));
+        glDrawElements(GL_TRIANGLES, (GLsizei)cmd->elem_count, GL_UNSIGNED_SHORT,
+                       (void *)elementOffset);
+        elementOffset += cmd->elem_count * sizeof(nk_draw_index);
+    }
+    nk_clear(&glfw->ctx);
+    nk_buffer_clear(&dev->cmds);
+
+    //OpenGL Zustand zuruecksetzen
+    glUseProgram(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+}
+
 //////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
 
 void gui_setStartingColDir(DirLight *light)
@@ -745,13 +1117,10 @@ void gui_render(ProgContext *ctx)
     gui_renderHelp(ctx, data->nk);
     gui_renderMenu(ctx, data->nk);
     gui_renderStats(ctx, data->nk);
+    gui_renderLoading(ctx, data->nk);
 
     // Als letztes rendern wir die GUI
-    nk_glfw3_render(
-        &data->glfw,
-        NK_ANTI_ALIASING_ON,
-        MAX_VERTEX_BUFFER,
-        MAX_ELEMENT_BUFFER);
+    gui_drawGeometry(ctx, &data->glfw);
 }
 
 void gui_cleanup(ProgContext *ctx)
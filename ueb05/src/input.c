@@ -13,6 +13,8 @@
 #include "scene.h"
 #include "rendering.h"
 #include "gui.h"
+#include "loader.h"
+#include "capture.h"
 
 //////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
 
@@ -28,6 +30,9 @@ void input_init(ProgContext *ctx)
     data->showWireframe = false;
     data->showStats = true;
     data->showGBuffer = false;
+    data->runJobBenchmark = false;
+    data->runBvhBenchmark = false;
+    data->runDdsBenchmark = false;
 
     // Rendering Werte initialisieren
     glm_vec4_zero(data->rendering.clearColor);
@@ -35,6 +40,14 @@ void input_init(ProgContext *ctx)
     glm_vec3_zero(data->rendering.modelRotation);
     data->rendering.scale = 1.0f;
     data->rendering.userScene = NULL;
+    data->rendering.useDepthPrePass = false;
+    data->rendering.useFrustumCulling = true;
+    data->rendering.useOcclusionCulling = true;
+    data->rendering.useLod = true;
+    data->rendering.lodPixelError = 1.0f;
+    data->rendering.textureBudget = 256;
+    data->rendering.pickedNode = -1;
+    data->rendering.pickedInstance = -1;
 
     //Lighting Inputs
     data->lighting.dirLightActive = true;
@@ -56,8 +69,10 @@ void input_init(ProgContext *ctx)
     data->tessellation.useTessellation = false;
     data->tessellation.innerTessellation = 1.0f;
     data->tessellation.outerTessellation = 4.0f;
-    data->tessellation.useDistanceTessellation = true;
+    data->tessellation.useDistanceTessellation = false;
     data->tessellation.tessellationAmount = 64.0f;
+    data->tessellation.useScreenSpaceTessellation = true;
+    data->tessellation.pixelsPerEdge = 8.0f;
 
     //PostProcessing Inputs
     data->postProcessing.colorWeight = 1.0f;
@@ -67,6 +82,10 @@ void input_init(ProgContext *ctx)
     data->postProcessing.exposure = 1.0f;
     data->postProcessing.useBloom = true;
     data->postProcessing.blurIterations = 3;
+    data->postProcessing.bloomMode = BLOOM_MODE_MIPCHAIN;
+    data->postProcessing.bloomFilterRadius = 1.0f;
+    data->postProcessing.blurRadius = 12;
+    data->postProcessing.runBlurBenchmark = false;
 
     //Schatten Inputs
     data->shadows.createDirShadows = true;
@@ -76,6 +95,7 @@ void input_init(ProgContext *ctx)
     data->shadows.realtimeDirShadows = false;
     data->shadows.useBilinearFiltering = true;
     data->shadows.PCFAmount = 1;
+    data->shadows.lodBias = 1;
 
     //Particle Inputs
     glm_vec3_zero(data->particles.startPos);
@@ -88,9 +108,20 @@ void input_init(ProgContext *ctx)
     data->particles.gravity[1] = -1.0f;
     data->particles.startSize = 1.0f;
     data->particles.endSize = 1.0f;
+    data->particles.alphaBlend = false;
+    data->particles.softness = 0.5f;
     glm_vec3_one(data->particles.startColor);
     glm_vec3_one(data->particles.endColor);
     data->particles.pauseSim = false;
+    data->particles.capacity = INPUT_PARTICLE_DEFAULT_CAPACITY;
+    data->particles.requestedCapacity = INPUT_PARTICLE_DEFAULT_CAPACITY;
+    data->particles.emissionRate = 200.0f;
+    data->particles.useInstancedQuads = true;
+    data->particles.runBenchmark = false;
+    data->particles.forceCpuSimulation = false;
+    data->particles.runParityCheck = false;
+    data->particles.parityResult = 0;
+    data->particles.reloadEmitters = false;
 
     Model *newSphere = NULL;
     newSphere = model_loadModel("..\\res\\models\\unitRadiusSphere.fbx");
@@ -134,9 +165,6 @@ void input_process(ProgContext *ctx)
 
 void input_event(ProgContext *ctx, int key, int action, int mods)
 {
-    // Mods wird aktuell nicht benutzt.
-    (void)mods;
-
     // Input-Events verarbeiten.
     InputData *data = ctx->input;
     if (action == GLFW_PRESS)
@@ -174,9 +202,25 @@ void input_event(ProgContext *ctx, int key, int action, int mods)
             data->showStats = !data->showStats;
             break;
 
-        /* Screenshot anfertigen */
+        /* Screenshot anfertigen, mit Shift Videoaufnahme umschalten */
         case GLFW_KEY_F6:
-            texture_saveScreenshot(ctx);
+            if (mods & GLFW_MOD_SHIFT)
+            {
+                CaptureStatus status;
+                capture_getStatus(ctx, &status);
+                if (status.recording)
+                {
+                    capture_stopRecording(ctx);
+                }
+                else
+                {
+                    capture_startRecording(ctx, CAPTURE_MODE_VIDEO);
+                }
+            }
+            else
+            {
+                capture_requestScreenshot(ctx);
+            }
             break;
 
         /* Shader neu kompilieren */
@@ -221,6 +265,67 @@ void input_mouseMove(ProgContext *ctx, double x, double y)
     }
 }
 
+/**
+ * Wählt die Instanz unter dem Mauszeiger aus. Dafür wird ein Strahl von der
+ * Kamera durch den Mauszeiger in die Szene geschossen.
+ * 
+ * @param ctx Programmkontext
+ */
+static void input_pickObject(ProgContext *ctx)
+{
+    InputData *data = ctx->input;
+    Scene *scene = data->rendering.userScene;
+    if (scene == NULL || ctx->winData->realWidth <= 0 || ctx->winData->realHeight <= 0)
+    {
+        return;
+    }
+
+    // Mausposition in normalisierte Gerätekoordinaten umrechnen.
+    double mouseX, mouseY;
+    glfwGetCursorPos(ctx->window, &mouseX, &mouseY);
+    float ndcX = (float)(2.0 * mouseX / ctx->winData->realWidth - 1.0);
+    float ndcY = (float)(1.0 - 2.0 * mouseY / ctx->winData->realHeight);
+
+    // Gleiche Matrizen wie beim Rendern verwenden.
+    mat4 projectionMatrix, viewMatrix, viewProjMatrix, inverse;
+    float aspect = (float)ctx->winData->width / (float)ctx->winData->height;
+    float zoom = camera_getZoom(data->mainCamera);
+    glm_perspective(glm_rad(zoom), aspect, RENDERING_NEAR_PLANE, RENDERING_FAR_PLANE, projectionMatrix);
+    camera_getViewMatrix(data->mainCamera, viewMatrix);
+    glm_mat4_mul(projectionMatrix, viewMatrix, viewProjMatrix);
+    glm_mat4_inv(viewProjMatrix, inverse);
+
+    // Punkte auf der Near- und Far-Plane bestimmen.
+    vec4 nearPoint = {ndcX, ndcY, -1.0f, 1.0f};
+    vec4 farPoint = {ndcX, ndcY, 1.0f, 1.0f};
+    glm_mat4_mulv(inverse, nearPoint, nearPoint);
+    glm_mat4_mulv(inverse, farPoint, farPoint);
+    glm_vec4_scale(nearPoint, 1.0f / nearPoint[3], nearPoint);
+    glm_vec4_scale(farPoint, 1.0f / farPoint[3], farPoint);
+
+    vec3 origin, dir;
+    glm_vec3(nearPoint, origin);
+    glm_vec3_sub(farPoint, nearPoint, dir);
+    glm_vec3_normalize(dir);
+
+    int node, instance;
+    float t;
+    double start = glfwGetTime();
+    if (scene_pick(scene, origin, dir, &node, &instance, &t))
+    {
+        data->rendering.pickedNode = node;
+        data->rendering.pickedInstance = instance;
+        printf("Picking: Knoten %i, Instanz %i, Entfernung %.2f (%.3f ms)\n",
+               node, instance, t, (glfwGetTime() - start) * 1000.0);
+    }
+    else
+    {
+        data->rendering.pickedNode = -1;
+        data->rendering.pickedInstance = -1;
+        printf("Picking: kein Treffer (%.3f ms)\n", (glfwGetTime() - start) * 1000.0);
+    }
+}
+
 void input_mouseAction(ProgContext *ctx, int button, int action, int mods)
 {
     // Die Modifikatioren werden nicht benutzt.
@@ -243,6 +348,10 @@ void input_mouseAction(ProgContext *ctx, int button, int action, int mods)
             data->mouseLooking = false;
         }
     }
+    else if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
+    {
+        input_pickObject(ctx);
+    }
 }
 
 void input_scroll(ProgContext *ctx, double xoff, double yoff)
@@ -264,34 +373,25 @@ static void input_copyFirstSceneDirLight(ProgContext *ctx, Scene *scene)
 
 void input_userSelectedFile(ProgContext *ctx, const char *path)
 {
-    // Sollte zuvor ein Modell geladen worden sein, muss es gelöscht werden.
-    if (ctx->input->rendering.userScene)
-    {
-        scene_deleteScene(ctx->input->rendering.userScene);
-        ctx->input->rendering.userScene = NULL;
-        deleteTextureCache();
-    }
+    // Die Szene wird im Hintergrund geladen, bis dahin bleibt die alte
+    // Szene sichtbar.
+    loader_requestScene(ctx, path);
+}
 
-    // Dann laden wir die neue Szene/das neue Modell.
-    Scene *newScene = NULL;
-    if (utils_hasSuffix(path, ".json"))
-    {
-        newScene = scene_loadScene(path);
-        if (newScene != NULL)
-        {
-            input_copyFirstSceneDirLight(ctx, newScene);
-            gui_setStartingColDir(&ctx->input->lighting.dirLight);
-        }
-    }
-    else
+void input_sceneLoaded(ProgContext *ctx, Scene *scene, bool isJson)
+{
+    if (isJson)
     {
-        newScene = scene_fromModel(path);
+        input_copyFirstSceneDirLight(ctx, scene);
+        gui_setStartingColDir(&ctx->input->lighting.dirLight);
     }
 
     ctx->input->shadows.createDirShadows = true;
     ctx->input->shadows.createPointLightShadows = false;
     ctx->input->shadows.showPointShadows = false;
-    ctx->input->rendering.userScene = newScene;
+    ctx->input->particles.reloadEmitters = true;
+    ctx->input->rendering.pickedNode = -1;
+    ctx->input->rendering.pickedInstance = -1;
 }
 
 void input_cleanup(ProgContext *ctx)
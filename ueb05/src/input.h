@@ -15,8 +15,24 @@
 #include "light.h"
 #include "scene.h"
 
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Standard- und Maximalkapazität des Partikelsystems.
+#define INPUT_PARTICLE_DEFAULT_CAPACITY (1 << 20)
+#define INPUT_PARTICLE_MAX_CAPACITY (1 << 24)
+
 //////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
 
+// Verfahren für die Berechnung des Bloom-Effekts.
+enum BloomMode
+{
+    BLOOM_MODE_GAUSSIAN,  // Gauss-Blur in voller Auflösung (Ping-Pong)
+    BLOOM_MODE_GAUSSIAN_COMPUTE, // Gauss-Blur als Compute-Shader
+    BLOOM_MODE_MIPCHAIN,  // Downsample/Upsample-Kette in kleineren Auflösungen
+    BLOOM_NUM_MODES
+};
+typedef enum BloomMode BloomMode;
+
 // Datenstruktur, die die Zustände des Programms enthält,
 // die durch Benutzereingaben direkt beeinfluss werden können.
 struct InputData
@@ -27,6 +43,9 @@ struct InputData
     bool showMenu;
     bool showStats;
     bool showGBuffer;
+    bool runJobBenchmark;
+    bool runBvhBenchmark;
+    bool runDdsBenchmark;
 
     struct
     {
@@ -34,6 +53,14 @@ struct InputData
         float scale;
         vec3 modelRotation;
         Scene *userScene;
+        bool useDepthPrePass;
+        bool useFrustumCulling;
+        bool useOcclusionCulling;
+        bool useLod;
+        float lodPixelError;  // Erlaubter Fehler der Detailstufen in Pixeln
+        int textureBudget;    // Grafikspeicher für gestreamte Texturen in MiB
+        int pickedNode;      // Per Rechtsklick gewählter Knoten oder -1
+        int pickedInstance;  // Instanz innerhalb des gewählten Knotens
     } rendering;
 
     struct {
@@ -58,6 +85,8 @@ struct InputData
         float outerTessellation;
         bool useDistanceTessellation;
         float tessellationAmount;
+        bool useScreenSpaceTessellation; // Stufen aus der Kantenlänge in Pixeln
+        float pixelsPerEdge;             // Angestrebte Kantenlänge in Pixeln
     } tessellation;
 
     struct
@@ -69,6 +98,10 @@ struct InputData
         float gamma;
         float exposure;
         int blurIterations;
+        BloomMode bloomMode;
+        float bloomFilterRadius;
+        int blurRadius;
+        bool runBlurBenchmark;
     } postProcessing;
 
     struct
@@ -81,6 +114,7 @@ struct InputData
         bool usePCF;
         bool useBilinearFiltering;
         int PCFAmount;
+        int lodBias;  // Zusätzliche Detailstufen der Schatten
     } shadows;
 
     struct
@@ -95,7 +129,18 @@ struct InputData
         vec3 endColor;
         float startSize;
         float endSize;
+        bool alphaBlend;
+        float softness;
         bool pauseSim;
+        int capacity;
+        int requestedCapacity;
+        float emissionRate;
+        bool useInstancedQuads;
+        bool runBenchmark;
+        bool forceCpuSimulation;
+        bool runParityCheck;
+        int parityResult; // 0 = nicht geprueft, 1 = bestanden, -1 = fehlgeschlagen
+        bool reloadEmitters;
     } particles;
        
     
@@ -178,6 +223,16 @@ void input_scroll(ProgContext *ctx, double xoff, double yoff);
  */
 void input_userSelectedFile(ProgContext *ctx, const char *path);
 
+/**
+ * Übernimmt die Einstellungen einer neu geladenen Szene. Wird vom
+ * Lade-Modul aufgerufen, nachdem die Szene veröffentlicht wurde.
+ * 
+ * @param ctx Programmkontext.
+ * @param scene die neue Szene
+ * @param isJson true, wenn eine Szenendatei statt eines Modells geladen wurde
+ */
+void input_sceneLoaded(ProgContext *ctx, Scene *scene, bool isJson);
+
 /**
  * Gibt die Ressourcen des Input-Moduls wieder frei.
  * 
@@ -0,0 +1,224 @@
+/**
+ * Modul für das Messen von Kennzahlen des Renderers.
+ * Zähler können entweder über OpenGL Queries (z.B. Anzahl gezeichneter
+ * Fragmente oder GPU-Zeit) oder direkt von der CPU gesetzt werden.
+ * Die Ergebnisse der Queries werden erst einige Frames später abgeholt,
+ * damit die CPU nie auf die GPU warten muss. Alle Zähler, die im letzten
+ * Frame benutzt wurden, werden im Statistikfenster angezeigt.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "instrumentation.h"
+
+#include <stdio.h>
+#include <string.h>
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Anzahl der Frames, die eine Query maximal unterwegs sein darf.
+#define INSTRUMENTATION_QUERY_LATENCY 3
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Art der Messung eines Zählers.
+enum InstrumentationType
+{
+    INSTRUMENTATION_TYPE_CPU,     // Wert wird von der CPU gesetzt
+    INSTRUMENTATION_TYPE_SAMPLES, // GL_SAMPLES_PASSED
+    INSTRUMENTATION_TYPE_TIME     // GL_TIME_ELAPSED
+};
+typedef enum InstrumentationType InstrumentationType;
+
+// Beschreibung eines Zählers.
+struct InstrumentationInfo
+{
+    const char* name;
+    const char* format;
+    InstrumentationType type;
+};
+typedef struct InstrumentationInfo InstrumentationInfo;
+
+// Laufzeitdaten eines Zählers.
+struct InstrumentationEntry
+{
+    GLuint queries[INSTRUMENTATION_QUERY_LATENCY];
+    bool pending[INSTRUMENTATION_QUERY_LATENCY];
+    double value;
+    unsigned long lastUsedFrame;
+};
+typedef struct InstrumentationEntry InstrumentationEntry;
+
+// Datentyp für alle persistenten Daten des Moduls.
+struct InstrumentationData
+{
+    InstrumentationEntry entries[INSTRUMENTATION_NUM_COUNTERS];
+    unsigned long frame;
+};
+typedef struct InstrumentationData InstrumentationData;
+
+////////////////////////////// LOKALE VARIABLEN ////////////////////////////////
+
+// Beschreibungen aller Zähler in der Reihenfolge von InstrumentationCounter.
+static const InstrumentationInfo g_counterInfos[INSTRUMENTATION_NUM_COUNTERS] = {
+    {"Pre-Pass Fragmente", "%s: %.0f", INSTRUMENTATION_TYPE_SAMPLES},
+    {"G-Buffer Fragmente", "%s: %.0f", INSTRUMENTATION_TYPE_SAMPLES},
+    {"Overdraw gespart", "%s: %.1f %%", INSTRUMENTATION_TYPE_CPU},
+    {"Bloom GPU-Zeit", "%s: %.3f ms", INSTRUMENTATION_TYPE_TIME},
+    {"Partikel GPU-Zeit", "%s: %.3f ms", INSTRUMENTATION_TYPE_TIME},
+    {"Partikel CPU-Zeit", "%s: %.3f ms", INSTRUMENTATION_TYPE_CPU},
+    {"Sichtbare Instanzen", "%s: %.0f", INSTRUMENTATION_TYPE_CPU},
+    {"Verdeckte Instanzen", "%s: %.0f", INSTRUMENTATION_TYPE_CPU},
+    {"Nachgezeichnete Instanzen", "%s: %.0f", INSTRUMENTATION_TYPE_CPU},
+    {"Verdeckte Schatten-Instanzen", "%s: %.0f", INSTRUMENTATION_TYPE_CPU},
+    {"Texturen geladen", "%s: %.1f MiB", INSTRUMENTATION_TYPE_CPU},
+    {"Texturen angefordert", "%s: %.1f MiB", INSTRUMENTATION_TYPE_CPU},
+};
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Liefert das OpenGL Query-Target für einen Zählertyp.
+ *
+ * @param type der Zählertyp
+ * @return das Query-Target
+ */
+static GLenum instrumentation_getTarget(InstrumentationType type)
+{
+    return type == INSTRUMENTATION_TYPE_TIME ? GL_TIME_ELAPSED : GL_SAMPLES_PASSED;
+}
+
+/**
+ * Liefert den Slot der Queries für den aktuellen Frame.
+ *
+ * @param data die Moduldaten
+ * @return der Slot
+ */
+static unsigned int instrumentation_currentSlot(InstrumentationData* data)
+{
+    return data->frame % INSTRUMENTATION_QUERY_LATENCY;
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+void instrumentation_init(ProgContext* ctx)
+{
+    ctx->instrumentation = malloc(sizeof(InstrumentationData));
+    InstrumentationData* data = ctx->instrumentation;
+    memset(data, 0, sizeof(InstrumentationData));
+
+    // Erst ab Frame 2 gelten Zähler als benutzt.
+    data->frame = 2;
+
+    for (int i = 0; i < INSTRUMENTATION_NUM_COUNTERS; i++)
+    {
+        if (g_counterInfos[i].type != INSTRUMENTATION_TYPE_CPU)
+        {
+            glGenQueries(INSTRUMENTATION_QUERY_LATENCY, data->entries[i].queries);
+        }
+    }
+}
+
+void instrumentation_beginFrame(ProgContext* ctx)
+{
+    InstrumentationData* data = ctx->instrumentation;
+    data->frame++;
+
+    // Alle Queries abholen, deren Ergebnis bereits vorliegt. Ergebnisse,
+    // die noch nicht fertig sind, werden im nächsten Frame erneut geprüft.
+    for (int i = 0; i < INSTRUMENTATION_NUM_COUNTERS; i++)
+    {
+        InstrumentationEntry* entry = &data->entries[i];
+        for (int s = 0; s < INSTRUMENTATION_QUERY_LATENCY; s++)
+        {
+            if (!entry->pending[s])
+            {
+                continue;
+            }
+
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(entry->queries[s], GL_QUERY_RESULT_AVAILABLE,
+                                &available);
+            if (available)
+            {
+                GLuint64 result = 0;
+                glGetQueryObjectui64v(entry->queries[s], GL_QUERY_RESULT, &result);
+                entry->value = g_counterInfos[i].type == INSTRUMENTATION_TYPE_TIME
+                                   ? (double)result / 1000000.0
+                                   : (double)result;
+                entry->pending[s] = false;
+            }
+        }
+    }
+}
+
+void instrumentation_beginQuery(ProgContext* ctx, InstrumentationCounter counter)
+{
+    InstrumentationData* data = ctx->instrumentation;
+    InstrumentationEntry* entry = &data->entries[counter];
+    unsigned int slot = instrumentation_currentSlot(data);
+
+    // Ist der Slot noch belegt, ist die GPU mehrere Frames im Rückstand.
+    // Die alte Messung wird dann verworfen, statt auf sie zu warten.
+    entry->pending[slot] = false;
+    entry->lastUsedFrame = data->frame;
+
+    glBeginQuery(instrumentation_getTarget(g_counterInfos[counter].type),
+                 entry->queries[slot]);
+}
+
+void instrumentation_endQuery(ProgContext* ctx, InstrumentationCounter counter)
+{
+    InstrumentationData* data = ctx->instrumentation;
+    InstrumentationEntry* entry = &data->entries[counter];
+
+    glEndQuery(instrumentation_getTarget(g_counterInfos[counter].type));
+    entry->pending[instrumentation_currentSlot(data)] = true;
+}
+
+void instrumentation_setValue(ProgContext* ctx, InstrumentationCounter counter,
+                              double value)
+{
+    InstrumentationData* data = ctx->instrumentation;
+    data->entries[counter].value = value;
+    data->entries[counter].lastUsedFrame = data->frame;
+}
+
+double instrumentation_getValue(ProgContext* ctx, InstrumentationCounter counter)
+{
+    return ctx->instrumentation->entries[counter].value;
+}
+
+bool instrumentation_formatCounter(ProgContext* ctx,
+                                   InstrumentationCounter counter,
+                                   char* buffer, size_t size)
+{
+    InstrumentationData* data = ctx->instrumentation;
+    InstrumentationEntry* entry = &data->entries[counter];
+
+    // Nur Zähler anzeigen, die im aktuellen oder letzten Frame benutzt wurden.
+    if (data->frame - entry->lastUsedFrame > 1)
+    {
+        return false;
+    }
+
+    snprintf(buffer, size, g_counterInfos[counter].format,
+             g_counterInfos[counter].name, entry->value);
+    return true;
+}
+
+void instrumentation_cleanup(ProgContext* ctx)
+{
+    InstrumentationData* data = ctx->instrumentation;
+
+    for (int i = 0; i < INSTRUMENTATION_NUM_COUNTERS; i++)
+    {
+        if (g_counterInfos[i].type != INSTRUMENTATION_TYPE_CPU)
+        {
+            glDeleteQueries(INSTRUMENTATION_QUERY_LATENCY, data->entries[i].queries);
+        }
+    }
+
+    free(ctx->instrumentation);
+}
@@ -0,0 +1,113 @@
+/**
+ * Modul für das Messen von Kennzahlen des Renderers.
+ * Zähler können entweder über OpenGL Queries (z.B. Anzahl gezeichneter
+ * Fragmente oder GPU-Zeit) oder direkt von der CPU gesetzt werden.
+ * Die Ergebnisse der Queries werden erst einige Frames später abgeholt,
+ * damit die CPU nie auf die GPU warten muss. Alle Zähler, die im letzten
+ * Frame benutzt wurden, werden im Statistikfenster angezeigt.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include "common.h"
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Alle verfügbaren Zähler.
+enum InstrumentationCounter
+{
+    INSTRUMENTATION_PREPASS_SAMPLES,
+    INSTRUMENTATION_GEOMETRY_SAMPLES,
+    INSTRUMENTATION_OVERDRAW_SAVED,
+    INSTRUMENTATION_BLOOM_TIME,
+    INSTRUMENTATION_PARTICLE_TIME,
+    INSTRUMENTATION_PARTICLE_CPU_TIME,
+    INSTRUMENTATION_VISIBLE_INSTANCES,
+    INSTRUMENTATION_OCCLUDED_INSTANCES,
+    INSTRUMENTATION_LATE_INSTANCES,
+    INSTRUMENTATION_OCCLUDED_SHADOW_INSTANCES,
+    INSTRUMENTATION_TEXTURE_RESIDENT,
+    INSTRUMENTATION_TEXTURE_REQUESTED,
+    INSTRUMENTATION_NUM_COUNTERS
+};
+typedef enum InstrumentationCounter InstrumentationCounter;
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Initialisiert das Instrumentation-Modul.
+ *
+ * @param ctx Programmkontext.
+ */
+void instrumentation_init(ProgContext* ctx);
+
+/**
+ * Beginnt einen neuen Frame. Dabei werden alle bereits verfügbaren
+ * Ergebnisse vergangener Queries abgeholt.
+ *
+ * @param ctx Programmkontext.
+ */
+void instrumentation_beginFrame(ProgContext* ctx);
+
+/**
+ * Startet die GPU-Messung eines Zählers. Zähler des gleichen Query-Typs
+ * dürfen nicht verschachtelt werden.
+ *
+ * @param ctx Programmkontext.
+ * @param counter der zu messende Zähler
+ */
+void instrumentation_beginQuery(ProgContext* ctx, InstrumentationCounter counter);
+
+/**
+ * Beendet die GPU-Messung eines Zählers.
+ *
+ * @param ctx Programmkontext.
+ * @param counter der gemessene Zähler
+ */
+void instrumentation_endQuery(ProgContext* ctx, InstrumentationCounter counter);
+
+/**
+ * Setzt den Wert eines Zählers direkt von der CPU aus.
+ *
+ * @param ctx Programmkontext.
+ * @param counter der zu setzende Zähler
+ * @param value der neue Wert
+ */
+void instrumentation_setValue(ProgContext* ctx, InstrumentationCounter counter,
+                              double value);
+
+/**
+ * Liefert den zuletzt bekannten Wert eines Zählers. Zeiten werden in
+ * Millisekunden geliefert.
+ *
+ * @param ctx Programmkontext.
+ * @param counter der abzufragende Zähler
+ * @return der Wert des Zählers
+ */
+double instrumentation_getValue(ProgContext* ctx, InstrumentationCounter counter);
+
+/**
+ * Formatiert einen Zähler für die Anzeige.
+ *
+ * @param ctx Programmkontext.
+ * @param counter der anzuzeigende Zähler
+ * @param buffer der Zielpuffer
+ * @param size die Größe des Zielpuffers
+ * @return true, wenn der Zähler im letzten Frame benutzt wurde
+ */
+bool instrumentation_formatCounter(ProgContext* ctx,
+                                   InstrumentationCounter counter,
+                                   char* buffer, size_t size);
+
+/**
+ * Gibt die Ressourcen des Instrumentation-Moduls wieder frei.
+ *
+ * @param ctx Programmkontext.
+ */
+void instrumentation_cleanup(ProgContext* ctx);
+
+#endif // INSTRUMENTATION_H
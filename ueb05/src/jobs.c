@@ -0,0 +1,624 @@
+/**
+ * Modul für das Verteilen von Arbeit auf mehrere Threads.
+ * Beim Start wird pro weiterem Prozessor ein Worker-Thread erzeugt. Jeder
+ * Worker und der Hauptthread besitzen eine eigene Chase-Lev-Deque: neue
+ * Jobs werden in die eigene Deque gelegt und von dort abgearbeitet, Worker
+ * ohne Arbeit stehlen Jobs von den anderen. Zusammengehörige Jobs teilen
+ * sich einen Zähler, auf den gewartet werden kann. Der wartende Thread
+ * arbeitet währenddessen selbst Jobs ab.
+ *
+ * Das Modul ist bewusst global und nicht im Programmkontext abgelegt, da es
+ * auch von Modulen ohne Zugriff auf den Kontext und aus den Worker-Threads
+ * heraus benutzt wird.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "jobs.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "thread.h"
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Maximale Anzahl an Threads inklusive des Hauptthreads.
+#define JOBS_MAX_THREADS 32
+
+// Kapazität einer Deque, muss eine Zweierpotenz sein.
+#define JOBS_DEQUE_CAPACITY 4096
+
+// Kapazität der Warteschlange für Jobs aus fremden Threads.
+#define JOBS_INJECT_CAPACITY 256
+
+// Maximale Anzahl an Bereichen, in die jobs_parallelFor aufteilt.
+#define JOBS_MAX_BATCHES 64
+
+// Bereiche pro Thread in jobs_parallelFor, damit das Stehlen
+// ungleich lange Bereiche ausgleichen kann.
+#define JOBS_BATCHES_PER_THREAD 4
+
+// Erfolglose Suchen nach Arbeit, bevor sich ein Worker schlafen legt.
+#define JOBS_SPIN_COUNT 64
+
+// Größe einer Cache-Line, trennt die Indizes der Deque.
+#define JOBS_CACHE_LINE 64
+
+// Durchläufe des Benchmarks.
+#define JOBS_BENCHMARK_JOBS 100000
+#define JOBS_BENCHMARK_BATCH 1000
+#define JOBS_BENCHMARK_LOOPS 10000
+#define JOBS_BENCHMARK_THREAD_LOOPS 100
+
+////////////////////////////////// MAKROS //////////////////////////////////////
+
+#ifdef _MSC_VER
+#define JOBS_THREAD_LOCAL __declspec(thread)
+#else
+#define JOBS_THREAD_LOCAL _Thread_local
+#endif
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Ein einzelner Job.
+struct Job
+{
+    JobFunction func;
+    void* arg;
+    JobCounter* counter;
+};
+typedef struct Job Job;
+
+// Chase-Lev-Deque fester Größe. Nur der Besitzer legt Jobs am unteren Ende
+// ab und nimmt sie dort wieder heraus, alle anderen Threads stehlen am
+// oberen Ende.
+struct JobDeque
+{
+    AtomicInt64 top;
+    char padTop[JOBS_CACHE_LINE - sizeof(AtomicInt64)];
+    AtomicInt64 bottom;
+    char padBottom[JOBS_CACHE_LINE - sizeof(AtomicInt64)];
+    Job jobs[JOBS_DEQUE_CAPACITY];
+};
+typedef struct JobDeque JobDeque;
+
+// Ein Bereich einer parallelen Schleife.
+struct JobRange
+{
+    JobRangeFunction func;
+    void* arg;
+    int begin;
+    int end;
+};
+typedef struct JobRange JobRange;
+
+// Datentyp für alle persistenten Daten des Moduls.
+struct JobSystem
+{
+    int threadCount; // Inklusive Hauptthread
+    JobDeque* deques[JOBS_MAX_THREADS];
+    Thread* workers[JOBS_MAX_THREADS];
+
+    AtomicInt queued;   // Jobs, die in einer Deque oder Warteschlange liegen
+    AtomicInt sleeping; // Worker, die schlafen oder sich schlafen legen
+    AtomicInt running;
+    Mutex* sleepMutex;
+    Condition* wakeUp;
+
+    // Ringpuffer für Jobs aus Threads ohne eigene Deque (z.B. dem Loader).
+    Mutex* injectMutex;
+    AtomicInt injectCount;
+    int injectHead;
+    Job injected[JOBS_INJECT_CAPACITY];
+};
+typedef struct JobSystem JobSystem;
+
+////////////////////////////// LOKALE VARIABLEN ////////////////////////////////
+
+// Das Job-System. Ohne jobs_init laufen alle Jobs direkt.
+static JobSystem g_jobs = {.threadCount = 1};
+
+// Index der Deque des aktuellen Threads, -1 für fremde Threads.
+static JOBS_THREAD_LOCAL int g_threadIndex = -1;
+
+// Zustand für die Wahl des Opfers beim Stehlen.
+static JOBS_THREAD_LOCAL unsigned int g_stealSeed = 1;
+
+// Summe des Benchmarks, verhindert das Wegoptimieren der Jobs.
+static AtomicInt g_benchmarkSum;
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Legt einen Job am unteren Ende der Deque ab. Nur für den Besitzer.
+ *
+ * @param deque die Deque
+ * @param job der Job
+ * @return false, wenn die Deque voll ist
+ */
+static bool jobs_push(JobDeque* deque, const Job* job)
+{
+    long long b = thread_atomicLoad64(&deque->bottom);
+    long long t = thread_atomicLoad64(&deque->top);
+    if (b - t >= JOBS_DEQUE_CAPACITY)
+    {
+        return false;
+    }
+
+    // Das Schreiben mit Release-Semantik veröffentlicht den Job.
+    deque->jobs[b & (JOBS_DEQUE_CAPACITY - 1)] = *job;
+    thread_atomicStore64(&deque->bottom, b + 1);
+    return true;
+}
+
+/**
+ * Nimmt den zuletzt abgelegten Job vom unteren Ende. Nur für den Besitzer.
+ *
+ * @param deque die Deque
+ * @param job Ziel für den Job
+ * @return true, wenn ein Job entnommen wurde
+ */
+static bool jobs_pop(JobDeque* deque, Job* job)
+{
+    long long b = thread_atomicLoad64(&deque->bottom) - 1;
+    thread_atomicStore64(&deque->bottom, b);
+    thread_atomicFence();
+    long long t = thread_atomicLoad64(&deque->top);
+
+    if (t > b)
+    {
+        // Deque war bereits leer.
+        thread_atomicStore64(&deque->bottom, b + 1);
+        return false;
+    }
+
+    *job = deque->jobs[b & (JOBS_DEQUE_CAPACITY - 1)];
+    if (t < b)
+    {
+        return true;
+    }
+
+    // Letzter Job: Der Wettlauf mit stehlenden Threads wird über top
+    // entschieden.
+    bool won = thread_atomicCompareExchange64(&deque->top, &t, t + 1);
+    thread_atomicStore64(&deque->bottom, b + 1);
+    return won;
+}
+
+/**
+ * Stiehlt den ältesten Job vom oberen Ende einer fremden Deque.
+ *
+ * @param deque die Deque
+ * @param job Ziel für den Job
+ * @return true, wenn ein Job gestohlen wurde
+ */
+static bool jobs_steal(JobDeque* deque, Job* job)
+{
+    long long t = thread_atomicLoad64(&deque->top);
+    thread_atomicFence();
+    long long b = thread_atomicLoad64(&deque->bottom);
+    if (t >= b)
+    {
+        return false;
+    }
+
+    // Der Job wird vor dem Vergleich kopiert. Schlägt der Vergleich fehl,
+    // kann der Platz bereits neu belegt sein und die Kopie wird verworfen.
+    Job stolen = deque->jobs[t & (JOBS_DEQUE_CAPACITY - 1)];
+    if (!thread_atomicCompareExchange64(&deque->top, &t, t + 1))
+    {
+        return false;
+    }
+
+    *job = stolen;
+    return true;
+}
+
+/**
+ * Legt einen Job eines fremden Threads in die gemeinsame Warteschlange.
+ *
+ * @param job der Job
+ * @return false, wenn die Warteschlange voll ist
+ */
+static bool jobs_inject(const Job* job)
+{
+    thread_lockMutex(g_jobs.injectMutex);
+    int count = thread_atomicLoad(&g_jobs.injectCount);
+    bool pushed = count < JOBS_INJECT_CAPACITY;
+    if (pushed)
+    {
+        g_jobs.injected[(g_jobs.injectHead + count) % JOBS_INJECT_CAPACITY] = *job;
+        thread_atomicStore(&g_jobs.injectCount, count + 1);
+    }
+    thread_unlockMutex(g_jobs.injectMutex);
+    return pushed;
+}
+
+/**
+ * Nimmt den ältesten Job aus der gemeinsamen Warteschlange.
+ *
+ * @param job Ziel für den Job
+ * @return true, wenn ein Job entnommen wurde
+ */
+static bool jobs_takeInjected(Job* job)
+{
+    // Ohne Sperre vorab prüfen, die Warteschlange ist fast immer leer.
+    if (thread_atomicLoad(&g_jobs.injectCount) == 0)
+    {
+        return false;
+    }
+
+    thread_lockMutex(g_jobs.injectMutex);
+    int count = thread_atomicLoad(&g_jobs.injectCount);
+    bool taken = count > 0;
+    if (taken)
+    {
+        *job = g_jobs.injected[g_jobs.injectHead];
+        g_jobs.injectHead = (g_jobs.injectHead + 1) % JOBS_INJECT_CAPACITY;
+        thread_atomicStore(&g_jobs.injectCount, count - 1);
+    }
+    thread_unlockMutex(g_jobs.injectMutex);
+    return taken;
+}
+
+/**
+ * Weckt schlafende Worker, nachdem ein Job abgelegt wurde.
+ */
+static void jobs_wakeWorkers(void)
+{
+    thread_atomicAdd(&g_jobs.queued, 1);
+    if (thread_atomicLoad(&g_jobs.sleeping) > 0)
+    {
+        thread_lockMutex(g_jobs.sleepMutex);
+        thread_broadcastCondition(g_jobs.wakeUp);
+        thread_unlockMutex(g_jobs.sleepMutex);
+    }
+}
+
+/**
+ * Führt einen Job aus und meldet ihn bei seinem Zähler ab.
+ *
+ * @param job der Job
+ */
+static void jobs_execute(const Job* job)
+{
+    job->func(job->arg);
+    thread_atomicAdd(&job->counter->pending, -1);
+}
+
+/**
+ * Sucht einen Job, zuerst in der eigenen Deque, danach bei den anderen
+ * Threads und zuletzt in der Warteschlange fremder Threads, und führt ihn
+ * aus.
+ *
+ * @return true, wenn ein Job ausgeführt wurde
+ */
+static bool jobs_runOne(void)
+{
+    int self = g_threadIndex;
+    int count = g_jobs.threadCount;
+    Job job;
+
+    bool found = self >= 0 && jobs_pop(g_jobs.deques[self], &job);
+
+    // Beim Stehlen an einer zufälligen Stelle beginnen, damit sich die
+    // Worker nicht alle auf dieselbe Deque stürzen.
+    g_stealSeed = g_stealSeed * 1103515245u + 12345u;
+    int start = (int)((g_stealSeed >> 16) % (unsigned int)count);
+    for (int i = 0; !found && i < count; i++)
+    {
+        int victim = (start + i) % count;
+        if (victim != self)
+        {
+            found = jobs_steal(g_jobs.deques[victim], &job);
+        }
+    }
+    if (!found && count > 1)
+    {
+        found = jobs_takeInjected(&job);
+    }
+
+    if (!found)
+    {
+        return false;
+    }
+
+    thread_atomicAdd(&g_jobs.queued, -1);
+    jobs_execute(&job);
+    return true;
+}
+
+/**
+ * Einstiegspunkt der Worker-Threads.
+ *
+ * @param arg der Index der Deque des Workers
+ */
+static void jobs_workerMain(void* arg)
+{
+    g_threadIndex = (int)(intptr_t)arg;
+    g_stealSeed = (unsigned int)g_threadIndex * 2654435761u + 1u;
+
+    int idle = 0;
+    while (thread_atomicLoad(&g_jobs.running))
+    {
+        if (jobs_runOne())
+        {
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < JOBS_SPIN_COUNT)
+        {
+            thread_yield();
+            continue;
+        }
+
+        // Schlafen legen. sleeping wird vor dem Prüfen von queued erhöht,
+        // jobs_run erhöht queued vor dem Prüfen von sleeping. So sieht
+        // mindestens eine Seite die andere und kein Wecken geht verloren.
+        thread_lockMutex(g_jobs.sleepMutex);
+        thread_atomicAdd(&g_jobs.sleeping, 1);
+        while (thread_atomicLoad(&g_jobs.queued) == 0 && thread_atomicLoad(&g_jobs.running))
+        {
+            thread_waitCondition(g_jobs.wakeUp, g_jobs.sleepMutex);
+        }
+        thread_atomicAdd(&g_jobs.sleeping, -1);
+        thread_unlockMutex(g_jobs.sleepMutex);
+        idle = 0;
+    }
+}
+
+/**
+ * Führt einen Bereich einer parallelen Schleife aus.
+ *
+ * @param arg der Bereich
+ */
+static void jobs_runRange(void* arg)
+{
+    JobRange* range = arg;
+    range->func(range->arg, range->begin, range->end);
+}
+
+/**
+ * Leerer Job für den Benchmark.
+ *
+ * @param arg unbenutzt
+ */
+static void jobs_benchmarkJob(void* arg)
+{
+    (void)arg;
+    thread_atomicAdd(&g_benchmarkSum, 1);
+}
+
+/**
+ * Leerer Schleifenbereich für den Benchmark.
+ *
+ * @param arg unbenutzt
+ * @param begin Anfang des Bereichs
+ * @param end Ende des Bereichs
+ */
+static void jobs_benchmarkRange(void* arg, int begin, int end)
+{
+    (void)arg;
+    thread_atomicAdd(&g_benchmarkSum, end - begin);
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+void jobs_init(int workerCount)
+{
+    if (workerCount < 0)
+    {
+        workerCount = thread_getProcessorCount() - 1;
+    }
+    if (workerCount > JOBS_MAX_THREADS - 1)
+    {
+        workerCount = JOBS_MAX_THREADS - 1;
+    }
+
+    memset(&g_jobs, 0, sizeof(JobSystem));
+    thread_atomicStore(&g_jobs.running, true);
+    g_jobs.sleepMutex = thread_createMutex();
+    g_jobs.wakeUp = thread_createCondition();
+    g_jobs.injectMutex = thread_createMutex();
+
+    // Alle Deques anlegen, bevor der erste Worker stehlen kann.
+    g_jobs.threadCount = workerCount + 1;
+    for (int i = 0; i < g_jobs.threadCount; i++)
+    {
+        g_jobs.deques[i] = malloc(sizeof(JobDeque));
+        thread_atomicStore64(&g_jobs.deques[i]->top, 0);
+        thread_atomicStore64(&g_jobs.deques[i]->bottom, 0);
+    }
+
+    g_threadIndex = 0;
+
+    for (int i = 1; i < g_jobs.threadCount; i++)
+    {
+        g_jobs.workers[i] = thread_create(jobs_workerMain, (void*)(intptr_t)i);
+        if (g_jobs.workers[i] == NULL)
+        {
+            // Nicht gestartete Worker lassen nur ihre leere Deque zurück.
+            fprintf(stderr, "Error: Could not start job worker %d!\n", i);
+        }
+    }
+}
+
+int jobs_getThreadCount(void)
+{
+    return g_jobs.threadCount;
+}
+
+void jobs_initCounter(JobCounter* counter)
+{
+    thread_atomicStore(&counter->pending, 0);
+}
+
+bool jobs_isDone(const JobCounter* counter)
+{
+    return thread_atomicLoad(&counter->pending) == 0;
+}
+
+void jobs_run(JobCounter* counter, JobFunction func, void* arg)
+{
+    Job job = {func, arg, counter};
+    thread_atomicAdd(&counter->pending, 1);
+
+    int self = g_threadIndex;
+    bool queued = g_jobs.threadCount >= 2
+                  && (self >= 0 ? jobs_push(g_jobs.deques[self], &job) : jobs_inject(&job));
+    if (!queued)
+    {
+        jobs_execute(&job);
+        return;
+    }
+
+    jobs_wakeWorkers();
+}
+
+void jobs_wait(JobCounter* counter)
+{
+    while (thread_atomicLoad(&counter->pending) > 0)
+    {
+        if (!jobs_runOne())
+        {
+            thread_yield();
+        }
+    }
+}
+
+void jobs_parallelFor(int count, int minBatch, JobRangeFunction func, void* arg)
+{
+    if (minBatch < 1)
+    {
+        minBatch = 1;
+    }
+
+    int batches = count / minBatch;
+    int maxBatches = g_jobs.threadCount * JOBS_BATCHES_PER_THREAD;
+    if (batches > maxBatches)
+    {
+        batches = maxBatches;
+    }
+    if (batches > JOBS_MAX_BATCHES)
+    {
+        batches = JOBS_MAX_BATCHES;
+    }
+
+    if (batches < 2)
+    {
+        if (count > 0)
+        {
+            func(arg, 0, count);
+        }
+        return;
+    }
+
+    // Bereichsgröße auf ein Vielfaches von minBatch runden.
+    int batchSize = (count + batches - 1) / batches;
+    batchSize = (batchSize + minBatch - 1) / minBatch * minBatch;
+
+    JobRange ranges[JOBS_MAX_BATCHES];
+    JobCounter counter;
+    jobs_initCounter(&counter);
+
+    int n = 0;
+    for (int begin = 0; begin < count; begin += batchSize)
+    {
+        ranges[n].func = func;
+        ranges[n].arg = arg;
+        ranges[n].begin = begin;
+        ranges[n].end = begin + batchSize < count ? begin + batchSize : count;
+        n++;
+    }
+
+    // Den ersten Bereich selbst bearbeiten, die übrigen verteilen.
+    for (int i = 1; i < n; i++)
+    {
+        jobs_run(&counter, jobs_runRange, &ranges[i]);
+    }
+    jobs_runRange(&ranges[0]);
+
+    jobs_wait(&counter);
+}
+
+void jobs_benchmark(void)
+{
+    printf("Job-Benchmark (%d Threads):\n", g_jobs.threadCount);
+    thread_atomicStore(&g_benchmarkSum, 0);
+
+    // Einzelne leere Jobs verteilen und abwarten.
+    double start = glfwGetTime();
+    for (int done = 0; done < JOBS_BENCHMARK_JOBS; done += JOBS_BENCHMARK_BATCH)
+    {
+        JobCounter counter;
+        jobs_initCounter(&counter);
+        for (int i = 0; i < JOBS_BENCHMARK_BATCH; i++)
+        {
+            jobs_run(&counter, jobs_benchmarkJob, NULL);
+        }
+        jobs_wait(&counter);
+    }
+    double jobTime = (glfwGetTime() - start) * 1e9 / JOBS_BENCHMARK_JOBS;
+
+    // Parallele Schleife mit leerem Rumpf, ein Bereich pro Thread.
+    int loopCount = g_jobs.threadCount * 1024;
+    start = glfwGetTime();
+    for (int i = 0; i < JOBS_BENCHMARK_LOOPS; i++)
+    {
+        jobs_parallelFor(loopCount, 1024, jobs_benchmarkRange, NULL);
+    }
+    double loopTime = (glfwGetTime() - start) * 1e6 / JOBS_BENCHMARK_LOOPS;
+
+    // Zum Vergleich: Threads für jeden Aufruf neu starten und beenden.
+    Thread* threads[JOBS_MAX_THREADS];
+    start = glfwGetTime();
+    for (int i = 0; i < JOBS_BENCHMARK_THREAD_LOOPS; i++)
+    {
+        for (int t = 1; t < g_jobs.threadCount; t++)
+        {
+            threads[t] = thread_create(jobs_benchmarkJob, NULL);
+        }
+        for (int t = 1; t < g_jobs.threadCount; t++)
+        {
+            thread_join(threads[t]);
+        }
+    }
+    double threadTime = (glfwGetTime() - start) * 1e6 / JOBS_BENCHMARK_THREAD_LOOPS;
+
+    int expected = JOBS_BENCHMARK_JOBS + loopCount * JOBS_BENCHMARK_LOOPS
+                   + (g_jobs.threadCount - 1) * JOBS_BENCHMARK_THREAD_LOOPS;
+    printf("  Einzelner Job:          %8.1f ns\n", jobTime);
+    printf("  Parallele Schleife:     %8.2f us\n", loopTime);
+    printf("  Threads starten/warten: %8.2f us\n", threadTime);
+    printf("  Pruefsumme: %s\n",
+           thread_atomicLoad(&g_benchmarkSum) == expected ? "OK" : "FEHLER");
+}
+
+void jobs_cleanup(void)
+{
+    thread_atomicStore(&g_jobs.running, false);
+    thread_lockMutex(g_jobs.sleepMutex);
+    thread_broadcastCondition(g_jobs.wakeUp);
+    thread_unlockMutex(g_jobs.sleepMutex);
+
+    for (int i = 1; i < g_jobs.threadCount; i++)
+    {
+        thread_join(g_jobs.workers[i]);
+    }
+    for (int i = 0; i < g_jobs.threadCount; i++)
+    {
+        free(g_jobs.deques[i]);
+    }
+
+    thread_deleteMutex(g_jobs.sleepMutex);
+    thread_deleteCondition(g_jobs.wakeUp);
+    thread_deleteMutex(g_jobs.injectMutex);
+
+    memset(&g_jobs, 0, sizeof(JobSystem));
+    g_jobs.threadCount = 1;
+    g_threadIndex = -1;
+}
@@ -0,0 +1,119 @@
+/**
+ * Modul für das Verteilen von Arbeit auf mehrere Threads.
+ * Beim Start wird pro weiterem Prozessor ein Worker-Thread erzeugt. Jeder
+ * Worker und der Hauptthread besitzen eine eigene Chase-Lev-Deque: neue
+ * Jobs werden in die eigene Deque gelegt und von dort abgearbeitet, Worker
+ * ohne Arbeit stehlen Jobs von den anderen. Zusammengehörige Jobs teilen
+ * sich einen Zähler, auf den gewartet werden kann. Der wartende Thread
+ * arbeitet währenddessen selbst Jobs ab. Fremde Threads wie der Loader
+ * geben ihre Jobs über eine gemeinsame Warteschlange ab.
+ *
+ * Das Modul ist bewusst global und nicht im Programmkontext abgelegt, da es
+ * auch von Modulen ohne Zugriff auf den Kontext und aus den Worker-Threads
+ * heraus benutzt wird.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "common.h"
+#include "thread.h"
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Funktion, die als Job ausgeführt wird.
+typedef void (*JobFunction)(void* arg);
+
+// Funktion, die einen Teilbereich [begin, end) einer Schleife bearbeitet.
+typedef void (*JobRangeFunction)(void* arg, int begin, int end);
+
+// Zähler der noch offenen Jobs einer Gruppe. Muss vor der ersten
+// Verwendung mit jobs_initCounter initialisiert werden.
+struct JobCounter
+{
+    AtomicInt pending;
+};
+typedef struct JobCounter JobCounter;
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Startet das Job-System. Muss vom Hauptthread aufgerufen werden.
+ *
+ * @param workerCount Anzahl der Worker-Threads, bei einem negativen Wert
+ *                    einer pro zusätzlichem Prozessor
+ */
+void jobs_init(int workerCount);
+
+/**
+ * Liefert die Anzahl der Threads, die Jobs ausführen, inklusive des
+ * Hauptthreads.
+ *
+ * @return die Anzahl der Threads
+ */
+int jobs_getThreadCount(void);
+
+/**
+ * Setzt einen Zähler auf null.
+ *
+ * @param counter der Zähler
+ */
+void jobs_initCounter(JobCounter* counter);
+
+/**
+ * Prüft ohne zu warten, ob alle Jobs eines Zählers beendet sind.
+ *
+ * @param counter der Zähler
+ * @return true, wenn kein Job der Gruppe mehr offen ist
+ */
+bool jobs_isDone(const JobCounter* counter);
+
+/**
+ * Legt einen neuen Job in die Deque des aufrufenden Threads. Der Zähler
+ * wird sofort erhöht und nach dem Ende des Jobs wieder verringert.
+ * Threads, die nicht zum Job-System gehören, legen ihn in eine gemeinsame
+ * Warteschlange, aus der sich die Worker bedienen. Ist die Deque bzw. die
+ * Warteschlange voll, wird der Job direkt ausgeführt.
+ *
+ * @param counter der Zähler der Gruppe
+ * @param func die auszuführende Funktion
+ * @param arg das Argument der Funktion, muss bis zum Ende gültig bleiben
+ */
+void jobs_run(JobCounter* counter, JobFunction func, void* arg);
+
+/**
+ * Wartet, bis alle Jobs eines Zählers beendet sind, und führt in der
+ * Zwischenzeit selbst Jobs aus.
+ *
+ * @param counter der Zähler
+ */
+void jobs_wait(JobCounter* counter);
+
+/**
+ * Teilt eine Schleife in Bereiche auf und bearbeitet sie parallel. Alle
+ * Bereiche beginnen bei einem Vielfachen von minBatch, nur der letzte
+ * Bereich darf kürzer sein. Kehrt erst zurück, wenn alle Bereiche
+ * bearbeitet wurden.
+ *
+ * @param count Anzahl der Elemente
+ * @param minBatch minimale Anzahl an Elementen pro Job
+ * @param func die Funktion für einen Bereich
+ * @param arg das Argument der Funktion
+ */
+void jobs_parallelFor(int count, int minBatch, JobRangeFunction func, void* arg);
+
+/**
+ * Misst den Aufwand für das Verteilen von Jobs und gibt das Ergebnis auf
+ * der Konsole aus. Muss vom Hauptthread aufgerufen werden.
+ */
+void jobs_benchmark(void);
+
+/**
+ * Beendet alle Worker-Threads und gibt das Job-System frei.
+ */
+void jobs_cleanup(void);
+
+#endif // JOBS_H
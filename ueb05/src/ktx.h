@@ -0,0 +1,80 @@
+/**
+ * Definitionen des KTX2 Containerformats, soweit sie für blockkomprimierte
+ * 2D-Texturen benötigt werden. Wird vom Loader in texture.c und vom
+ * Konverter in tools/ktxconv gemeinsam verwendet.
+ *
+ * Aufbau einer Datei: Kennung, Header, Index, Level-Index (ein Eintrag je
+ * Mipmap, Level 0 zuerst), Data Format Descriptor, Key/Value-Daten und
+ * zuletzt die Bilddaten, bei denen die kleinste Mipmap vorne liegt.
+ * Alle Werte sind Little Endian.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef KTX_H
+#define KTX_H
+
+#include <stdint.h>
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Die ersten Bytes jeder KTX2 Datei.
+#define KTX2_IDENTIFIER_SIZE 12
+#define KTX2_IDENTIFIER \
+    {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'}
+
+// Die unterstützten Formate, Werte entsprechen VkFormat.
+#define KTX2_FORMAT_BC1_RGB_UNORM 131
+#define KTX2_FORMAT_BC1_RGB_SRGB 132
+#define KTX2_FORMAT_BC1_RGBA_UNORM 133
+#define KTX2_FORMAT_BC1_RGBA_SRGB 134
+#define KTX2_FORMAT_BC3_UNORM 137
+#define KTX2_FORMAT_BC3_SRGB 138
+#define KTX2_FORMAT_BC4_UNORM 139
+#define KTX2_FORMAT_BC5_UNORM 141
+#define KTX2_FORMAT_BC7_UNORM 145
+#define KTX2_FORMAT_BC7_SRGB 146
+
+// Keine Superkompression, die Level liegen direkt in der Datei.
+#define KTX2_SUPERCOMPRESSION_NONE 0
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Header direkt hinter der Kennung.
+struct Ktx2Header
+{
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;  // 0 für 2D-Texturen
+    uint32_t layerCount;  // 0, wenn kein Array
+    uint32_t faceCount;   // 6 für Cube Maps, sonst 1
+    uint32_t levelCount;  // 0 heißt: Mipmaps zur Laufzeit erzeugen
+    uint32_t supercompressionScheme;
+};
+typedef struct Ktx2Header Ktx2Header;
+
+// Lage der optionalen Blöcke in der Datei.
+struct Ktx2Index
+{
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+typedef struct Ktx2Index Ktx2Index;
+
+// Eintrag des Level-Index für eine Mipmap.
+struct Ktx2Level
+{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+typedef struct Ktx2Level Ktx2Level;
+
+#endif // KTX_H
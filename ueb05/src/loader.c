@@ -0,0 +1,412 @@
+/**
+ * Modul für das Laden von Szenen im Hintergrund.
+ * Ein eigener Lade-Thread besitzt einen zweiten, mit dem Hauptfenster
+ * geteilten OpenGL Kontext. Dort werden Modelle importiert und Buffer sowie
+ * Texturen hochgeladen, während der Renderer die alte Szene weiter zeichnet.
+ * Eine fertige Szene wird mit einem Fence übergeben und erst dann im
+ * Hauptthread veröffentlicht, wenn die GPU alle Uploads abgeschlossen hat.
+ * Die alte Szene wird gelöscht, sobald die GPU sie nicht mehr benutzt.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "loader.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "thread.h"
+#include "texture.h"
+#include "utils.h"
+#include "input.h"
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Maximale Anzahl alter Szenen, die auf das Ende der GPU-Arbeit warten.
+#define LOADER_MAX_RETIRED 8
+
+// Wartezeit auf eine alte Szene, wenn die Liste voll ist (Nanosekunden).
+#define LOADER_RETIRE_TIMEOUT 1000000000
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Schritte eines Ladevorgangs.
+enum LoaderStage
+{
+    LOADER_STAGE_IDLE,
+    LOADER_STAGE_QUEUED,
+    LOADER_STAGE_IMPORTING,
+    LOADER_STAGE_UPLOADING
+};
+typedef enum LoaderStage LoaderStage;
+
+// Fertig geladene, aber noch nicht veröffentlichte Szene.
+struct LoaderResult
+{
+    Scene* scene;
+    GLsync fence;
+    bool isJson;
+};
+typedef struct LoaderResult LoaderResult;
+
+// Alte Szene, die gelöscht wird, sobald die GPU den Fence erreicht hat.
+struct LoaderRetired
+{
+    Scene* scene;
+    GLsync fence;
+};
+typedef struct LoaderRetired LoaderRetired;
+
+// Datentyp für alle persistenten Daten des Moduls.
+struct LoaderData
+{
+    GLFWwindow* context; // Unsichtbares Fenster mit geteiltem Kontext
+    Thread* thread;
+
+    // Durch den Mutex geschützt.
+    Mutex* mutex;
+    Condition* wakeUp;
+    char* request;
+    bool quit;
+    char name[LOADER_MAX_NAME];
+    double startTime;
+
+    AtomicInt stage;
+    AtomicPointer result;
+
+    // Nur im Hauptthread benutzt.
+    LoaderResult* pending;
+    LoaderRetired retired[LOADER_MAX_RETIRED];
+    int retiredCount;
+};
+typedef struct LoaderData LoaderData;
+
+////////////////////////////// LOKALE VARIABLEN ////////////////////////////////
+
+// Beschreibungen der Schritte in der Reihenfolge von LoaderStage.
+static const char* g_stageNames[] = {
+    "Bereit",
+    "Warte auf Lade-Thread",
+    "Importiere Modelle und Texturen",
+    "Warte auf GPU-Upload"
+};
+
+// Angezeigter Fortschritt der Schritte.
+static const float g_stageProgress[] = {1.0f, 0.05f, 0.3f, 0.9f};
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Lädt eine Szene oder ein Modell im aktuellen Kontext und setzt einen
+ * Fence hinter die Uploads.
+ *
+ * @param path der Pfad der Datei
+ * @return das Ergebnis, die Szene ist bei Fehlern NULL
+ */
+static LoaderResult* loader_loadFile(const char* path)
+{
+    LoaderResult* result = malloc(sizeof(LoaderResult));
+    result->isJson = utils_hasSuffix(path, ".json");
+
+    // Texturen der alten Szene werden mit ihr gelöscht und dürfen daher
+    // nicht aus dem Cache wiederverwendet werden.
+    deleteTextureCache();
+
+    result->scene = result->isJson ? scene_loadScene(path) : scene_fromModel(path);
+
+    // Der Flush sorgt dafür, dass der Fence auch aus dem anderen Kontext
+    // heraus signalisiert werden kann.
+    result->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    return result;
+}
+
+/**
+ * Löscht ein nicht veröffentlichtes Ergebnis.
+ *
+ * @param result das Ergebnis
+ */
+static void loader_deleteResult(LoaderResult* result)
+{
+    if (result == NULL)
+    {
+        return;
+    }
+
+    if (result->scene)
+    {
+        scene_deleteScene(result->scene);
+    }
+    glDeleteSync(result->fence);
+    free(result);
+}
+
+/**
+ * Übergibt ein Ergebnis an den Hauptthread. Ein noch nicht abgeholtes
+ * älteres Ergebnis wird verworfen.
+ *
+ * @param data die Moduldaten
+ * @param result das neue Ergebnis
+ */
+static void loader_publishResult(LoaderData* data, LoaderResult* result)
+{
+    LoaderResult* old = thread_atomicExchangePointer(&data->result, result);
+    loader_deleteResult(old);
+}
+
+/**
+ * Einstiegspunkt des Lade-Threads.
+ *
+ * @param arg die Moduldaten
+ */
+static void loader_threadMain(void* arg)
+{
+    LoaderData* data = arg;
+    glfwMakeContextCurrent(data->context);
+
+    thread_lockMutex(data->mutex);
+    while (true)
+    {
+        while (!data->quit && data->request == NULL)
+        {
+            thread_waitCondition(data->wakeUp, data->mutex);
+        }
+        if (data->quit)
+        {
+            break;
+        }
+
+        char* path = data->request;
+        data->request = NULL;
+        thread_atomicStore(&data->stage, LOADER_STAGE_IMPORTING);
+        thread_unlockMutex(data->mutex);
+
+        LoaderResult* result = loader_loadFile(path);
+        free(path);
+        loader_publishResult(data, result);
+
+        // Liegt bereits die nächste Anfrage vor, bleibt sie wartend.
+        thread_lockMutex(data->mutex);
+        thread_atomicStore(&data->stage, data->request ? LOADER_STAGE_QUEUED
+                                                       : LOADER_STAGE_UPLOADING);
+    }
+    thread_unlockMutex(data->mutex);
+
+    glfwMakeContextCurrent(NULL);
+}
+
+/**
+ * Löscht alte Szenen, deren Fence die GPU bereits erreicht hat.
+ *
+ * @param data die Moduldaten
+ * @param timeout Wartezeit auf die älteste Szene in Nanosekunden
+ */
+static void loader_deleteRetired(LoaderData* data, GLuint64 timeout)
+{
+    int kept = 0;
+    for (int i = 0; i < data->retiredCount; i++)
+    {
+        LoaderRetired* r = &data->retired[i];
+        GLenum state = glClientWaitSync(r->fence, 0, i == 0 ? timeout : 0);
+        if (state == GL_ALREADY_SIGNALED || state == GL_CONDITION_SATISFIED)
+        {
+            scene_deleteScene(r->scene);
+            glDeleteSync(r->fence);
+        }
+        else
+        {
+            data->retired[kept++] = *r;
+        }
+    }
+    data->retiredCount = kept;
+}
+
+/**
+ * Merkt eine alte Szene zum Löschen vor. Der Fence wird hinter alle
+ * bisherigen Zeichenbefehle gesetzt.
+ *
+ * @param data die Moduldaten
+ * @param scene die alte Szene
+ */
+static void loader_retireScene(LoaderData* data, Scene* scene)
+{
+    if (scene == NULL)
+    {
+        return;
+    }
+
+    if (data->retiredCount == LOADER_MAX_RETIRED)
+    {
+        loader_deleteRetired(data, LOADER_RETIRE_TIMEOUT);
+    }
+    if (data->retiredCount == LOADER_MAX_RETIRED)
+    {
+        // Die GPU hängt zu weit zurück, dann muss gewartet werden.
+        glFinish();
+        loader_deleteRetired(data, 0);
+    }
+
+    LoaderRetired* r = &data->retired[data->retiredCount++];
+    r->scene = scene;
+    r->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+void loader_init(ProgContext* ctx)
+{
+    ctx->loader = malloc(sizeof(LoaderData));
+    LoaderData* data = ctx->loader;
+    memset(data, 0, sizeof(LoaderData));
+
+    data->mutex = thread_createMutex();
+    data->wakeUp = thread_createCondition();
+    thread_atomicStore(&data->stage, LOADER_STAGE_IDLE);
+    thread_atomicStorePointer(&data->result, NULL);
+
+    // Unsichtbares Fenster, dessen Kontext die Objekte mit dem Hauptfenster
+    // teilt. Die Versionshinweise des Hauptfensters gelten weiterhin.
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    data->context = glfwCreateWindow(1, 1, "Loader", NULL, ctx->window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    if (data->context == NULL)
+    {
+        fprintf(stderr, "Error: Could not create shared loader context, "
+                        "loading synchronously!\n");
+        return;
+    }
+
+    data->thread = thread_create(loader_threadMain, data);
+    if (data->thread == NULL)
+    {
+        glfwDestroyWindow(data->context);
+        data->context = NULL;
+    }
+}
+
+void loader_requestScene(ProgContext* ctx, const char* path)
+{
+    LoaderData* data = ctx->loader;
+
+    thread_lockMutex(data->mutex);
+    const char* slash = strrchr(path, '/');
+    const char* backslash = strrchr(path, '\\');
+    const char* name = slash > backslash ? slash : backslash;
+    snprintf(data->name, LOADER_MAX_NAME, "%s", name ? name + 1 : path);
+    data->startTime = glfwGetTime();
+
+    if (data->thread == NULL)
+    {
+        thread_unlockMutex(data->mutex);
+
+        // Ohne Lade-Thread wird direkt geladen, veröffentlicht wird
+        // trotzdem erst in loader_update.
+        thread_atomicStore(&data->stage, LOADER_STAGE_UPLOADING);
+        loader_publishResult(data, loader_loadFile(path));
+        return;
+    }
+
+    free(data->request);
+    data->request = malloc(strlen(path) + 1);
+    strcpy(data->request, path);
+    if (thread_atomicLoad(&data->stage) != LOADER_STAGE_IMPORTING)
+    {
+        thread_atomicStore(&data->stage, LOADER_STAGE_QUEUED);
+    }
+    thread_broadcastCondition(data->wakeUp);
+    thread_unlockMutex(data->mutex);
+}
+
+void loader_update(ProgContext* ctx)
+{
+    LoaderData* data = ctx->loader;
+    InputData* input = ctx->input;
+
+    loader_deleteRetired(data, 0);
+
+    // Ein neueres Ergebnis ersetzt ein noch nicht fertig hochgeladenes.
+    LoaderResult* result = thread_atomicExchangePointer(&data->result, NULL);
+    if (result)
+    {
+        loader_deleteResult(data->pending);
+        data->pending = result;
+    }
+    if (data->pending == NULL)
+    {
+        return;
+    }
+
+    GLenum state = glClientWaitSync(data->pending->fence, 0, 0);
+    if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+    {
+        return;
+    }
+
+    LoaderResult* done = data->pending;
+    data->pending = NULL;
+
+    if (done->scene)
+    {
+        // Die alte Szene wird bis zum Fence noch von der GPU benutzt.
+        loader_retireScene(data, input->rendering.userScene);
+        input->rendering.userScene = done->scene;
+        input_sceneLoaded(ctx, done->scene, done->isJson);
+    }
+    else
+    {
+        fprintf(stderr, "Error: Could not load %s, keeping current scene!\n",
+                data->name);
+    }
+    glDeleteSync(done->fence);
+    free(done);
+
+    int uploading = LOADER_STAGE_UPLOADING;
+    thread_atomicCompareExchange(&data->stage, &uploading, LOADER_STAGE_IDLE);
+}
+
+void loader_getStatus(ProgContext* ctx, LoaderStatus* status)
+{
+    LoaderData* data = ctx->loader;
+
+    LoaderStage stage = thread_atomicLoad(&data->stage);
+    status->active = stage != LOADER_STAGE_IDLE;
+    status->stage = g_stageNames[stage];
+    status->progress = g_stageProgress[stage];
+
+    thread_lockMutex(data->mutex);
+    memcpy(status->name, data->name, LOADER_MAX_NAME);
+    status->elapsed = glfwGetTime() - data->startTime;
+    thread_unlockMutex(data->mutex);
+}
+
+void loader_cleanup(ProgContext* ctx)
+{
+    LoaderData* data = ctx->loader;
+
+    if (data->thread)
+    {
+        thread_lockMutex(data->mutex);
+        data->quit = true;
+        thread_broadcastCondition(data->wakeUp);
+        thread_unlockMutex(data->mutex);
+        thread_join(data->thread);
+    }
+    if (data->context)
+    {
+        glfwDestroyWindow(data->context);
+    }
+
+    // Ab hier benutzt nur noch der Hauptkontext die Objekte.
+    glFinish();
+    loader_deleteResult(thread_atomicExchangePointer(&data->result, NULL));
+    loader_deleteResult(data->pending);
+    loader_deleteRetired(data, 0);
+
+    free(data->request);
+    thread_deleteMutex(data->mutex);
+    thread_deleteCondition(data->wakeUp);
+    free(ctx->loader);
+}
@@ -0,0 +1,84 @@
+/**
+ * Modul für das Laden von Szenen im Hintergrund.
+ * Ein eigener Lade-Thread besitzt einen zweiten, mit dem Hauptfenster
+ * geteilten OpenGL Kontext. Dort werden Modelle importiert und Buffer sowie
+ * Texturen hochgeladen, während der Renderer die alte Szene weiter zeichnet.
+ * Eine fertige Szene wird mit einem Fence übergeben und erst dann im
+ * Hauptthread veröffentlicht, wenn die GPU alle Uploads abgeschlossen hat.
+ * Die alte Szene wird gelöscht, sobald die GPU sie nicht mehr benutzt.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "common.h"
+
+#include "scene.h"
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Maximale Länge des angezeigten Dateinamens.
+#define LOADER_MAX_NAME 128
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Zustand eines laufenden Ladevorgangs für die Anzeige.
+struct LoaderStatus
+{
+    bool active;                 // true, solange eine Szene geladen wird
+    char name[LOADER_MAX_NAME];  // Dateiname ohne Verzeichnis
+    const char* stage;           // Beschreibung des aktuellen Schritts
+    float progress;              // Fortschritt zwischen 0 und 1
+    double elapsed;              // Bisherige Ladezeit in Sekunden
+};
+typedef struct LoaderStatus LoaderStatus;
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Initialisiert das Lade-Modul und startet den Lade-Thread. Muss im
+ * Hauptthread nach dem Erzeugen des Fensters aufgerufen werden. Kann kein
+ * geteilter Kontext erstellt werden, wird synchron geladen.
+ *
+ * @param ctx Programmkontext.
+ */
+void loader_init(ProgContext* ctx);
+
+/**
+ * Fordert das Laden einer Szene (.json) oder eines Modells an. Eine noch
+ * nicht begonnene Anfrage wird dabei ersetzt.
+ *
+ * @param ctx Programmkontext.
+ * @param path der Pfad der Datei
+ */
+void loader_requestScene(ProgContext* ctx, const char* path);
+
+/**
+ * Veröffentlicht fertig hochgeladene Szenen und löscht alte Szenen, die
+ * die GPU nicht mehr benutzt. Muss einmal pro Frame im Hauptthread vor dem
+ * Rendern aufgerufen werden.
+ *
+ * @param ctx Programmkontext.
+ */
+void loader_update(ProgContext* ctx);
+
+/**
+ * Liefert den Zustand des aktuellen Ladevorgangs.
+ *
+ * @param ctx Programmkontext.
+ * @param status Ziel für den Zustand
+ */
+void loader_getStatus(ProgContext* ctx, LoaderStatus* status);
+
+/**
+ * Beendet den Lade-Thread und gibt alle noch nicht veröffentlichten oder
+ * gelöschten Szenen frei.
+ *
+ * @param ctx Programmkontext.
+ */
+void loader_cleanup(ProgContext* ctx);
+
+#endif // LOADER_H
@@ -16,6 +16,8 @@
 // Datenstruktur für die Repräsentation eines Materials.
 struct Material
 {
+    unsigned int id; // Fortlaufende ID für die Sortierung von Drawcalls
+
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
@@ -39,6 +41,11 @@ struct Material
     GLuint heightMap;
 };
 
+////////////////////////////// LOKALE VARIABLEN ///////////////////////////////
+
+// Zähler für die Vergabe von Material-IDs.
+static unsigned int g_materialCounter = 0;
+
 ////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
 
 /**
@@ -102,6 +109,7 @@ Material *material_createMaterialFromMaps(vec3 ambient, vec3 diffuse,
 {
     // Den Speicher für das neue Material reservieren.
     Material *mat = malloc(sizeof(Material));
+    mat->id = ++g_materialCounter;
 
     // Dann werden alle Eigenschaften kopiert.
     glm_vec3_copy(ambient, mat->ambient);
@@ -138,6 +146,7 @@ Material *material_createMaterialFromAI(struct aiMaterial *aiMat,
 {
     // Speicher für das Material reservieren.
     Material *mat = malloc(sizeof(Material));
+    mat->id = ++g_materialCounter;
     mat->dispFactor = MATERIAL_DEFAULT_DISP_FACTOR;
 
     // Temporäre Variable zum Einlesen von Farben.
@@ -224,9 +233,9 @@ void material_useMaterial(Shader *shader, Material *mat)
     shader_setFloat(shader, "material.dispFactor", mat->dispFactor);
 
 // Als nächstes setzen wir die Texturen über das folgende Makro.
+// Ob eine Textur verwendet wird, steht bereits über die Permutation im Shader.
 #define MATERIAL_SET_TEX(idx, use, map)                     \
     {                                                       \
-        shader_setBool(shader, "material." #use, mat->use); \
         if (mat->use)                                       \
         {                                                   \
             glActiveTexture(GL_TEXTURE##idx);               \
@@ -245,6 +254,61 @@ void material_useMaterial(Shader *shader, Material *mat)
 #undef MATERIAL_SET_TEX
 }
 
+unsigned int material_getId(Material *mat)
+{
+    return mat->id;
+}
+
+unsigned int material_getTextureKey(Material *mat)
+{
+    // FNV-1a Hash über alle gebundenen Textur-IDs.
+    unsigned int hash = 2166136261u;
+
+#define MATERIAL_HASH_TEX(use, map)                \
+    {                                              \
+        hash ^= mat->use ? mat->map : 0;           \
+        hash *= 16777619u;                         \
+    }
+
+    MATERIAL_HASH_TEX(useDiffuseMap, diffuseMap);
+    MATERIAL_HASH_TEX(useSpecularMap, specularMap);
+    MATERIAL_HASH_TEX(useNormalMap, normalMap);
+    MATERIAL_HASH_TEX(useHeightMap, heightMap);
+    MATERIAL_HASH_TEX(useEmissionMap, emissionMap);
+
+#undef MATERIAL_HASH_TEX
+
+    return hash;
+}
+
+void material_requestTextures(Material *mat, float pixels)
+{
+#define MATERIAL_REQUEST_TEX(use, map)               \
+    {                                                \
+        if (mat->use)                                \
+        {                                            \
+            texture_requestSize(mat->map, pixels);   \
+        }                                            \
+    }
+
+    MATERIAL_REQUEST_TEX(useDiffuseMap, diffuseMap);
+    MATERIAL_REQUEST_TEX(useSpecularMap, specularMap);
+    MATERIAL_REQUEST_TEX(useNormalMap, normalMap);
+    MATERIAL_REQUEST_TEX(useHeightMap, heightMap);
+    MATERIAL_REQUEST_TEX(useEmissionMap, emissionMap);
+
+#undef MATERIAL_REQUEST_TEX
+}
+
+unsigned int material_getMaps(Material *mat)
+{
+    return (mat->useDiffuseMap ? MATERIAL_MAP_DIFFUSE : 0)
+         | (mat->useSpecularMap ? MATERIAL_MAP_SPECULAR : 0)
+         | (mat->useNormalMap ? MATERIAL_MAP_NORMAL : 0)
+         | (mat->useHeightMap ? MATERIAL_MAP_HEIGHT : 0)
+         | (mat->useEmissionMap ? MATERIAL_MAP_EMISSION : 0);
+}
+
 void material_deleteMaterial(Material *mat)
 {
     // Material nur löschen, wenn es existiert.
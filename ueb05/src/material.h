@@ -25,12 +25,27 @@
 #define MATERIAL_DEFAULT_DISP_FACTOR 0.06f
 #define MATERIAL_DEFAULT_EMISSION (vec3){0,0,0}
 
+// Anzahl der Texturen eines Materials und damit der Bits von MaterialMap.
+#define MATERIAL_MAP_COUNT 5
+
 //////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
 
 // Datenstruktur für die Repräsentation eines Materials.
 struct Material;
 typedef struct Material Material;
 
+// Bits der Texturen, die ein Material verwendet. Sie bilden die unteren Bits
+// der Merkmalsmasken von Shader-Permutationen.
+enum MaterialMap
+{
+    MATERIAL_MAP_DIFFUSE = 1 << 0,
+    MATERIAL_MAP_SPECULAR = 1 << 1,
+    MATERIAL_MAP_NORMAL = 1 << 2,
+    MATERIAL_MAP_HEIGHT = 1 << 3,
+    MATERIAL_MAP_EMISSION = 1 << 4
+};
+typedef enum MaterialMap MaterialMap;
+
 //////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
 
 /**
@@ -85,6 +100,39 @@ Material* material_createMaterialFromAI(struct aiMaterial* aiMat,
  */
 void material_useMaterial(Shader* shader, Material* mat);
 
+/**
+ * Liefert die eindeutige ID eines Materials.
+ * 
+ * @param mat das Material
+ * @return die ID des Materials
+ */
+unsigned int material_getId(Material* mat);
+
+/**
+ * Liefert einen Hash über alle Texturen, die das Material bindet.
+ * Materialien mit identischen Texturen liefern den gleichen Wert.
+ * 
+ * @param mat das Material
+ * @return der Hash der gebundenen Texturen
+ */
+unsigned int material_getTextureKey(Material* mat);
+
+/**
+ * Meldet alle Texturen eines Materials für das Streaming als sichtbar an.
+ * 
+ * @param mat das Material
+ * @param pixels die Größe der damit gezeichneten Geometrie in Pixeln
+ */
+void material_requestTextures(Material* mat, float pixels);
+
+/**
+ * Liefert die Texturen, die ein Material verwendet.
+ * 
+ * @param mat das Material
+ * @return die Bitmaske aus MaterialMap
+ */
+unsigned int material_getMaps(Material* mat);
+
 /**
  * Löscht ein Material.
  * 
@@ -9,6 +9,14 @@
 
 #include "mesh.h"
 
+#include <math.h>
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Eine gröbere Stufe wird erst gewählt, wenn ihr projizierter Fehler unter
+// diesem Anteil der Schwelle liegt.
+#define MESH_LOD_HYSTERESIS 0.75f
+
 ////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
 
 // Datenstruktur für die Repräsentation eines Meshes.
@@ -25,51 +33,37 @@ struct Mesh
     GLuint ebo; // Element Buffer Object
 
     Material *material;
-};
-
-//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
-
-Mesh *mesh_createMesh(Vertex *vertices, GLuint vertexCount,
-                      GLint *indices, GLuint indexCount, Material *material)
-{
-    // Zuerst wird der Speicher reserviert.
-    Mesh *mesh = malloc(sizeof(Mesh));
 
-    // Danach werden die Vertices festgelegt.
-    mesh->vertices = vertices;
-    mesh->vertexCount = vertexCount;
+    MeshLod lods[MESH_MAX_LODS]; // Indexbereiche der Detailstufen
+    int lodCount;
+    int currentLod;              // Für die Kamera gewählte Stufe
 
-    // Dann die Indices.
-    mesh->indices = indices;
-    mesh->indexCount = indexCount;
+    vec3 boundsMin; // Achsenparallele Bounding Box im Objektraum
+    vec3 boundsMax;
+};
 
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
 
-    // Außerdem übernehmen wir das Material.
-    mesh->material = material;
+/**
+ * Bindet das VAO eines Meshes und legt es beim ersten Aufruf im aktuellen
+ * Kontext an.
+ * 
+ * @param mesh das Mesh
+ */
+static void mesh_bindVertexArray(Mesh *mesh)
+{
+    if (mesh->vao != 0)
+    {
+        glBindVertexArray(mesh->vao);
+        return;
+    }
 
-    // Dann legen wir die benötigten Buffer und Objekte an.
     glGenVertexArrays(1, &mesh->vao);
-    glGenBuffers(1, &mesh->vbo);
-    glGenBuffers(1, &mesh->ebo);
 
     // Ab jetzt binden wir das VAO.
     glBindVertexArray(mesh->vao);
-
-    // Die folgenden Befehle übertragen die Vertexdaten an OpenGL.
     glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
-    glBufferData(
-        GL_ARRAY_BUFFER,
-        mesh->vertexCount * sizeof(Vertex),
-        &mesh->vertices[0],
-        GL_STATIC_DRAW);
-
-    // Und diese Befehle legen die Indicies fest.
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
-    glBufferData(
-        GL_ELEMENT_ARRAY_BUFFER,
-        mesh->indexCount * sizeof(GLint),
-        &mesh->indices[0],
-        GL_STATIC_DRAW);
 
     // Vertex Position
     glEnableVertexAttribArray(0);
@@ -114,6 +108,106 @@ Mesh *mesh_createMesh(Vertex *vertices, GLuint vertexCount,
         sizeof(Vertex),                    // Größe eines Datensatzes/Vertex
         (void *)offsetof(Vertex, texCoord) // Offset der Daten in einem Vertex
     );
+}
+
+/**
+ * Liefert den Offset einer Detailstufe im Element Buffer.
+ * 
+ * @param mesh das Mesh
+ * @param lod die Detailstufe
+ * @return der Offset für die Drawcalls
+ */
+static void *mesh_lodOffset(Mesh *mesh, int lod)
+{
+    return (void *)((GLintptr)mesh->lods[lod].firstIndex * sizeof(GLint));
+}
+
+/**
+ * Liefert die Primitive, mit denen ein Shader zeichnet. Programme mit
+ * Tessellation-Stufen erwarten Patches aus je drei Vertices, alle anderen
+ * normale Dreiecke.
+ * 
+ * @param shader der zu verwendende Shader
+ * @return GL_PATCHES oder GL_TRIANGLES
+ */
+static GLenum mesh_primitiveMode(Shader *shader)
+{
+    if (shader_isTessellated(shader))
+    {
+        glPatchParameteri(GL_PATCH_VERTICES, 3);
+        return GL_PATCHES;
+    }
+
+    return GL_TRIANGLES;
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+Mesh *mesh_createMesh(Vertex *vertices, GLuint vertexCount,
+                      GLint *indices, GLuint indexCount, Material *material)
+{
+    MeshLod lod = {0, indexCount, 0.0f};
+    return mesh_createMeshLods(vertices, vertexCount, indices, indexCount,
+                               &lod, 1, material);
+}
+
+Mesh *mesh_createMeshLods(Vertex *vertices, GLuint vertexCount,
+                          GLint *indices, GLuint indexCount,
+                          const MeshLod *lods, int lodCount, Material *material)
+{
+    // Zuerst wird der Speicher reserviert.
+    Mesh *mesh = malloc(sizeof(Mesh));
+
+    // Danach werden die Vertices festgelegt.
+    mesh->vertices = vertices;
+    mesh->vertexCount = vertexCount;
+
+    // Dann die Indices.
+    mesh->indices = indices;
+    mesh->indexCount = indexCount;
+
+    // Die Detailstufen verweisen auf Bereiche der Indices.
+    mesh->lodCount = lodCount < MESH_MAX_LODS ? lodCount : MESH_MAX_LODS;
+    memcpy(mesh->lods, lods, sizeof(MeshLod) * mesh->lodCount);
+    mesh->currentLod = 0;
+
+    // Außerdem übernehmen wir das Material.
+    mesh->material = material;
+
+    // Die Bounding Box wird einmalig aus den Vertices bestimmt.
+    glm_vec3_copy(vertexCount > 0 ? vertices[0].position : GLM_VEC3_ZERO,
+                  mesh->boundsMin);
+    glm_vec3_copy(mesh->boundsMin, mesh->boundsMax);
+    for (GLuint i = 1; i < vertexCount; i++)
+    {
+        glm_vec3_minv(mesh->boundsMin, vertices[i].position, mesh->boundsMin);
+        glm_vec3_maxv(mesh->boundsMax, vertices[i].position, mesh->boundsMax);
+    }
+
+    // Dann legen wir die benötigten Buffer an. Das VAO wird erst beim
+    // ersten Zeichnen erzeugt, da VAOs nicht zwischen Kontexten geteilt
+    // werden und Meshes auch im Lade-Thread erstellt werden.
+    mesh->vao = 0;
+    glGenBuffers(1, &mesh->vbo);
+    glGenBuffers(1, &mesh->ebo);
+
+    // Die folgenden Befehle übertragen die Vertexdaten an OpenGL.
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        mesh->vertexCount * sizeof(Vertex),
+        &mesh->vertices[0],
+        GL_STATIC_DRAW);
+
+    // Und diese Befehle legen die Indicies fest. Ohne gebundenes VAO wird
+    // dafür ebenfalls GL_ARRAY_BUFFER verwendet.
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->ebo);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        mesh->indexCount * sizeof(GLint),
+        &mesh->indices[0],
+        GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     return mesh;
 }
@@ -173,12 +267,70 @@ void mesh_drawMesh(Mesh *mesh, Shader *shader)
     material_useMaterial(shader, mesh->material);
 
     // Mesh rendern.
-    glBindVertexArray(mesh->vao);
-    glPatchParameteri(GL_PATCH_VERTICES, 3);
-    glDrawElements(GL_PATCHES, mesh->indexCount, GL_UNSIGNED_INT, 0);
+    mesh_bindVertexArray(mesh);
+    glDrawElements(mesh_primitiveMode(shader), mesh->lods[0].indexCount, GL_UNSIGNED_INT, 0);
 }
 
 void mesh_drawMeshTris(Mesh *mesh, Shader *shader)
+{
+    mesh_drawMeshTrisInstanced(mesh, shader, 0, 1);
+}
+
+void mesh_drawMeshTrisInstanced(Mesh *mesh, Shader *shader, int lod, int instanceCount)
+{
+    // Nur rendern, wenn auch ein Mesh existiert.
+    if (mesh == NULL || instanceCount <= 0)
+    {
+        return;
+    }
+
+    // Material aktivieren.
+    material_useMaterial(shader, mesh->material);
+
+    // Mesh rendern.
+    mesh_bindVertexArray(mesh);
+    glDrawElementsInstanced(GL_TRIANGLES, mesh->lods[lod].indexCount, GL_UNSIGNED_INT,
+                            mesh_lodOffset(mesh, lod), instanceCount);
+}
+
+void mesh_drawMeshGeometry(Mesh *mesh, Shader *shader, int lod, int instanceCount)
+{
+    // Nur rendern, wenn auch ein Mesh existiert.
+    if (mesh == NULL)
+    {
+        return;
+    }
+
+    // Mesh ohne Materialwechsel rendern.
+    mesh_bindVertexArray(mesh);
+    glDrawElementsInstanced(mesh_primitiveMode(shader), mesh->lods[lod].indexCount, GL_UNSIGNED_INT,
+                            mesh_lodOffset(mesh, lod), instanceCount);
+}
+
+void mesh_initDrawCommand(Mesh *mesh, int lod, MeshDrawCommand *command)
+{
+    command->count = mesh->lods[lod].indexCount;
+    command->instanceCount = 0;
+    command->firstIndex = mesh->lods[lod].firstIndex;
+    command->baseVertex = 0;
+    command->baseInstance = 0;
+}
+
+void mesh_drawMeshGeometryIndirect(Mesh *mesh, Shader *shader, int command)
+{
+    // Nur rendern, wenn auch ein Mesh existiert.
+    if (mesh == NULL)
+    {
+        return;
+    }
+
+    // Die Instanzanzahl liegt im Drawcall auf der GPU.
+    mesh_bindVertexArray(mesh);
+    glDrawElementsIndirect(mesh_primitiveMode(shader), GL_UNSIGNED_INT,
+                           (void *)((GLintptr)command * sizeof(MeshDrawCommand)));
+}
+
+void mesh_drawMeshTrisIndirect(Mesh *mesh, Shader *shader, int command)
 {
     // Nur rendern, wenn auch ein Mesh existiert.
     if (mesh == NULL)
@@ -190,8 +342,108 @@ void mesh_drawMeshTris(Mesh *mesh, Shader *shader)
     material_useMaterial(shader, mesh->material);
 
     // Mesh rendern.
-    glBindVertexArray(mesh->vao);
-    glDrawElements(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT, 0);
+    mesh_bindVertexArray(mesh);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                           (void *)((GLintptr)command * sizeof(MeshDrawCommand)));
+}
+
+void mesh_selectLod(Mesh *mesh, float pixelsPerUnit, float maxPixelError)
+{
+    // Die Fehler der Stufen steigen monoton an.
+    int ideal = 0;
+    int coarse = 0;
+    for (int i = 1; i < mesh->lodCount; i++)
+    {
+        float pixelError = mesh->lods[i].error * pixelsPerUnit;
+        if (pixelError <= maxPixelError)
+        {
+            ideal = i;
+        }
+        if (pixelError <= maxPixelError * MESH_LOD_HYSTERESIS)
+        {
+            coarse = i;
+        }
+    }
+
+    // Zu grob: sofort verfeinern. Sonst nur mit Abstand zur Schwelle
+    // vergröbern.
+    if (mesh->lods[mesh->currentLod].error * pixelsPerUnit > maxPixelError)
+    {
+        mesh->currentLod = ideal;
+    }
+    else if (coarse > mesh->currentLod)
+    {
+        mesh->currentLod = coarse;
+    }
+}
+
+int mesh_getLod(Mesh *mesh, int lodBias)
+{
+    int lod = mesh->currentLod + lodBias;
+    return lod < mesh->lodCount ? lod : mesh->lodCount - 1;
+}
+
+GLuint mesh_getTriangleCount(Mesh *mesh, int lod)
+{
+    return mesh->lods[lod].indexCount / 3;
+}
+
+Material *mesh_getMaterial(Mesh *mesh)
+{
+    return mesh->material;
+}
+
+void mesh_getBounds(Mesh *mesh, vec3 min, vec3 max)
+{
+    glm_vec3_copy(mesh->boundsMin, min);
+    glm_vec3_copy(mesh->boundsMax, max);
+}
+
+bool mesh_intersectRay(Mesh *mesh, vec3 origin, vec3 dir, float maxT, float *t)
+{
+    // Schnitt nach Möller-Trumbore mit beiden Seiten der Dreiecke.
+    bool hit = false;
+    for (GLuint i = 0; i + 2 < mesh->lods[0].indexCount; i += 3)
+    {
+        float *v0 = mesh->vertices[mesh->indices[i]].position;
+        float *v1 = mesh->vertices[mesh->indices[i + 1]].position;
+        float *v2 = mesh->vertices[mesh->indices[i + 2]].position;
+
+        vec3 e1, e2, p, s, q;
+        glm_vec3_sub(v1, v0, e1);
+        glm_vec3_sub(v2, v0, e2);
+        glm_vec3_cross(dir, e2, p);
+        float det = glm_vec3_dot(e1, p);
+        if (fabsf(det) < 1e-12f)
+        {
+            continue;
+        }
+
+        float invDet = 1.0f / det;
+        glm_vec3_sub(origin, v0, s);
+        float u = glm_vec3_dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f)
+        {
+            continue;
+        }
+
+        glm_vec3_cross(s, e1, q);
+        float v = glm_vec3_dot(dir, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f)
+        {
+            continue;
+        }
+
+        float hitT = glm_vec3_dot(e2, q) * invDet;
+        if (hitT >= 0.0f && hitT < maxT)
+        {
+            maxT = hitT;
+            hit = true;
+        }
+    }
+
+    *t = maxT;
+    return hit;
 }
 
 void mesh_deleteMesh(Mesh *mesh)
@@ -212,7 +464,10 @@ void mesh_deleteMesh(Mesh *mesh)
     // Alle OpenGL Buffer löschen
     glDeleteBuffers(1, &mesh->vbo);
     glDeleteBuffers(1, &mesh->ebo);
-    glDeleteVertexArrays(1, &mesh->vao);
+    if (mesh->vao != 0)
+    {
+        glDeleteVertexArrays(1, &mesh->vao);
+    }
 
     // Das Mesh löschen
     free(mesh);
@@ -15,6 +15,11 @@
 #include "shader.h"
 #include "material.h"
 
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Maximale Anzahl an Detailstufen eines Meshes inklusive des Originals.
+#define MESH_MAX_LODS 4
+
 //////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
 
 // Datenstruktur für einen Vertex.
@@ -27,10 +32,31 @@ struct Vertex
 };
 typedef struct Vertex Vertex;
 
+// Indexbereich einer Detailstufe. Alle Stufen teilen sich die Vertices.
+struct MeshLod
+{
+    GLuint firstIndex;
+    GLuint indexCount;
+    float error; // Geometrischer Fehler im Objektraum
+};
+typedef struct MeshLod MeshLod;
+
 // Datenstruktur für die Repräsentation eines Meshs.
 struct Mesh;
 typedef struct Mesh Mesh;
 
+// Indirekter Drawcall eines Meshes, entspricht DrawElementsIndirectCommand.
+// Die Instanzanzahl kann damit auf der GPU gesetzt werden.
+struct MeshDrawCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+typedef struct MeshDrawCommand MeshDrawCommand;
+
 //////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
 
 /**
@@ -48,6 +74,24 @@ typedef struct Mesh Mesh;
 Mesh* mesh_createMesh(Vertex* vertices, GLuint vertexCount, 
                       GLint* indices, GLuint indexCount, Material* material);
 
+/**
+ * Erstellt ein neues Mesh mit mehreren Detailstufen. Die Indices aller
+ * Stufen liegen hintereinander im Indexarray, Stufe 0 ist das Original.
+ * Wie bei mesh_createMesh werden alle Daten übernommen.
+ * 
+ * @param vertices die Vertices des Meshes
+ * @param vertexCount die Anzahl der Vertices
+ * @param indices die Indices aller Stufen
+ * @param indexCount die Anzahl aller Indices
+ * @param lods die Indexbereiche der Stufen
+ * @param lodCount die Anzahl der Stufen
+ * @param material das zu verwendende Material
+ * @return ein neues Mesh
+ */
+Mesh* mesh_createMeshLods(Vertex* vertices, GLuint vertexCount,
+                          GLint* indices, GLuint indexCount,
+                          const MeshLod* lods, int lodCount, Material* material);
+
 /**
  * Erstellt ein neues Quad mit einem Default-Material.
  * 
@@ -57,7 +101,8 @@ Mesh* mesh_createQuad(void);
 
 /**
  * Zeigt ein Mesh mit einem festgelegten Shader an.
- * Der Shader muss zuvor nicht aktiviert werden.
+ * Der Shader muss zuvor nicht aktiviert werden. Enthält er
+ * Tessellation-Stufen, wird das Mesh als Patches gezeichnet.
  * 
  * @param mesh das zu zeichnende Mesh
  * @param shader der zu verwendene Shader
@@ -65,6 +110,124 @@ Mesh* mesh_createQuad(void);
 void mesh_drawMesh(Mesh* mesh, Shader* shader);
 
 void mesh_drawMeshTris(Mesh *mesh, Shader *shader);
+
+/**
+ * Zeigt mehrere Instanzen einer Detailstufe eines Meshes als Dreiecke an.
+ * Der Shader muss zuvor nicht aktiviert werden.
+ * 
+ * @param mesh das zu zeichnende Mesh
+ * @param shader der zu verwendene Shader
+ * @param lod die Detailstufe
+ * @param instanceCount die Anzahl der Instanzen
+ */
+void mesh_drawMeshTrisInstanced(Mesh *mesh, Shader *shader, int lod, int instanceCount);
+
+/**
+ * Zeigt mehrere Instanzen einer Detailstufe eines Meshes an, ohne das
+ * Material zu aktivieren. Shader und Material müssen zuvor vom Aufrufer
+ * gesetzt worden sein. Mit Tessellation-Stufen im Shader wird das Mesh als
+ * Patches gezeichnet, sonst als Dreiecke.
+ * 
+ * @param mesh das zu zeichnende Mesh
+ * @param shader der aktive Shader
+ * @param lod die Detailstufe
+ * @param instanceCount die Anzahl der Instanzen
+ */
+void mesh_drawMeshGeometry(Mesh* mesh, Shader* shader, int lod, int instanceCount);
+
+/**
+ * Initialisiert einen indirekten Drawcall für eine Detailstufe eines
+ * Meshes. Die Instanzanzahl ist zunächst 0.
+ * 
+ * @param mesh das Mesh
+ * @param lod die Detailstufe
+ * @param command der zu initialisierende Drawcall
+ */
+void mesh_initDrawCommand(Mesh* mesh, int lod, MeshDrawCommand* command);
+
+/**
+ * Wählt die Detailstufe eines Meshes für die Kamera anhand des
+ * projizierten Fehlers. Eine gröbere Stufe wird erst gewählt, wenn ihr
+ * Fehler deutlich unter der Schwelle liegt, damit Stufen an der Grenze
+ * nicht ständig wechseln.
+ * 
+ * @param mesh das Mesh
+ * @param pixelsPerUnit Pixel pro Längeneinheit im Objektraum an der
+ *                      nächsten Instanz
+ * @param maxPixelError der erlaubte Fehler in Pixeln
+ */
+void mesh_selectLod(Mesh* mesh, float pixelsPerUnit, float maxPixelError);
+
+/**
+ * Liefert die gewählte Detailstufe eines Meshes, optional um einige Stufen
+ * vergröbert.
+ * 
+ * @param mesh das Mesh
+ * @param lodBias die Anzahl der zusätzlichen Stufen
+ * @return die Detailstufe
+ */
+int mesh_getLod(Mesh* mesh, int lodBias);
+
+/**
+ * Liefert die Anzahl der Dreiecke einer Detailstufe.
+ * 
+ * @param mesh das Mesh
+ * @param lod die Detailstufe
+ * @return die Anzahl der Dreiecke
+ */
+GLuint mesh_getTriangleCount(Mesh* mesh, int lod);
+
+/**
+ * Zeigt ein Mesh über einen indirekten Drawcall an, ohne das Material zu
+ * aktivieren. Der Buffer mit den Drawcalls muss an GL_DRAW_INDIRECT_BUFFER
+ * gebunden sein. Die Primitive richten sich wie bei mesh_drawMeshGeometry
+ * nach dem Shader.
+ * 
+ * @param mesh das zu zeichnende Mesh
+ * @param shader der aktive Shader
+ * @param command der Index des Drawcalls im gebundenen Buffer
+ */
+void mesh_drawMeshGeometryIndirect(Mesh* mesh, Shader* shader, int command);
+
+/**
+ * Zeigt ein Mesh als Dreiecke über einen indirekten Drawcall an. Der Buffer
+ * mit den Drawcalls muss an GL_DRAW_INDIRECT_BUFFER gebunden sein.
+ * 
+ * @param mesh das zu zeichnende Mesh
+ * @param shader der zu verwendene Shader
+ * @param command der Index des Drawcalls im gebundenen Buffer
+ */
+void mesh_drawMeshTrisIndirect(Mesh* mesh, Shader* shader, int command);
+
+/**
+ * Liefert das Material eines Meshes.
+ * 
+ * @param mesh das Mesh
+ * @return das Material des Meshes
+ */
+Material* mesh_getMaterial(Mesh* mesh);
+
+/**
+ * Liefert die achsenparallele Bounding Box eines Meshes im Objektraum.
+ * 
+ * @param mesh das Mesh
+ * @param min Ausgabeparameter für die minimale Ecke
+ * @param max Ausgabeparameter für die maximale Ecke
+ */
+void mesh_getBounds(Mesh* mesh, vec3 min, vec3 max);
+
+/**
+ * Schneidet einen Strahl im Objektraum mit allen Dreiecken eines Meshes.
+ * 
+ * @param mesh das Mesh
+ * @param origin der Ursprung des Strahls
+ * @param dir die Richtung des Strahls, muss nicht normiert sein
+ * @param maxT maximale Entfernung in Vielfachen von dir
+ * @param t Ausgabe für die Entfernung des nächsten Treffers
+ * @return true, wenn ein Dreieck vor maxT getroffen wurde
+ */
+bool mesh_intersectRay(Mesh* mesh, vec3 origin, vec3 dir, float maxT, float* t);
+
 /**
  * Löscht ein Mesh.
  * 
@@ -0,0 +1,444 @@
+/**
+ * Modul für das Erzeugen von Mipmaps auf der CPU.
+ * Ersetzt glGenerateMipmap, das je nach Treiber langsam ist oder sRGB
+ * Texturen im Gammaraum filtert. Jede Mipmap wird über einen Boxfilter aus
+ * der nächstgrößeren berechnet, sRGB Farben werden dabei linear gemittelt.
+ * Die Zeilen einer Mipmap werden über das Job-System verteilt, für RGBA
+ * Bilder mit geraden Größen gibt es SSE2 und AVX2 Kernel.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "mipmap.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "jobs.h"
+
+// SSE2 ist auf x86-64 immer vorhanden und wird für lineare RGBA Bilder
+// genutzt.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPMAP_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 wird nur mit GCC und Clang auf x86 genutzt. Die Funktion wird per
+// target-Attribut übersetzt, ob die CPU AVX2 unterstützt, wird zur Laufzeit
+// geprüft. Die Gather-Befehle übernehmen das Nachschlagen in der Tabelle
+// für sRGB.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MIPMAP_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Einträge der Tabelle für die Umrechnung von linearen Werten nach sRGB.
+// Bei dieser Auflösung weicht das Ergebnis auch bei dunklen Farben höchstens
+// um eine Stufe von der exakten Umrechnung ab.
+#define MIPMAP_ENCODE_SIZE 16384
+
+// Offset der linearen Hälfte in den Tabellen. Die erste Hälfte gilt für
+// sRGB Kanäle, die zweite für lineare Kanäle wie Alpha.
+#define MIPMAP_DECODE_LINEAR 256
+#define MIPMAP_ENCODE_LINEAR MIPMAP_ENCODE_SIZE
+
+// Texel, die ein Job mindestens bearbeiten soll.
+#define MIPMAP_BATCH_TEXELS 16384
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+struct MipmapJob;
+
+// Berechnet die Zeilen [begin, end) einer Mipmap.
+typedef void (*MipmapRowFunc)(const struct MipmapJob* job, int begin, int end);
+
+// Parameter für das Verkleinern einer Mipmap.
+struct MipmapJob
+{
+    MipmapRowFunc func;
+    const unsigned char* src;
+    unsigned char* dst;
+    int srcWidth;
+    int srcHeight;
+    int dstWidth;
+    int dstHeight;
+    int channels;
+    bool srgb;
+};
+typedef struct MipmapJob MipmapJob;
+
+// Texel der größeren Mipmap, die ein Texel der kleineren entlang einer
+// Achse abdeckt.
+struct MipmapTaps
+{
+    int first;
+    int count;
+    float weights[3];
+};
+typedef struct MipmapTaps MipmapTaps;
+
+////////////////////////////// LOKALE VARIABLEN ////////////////////////////////
+
+// 8 Bit Wert nach linearem Wert zwischen 0 und 1, zuerst für sRGB, dann
+// für lineare Kanäle.
+static float g_decode[2 * MIPMAP_DECODE_LINEAR];
+
+// Linearer Wert mal (MIPMAP_ENCODE_SIZE - 1) nach 8 Bit Wert, zuerst für
+// sRGB, dann für lineare Kanäle.
+static unsigned char g_encode[2 * MIPMAP_ENCODE_SIZE];
+
+// Ob die CPU AVX2 unterstützt.
+static bool g_useAvx2 = false;
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Bestimmt, welche Texel der größeren Mipmap ein Texel der kleineren
+ * entlang einer Achse abdeckt. Bei gerader Größe sind es zwei gleich
+ * gewichtete Texel. Bei ungerader Größe 2n+1 deckt jeder der n Texel
+ * 2+1/n Texel ab, die Gewichte der drei Texel entsprechen ihrem Anteil.
+ *
+ * @param srcSize Größe der größeren Mipmap
+ * @param index Index in der kleineren Mipmap
+ * @param taps Ziel für die Texel und Gewichte
+ */
+static void mipmap_taps(int srcSize, int index, MipmapTaps* taps)
+{
+    taps->first = index * 2;
+    if (srcSize == 1)
+    {
+        taps->first = 0;
+        taps->count = 1;
+        taps->weights[0] = 1.0f;
+    }
+    else if (srcSize % 2 == 0)
+    {
+        taps->count = 2;
+        taps->weights[0] = 0.5f;
+        taps->weights[1] = 0.5f;
+    }
+    else
+    {
+        float n = (float)(srcSize / 2);
+        taps->count = 3;
+        taps->weights[0] = (n - index) / srcSize;
+        taps->weights[1] = n / srcSize;
+        taps->weights[2] = (index + 1.0f) / srcSize;
+    }
+}
+
+/**
+ * Wandelt einen linearen Wert in einen 8 Bit Wert um.
+ *
+ * @param value der lineare Wert
+ * @param encodeOffset 0 für sRGB, MIPMAP_ENCODE_LINEAR für lineare Kanäle
+ * @return der 8 Bit Wert
+ */
+static unsigned char mipmap_encode(float value, int encodeOffset)
+{
+    value = fminf(fmaxf(value, 0.0f), 1.0f);
+    return g_encode[(int)(value * (MIPMAP_ENCODE_SIZE - 1) + 0.5f) + encodeOffset];
+}
+
+/**
+ * Berechnet einen Ausschnitt einer Zeile ohne SIMD. Funktioniert für alle
+ * Größen und Kanalanzahlen und schließt die Zeilen der SIMD-Kernel ab.
+ *
+ * @param job die Parameter
+ * @param y die Zeile der kleineren Mipmap
+ * @param xBegin erster Texel
+ * @param xEnd Ende des Ausschnitts (exklusiv)
+ */
+static void mipmap_downsampleSpan(const MipmapJob* job, int y, int xBegin, int xEnd)
+{
+    int channels = job->channels;
+    size_t srcStride = (size_t)job->srcWidth * channels;
+    unsigned char* out = job->dst + ((size_t)y * job->dstWidth + xBegin) * channels;
+
+    MipmapTaps ty;
+    mipmap_taps(job->srcHeight, y, &ty);
+
+    for (int x = xBegin; x < xEnd; x++)
+    {
+        MipmapTaps tx;
+        mipmap_taps(job->srcWidth, x, &tx);
+
+        for (int c = 0; c < channels; c++)
+        {
+            bool linear = !job->srgb || c == 3;
+            const float* decode = g_decode + (linear ? MIPMAP_DECODE_LINEAR : 0);
+
+            float sum = 0.0f;
+            for (int j = 0; j < ty.count; j++)
+            {
+                const unsigned char* row = job->src + (ty.first + j) * srcStride;
+                float rowSum = 0.0f;
+                for (int i = 0; i < tx.count; i++)
+                {
+                    rowSum += tx.weights[i] * decode[row[(tx.first + i) * channels + c]];
+                }
+                sum += ty.weights[j] * rowSum;
+            }
+
+            *out++ = mipmap_encode(sum, linear ? MIPMAP_ENCODE_LINEAR : 0);
+        }
+    }
+}
+
+/**
+ * Berechnet Zeilen einer Mipmap ohne SIMD.
+ *
+ * @param job die Parameter
+ * @param begin erste Zeile
+ * @param end Ende des Bereichs (exklusiv)
+ */
+static void mipmap_downsampleScalar(const MipmapJob* job, int begin, int end)
+{
+    for (int y = begin; y < end; y++)
+    {
+        mipmap_downsampleSpan(job, y, 0, job->dstWidth);
+    }
+}
+
+#ifdef MIPMAP_HAS_SSE2
+/**
+ * Berechnet Zeilen einer linearen RGBA Mipmap mit geraden Größen. Rechnet
+ * ganzzahlig in 16 Bit, je zwei Ausgabetexel pro Durchlauf.
+ *
+ * @param job die Parameter
+ * @param begin erste Zeile
+ * @param end Ende des Bereichs (exklusiv)
+ */
+static void mipmap_downsampleSse2(const MipmapJob* job, int begin, int end)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(2);
+    size_t srcStride = (size_t)job->srcWidth * 4;
+
+    for (int y = begin; y < end; y++)
+    {
+        const unsigned char* row0 = job->src + (size_t)y * 2 * srcStride;
+        const unsigned char* row1 = row0 + srcStride;
+        unsigned char* out = job->dst + (size_t)y * job->dstWidth * 4;
+
+        int x = 0;
+        for (; x + 2 <= job->dstWidth; x += 2)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+            __m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+
+            // Vertikal addieren: lo enthält die Texel 0 und 1, hi 2 und 3.
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+            // Horizontal addieren, die Summe landet jeweils in der unteren
+            // Hälfte.
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+            __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), round), 2);
+            _mm_storel_epi64((__m128i*)(out + x * 4), _mm_packus_epi16(sum, sum));
+        }
+
+        mipmap_downsampleSpan(job, y, x, job->dstWidth);
+    }
+}
+#endif
+
+#ifdef MIPMAP_HAS_AVX2
+/**
+ * Berechnet Zeilen einer sRGB RGBA Mipmap mit geraden Größen. Die Texel
+ * werden per Gather über die Tabelle linearisiert, je zwei Ausgabetexel
+ * pro Durchlauf.
+ *
+ * @param job die Parameter
+ * @param begin erste Zeile
+ * @param end Ende des Bereichs (exklusiv)
+ */
+__attribute__((target("avx2")))
+static void mipmap_downsampleAvx2(const MipmapJob* job, int begin, int end)
+{
+    // Alpha liegt in jedem vierten Kanal und nutzt die lineare Hälfte der
+    // Tabellen.
+    const __m256i decodeOffset = _mm256_setr_epi32(0, 0, 0, MIPMAP_DECODE_LINEAR,
+                                                   0, 0, 0, MIPMAP_DECODE_LINEAR);
+    const __m256i encodeOffset = _mm256_setr_epi32(0, 0, 0, MIPMAP_ENCODE_LINEAR,
+                                                   0, 0, 0, MIPMAP_ENCODE_LINEAR);
+    const __m256 scale = _mm256_set1_ps(0.25f * (MIPMAP_ENCODE_SIZE - 1));
+    const __m256 maxIndex = _mm256_set1_ps(MIPMAP_ENCODE_SIZE - 1);
+    size_t srcStride = (size_t)job->srcWidth * 4;
+
+    for (int y = begin; y < end; y++)
+    {
+        const unsigned char* row0 = job->src + (size_t)y * 2 * srcStride;
+        const unsigned char* row1 = row0 + srcStride;
+        unsigned char* out = job->dst + (size_t)y * job->dstWidth * 4;
+
+        int x = 0;
+        for (; x + 2 <= job->dstWidth; x += 2)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+            __m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+
+            // Je acht Kanäle (zwei Texel) nachschlagen und vertikal
+            // addieren: s01 enthält die Texel 0 und 1, s23 die Texel 2 und 3.
+            __m256 a01 = _mm256_i32gather_ps(
+                g_decode, _mm256_add_epi32(_mm256_cvtepu8_epi32(a), decodeOffset), 4);
+            __m256 a23 = _mm256_i32gather_ps(
+                g_decode, _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(a, 8)), decodeOffset), 4);
+            __m256 b01 = _mm256_i32gather_ps(
+                g_decode, _mm256_add_epi32(_mm256_cvtepu8_epi32(b), decodeOffset), 4);
+            __m256 b23 = _mm256_i32gather_ps(
+                g_decode, _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(b, 8)), decodeOffset), 4);
+            __m256 s01 = _mm256_add_ps(a01, b01);
+            __m256 s23 = _mm256_add_ps(a23, b23);
+
+            // Horizontal addieren: Texel 0 mit 1 und Texel 2 mit 3.
+            __m256 left = _mm256_permute2f128_ps(s01, s23, 0x20);
+            __m256 right = _mm256_permute2f128_ps(s01, s23, 0x31);
+            __m256 sum = _mm256_min_ps(_mm256_mul_ps(_mm256_add_ps(left, right), scale), maxIndex);
+
+            __m256i index = _mm256_add_epi32(_mm256_cvtps_epi32(sum), encodeOffset);
+            int indices[8];
+            _mm256_storeu_si256((__m256i*)indices, index);
+            for (int i = 0; i < 8; i++)
+            {
+                out[x * 4 + i] = g_encode[indices[i]];
+            }
+        }
+
+        mipmap_downsampleSpan(job, y, x, job->dstWidth);
+    }
+}
+#endif
+
+/**
+ * Führt einen Bereich von Zeilen als Job aus.
+ *
+ * @param arg der MipmapJob
+ * @param begin erste Zeile
+ * @param end Ende des Bereichs (exklusiv)
+ */
+static void mipmap_runJob(void* arg, int begin, int end)
+{
+    const MipmapJob* job = arg;
+    job->func(job, begin, end);
+}
+
+/**
+ * Wählt den schnellsten Kernel für eine Mipmap.
+ *
+ * @param job die Parameter der Mipmap
+ * @return der Kernel
+ */
+static MipmapRowFunc mipmap_selectKernel(const MipmapJob* job)
+{
+    bool even = job->srcWidth % 2 == 0 && job->srcHeight % 2 == 0;
+    if (!even || job->channels != 4)
+    {
+        return mipmap_downsampleScalar;
+    }
+
+#ifdef MIPMAP_HAS_AVX2
+    if (job->srgb && g_useAvx2)
+    {
+        return mipmap_downsampleAvx2;
+    }
+#endif
+#ifdef MIPMAP_HAS_SSE2
+    if (!job->srgb)
+    {
+        return mipmap_downsampleSse2;
+    }
+#endif
+
+    return mipmap_downsampleScalar;
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+void mipmap_init(void)
+{
+    for (int i = 0; i < MIPMAP_DECODE_LINEAR; i++)
+    {
+        float c = i / 255.0f;
+        g_decode[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+        g_decode[MIPMAP_DECODE_LINEAR + i] = c;
+    }
+
+    for (int i = 0; i < MIPMAP_ENCODE_SIZE; i++)
+    {
+        float value = (float)i / (MIPMAP_ENCODE_SIZE - 1);
+        float c = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+        g_encode[i] = (unsigned char)(fminf(fmaxf(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+        g_encode[MIPMAP_ENCODE_LINEAR + i] = (unsigned char)(value * 255.0f + 0.5f);
+    }
+
+#ifdef MIPMAP_HAS_AVX2
+    g_useAvx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+void mipmap_generate(MipmapChain* chain, unsigned char* image, int width, int height,
+                     int channels, bool srgb)
+{
+    chain->channels = channels;
+    chain->levelCount = 1;
+    chain->width[0] = width;
+    chain->height[0] = height;
+    chain->levels[0] = image;
+
+    // Größen aller Mipmaps bestimmen, alle liegen in einem Speicherblock.
+    size_t total = 0;
+    while ((chain->width[chain->levelCount - 1] > 1 || chain->height[chain->levelCount - 1] > 1)
+           && chain->levelCount < MIPMAP_MAX_LEVELS)
+    {
+        int level = chain->levelCount++;
+        chain->width[level] = chain->width[level - 1] > 1 ? chain->width[level - 1] / 2 : 1;
+        chain->height[level] = chain->height[level - 1] > 1 ? chain->height[level - 1] / 2 : 1;
+        total += (size_t)chain->width[level] * chain->height[level] * channels;
+    }
+    if (chain->levelCount == 1)
+    {
+        return;
+    }
+
+    unsigned char* memory = malloc(total);
+    for (int level = 1; level < chain->levelCount; level++)
+    {
+        chain->levels[level] = memory;
+        memory += (size_t)chain->width[level] * chain->height[level] * channels;
+    }
+
+    // Jede Mipmap hängt von der vorherigen ab, parallelisiert wird daher
+    // über die Zeilen einer Mipmap. Kleine Mipmaps bleiben in einem Job.
+    for (int level = 1; level < chain->levelCount; level++)
+    {
+        MipmapJob job = {
+            .src = chain->levels[level - 1],
+            .dst = chain->levels[level],
+            .srcWidth = chain->width[level - 1],
+            .srcHeight = chain->height[level - 1],
+            .dstWidth = chain->width[level],
+            .dstHeight = chain->height[level],
+            .channels = channels,
+            .srgb = srgb && channels >= 3,
+        };
+        job.func = mipmap_selectKernel(&job);
+
+        int minRows = MIPMAP_BATCH_TEXELS / job.dstWidth;
+        jobs_parallelFor(job.dstHeight, minRows > 0 ? minRows : 1, mipmap_runJob, &job);
+    }
+}
+
+void mipmap_free(MipmapChain* chain)
+{
+    if (chain->levelCount > 1)
+    {
+        free(chain->levels[1]);
+    }
+    chain->levelCount = 0;
+}
@@ -0,0 +1,70 @@
+/**
+ * Modul für das Erzeugen von Mipmaps auf der CPU.
+ * Ersetzt glGenerateMipmap, das je nach Treiber langsam ist oder sRGB
+ * Texturen im Gammaraum filtert. Jede Mipmap wird über einen Boxfilter aus
+ * der nächstgrößeren berechnet, sRGB Farben werden dabei linear gemittelt.
+ * Die Zeilen einer Mipmap werden über das Job-System verteilt, für RGBA
+ * Bilder mit geraden Größen gibt es SSE2 und AVX2 Kernel.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <stdbool.h>
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Maximale Anzahl an Mipmaps inklusive des Ausgangsbildes.
+#define MIPMAP_MAX_LEVELS 32
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Vollständige Kette von Mipmaps eines Bildes mit 8 Bit je Kanal. Die Texel
+// liegen zeilenweise ohne Auffüllung hintereinander.
+struct MipmapChain
+{
+    int levelCount;
+    int channels;
+    int width[MIPMAP_MAX_LEVELS];
+    int height[MIPMAP_MAX_LEVELS];
+    unsigned char* levels[MIPMAP_MAX_LEVELS]; // Level 0 ist das Ausgangsbild
+};
+typedef struct MipmapChain MipmapChain;
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Berechnet die Umrechnungstabellen für sRGB. Muss vor dem ersten Aufruf
+ * von mipmap_generate aus dem Hauptthread aufgerufen werden.
+ */
+void mipmap_init(void);
+
+/**
+ * Erzeugt alle Mipmaps bis zur Größe 1x1. Die Größen folgen den Regeln von
+ * OpenGL, jede Kante wird abgerundet halbiert. Bei ungeraden Größen deckt
+ * jeder Texel der kleineren Mipmap drei Texel mit passenden Gewichten ab.
+ * Darf auch aus Threads aufgerufen werden, die nicht zum Job-System
+ * gehören.
+ *
+ * @param chain Ziel für die Mipmaps, muss mit mipmap_free freigegeben werden
+ * @param image das Ausgangsbild, wird nicht kopiert und nicht freigegeben
+ * @param width Breite des Ausgangsbildes
+ * @param height Höhe des Ausgangsbildes
+ * @param channels Anzahl der Kanäle (1 bis 4)
+ * @param srgb true, wenn die ersten drei Kanäle in sRGB vorliegen; der
+ *             vierte Kanal ist immer linear
+ */
+void mipmap_generate(MipmapChain* chain, unsigned char* image, int width, int height,
+                     int channels, bool srgb);
+
+/**
+ * Gibt die erzeugten Mipmaps frei. Das Ausgangsbild bleibt erhalten.
+ *
+ * @param chain die Mipmaps
+ */
+void mipmap_free(MipmapChain* chain);
+
+#endif // MIPMAP_H
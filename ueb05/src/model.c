@@ -13,6 +13,7 @@
 
 #include "material.h"
 #include "mesh.h"
+#include "simplify.h"
 #include "utils.h"
 #include "texture.h"
 #include <sesp/stb_image.h>
@@ -157,10 +158,17 @@ static Mesh *model_processMesh(struct aiMesh *srcMesh,
             MATERIAL_DEFAULT_SHININESS);
     }
 
+    // Beim Import werden gröbere Detailstufen in den gleichen Buffern
+    // erzeugt.
+    MeshLod lods[MESH_MAX_LODS];
+    int lodCount = simplify_buildLods(vertices, vertexCount, &indices, &indexCount,
+                                      lods, MESH_MAX_LODS);
+
     // Zum Schluss erzeugen wir ein neues Mesh und geben es zurück.
-    return mesh_createMesh(
+    return mesh_createMeshLods(
         vertices, vertexCount,
         indices, indexCount,
+        lods, lodCount,
         material);
 }
 
@@ -293,6 +301,108 @@ void model_drawModel(Model *model, Shader *shader)
     }
 }
 
+void model_enqueueModel(Model *model, RenderQueue *queue, RenderPass pass,
+                        ShaderPermutations *shaders, unsigned int features,
+                        mat4 modelMatrix, int instanceBase,
+                        int instanceCount, int firstCommand, int lodBias,
+                        vec3 camPos, float farPlane)
+{
+    for (unsigned int i = 0; i < model->meshCount; i++)
+    {
+        // Permutation passend zu den Texturen des Materials wählen. Konnte
+        // sie nicht gebaut werden, entfällt das Mesh.
+        Material *mat = mesh_getMaterial(model->meshes[i]);
+        Shader *shader = shader_getPermutation(shaders, features | material_getMaps(mat));
+        if (shader == NULL)
+        {
+            continue;
+        }
+
+        // Mittelpunkt der Bounding Box in Weltkoordinaten bestimmen.
+        vec3 min, max, center;
+        mesh_getBounds(model->meshes[i], min, max);
+        glm_vec3_center(min, max, center);
+        glm_mat4_mulv3(modelMatrix, center, 1.0f, center);
+
+        float depth = glm_vec3_distance(center, camPos) / farPlane;
+        renderQueue_push(queue, pass, shader, model->meshes[i], depth,
+                         mesh_getLod(model->meshes[i], lodBias),
+                         instanceBase, instanceCount,
+                         firstCommand >= 0 ? firstCommand + (int)i : -1);
+    }
+}
+
+int model_getMeshCount(Model *model)
+{
+    return (int)model->meshCount;
+}
+
+void model_initDrawCommands(Model *model, int lodBias, MeshDrawCommand *commands)
+{
+    for (unsigned int i = 0; i < model->meshCount; i++)
+    {
+        Mesh *mesh = model->meshes[i];
+        mesh_initDrawCommand(mesh, mesh_getLod(mesh, lodBias), &commands[i]);
+    }
+}
+
+void model_selectLods(Model *model, float pixelsPerUnit, float maxPixelError)
+{
+    for (unsigned int i = 0; i < model->meshCount; i++)
+    {
+        mesh_selectLod(model->meshes[i], pixelsPerUnit, maxPixelError);
+    }
+}
+
+void model_requestTextures(Model *model, float pixelsPerUnit)
+{
+    for (unsigned int i = 0; i < model->meshCount; i++)
+    {
+        vec3 min, max;
+        mesh_getBounds(model->meshes[i], min, max);
+        float pixels = glm_vec3_distance(min, max) * pixelsPerUnit;
+        material_requestTextures(mesh_getMaterial(model->meshes[i]), pixels);
+    }
+}
+
+void model_getBounds(Model *model, vec3 min, vec3 max)
+{
+    glm_vec3_zero(min);
+    glm_vec3_zero(max);
+    for (unsigned int i = 0; i < model->meshCount; i++)
+    {
+        vec3 meshMin, meshMax;
+        mesh_getBounds(model->meshes[i], meshMin, meshMax);
+        if (i == 0)
+        {
+            glm_vec3_copy(meshMin, min);
+            glm_vec3_copy(meshMax, max);
+        }
+        else
+        {
+            glm_vec3_minv(min, meshMin, min);
+            glm_vec3_maxv(max, meshMax, max);
+        }
+    }
+}
+
+bool model_intersectRay(Model *model, vec3 origin, vec3 dir, float maxT, float *t)
+{
+    bool hit = false;
+    for (unsigned int i = 0; i < model->meshCount; i++)
+    {
+        float meshT;
+        if (mesh_intersectRay(model->meshes[i], origin, dir, maxT, &meshT))
+        {
+            maxT = meshT;
+            hit = true;
+        }
+    }
+
+    *t = maxT;
+    return hit;
+}
+
 void model_drawModelTris(Model *model, Shader *shader) 
 {
     // Alle Meshes des Modells werden nacheinander gerendert.
@@ -302,6 +412,24 @@ void model_drawModelTris(Model *model, Shader *shader)
     }
 }
 
+void model_drawModelTrisInstanced(Model *model, Shader *shader, int lodBias,
+                                  int instanceCount)
+{
+    for (unsigned int i = 0; i < model->meshCount; i++)
+    {
+        Mesh *mesh = model->meshes[i];
+        mesh_drawMeshTrisInstanced(mesh, shader, mesh_getLod(mesh, lodBias), instanceCount);
+    }
+}
+
+void model_drawModelTrisIndirect(Model *model, Shader *shader, int firstCommand)
+{
+    for (unsigned int i = 0; i < model->meshCount; i++)
+    {
+        mesh_drawMeshTrisIndirect(model->meshes[i], shader, firstCommand + (int)i);
+    }
+}
+
 void model_deleteModel(Model *model)
 {
     // Zuerst werden alle Meshes gelöscht.
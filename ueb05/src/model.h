@@ -11,6 +11,7 @@
 #include "common.h"
 
 #include "shader.h"
+#include "renderQueue.h"
 
 //////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
 
@@ -37,6 +38,92 @@ Model* model_loadModel(const char* filename);
  */
 void model_drawModel(Model* model, Shader* shader);
 
+/**
+ * Fügt alle Meshes eines 3D Modells als instanzierte Drawcalls in eine
+ * Render Queue ein. Als Tiefe wird der Abstand des Mittelpunkts jedes
+ * Meshes zur Kamera verwendet, normalisiert auf die Far Plane. Jedes Mesh
+ * wird in seiner gewählten Detailstufe und mit der Permutation gezeichnet,
+ * die um die Texturen seines Materials ergänzt wurde.
+ * 
+ * @param model das 3D Modell
+ * @param queue die Render Queue
+ * @param pass der Pass, in dem das Modell gezeichnet wird
+ * @param shaders die Permutationen des zu verwendenden Shaders
+ * @param features Merkmale der Permutation ohne die Texturen der Materialien
+ * @param modelMatrix die Modelmatrix der nächsten Instanz für die Tiefe
+ * @param instanceBase erster Eintrag in der Liste der sichtbaren Instanzen
+ * @param instanceCount Anzahl der Instanzen
+ * @param firstCommand indirekter Drawcall des ersten Meshes oder -1
+ * @param lodBias zusätzliche Detailstufen gegenüber der Kamera
+ * @param camPos die Position der Kamera
+ * @param farPlane die Entfernung der Far Plane
+ */
+void model_enqueueModel(Model* model, RenderQueue* queue, RenderPass pass,
+                        ShaderPermutations* shaders, unsigned int features,
+                        mat4 modelMatrix, int instanceBase,
+                        int instanceCount, int firstCommand, int lodBias,
+                        vec3 camPos, float farPlane);
+
+/**
+ * Liefert die Anzahl der Meshes eines Modells.
+ * 
+ * @param model das 3D Modell
+ * @return die Anzahl der Meshes
+ */
+int model_getMeshCount(Model* model);
+
+/**
+ * Initialisiert je einen indirekten Drawcall pro Mesh eines Modells in der
+ * gewählten Detailstufe des Meshes.
+ * 
+ * @param model das 3D Modell
+ * @param lodBias zusätzliche Detailstufen gegenüber der Kamera
+ * @param commands Ziel für model_getMeshCount Drawcalls
+ */
+void model_initDrawCommands(Model* model, int lodBias, MeshDrawCommand* commands);
+
+/**
+ * Wählt die Detailstufen aller Meshes eines Modells für die Kamera.
+ * 
+ * @param model das 3D Modell
+ * @param pixelsPerUnit Pixel pro Längeneinheit im Objektraum an der
+ *                      nächsten Instanz
+ * @param maxPixelError der erlaubte Fehler in Pixeln
+ */
+void model_selectLods(Model* model, float pixelsPerUnit, float maxPixelError);
+
+/**
+ * Meldet die Texturen aller Meshes eines Modells für das Streaming an.
+ * Die Größe eines Meshes auf dem Bildschirm wird über die Diagonale
+ * seiner Bounding Box abgeschätzt.
+ * 
+ * @param model das 3D Modell
+ * @param pixelsPerUnit Pixel pro Längeneinheit im Objektraum an der
+ *                      nächsten sichtbaren Instanz
+ */
+void model_requestTextures(Model* model, float pixelsPerUnit);
+
+/**
+ * Liefert die achsenparallele Bounding Box aller Meshes eines Modells.
+ * 
+ * @param model das 3D Modell
+ * @param min Ausgabeparameter für die minimale Ecke
+ * @param max Ausgabeparameter für die maximale Ecke
+ */
+void model_getBounds(Model* model, vec3 min, vec3 max);
+
+/**
+ * Schneidet einen Strahl im Objektraum mit allen Meshes eines Modells.
+ * 
+ * @param model das 3D Modell
+ * @param origin der Ursprung des Strahls
+ * @param dir die Richtung des Strahls, muss nicht normiert sein
+ * @param maxT maximale Entfernung in Vielfachen von dir
+ * @param t Ausgabe für die Entfernung des nächsten Treffers
+ * @return true, wenn das Modell vor maxT getroffen wurde
+ */
+bool model_intersectRay(Model* model, vec3 origin, vec3 dir, float maxT, float* t);
+
 void model_drawCubeMap(Shader *shader, GLuint *vao, GLuint* texture);
 
 /**
@@ -48,4 +135,26 @@ void model_deleteModel(Model* model);
 
 void model_drawModelTris(Model *model, Shader *shader);
 
+/**
+ * Zeigt mehrere Instanzen eines 3D Modells als Dreiecke an. Die Matrizen
+ * der Instanzen liest der Shader selbst aus dem Instanzbuffer.
+ * 
+ * @param model das anzuzeigende 3D Modell
+ * @param shader der zu verwendende Shader
+ * @param lodBias zusätzliche Detailstufen gegenüber der Kamera
+ * @param instanceCount die Anzahl der Instanzen
+ */
+void model_drawModelTrisInstanced(Model *model, Shader *shader, int lodBias,
+                                  int instanceCount);
+
+/**
+ * Zeigt ein 3D Modell als Dreiecke über indirekte Drawcalls an, die
+ * aufeinanderfolgend im gebundenen GL_DRAW_INDIRECT_BUFFER liegen.
+ * 
+ * @param model das anzuzeigende 3D Modell
+ * @param shader der zu verwendende Shader
+ * @param firstCommand der Drawcall des ersten Meshes
+ */
+void model_drawModelTrisIndirect(Model *model, Shader *shader, int firstCommand);
+
 #endif // MODEL_H
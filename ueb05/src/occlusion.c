@@ -0,0 +1,332 @@
+/**
+ * Modul für Occlusion Culling über eine Hierarchical-Z Pyramide.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "occlusion.h"
+
+#include <string.h>
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Größe der Arbeitsgruppen, muss mit den Compute-Shadern übereinstimmen.
+#define OCCLUSION_BUILD_GROUP 8
+#define OCCLUSION_CULL_GROUP 64
+
+// Textureinheit, über die die Shader Tiefe und Pyramide lesen.
+#define OCCLUSION_TEXTURE_UNIT 10
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Pyramide und Listen einer Ansicht.
+struct Occlusion
+{
+    GLuint pyramid;
+    int depthWidth, depthHeight; // Größe der Tiefentextur
+    int levels;
+    mat4 viewProjMatrix;         // Matrix, mit der die Tiefe entstand
+    bool valid;
+
+    // Listen des aktuellen Frames
+    int inputList;
+    int earlyList;
+    int rejectList;
+    int lateList;
+    int tested;
+
+    // Asynchrones Auslesen der Zähler eines vergangenen Frames
+    GLuint readbackBuffer;
+    int readbackCapacity;
+    GLsync readbackFence;
+    int readbackModels;
+    int readbackTested;
+    SceneBatch* readbackData;
+    OcclusionStats stats;
+};
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Übernimmt die Zähler eines vergangenen Frames, falls die GPU sie bereits
+ * geschrieben hat. Es wird nie auf die GPU gewartet.
+ *
+ * @param occlusion das Occlusion Culling
+ */
+static void occlusion_readStats(Occlusion* occlusion)
+{
+    if (occlusion->readbackFence == NULL)
+    {
+        return;
+    }
+
+    GLenum result = glClientWaitSync(occlusion->readbackFence, 0, 0);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+    {
+        return;
+    }
+    glDeleteSync(occlusion->readbackFence);
+    occlusion->readbackFence = NULL;
+
+    // Früh sichtbar, verworfen und spät sichtbar liegen hintereinander.
+    int models = occlusion->readbackModels;
+    glBindBuffer(GL_COPY_READ_BUFFER, occlusion->readbackBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(SceneBatch) * 3 * models,
+                       occlusion->readbackData);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    int sums[3] = {0, 0, 0};
+    for (int l = 0; l < 3; l++)
+    {
+        for (int m = 0; m < models; m++)
+        {
+            sums[l] += occlusion->readbackData[l * models + m].count;
+        }
+    }
+
+    occlusion->stats.tested = occlusion->readbackTested;
+    occlusion->stats.early = sums[0];
+    occlusion->stats.late = sums[2];
+    occlusion->stats.occluded = sums[1] - sums[2];
+}
+
+/**
+ * Kopiert die Zähler der Listen dieses Frames in den Readback-Buffer.
+ *
+ * @param occlusion das Occlusion Culling
+ * @param scene die Szene
+ */
+static void occlusion_copyStats(Occlusion* occlusion, Scene* scene)
+{
+    // Ein noch ausstehendes Ergebnis wird durch das neuere ersetzt.
+    if (occlusion->readbackFence != NULL)
+    {
+        glDeleteSync(occlusion->readbackFence);
+        occlusion->readbackFence = NULL;
+    }
+
+    int models = scene->countModels;
+    if (models * 3 > occlusion->readbackCapacity)
+    {
+        occlusion->readbackCapacity = models * 3;
+        free(occlusion->readbackData);
+        occlusion->readbackData = malloc(sizeof(SceneBatch) * occlusion->readbackCapacity);
+
+        if (occlusion->readbackBuffer == 0)
+        {
+            glGenBuffers(1, &occlusion->readbackBuffer);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, occlusion->readbackBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(SceneBatch) * occlusion->readbackCapacity,
+                     NULL, GL_STREAM_READ);
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, scene->listBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, occlusion->readbackBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        sizeof(SceneBatch) * occlusion->earlyList * models, 0,
+                        sizeof(SceneBatch) * 3 * models);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    occlusion->readbackModels = models;
+    occlusion->readbackTested = occlusion->tested;
+    occlusion->readbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/**
+ * Testet eine Liste und verteilt ihre Instanzen auf eine Liste der
+ * sichtbaren und eine Liste der verworfenen Instanzen. Anschließend werden
+ * die Instanzanzahlen der indirekten Drawcalls gesetzt.
+ *
+ * @param occlusion das Occlusion Culling
+ * @param scene die Szene
+ * @param shaders die Compute-Shader
+ * @param input die zu testende Liste
+ * @param visible die Liste der sichtbaren Instanzen
+ * @param reject die Liste der verworfenen Instanzen oder -1
+ */
+static void occlusion_cullList(Occlusion* occlusion, Scene* scene,
+                               const OcclusionShaders* shaders, int input,
+                               int visible, int reject)
+{
+    Shader* cull = shaders->cull;
+    shader_useShader(cull);
+    shader_setInt(cull, "modelCount", scene->countModels);
+    shader_setInt(cull, "inputList", input);
+    shader_setInt(cull, "visibleList", visible);
+    shader_setInt(cull, "rejectList", reject);
+    shader_setInt(cull, "total", occlusion->tested);
+    shader_setBool(cull, "useOcclusion", occlusion->valid);
+
+    if (occlusion->valid)
+    {
+        vec2 depthSize = {(float)occlusion->depthWidth, (float)occlusion->depthHeight};
+        shader_setMat4(cull, "viewProj", &occlusion->viewProjMatrix);
+        shader_setVec2(cull, "depthSize", &depthSize);
+        shader_setInt(cull, "pyramidLevels", occlusion->levels);
+        shader_setInt(cull, "pyramid", OCCLUSION_TEXTURE_UNIT);
+        glActiveTexture(GL_TEXTURE0 + OCCLUSION_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, occlusion->pyramid);
+    }
+
+    glDispatchCompute((occlusion->tested + OCCLUSION_CULL_GROUP - 1) / OCCLUSION_CULL_GROUP, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Die Anzahlen aller Listen in die Drawcalls übernehmen.
+    shader_useShader(shaders->commands);
+    shader_setInt(shaders->commands, "commandCount", scene->countCommands);
+    glDispatchCompute((scene->countCommands + OCCLUSION_CULL_GROUP - 1) / OCCLUSION_CULL_GROUP, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+Occlusion* occlusion_createOcclusion(void)
+{
+    Occlusion* occlusion = malloc(sizeof(Occlusion));
+    memset(occlusion, 0, sizeof(Occlusion));
+    occlusion->inputList = -1;
+    return occlusion;
+}
+
+int occlusion_prepare(Occlusion* occlusion, Scene* scene, int list, int lodBias)
+{
+    occlusion_readStats(occlusion);
+
+    occlusion->inputList = list;
+    occlusion->tested = scene_getListCount(scene, list);
+    occlusion->earlyList = scene_reserveList(scene, list, lodBias);
+    occlusion->rejectList = scene_reserveList(scene, list, lodBias);
+    occlusion->lateList = scene_reserveList(scene, occlusion->rejectList, lodBias);
+
+    return occlusion->earlyList;
+}
+
+void occlusion_cullEarly(Occlusion* occlusion, Scene* scene,
+                         const OcclusionShaders* shaders)
+{
+    if (occlusion->tested == 0)
+    {
+        return;
+    }
+
+    occlusion_cullList(occlusion, scene, shaders, occlusion->inputList,
+                       occlusion->earlyList, occlusion->rejectList);
+}
+
+void occlusion_buildPyramid(Occlusion* occlusion, const OcclusionShaders* shaders,
+                            GLuint depthTexture, int width, int height,
+                            mat4 viewProjMatrix)
+{
+    // Stufe 0 hat die halbe Auflösung der Tiefe, die letzte Stufe 1x1 Texel.
+    if (occlusion->pyramid == 0 || width != occlusion->depthWidth
+        || height != occlusion->depthHeight)
+    {
+        if (occlusion->pyramid != 0)
+        {
+            glDeleteTextures(1, &occlusion->pyramid);
+        }
+
+        int baseWidth = (width + 1) / 2;
+        int baseHeight = (height + 1) / 2;
+        int size = baseWidth > baseHeight ? baseWidth : baseHeight;
+        occlusion->levels = 1;
+        while (size > 1)
+        {
+            size /= 2;
+            occlusion->levels++;
+        }
+
+        glGenTextures(1, &occlusion->pyramid);
+        glBindTexture(GL_TEXTURE_2D, occlusion->pyramid);
+        glTexStorage2D(GL_TEXTURE_2D, occlusion->levels, GL_R32F, baseWidth, baseHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        occlusion->depthWidth = width;
+        occlusion->depthHeight = height;
+    }
+
+    Shader* build = shaders->build;
+    shader_useShader(build);
+    shader_setInt(build, "depthTexture", OCCLUSION_TEXTURE_UNIT);
+    glActiveTexture(GL_TEXTURE0 + OCCLUSION_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+
+    // Jede Stufe liest die vorherige, die erste die Tiefentextur. Weitere
+    // Stufen werden wie von OpenGL abgerundet, bei ungerader Größe nimmt
+    // der letzte Texel die übrige Zeile bzw. Spalte mit auf.
+    int levelWidth = (width + 1) / 2;
+    int levelHeight = (height + 1) / 2;
+    for (int level = 0; level < occlusion->levels; level++)
+    {
+        if (level > 0)
+        {
+            levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+            levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+        }
+
+        shader_setInt(build, "level", level);
+        glBindImageTexture(0, occlusion->pyramid, level > 0 ? level - 1 : 0,
+                           GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, occlusion->pyramid, level, GL_FALSE, 0,
+                           GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((levelWidth + OCCLUSION_BUILD_GROUP - 1) / OCCLUSION_BUILD_GROUP,
+                          (levelHeight + OCCLUSION_BUILD_GROUP - 1) / OCCLUSION_BUILD_GROUP, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    glm_mat4_copy(viewProjMatrix, occlusion->viewProjMatrix);
+    occlusion->valid = true;
+}
+
+int occlusion_getLateList(Occlusion* occlusion)
+{
+    return occlusion->lateList;
+}
+
+void occlusion_cullLate(Occlusion* occlusion, Scene* scene,
+                        const OcclusionShaders* shaders)
+{
+    if (occlusion->tested == 0)
+    {
+        return;
+    }
+
+    occlusion_cullList(occlusion, scene, shaders, occlusion->rejectList,
+                       occlusion->lateList, -1);
+    occlusion_copyStats(occlusion, scene);
+}
+
+void occlusion_getStats(Occlusion* occlusion, OcclusionStats* stats)
+{
+    *stats = occlusion->stats;
+}
+
+void occlusion_deleteOcclusion(Occlusion* occlusion)
+{
+    if (occlusion == NULL)
+    {
+        return;
+    }
+
+    if (occlusion->pyramid != 0)
+    {
+        glDeleteTextures(1, &occlusion->pyramid);
+    }
+    if (occlusion->readbackBuffer != 0)
+    {
+        glDeleteBuffers(1, &occlusion->readbackBuffer);
+    }
+    if (occlusion->readbackFence != NULL)
+    {
+        glDeleteSync(occlusion->readbackFence);
+    }
+    free(occlusion->readbackData);
+    free(occlusion);
+}
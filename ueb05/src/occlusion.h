@@ -0,0 +1,139 @@
+/**
+ * Modul für Occlusion Culling über eine Hierarchical-Z Pyramide.
+ * Jede Stufe der Pyramide enthält die fernste Tiefe von 2x2 Texeln der
+ * vorherigen Stufe und wird per Compute-Shader aus einer Tiefentextur
+ * aufgebaut. Ein zweiter Compute-Shader projiziert die Box jeder Instanz
+ * einer Sichtbarkeitsliste, wählt die Stufe, in der die Box höchstens 2x2
+ * Texel überdeckt, und verwirft die Instanz, wenn sie hinter allen diesen
+ * Texeln liegt. Die übrigen Instanzen landen in einer auf der GPU gefüllten
+ * Liste der Szene, die über indirekte Drawcalls gezeichnet wird.
+ *
+ * Das Culling läuft in zwei Phasen: Die frühe Phase testet gegen die
+ * Pyramide des letzten Frames. Nachdem die sichtbaren Instanzen gezeichnet
+ * wurden, wird die Pyramide aus der neuen Tiefe aufgebaut und die späte
+ * Phase testet alle zuvor verworfenen Instanzen erneut. Gerade sichtbar
+ * gewordene Instanzen fehlen so in keinem Frame.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include "common.h"
+
+#include "shader.h"
+#include "scene.h"
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Compute-Shader des Occlusion Cullings, die alle Pyramiden teilen.
+struct OcclusionShaders
+{
+    Shader* build;    // Baut eine Stufe der Pyramide auf
+    Shader* cull;     // Testet die Instanzen einer Liste
+    Shader* commands; // Überträgt die Anzahlen in die indirekten Drawcalls
+};
+typedef struct OcclusionShaders OcclusionShaders;
+
+// Ergebnis des Cullings eines vergangenen Frames.
+struct OcclusionStats
+{
+    int tested;   // Getestete Instanzen
+    int early;    // In der frühen Phase gezeichnet
+    int late;     // Erst in der späten Phase gezeichnet
+    int occluded; // In beiden Phasen verworfen
+};
+typedef struct OcclusionStats OcclusionStats;
+
+// Pyramide und Listen einer Ansicht (Kamera oder Licht).
+struct Occlusion;
+typedef struct Occlusion Occlusion;
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Erstellt das Occlusion Culling für eine Ansicht. Die Pyramide wird erst
+ * beim ersten Aufbau angelegt.
+ *
+ * @return das neue Occlusion Culling
+ */
+Occlusion* occlusion_createOcclusion(void);
+
+/**
+ * Legt die auf der GPU gefüllten Listen beider Phasen für eine
+ * Sichtbarkeitsliste an und übernimmt die Statistik eines vergangenen
+ * Frames, sobald sie ohne Warten gelesen werden kann. Muss vor
+ * scene_uploadVisibility aufgerufen werden.
+ *
+ * @param occlusion das Occlusion Culling
+ * @param scene die Szene
+ * @param list die zu testende Liste
+ * @param lodBias zusätzliche Detailstufen der Drawcalls gegenüber der Kamera
+ * @return die Liste der frühen Phase
+ */
+int occlusion_prepare(Occlusion* occlusion, Scene* scene, int list, int lodBias);
+
+/**
+ * Testet die Liste gegen die Pyramide des letzten Frames. Gibt es noch
+ * keine Pyramide, gelten alle Instanzen als sichtbar.
+ *
+ * @param occlusion das Occlusion Culling
+ * @param scene die Szene
+ * @param shaders die Compute-Shader
+ */
+void occlusion_cullEarly(Occlusion* occlusion, Scene* scene,
+                         const OcclusionShaders* shaders);
+
+/**
+ * Baut die Pyramide aus einer Tiefentextur auf.
+ *
+ * @param occlusion das Occlusion Culling
+ * @param shaders die Compute-Shader
+ * @param depthTexture die Tiefentextur
+ * @param width die Breite der Tiefentextur
+ * @param height die Höhe der Tiefentextur
+ * @param viewProjMatrix die View-Projection-Matrix der Tiefe
+ */
+void occlusion_buildPyramid(Occlusion* occlusion, const OcclusionShaders* shaders,
+                            GLuint depthTexture, int width, int height,
+                            mat4 viewProjMatrix);
+
+/**
+ * Liefert die Liste der späten Phase. Sie steht bereits nach
+ * occlusion_prepare fest, damit ihre Drawcalls vorab gesammelt werden
+ * können, wird aber erst von occlusion_cullLate gefüllt.
+ *
+ * @param occlusion das Occlusion Culling
+ * @return die Liste der späten Phase
+ */
+int occlusion_getLateList(Occlusion* occlusion);
+
+/**
+ * Testet die in der frühen Phase verworfenen Instanzen gegen die gerade
+ * aufgebaute Pyramide.
+ *
+ * @param occlusion das Occlusion Culling
+ * @param scene die Szene
+ * @param shaders die Compute-Shader
+ */
+void occlusion_cullLate(Occlusion* occlusion, Scene* scene,
+                        const OcclusionShaders* shaders);
+
+/**
+ * Liefert die zuletzt gelesene Statistik.
+ *
+ * @param occlusion das Occlusion Culling
+ * @param stats Ziel für die Statistik
+ */
+void occlusion_getStats(Occlusion* occlusion, OcclusionStats* stats);
+
+/**
+ * Löscht das Occlusion Culling einer Ansicht.
+ *
+ * @param occlusion das zu löschende Occlusion Culling
+ */
+void occlusion_deleteOcclusion(Occlusion* occlusion);
+
+#endif // OCCLUSION_H
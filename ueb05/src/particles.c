@@ -8,19 +8,47 @@
 #include "particles.h"
 
 #include <string.h>
+#include <stddef.h>
+#include <math.h>
 #include "shader.h"
 #include "input.h"
 #include "utils.h"
 #include "texture.h"
+#include "particlesCpu.h"
+#include "instrumentation.h"
+#include "scene.h"
+#include "rendering.h"
 
 ////////////////////////////////// KONSTANTEN //////////////////////////////////
 
-// Gesammtzahl der Partikel
-#define NUM_PARTICLES 1000
-
 // Partikel pro lokaler Workgroup.
-// Achtung: Dieser Wert muss identisch mit dem im Compute-Shader sein!
-#define NUM_PARTICLES_PER_LOCAL_WORK_GROUP 100
+// Wird per #define als WORK_GROUP_SIZE an die Compute-Shader übergeben.
+#define PARTICLES_WORK_GROUP_SIZE 256
+
+// Elemente, die eine Workgroup der Sortierung im Shared Memory sortiert.
+// Muss mit BLOCK_SIZE in particleSort.comp übereinstimmen.
+#define PARTICLES_SORT_BLOCK_SIZE (2 * PARTICLES_WORK_GROUP_SIZE)
+
+// Stufen der Sortierung, siehe particleSort.comp.
+#define PARTICLES_SORT_STAGE_PREPARE 0
+#define PARTICLES_SORT_STAGE_LOCAL_SORT 1
+#define PARTICLES_SORT_STAGE_GLOBAL_STEP 2
+#define PARTICLES_SORT_STAGE_LOCAL_MERGE 3
+
+// Kantenlänge einer Ebene im Textur-Array der Emitter. Alle Texturen werden
+// beim Laden auf diese Größe skaliert.
+#define PARTICLES_TEXTURE_SIZE 256
+
+// Partikelanzahlen und Durchläufe des Render-Benchmarks.
+#define PARTICLES_BENCHMARK_SIZES 3
+#define PARTICLES_BENCHMARK_RUNS 10
+static const int g_benchmarkSizes[PARTICLES_BENCHMARK_SIZES] = {10000, 100000, 1000000};
+
+// Partikelanzahl, Schritte und erlaubte Abweichung des CPU/GPU-Vergleichs.
+#define PARTICLES_PARITY_COUNT 65536
+#define PARTICLES_PARITY_STEPS 30
+#define PARTICLES_PARITY_DT (1.0f / 60.0f)
+#define PARTICLES_PARITY_TOLERANCE 1e-3f
 
 //////////////////////////////////// MAKROS ////////////////////////////////////
 
@@ -28,16 +56,62 @@
 
 ////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
 
+// Zähler und indirekte Kommandos der Simulation.
+// Achtung: Der Aufbau muss identisch mit CounterBuffer in den Shadern sein!
+struct ParticleCounters {
+    GLuint deadCount; //Anzahl freier Partikel
+    GLuint aliveCount; //Anzahl lebender Partikel in diesem Frame
+    GLuint emitCount; //Anzahl neuer Partikel in diesem Frame
+    GLuint emitDispatch[3]; //Indirekter Dispatch der Emission
+    GLuint simDispatch[3]; //Indirekter Dispatch der Simulation
+    GLuint drawCount; //Indirekter Zeichenbefehl der Punkte (DrawArraysIndirectCommand)
+    GLuint drawInstanceCount;
+    GLuint drawFirst;
+    GLuint drawBaseInstance;
+    GLuint quadVertexCount; //Indirekter Zeichenbefehl der instanzierten Quads
+    GLuint quadInstanceCount;
+    GLuint quadFirst;
+    GLuint quadBaseInstance;
+    GLuint alphaCount; //Lebende Partikel mit Alpha-Blending am Ende der Liste
+    GLuint sortCount; //Überlebende mit Alpha-Blending, werden sortiert
+    GLuint sortSize; //sortCount auf eine Zweierpotenz aufgefüllt
+    GLuint sortDispatch[3]; //Indirekter Dispatch der Sortierung
+    GLuint sortedVertexCount; //Indirekter Zeichenbefehl der sortierten Quads
+    GLuint sortedInstanceCount;
+    GLuint sortedFirst;
+    GLuint sortedBaseInstance;
+};
+typedef struct ParticleCounters ParticleCounters;
+
 // Datentyp für alle persistenten Daten des Renderers.
 struct ParticleData {
+    Shader* particlePrepareShader; //Berechnet die indirekten Dispatches
+    Shader* particleEmitShader; //Erzeugt neue Partikel
     Shader* particleSimShader; //Simulations Shader
-    Shader* particleDispShader; //Render Shader
-    GLuint particlePosBuffer; //Position
+    Shader* particleSortShader; //Tiefensortierung der Partikel mit Alpha-Blending
+    Shader* particleDispShader; //Render Shader (Punkte + Geometrie-Shader)
+    Shader* particleQuadShader; //Render Shader (instanzierte Quads)
+    Shader* particleCpuShader; //Render Shader der CPU-Simulation
+    ParticlesCpu* cpu; //CPU-Simulation, wird erst bei Bedarf angelegt
+    bool computeSupported; //GPU-Simulation verfügbar
+    GLuint particlePosBuffer; //Position, w enthält die Restlebenszeit
     GLuint particleVelBuffer; //Velocity
-    GLuint particleLifeBuffer; //Derzeitige Lebenszeit des Partikels
-    GLuint particleVAO;
-    GLuint lookupTexture;
-    GLfloat lifeTime; //Maximale Lebenszeit 
+    GLuint deadListBuffer; //Indizes der freien Partikel
+    GLuint aliveListBuffers[2]; //Indizes der lebenden Partikel (Ping-Pong)
+    GLuint counterBuffer; //ParticleCounters
+    GLuint sortBuffer; //Schlüssel und Indizes der zu sortierenden Partikel
+    int sortBufferSize; //Einträge im Sortier-Buffer, eine Zweierpotenz
+    bool hasAlphaEmitters; //Mindestens ein Emitter benötigt die Sortierung
+    int currentAliveList; //Zuletzt von der Simulation geschriebene Liste
+    GLuint particleVAO; //Leeres VAO, die Daten kommen aus den Buffern
+    GLuint textureArray; //Texturen aller Emitter, Ebene 0 ist die Standardtextur
+    GLuint emitterBuffer; //ParticleEmitterParams aller Emitter
+    ParticleEmitterParams* emitterParams; //Zuletzt hochgeladene Emitter
+    int emitterCount; //Anzahl der Emitter der Szene
+    int* emitterLayers; //Texturebene je Emitter der Szene
+    float* emitAccumulators; //Noch nicht emittierte Partikelbruchteile je Emitter
+    int capacity; //Maximale Anzahl gleichzeitig lebender Partikel
+    float seed; //Startwert der Zufallszahlen
 };
 typedef struct ParticleData ParticleData;
 
@@ -77,158 +151,828 @@ void particles_printComputeInfo(void)
 }
 
 /**
- * Initialisiert den Positions-Partikelbuffer.
+ * Legt einen Shader Storage Buffer an.
+ * 
+ * @param buffer der anzulegende Buffer
+ * @param size die Größe in Bytes
+ * @param content der Inhalt oder NULL
+ */
+static void particles_createBuffer(GLuint* buffer, GLsizeiptr size, const void* content)
+{
+    glGenBuffers(1, buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, *buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, content, GL_DYNAMIC_DRAW);
+}
+
+/**
+ * Legt alle Buffer der Partikel für die angegebene Kapazität an.
+ * Zu Beginn sind alle Partikel frei.
  * 
  * @param data Zugirff auf das Partikel-Datenobjekt.
+ * @param capacity die maximale Anzahl an Partikeln
  */
-static void particles_initPosBuffer(ParticleData* data )
+static void particles_initBuffers(ParticleData* data, int capacity)
 {
-    // Zuerst wird der Positionsbuffer erstellt.
-    glGenBuffers(1, &data->particlePosBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, data->particlePosBuffer);
-
-    // Wir initialisieren einen leeren Buffer.
-    glBufferData(
-        GL_ARRAY_BUFFER, 
-        NUM_PARTICLES * sizeof(vec4), 
-        NULL, GL_STREAM_DRAW
-    );
-    
-    // In dem folgendem Block werden die Buffer-Daten auf einen Zeiger gemappt.
-    // Dieser Zeiger ist nur bis glUnmapBuffer gültig und kann benutzt werden,
-    // um den Speicher zu initialsieren.
-    vec4* positions = glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
-    for (int i = 0; i < NUM_PARTICLES; i++)
+    data->capacity = capacity;
+    data->currentAliveList = 0;
+
+    // Positionen und Geschwindigkeiten werden erst bei der Emission
+    // geschrieben und müssen daher nicht initialisiert werden.
+    particles_createBuffer(&data->particlePosBuffer, capacity * sizeof(vec4), NULL);
+    particles_createBuffer(&data->particleVelBuffer, capacity * sizeof(vec4), NULL);
+    particles_createBuffer(&data->aliveListBuffers[0], capacity * sizeof(GLuint), NULL);
+    particles_createBuffer(&data->aliveListBuffers[1], capacity * sizeof(GLuint), NULL);
+
+    // Zu Beginn sind alle Partikel frei.
+    GLuint* deadList = malloc(capacity * sizeof(GLuint));
+    for (int i = 0; i < capacity; i++)
     {
-        memcpy(
-            positions[i], 
-            (vec4){0.0f, 0.0f, 0.0f, 1.0f}, 
-            sizeof(vec4)
-        );
+        deadList[i] = i;
     }
-    glUnmapBuffer(GL_ARRAY_BUFFER);
+    particles_createBuffer(&data->deadListBuffer, capacity * sizeof(GLuint), deadList);
+    free(deadList);
 
-    // Zum Schluss binden wir unseren Buffer an den Simulations-Shader.
-    shader_useShader(data->particleSimShader);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, data->particlePosBuffer);
+    ParticleCounters counters;
+    memset(&counters, 0, sizeof(ParticleCounters));
+    counters.deadCount = capacity;
+    counters.drawInstanceCount = 1;
+    counters.quadVertexCount = 4;
+    particles_createBuffer(&data->counterBuffer, sizeof(ParticleCounters), &counters);
+
+    // Die Sortierung füllt auf eine Zweierpotenz von mindestens einem
+    // Block auf, der Buffer muss auch dann noch groß genug sein.
+    data->sortBufferSize = PARTICLES_SORT_BLOCK_SIZE;
+    while (data->sortBufferSize < capacity)
+    {
+        data->sortBufferSize *= 2;
+    }
+    particles_createBuffer(&data->sortBuffer, data->sortBufferSize * 2 * sizeof(GLuint), NULL);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
 /**
- * Initialisiert den Geschwindigkeits-Partikelbuffer.
+ * Löscht alle Buffer der Partikel.
  * 
  * @param data Zugirff auf das Partikel-Datenobjekt.
  */
-static void particles_initVelBuffer(ParticleData* data)
+static void particles_deleteBuffers(ParticleData* data)
 {
-    // Zuerst wird der Buffer erstellt.
-    glGenBuffers(1, &data->particleVelBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, data->particleVelBuffer);
-
-    // Wir initialisieren einen leeren Buffer.
-    glBufferData(
-        GL_ARRAY_BUFFER, 
-        NUM_PARTICLES * sizeof(vec4), 
-        NULL, GL_STREAM_DRAW
-    );
-    
-    // In dem folgendem Block werden die Buffer-Daten auf einen Zeiger gemappt.
-    // Dieser Zeiger ist nur bis glUnmapBuffer gültig und kann benutzt werden,
-    // um den Speicher zu initialsieren.
-    vec4* velocities = glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
-    for (int i = 0; i < NUM_PARTICLES; i++)
+    glDeleteBuffers(1, &data->particlePosBuffer);
+    glDeleteBuffers(1, &data->particleVelBuffer);
+    glDeleteBuffers(1, &data->deadListBuffer);
+    glDeleteBuffers(2, data->aliveListBuffers);
+    glDeleteBuffers(1, &data->counterBuffer);
+    glDeleteBuffers(1, &data->sortBuffer);
+}
+
+/**
+ * Legt die Buffer neu an, wenn im Menü eine andere Kapazität gewählt wurde.
+ * Dabei gehen alle lebenden Partikel verloren.
+ * 
+ * @param ctx Programmkontext.
+ */
+static void particles_applyCapacity(ProgContext* ctx)
+{
+    ParticleData* data = ctx->particles;
+    if (ctx->input->particles.capacity != data->capacity)
     {
-        memcpy(
-            velocities[i], 
-            (vec4){ 0.0f, 5.0f, 0.0f , 1.0f}, 
-            sizeof(vec4)
-        );
+        // Ohne Compute Shader gibt es keine GPU-Buffer.
+        if (data->computeSupported)
+        {
+            particles_deleteBuffers(data);
+            particles_initBuffers(data, ctx->input->particles.capacity);
+        }
+        else
+        {
+            data->capacity = ctx->input->particles.capacity;
+        }
     }
-    glUnmapBuffer(GL_ARRAY_BUFFER);
 
-    // Zum Schluss binden wir unseren Buffer an den Simulations-Shader.
-    shader_useShader(data->particleSimShader);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, data->particleVelBuffer);
+    // Die CPU-Simulation wird beim nächsten Gebrauch neu angelegt.
+    if (data->cpu && particlesCpu_getCapacity(data->cpu) != data->capacity)
+    {
+        particlesCpu_delete(data->cpu);
+        data->cpu = NULL;
+    }
+}
+
+/**
+ * Liefert den Emitter, der im Menü eingestellt ist. Er wird verwendet,
+ * wenn die Szene keine eigenen Emitter enthält.
+ * 
+ * @param ctx Programmkontext.
+ * @param emitter der zu füllende Emitter
+ */
+static void particles_getMenuEmitter(ProgContext* ctx, ParticleEmitter* emitter)
+{
+    glm_vec3_copy(ctx->input->particles.startPos, emitter->position);
+    glm_vec3_copy(ctx->input->particles.startDir, emitter->direction);
+    emitter->directionRand = ctx->input->particles.startDirRand;
+    emitter->rate = ctx->input->particles.emissionRate;
+    emitter->lifeTime = ctx->input->particles.lifeTime;
+    emitter->lifeTimeRand = ctx->input->particles.lifeTimeRand;
+    glm_vec3_copy(ctx->input->particles.startColor, emitter->startColor);
+    glm_vec3_copy(ctx->input->particles.endColor, emitter->endColor);
+    emitter->startSize = ctx->input->particles.startSize;
+    emitter->endSize = ctx->input->particles.endSize;
+    emitter->alphaBlend = ctx->input->particles.alphaBlend;
+    emitter->softness = ctx->input->particles.softness;
+    emitter->texture = NULL;
+}
+
+/**
+ * Kopiert eine Textur skaliert in eine Ebene des Textur-Arrays.
+ * 
+ * @param texture die Quelltextur
+ * @param textureArray das Ziel-Array
+ * @param layer die Zielebene
+ * @param fbos je ein Framebuffer zum Lesen und Schreiben
+ */
+static void particles_copyToLayer(GLuint texture, GLuint textureArray, int layer, GLuint fbos[2])
+{
+    // Konnte die Textur nicht geladen werden, bleibt die Ebene leer.
+    GLint width = 0;
+    GLint height = 0;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    if (width == 0 || height == 0)
+    {
+        return;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos[0]);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[1]);
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureArray, 0, layer);
+    glBlitFramebuffer(0, 0, width, height,
+                      0, 0, PARTICLES_TEXTURE_SIZE, PARTICLES_TEXTURE_SIZE,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+}
+
+/**
+ * Übernimmt die Emitter der aktuellen Szene. Jede verschiedene Textur
+ * erhält eine Ebene im Textur-Array, damit alle Emitter mit einem
+ * einzigen Zeichenbefehl dargestellt werden können.
+ * 
+ * @param ctx Programmkontext.
+ */
+static void particles_loadEmitters(ProgContext* ctx)
+{
+    ParticleData* data = ctx->particles;
+    Scene* scene = ctx->input->rendering.userScene;
+    int count = scene ? scene->countEmitters : 0;
+
+    // Ebene 0 ist immer die Standardtextur, weitere Texturen werden nur
+    // einmal angelegt.
+    const char** paths = malloc((count + 1) * sizeof(const char*));
+    int layers = 1;
+    paths[0] = UTILS_CONST_RES("textures/particle.png");
+    data->emitterLayers = realloc(data->emitterLayers, (count + 1) * sizeof(int));
+    for (int i = 0; i < count; i++)
+    {
+        const char* texture = scene->emitters[i]->texture;
+        int layer = 0;
+        if (texture)
+        {
+            for (layer = 1; layer < layers && strcmp(paths[layer], texture) != 0; layer++);
+            if (layer == layers)
+            {
+                paths[layers++] = texture;
+            }
+        }
+        data->emitterLayers[i] = layer;
+    }
+
+    // Textur-Array anlegen und alle Texturen hineinkopieren.
+    GLint readFbo, drawFbo;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFbo);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFbo);
+
+    glDeleteTextures(1, &data->textureArray);
+    glGenTextures(1, &data->textureArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, data->textureArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
+                 PARTICLES_TEXTURE_SIZE, PARTICLES_TEXTURE_SIZE, layers,
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    GLuint fbos[2];
+    glGenFramebuffers(2, fbos);
+    for (int l = 0; l < layers; l++)
+    {
+        GLuint texture = texture_loadTexture(paths[l], GL_REPEAT, GL_FALSE);
+        particles_copyToLayer(texture, data->textureArray, l, fbos);
+    }
+    glDeleteFramebuffers(2, fbos);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFbo);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, data->textureArray);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    free(paths);
+
+    // Ohne Emitter in der Szene wird der Emitter aus dem Menü verwendet.
+    data->emitterCount = count > 0 ? count : 1;
+    data->emitterParams = realloc(data->emitterParams, data->emitterCount * sizeof(ParticleEmitterParams));
+    free(data->emitAccumulators);
+    data->emitAccumulators = calloc(data->emitterCount, sizeof(float));
+
+    printf("Partikel: %d Emitter, %d Texturen\n", data->emitterCount, layers);
+}
+
+/**
+ * Füllt die Shader-Parameter eines Emitters.
+ * 
+ * @param params die zu füllenden Parameter
+ * @param emitter der Emitter
+ * @param layer die Ebene der Textur im Textur-Array
+ */
+static void particles_fillEmitterParams(ParticleEmitterParams* params,
+                                        const ParticleEmitter* emitter, int layer)
+{
+    glm_vec3_copy((float*)emitter->position, params->position);
+    glm_vec3_copy((float*)emitter->direction, params->direction);
+    glm_vec3_copy((float*)emitter->startColor, params->startColor);
+    glm_vec3_copy((float*)emitter->endColor, params->endColor);
+    params->directionRand = emitter->directionRand;
+    params->startSize = emitter->startSize;
+    params->endSize = emitter->endSize;
+    params->textureLayer = (float)layer;
+    params->lifeTime = emitter->lifeTime;
+    params->lifeTimeRand = emitter->lifeTimeRand;
+    params->softness = emitter->softness;
+    params->alphaBlend = emitter->alphaBlend;
+}
+
+/**
+ * Bestimmt die Parameter und die Anzahl neuer Partikel aller Emitter.
+ * Jeder Emitter erhält einen zusammenhängenden Bereich der Emission, damit
+ * auf der GPU ein einziger Dispatch für alle Emitter genügt.
+ * 
+ * @param ctx Programmkontext.
+ * @param dt die Zeitdifferenz des Schritts
+ * @return die Anzahl der gewünschten neuen Partikel aller Emitter
+ */
+static GLuint particles_updateEmitters(ProgContext* ctx, float dt)
+{
+    ParticleData* data = ctx->particles;
+    Scene* scene = ctx->input->rendering.userScene;
+    bool sceneEmitters = scene && scene->countEmitters == data->emitterCount;
+
+    ParticleEmitter menuEmitter;
+    particles_getMenuEmitter(ctx, &menuEmitter);
+
+    GLuint emitOffset = 0;
+    data->hasAlphaEmitters = false;
+    for (int i = 0; i < data->emitterCount; i++)
+    {
+        const ParticleEmitter* emitter = sceneEmitters ? scene->emitters[i] : &menuEmitter;
+        ParticleEmitterParams* params = &data->emitterParams[i];
+        particles_fillEmitterParams(params, emitter, sceneEmitters ? data->emitterLayers[i] : 0);
+        data->hasAlphaEmitters |= emitter->alphaBlend;
+
+        // Bruchteile werden in den nächsten Frame übernommen.
+        data->emitAccumulators[i] += emitter->rate * dt;
+        if (data->emitAccumulators[i] > (float)data->capacity)
+        {
+            data->emitAccumulators[i] = (float)data->capacity;
+        }
+        params->emitOffset = emitOffset;
+        params->emitCount = (GLuint)data->emitAccumulators[i];
+        data->emitAccumulators[i] -= (float)params->emitCount;
+        emitOffset += params->emitCount;
+    }
+
+    return emitOffset;
 }
 
 /**
- * Initialisiert den Positions-Partikelbuffer.
+ * Lädt die Parameter aller Emitter in den Emitter-Buffer der
+ * GPU-Simulation.
  * 
  * @param data Zugirff auf das Partikel-Datenobjekt.
  */
-static void particles_initLife(ParticleData* data)
+static void particles_uploadEmitters(ParticleData* data)
 {
-    // Zuerst wird der Lebenszeitsbuffer erstellt.
-    glGenBuffers(1, &data->particleLifeBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, data->particleLifeBuffer);
-
-    // Wir initialisieren einen leeren Buffer.
-    glBufferData(
-        GL_ARRAY_BUFFER, 
-        NUM_PARTICLES * sizeof(float), 
-        NULL, GL_STREAM_DRAW
-    );
-    
-    // In dem folgendem Block werden die Buffer-Daten auf einen Zeiger gemappt.
-    // Dieser Zeiger ist nur bis glUnmapBuffer gültig und kann benutzt werden,
-    // um den Speicher zu initialsieren.
-    float *lifeLeft = glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
-    for (int i = 0; i < NUM_PARTICLES; i++)
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->emitterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, data->emitterCount * sizeof(ParticleEmitterParams),
+                 data->emitterParams, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/**
+ * Prüft, ob die Partikel auf der CPU simuliert werden. Das ist der Fall,
+ * wenn keine Compute Shader verfügbar sind oder es im Menü erzwungen wird.
+ * 
+ * @param ctx Programmkontext.
+ * @return true, wenn die CPU-Simulation verwendet wird
+ */
+static bool particles_useCpu(ProgContext* ctx)
+{
+    return !ctx->particles->computeSupported || ctx->input->particles.forceCpuSimulation;
+}
+
+/**
+ * Liefert die CPU-Simulation und legt sie bei Bedarf an.
+ * 
+ * @param data Zugirff auf das Partikel-Datenobjekt.
+ * @return die CPU-Simulation
+ */
+static ParticlesCpu* particles_getCpu(ParticleData* data)
+{
+    if (data->cpu == NULL)
     {
-        lifeLeft[i] = 5.0f;
+        data->cpu = particlesCpu_create(data->capacity);
     }
-    glUnmapBuffer(GL_ARRAY_BUFFER);
+    return data->cpu;
+}
 
-    // Zum Schluss binden wir unseren Buffer an den Simulations-Shader.
+/**
+ * Füllt die Parameter eines CPU-Simulationsschritts aus den Eingaben.
+ * 
+ * @param ctx Programmkontext.
+ * @param params die zu füllenden Parameter
+ * @param dt die Zeitdifferenz des Schritts
+ */
+static void particles_fillCpuParams(ProgContext* ctx, ParticlesCpuParams* params, float dt)
+{
+    params->dt = dt;
+    glm_vec3_copy(ctx->input->particles.gravity, params->gravity);
+    params->seed = ctx->particles->seed;
+    params->emitters = ctx->particles->emitterParams;
+    params->emitterCount = ctx->particles->emitterCount;
+    glm_vec3_copy(*camera_getCameraPos(ctx->input->mainCamera), params->camPos);
+    glm_vec3_copy(*camera_getCameraFront(ctx->input->mainCamera), params->camFront);
+}
+
+/**
+ * Führt einen Simulationsschritt mit den Compute Shadern aus.
+ * 
+ * @param ctx Programmkontext.
+ * @param dt die Zeitdifferenz des Schritts
+ * @param emitRequest die Anzahl der gewünschten neuen Partikel
+ */
+static void particles_simulateGpu(ProgContext* ctx, float dt, GLuint emitRequest)
+{
+    ParticleData* data = ctx->particles;
+
+    // Die Simulation liest die zuletzt geschriebene Liste und schreibt
+    // die Überlebenden in die andere.
+    GLuint aliveIn = data->aliveListBuffers[data->currentAliveList];
+    GLuint aliveOut = data->aliveListBuffers[!data->currentAliveList];
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, data->particlePosBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, data->particleVelBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, data->deadListBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, aliveIn);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, aliveOut);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, data->counterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, data->emitterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, data->sortBuffer);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, data->counterBuffer);
+
+    // Vorbereitung: Anzahl neuer Partikel und Größe der Dispatches bestimmen.
+    shader_useShader(data->particlePrepareShader);
+    shader_setUInt(data->particlePrepareShader, "emitRequest", emitRequest);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    // Emission: Neue Partikel aller Emitter aus der Liste der freien
+    // Partikel erzeugen.
+    shader_useShader(data->particleEmitShader);
+    shader_setFloat(data->particleEmitShader, "seed", data->seed);
+    glDispatchComputeIndirect((GLintptr)offsetof(ParticleCounters, emitDispatch));
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Simulation: Nur die lebenden Partikel werden bearbeitet.
     shader_useShader(data->particleSimShader);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, data->particleLifeBuffer);
+    shader_setFloat(data->particleSimShader, "Dt", dt);
+    shader_setVec3(data->particleSimShader, "Gravity", &ctx->input->particles.gravity);
+    glDispatchComputeIndirect((GLintptr)offsetof(ParticleCounters, simDispatch));
+
+    // Die Ergebnisse werden sowohl als Buffer als auch als indirekter
+    // Zeichenbefehl gelesen.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+    data->currentAliveList = !data->currentAliveList;
 }
 
 /**
- * Initialisiert das Partikel-VAO, das zum Rendern verwendet wird.
+ * Führt einen Simulationsschritt auf der CPU aus. Die benötigte Zeit wird
+ * im Statistikfenster angezeigt. Hochgeladen werden die Partikel erst beim
+ * Zeichnen.
+ * 
+ * @param ctx Programmkontext.
+ * @param dt die Zeitdifferenz des Schritts
+ */
+static void particles_simulateCpu(ProgContext* ctx, float dt)
+{
+    ParticleData* data = ctx->particles;
+    ParticlesCpu* cpu = particles_getCpu(data);
+    double start = glfwGetTime();
+
+    // Die Emitter liegen bereits im Speicher, die CPU-Simulation liest sie
+    // direkt statt aus dem Emitter-Buffer.
+    particles_updateEmitters(ctx, dt);
+
+    ParticlesCpuParams params;
+    particles_fillCpuParams(ctx, &params, dt);
+    particlesCpu_update(cpu, &params);
+
+    instrumentation_setValue(ctx, INSTRUMENTATION_PARTICLE_CPU_TIME,
+                             (glfwGetTime() - start) * 1000.0);
+}
+
+/**
+ * Vergleicht die CPU-Simulation mit der GPU-Simulation. Beide erhalten die
+ * gleichen zufälligen Partikel und simulieren mit fester Zeitdifferenz
+ * ohne Emission. Anschließend müssen Lebenszustand, Position und
+ * Restlebenszeit jedes Partikels übereinstimmen. Das Ergebnis wird auf der
+ * Konsole ausgegeben, beide Simulationen beginnen danach von vorn.
+ * 
+ * Die Emission wird nicht verglichen: Sie verwendet auf beiden Seiten die
+ * gleiche Zufallsfunktion, deren sin() ist auf CPU und GPU aber nicht
+ * bitgenau.
+ * 
+ * @param ctx Programmkontext.
+ * @return true, wenn beide Simulationen übereinstimmen
+ */
+static bool particles_checkGpuParity(ProgContext* ctx)
+{
+    ParticleData* data = ctx->particles;
+    int count = PARTICLES_PARITY_COUNT < data->capacity ? PARTICLES_PARITY_COUNT : data->capacity;
+    ParticlesCpu* cpu = particles_getCpu(data);
+
+    // Lebenszeiten liegen eine halbe Zeitdifferenz neben den Schritten,
+    // damit Rundungsunterschiede nicht über Leben und Tod entscheiden.
+    vec4* positions = malloc(count * sizeof(vec4));
+    vec4* velocities = malloc(count * sizeof(vec4));
+    GLuint* indices = malloc(data->capacity * sizeof(GLuint));
+    for (int i = 0; i < count; i++)
+    {
+        positions[i][0] = (rand01() - 0.5f) * 10.0f;
+        positions[i][1] = rand01() * 10.0f;
+        positions[i][2] = (rand01() - 0.5f) * 10.0f;
+        positions[i][3] = PARTICLES_PARITY_DT * ((float)(rand() % (2 * PARTICLES_PARITY_STEPS)) + 0.5f);
+        velocities[i][0] = (rand01() - 0.5f) * 4.0f;
+        velocities[i][1] = rand01() * 4.0f;
+        velocities[i][2] = (rand01() - 0.5f) * 4.0f;
+        velocities[i][3] = 0.0f;
+    }
+    particlesCpu_setParticles(cpu, positions, velocities, count);
+
+    // GPU: Partikel 0..count-1 leben, alle weiteren sind frei.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->particlePosBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(vec4), positions);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->particleVelBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(vec4), velocities);
+    for (int i = 0; i < data->capacity; i++)
+    {
+        indices[i] = i;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->aliveListBuffers[data->currentAliveList]);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GLuint), indices);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->deadListBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (data->capacity - count) * sizeof(GLuint), indices + count);
+
+    ParticleCounters counters;
+    memset(&counters, 0, sizeof(ParticleCounters));
+    counters.deadCount = data->capacity - count;
+    counters.drawCount = count;
+    counters.drawInstanceCount = 1;
+    counters.quadVertexCount = 4;
+    counters.quadInstanceCount = count;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->counterBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(ParticleCounters), &counters);
+
+    // Beide Simulationen mit gleichen Parametern und ohne Emission laufen
+    // lassen.
+    ParticlesCpuParams params;
+    particles_fillCpuParams(ctx, &params, PARTICLES_PARITY_DT);
+    params.emitterCount = 0;
+    for (int step = 0; step < PARTICLES_PARITY_STEPS; step++)
+    {
+        particles_simulateGpu(ctx, PARTICLES_PARITY_DT, 0);
+        particlesCpu_update(cpu, &params);
+    }
+
+    // GPU-Ergebnis zurücklesen, lebendig ist, wer in der Ausgabeliste steht.
+    // Partikel mit Alpha-Blending stehen am Ende der Liste.
+    vec4* gpuPositions = malloc(count * sizeof(vec4));
+    bool* gpuAlive = calloc(count, sizeof(bool));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->counterBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(ParticleCounters), &counters);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->aliveListBuffers[data->currentAliveList]);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, data->capacity * sizeof(GLuint), indices);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->particlePosBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(vec4), gpuPositions);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    for (GLuint i = 0; i < counters.drawCount + counters.sortCount; i++)
+    {
+        GLuint index = i < counters.drawCount
+            ? indices[i]
+            : indices[data->capacity - 1 - (i - counters.drawCount)];
+        if (index < (GLuint)count)
+        {
+            gpuAlive[index] = true;
+        }
+    }
+
+    // CPU-Ergebnis nach Kennung sortiert auslesen und vergleichen.
+    bool* cpuAlive = malloc(count * sizeof(bool));
+    particlesCpu_readParticles(cpu, positions, cpuAlive, count);
+    int mismatches = 0;
+    int alive = 0;
+    float maxError = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        if (gpuAlive[i] != cpuAlive[i])
+        {
+            mismatches++;
+        }
+        else if (gpuAlive[i])
+        {
+            alive++;
+            for (int c = 0; c < 4; c++)
+            {
+                maxError = fmaxf(maxError, fabsf(gpuPositions[i][c] - positions[i][c]));
+            }
+        }
+    }
+
+    bool ok = mismatches == 0 && maxError <= PARTICLES_PARITY_TOLERANCE;
+    printf("Partikel-Paritaet CPU/GPU (%d Partikel, %d Schritte): %s\n",
+           count, PARTICLES_PARITY_STEPS, ok ? "OK" : "FEHLER");
+    printf("  Lebend: %d, abweichender Lebenszustand: %d, max. Abweichung: %g\n",
+           alive, mismatches, maxError);
+
+    free(positions);
+    free(velocities);
+    free(indices);
+    free(gpuPositions);
+    free(gpuAlive);
+    free(cpuAlive);
+
+    // Beide Simulationen enthalten keinen gültigen Zustand mehr.
+    particles_deleteBuffers(data);
+    particles_initBuffers(data, data->capacity);
+    particlesCpu_clear(cpu);
+
+    return ok;
+}
+
+/**
+ * Setzt die Uniforms eines Render Shaders. Beide Render-Pfade verwenden
+ * die gleichen Uniforms.
+ * 
+ * @param ctx Programmkontext.
+ * @param shader der zu verwendende Render Shader
+ * @param viewPojMat View-Projektions-Matrix
+ */
+static void particles_setDrawUniforms(ProgContext* ctx, Shader* shader, mat4 viewProjMat)
+{
+    ParticleData* data = ctx->particles;
+
+    // Shader aktivieren.
+    shader_useShader(shader);
+
+    //Kamera Position ermitteln und uebergeben
+    vec3 *camPos;
+    camPos = camera_getCameraPos(ctx->input->mainCamera);
+    shader_setVec3(shader, "camPos", camPos);
+
+    //View-Projektions-Matrix uebergeben
+    mat4 vpMat;
+    glm_mat4_copy(viewProjMat, vpMat);
+    shader_setMat4(shader, "vpMat", &vpMat);
+
+    // Texturen aller Emitter aktivieren und binden.
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, data->textureArray);
+    shader_setInt(shader, "partTextures", 0);
+
+    // Position und Normale der Szene für das weiche Ausblenden.
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, ctx->rendering->fb.textures[GBUFFER_COLORATTACH_POSITION]);
+    shader_setInt(shader, "gPosition", 1);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, ctx->rendering->fb.textures[GBUFFER_COLORATTACH_NORMAL]);
+    shader_setInt(shader, "gNormal", 2);
+}
+
+/**
+ * Bindet die Buffer, die beim Zeichnen der GPU-Simulation gelesen werden.
  * 
  * @param data Zugirff auf das Partikel-Datenobjekt.
  */
-static void particles_initVAO(ParticleData* data)
+static void particles_bindDrawBuffers(ParticleData* data)
 {
-    // VAO erzeugen.
-    glGenVertexArrays(1, &data->particleVAO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, data->particlePosBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, data->particleVelBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, data->aliveListBuffers[data->currentAliveList]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, data->emitterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, data->sortBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, data->counterBuffer);
     glBindVertexArray(data->particleVAO);
+}
 
-    // Partikel Position
-    glBindBuffer(GL_ARRAY_BUFFER, data->particlePosBuffer);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(
-        0,                                    // Die Attribut-Position
-        4,                                    // Anzahl der Komponenten
-        GL_FLOAT,                             // Datentyp der Komponenten
-        GL_FALSE,                             // Normalisierung der Daten
-        sizeof(vec4),                                    // Größe eines Datensatzes/Vertex
-        NULL                                  // Offset der Daten in einem Struct
-    );
+/**
+ * Sortiert die Partikel mit Alpha-Blending von hinten nach vorne. Jede
+ * Workgroup sortiert zunächst einen Block im Shared Memory, danach werden
+ * die Blöcke bitonisch zusammengeführt. Da die Anzahl nur auf der GPU
+ * bekannt ist, werden die Stufen bis zur Größe des Sortier-Buffers
+ * abgesetzt. Stufen oberhalb der tatsächlichen Anzahl kehren im Shader
+ * sofort zurück.
+ * 
+ * @param ctx Programmkontext.
+ */
+static void particles_sortParticles(ProgContext* ctx)
+{
+    ParticleData* data = ctx->particles;
+    Shader* shader = data->particleSortShader;
 
-    // Partikel Geschwindigkeit
-    glBindBuffer(GL_ARRAY_BUFFER, data->particleVelBuffer);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(
-        1,                                    // Die Attribut-Position
-        4,                                    // Anzahl der Komponenten
-        GL_FLOAT,                             // Datentyp der Komponenten
-        GL_FALSE,                             // Normalisierung der Daten
-        sizeof(vec4),                                    // Größe eines Datensatzes/Vertex
-        NULL                                  // Offset der Daten in einem Struct
-    );
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, data->particlePosBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, data->counterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, data->sortBuffer);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, data->counterBuffer);
 
-    // Partikel Lebenszeit
-    glBindBuffer(GL_ARRAY_BUFFER, data->particleLifeBuffer);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(
-        2,                                    // Die Attribut-Position
-        1,                                    // Anzahl der Komponenten
-        GL_FLOAT,                             // Datentyp der Komponenten
-        GL_FALSE,                             // Normalisierung der Daten
-        sizeof(float),                                    // Größe eines Datensatzes/Vertex
-        NULL                                  // Offset der Daten in einem Struct
-    );
+    shader_useShader(shader);
+    shader_setVec3(shader, "camPos", camera_getCameraPos(ctx->input->mainCamera));
+    shader_setVec3(shader, "camFront", camera_getCameraFront(ctx->input->mainCamera));
+
+    // Größe und Dispatch aus der Anzahl der Überlebenden bestimmen.
+    shader_setUInt(shader, "stage", PARTICLES_SORT_STAGE_PREPARE);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    // Schlüssel berechnen und jeden Block für sich sortieren.
+    shader_setUInt(shader, "stage", PARTICLES_SORT_STAGE_LOCAL_SORT);
+    shader_setUInt(shader, "k", 0);
+    glDispatchComputeIndirect((GLintptr)offsetof(ParticleCounters, sortDispatch));
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Blöcke zusammenführen: Vergleiche über Blockgrenzen global, alle
+    // kleineren Abstände wieder im Shared Memory.
+    for (GLuint k = 2 * PARTICLES_SORT_BLOCK_SIZE; k <= (GLuint)data->sortBufferSize; k *= 2)
+    {
+        shader_setUInt(shader, "k", k);
+        shader_setUInt(shader, "stage", PARTICLES_SORT_STAGE_GLOBAL_STEP);
+        for (GLuint j = k / 2; j >= PARTICLES_SORT_BLOCK_SIZE; j /= 2)
+        {
+            shader_setUInt(shader, "j", j);
+            glDispatchComputeIndirect((GLintptr)offsetof(ParticleCounters, sortDispatch));
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        shader_setUInt(shader, "stage", PARTICLES_SORT_STAGE_LOCAL_MERGE);
+        glDispatchComputeIndirect((GLintptr)offsetof(ParticleCounters, sortDispatch));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+}
+
+/**
+ * Zeichnet die sortierten Partikel mit Alpha-Blending als instanzierte
+ * Quads. Die Reihenfolge der Instanzen entspricht der Sortierung.
+ * 
+ * @param ctx Programmkontext.
+ * @param viewPojMat View-Projektions-Matrix
+ */
+static void particles_drawSorted(ProgContext* ctx, mat4 viewProjMat)
+{
+    ParticleData* data = ctx->particles;
+
+    particles_bindDrawBuffers(data);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    particles_setDrawUniforms(ctx, data->particleQuadShader, viewProjMat);
+    shader_setBool(data->particleQuadShader, "sorted", true);
+    glDrawArraysIndirect(GL_TRIANGLE_STRIP, (const void*)offsetof(ParticleCounters, sortedVertexCount));
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/**
+ * Zeichnet alle additiven Partikel über einen der beiden Render-Pfade.
+ * Die Anzahl steht bereits im jeweiligen indirekten Zeichenbefehl.
+ * 
+ * @param ctx Programmkontext.
+ * @param viewPojMat View-Projektions-Matrix
+ * @param instanced true für instanzierte Quads, false für Punkte mit
+ *                  Geometrie-Shader
+ */
+static void particles_drawParticles(ProgContext* ctx, mat4 viewProjMat, bool instanced)
+{
+    ParticleData* data = ctx->particles;
+
+    particles_bindDrawBuffers(data);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+
+    if (instanced)
+    {
+        // Ein Quad pro Partikel, die Ecke ergibt sich aus gl_VertexID.
+        particles_setDrawUniforms(ctx, data->particleQuadShader, viewProjMat);
+        shader_setBool(data->particleQuadShader, "sorted", false);
+        glDrawArraysIndirect(GL_TRIANGLE_STRIP, (const void*)offsetof(ParticleCounters, quadVertexCount));
+    }
+    else
+    {
+        // Ein Punkt pro Partikel, der Geometrie-Shader erzeugt das Quad.
+        particles_setDrawUniforms(ctx, data->particleDispShader, viewProjMat);
+        glDrawArraysIndirect(GL_POINTS, (const void*)offsetof(ParticleCounters, drawCount));
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/**
+ * Vergleicht beide Render-Pfade bei 10k, 100k und 1M Partikeln und gibt
+ * die GPU-Zeiten auf der Konsole aus. Dafür werden die Partikel zufällig
+ * um den Startpunkt verteilt, die laufende Simulation geht dabei verloren.
+ * 
+ * @param ctx Programmkontext.
+ * @param viewPojMat View-Projektions-Matrix
+ */
+static void particles_benchmark(ProgContext* ctx, mat4 viewProjMat)
+{
+    ParticleData* data = ctx->particles;
+    float lifeTime = ctx->input->particles.lifeTime;
+
+    GLuint query;
+    glGenQueries(1, &query);
+
+    printf("Partikel-Benchmark (%dx%d, %d Durchlaeufe):\n",
+           ctx->winData->width, ctx->winData->height, PARTICLES_BENCHMARK_RUNS);
+
+    for (int s = 0; s < PARTICLES_BENCHMARK_SIZES; s++)
+    {
+        int count = g_benchmarkSizes[s];
+        if (count > data->capacity)
+        {
+            printf("  %8d Partikel: Kapazitaet zu klein\n", count);
+            continue;
+        }
+
+        // Partikel zufällig in einem Würfel um den Startpunkt verteilen.
+        vec4* positions = malloc(count * sizeof(vec4));
+        GLuint* aliveList = malloc(count * sizeof(GLuint));
+        for (int i = 0; i < count; i++)
+        {
+            positions[i][0] = ctx->input->particles.startPos[0] + (rand01() - 0.5f) * 10.0f;
+            positions[i][1] = ctx->input->particles.startPos[1] + rand01() * 10.0f;
+            positions[i][2] = ctx->input->particles.startPos[2] + (rand01() - 0.5f) * 10.0f;
+            positions[i][3] = rand01() * lifeTime;
+            aliveList[i] = i;
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->particlePosBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(vec4), positions);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->aliveListBuffers[data->currentAliveList]);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(GLuint), aliveList);
+        free(positions);
+        free(aliveList);
+
+        ParticleCounters counters;
+        memset(&counters, 0, sizeof(ParticleCounters));
+        counters.drawCount = count;
+        counters.drawInstanceCount = 1;
+        counters.quadVertexCount = 4;
+        counters.quadInstanceCount = count;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->counterBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(ParticleCounters), &counters);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        double times[2] = {0};
+        for (int mode = 0; mode < 2; mode++)
+        {
+            glFinish();
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            for (int i = 0; i < PARTICLES_BENCHMARK_RUNS; i++)
+            {
+                particles_drawParticles(ctx, viewProjMat, mode == 1);
+            }
+            glEndQuery(GL_TIME_ELAPSED);
+
+            //Auf das Ergebnis warten
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            times[mode] = (double)elapsed / 1000000.0 / PARTICLES_BENCHMARK_RUNS;
+        }
+
+        printf("  %8d Partikel: Geometrie-Shader %8.3f ms, Instanziert %8.3f ms\n",
+               count, times[0], times[1]);
+    }
+
+    glDeleteQueries(1, &query);
+
+    // Die Buffer enthalten keinen gültigen Simulationszustand mehr.
+    particles_deleteBuffers(data);
+    particles_initBuffers(data, data->capacity);
 }
 
 //////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
@@ -244,96 +988,167 @@ void particles_init(ProgContext* ctx)
     
 
     // Shader laden.
-    data->particleDispShader = shader_createVeGeomFrShader(
-        UTILS_CONST_RES("shader/particleDisp/particleDisp.vert"),
+    data->particleCpuShader = shader_createVeGeomFrShader(
+        UTILS_CONST_RES("shader/particleDisp/particleCpu.vert"),
         UTILS_CONST_RES("shader/particleDisp/particleDisp.geom"),
         UTILS_CONST_RES("shader/particleDisp/particleDisp.frag")
     );
 
-    data->particleSimShader = shader_createCompShader(
-        UTILS_CONST_RES("shader/particleSim/particleSim.comp")
-    );
-    //Textur der partikel laden
-    data->lookupTexture = texture_loadTexture(UTILS_CONST_RES("textures/particle.png"),GL_REPEAT, GL_FALSE);
-    glBindTexture(GL_TEXTURE_2D, data->lookupTexture);
-
-    // Buffer initialisieren.
-    particles_initPosBuffer(data);
-    particles_initVelBuffer(data);
-    particles_initLife(data);
-    particles_initVAO(data);
+    // Ohne OpenGL 4.3 gibt es weder Compute Shader noch Shader Storage
+    // Buffer, dann wird nur der CPU-Pfad geladen.
+    if (GLAD_GL_VERSION_4_3)
+    {
+        data->particleDispShader = shader_createVeGeomFrShader(
+            UTILS_CONST_RES("shader/particleDisp/particleDisp.vert"),
+            UTILS_CONST_RES("shader/particleDisp/particleDisp.geom"),
+            UTILS_CONST_RES("shader/particleDisp/particleDisp.frag")
+        );
+        data->particleQuadShader = shader_createVeFrShader(
+            UTILS_CONST_RES("shader/particleDisp/particleQuad.vert"),
+            UTILS_CONST_RES("shader/particleDisp/particleDisp.frag")
+        );
+
+        // Die Workgroup-Größe wird allen Compute-Shadern per Define mitgegeben.
+        char defines[64];
+        snprintf(defines, sizeof(defines), "#define WORK_GROUP_SIZE %d\n", PARTICLES_WORK_GROUP_SIZE);
+        data->particlePrepareShader = shader_createCompShaderWithDefines(
+            UTILS_CONST_RES("shader/particleSim/particlePrepare.comp"), defines
+        );
+        data->particleEmitShader = shader_createCompShaderWithDefines(
+            UTILS_CONST_RES("shader/particleSim/particleEmit.comp"), defines
+        );
+        data->particleSimShader = shader_createCompShaderWithDefines(
+            UTILS_CONST_RES("shader/particleSim/particleSim.comp"), defines
+        );
+        data->particleSortShader = shader_createCompShaderWithDefines(
+            UTILS_CONST_RES("shader/particleSim/particleSort.comp"), defines
+        );
+    }
+
+    data->computeSupported = data->particlePrepareShader && data->particleEmitShader
+        && data->particleSimShader && data->particleSortShader
+        && data->particleDispShader && data->particleQuadShader;
+    if (!data->computeSupported)
+    {
+        printf("Compute Shader nicht verfuegbar, Partikel werden auf der CPU simuliert.\n");
+    }
+
+    // Emitter und Texturen der Szene laden.
+    particles_loadEmitters(ctx);
+
+    // Buffer initialisieren. Das VAO bleibt leer, muss im Core Profile
+    // aber zum Zeichnen gebunden sein. Der Emitter-Buffer wird jeden Frame
+    // neu befüllt, muss aber schon vorher gültig sein.
+    data->capacity = ctx->input->particles.capacity;
+    if (data->computeSupported)
+    {
+        particles_initBuffers(data, data->capacity);
+        glGenBuffers(1, &data->emitterBuffer);
+        particles_updateEmitters(ctx, 0.0f);
+        particles_uploadEmitters(data);
+    }
+    glGenVertexArrays(1, &data->particleVAO);
 }
 
 void particles_update(ProgContext* ctx)
 {
     ParticleData* data = ctx->particles;
+    particles_applyCapacity(ctx);
 
+    // Nach einem Szenenwechsel gehören die lebenden Partikel zu Emittern,
+    // die es nicht mehr gibt.
+    if (ctx->input->particles.reloadEmitters)
+    {
+        particles_loadEmitters(ctx);
+        if (data->computeSupported)
+        {
+            particles_deleteBuffers(data);
+            particles_initBuffers(data, data->capacity);
+        }
+        if (data->cpu)
+        {
+            particlesCpu_clear(data->cpu);
+        }
+        ctx->input->particles.reloadEmitters = false;
+    }
 
-    // Shader aktivieren und Uniforms setzen.
-    shader_useShader(data->particleSimShader);
-    shader_setFloat(
-        data->particleSimShader, "Dt", 
-        (float)ctx->winData->deltaTime
-    );
-    shader_setVec3(data->particleSimShader, "Gravity", &ctx->input->particles.gravity);
-    shader_setVec3(data->particleSimShader, "startPos", &ctx->input->particles.startPos);
-    shader_setVec3(data->particleSimShader, "startDir", &ctx->input->particles.startDir);
-    shader_setFloat(data->particleSimShader, "lifeTimeTotal", ctx->input->particles.lifeTime);
-    shader_setFloat(data->particleSimShader, "lifeTimeRand", ctx->input->particles.lifeTimeRand);
-    shader_setFloat(data->particleSimShader, "startDirRand", ctx->input->particles.startDirRand);
-
-    // Der nächste Befehl startet die Berechnung auf der GPU.
-    glDispatchCompute(NUM_PARTICLES / NUM_PARTICLES_PER_LOCAL_WORK_GROUP, 1, 1);
-
-    // Dieser Befehl blockiert das Host-Programm, bis die Simulation abgeschlossen ist.
-    // Grundsätzlich kann der Befehl auch erst später erfolgen, um weiterhin auf der CPU
-    // zu arbeiten. Er muss aber aufgerufen werden, bevor die Partikel gerendert werden.
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    float dt = (float)ctx->winData->deltaTime;
+    data->seed = fmodf(data->seed + dt, 1000.0f);
+
+    if (particles_useCpu(ctx))
+    {
+        if (data->particleCpuShader)
+        {
+            particles_simulateCpu(ctx, dt);
+        }
+    }
+    else
+    {
+        GLuint emitRequest = particles_updateEmitters(ctx, dt);
+        particles_uploadEmitters(data);
+        particles_simulateGpu(ctx, dt, emitRequest);
+    }
+}
+
+bool particles_checkParity(ProgContext* ctx)
+{
+    bool ok = particlesCpu_checkParity();
+    if (ctx->particles->computeSupported)
+    {
+        ok = particles_checkGpuParity(ctx) && ok;
+    }
+    return ok;
 }
 
 void particles_draw(ProgContext* ctx, mat4 viewProjMat)
 {
     ParticleData* data = ctx->particles;
-    // Alpha-Blending aktivieren.
+    RenderingData* rendering = ctx->rendering;
+    particles_applyCapacity(ctx);
+
+    // Die Partikel werden nach der Beleuchtung in das Ergebnisbild des
+    // G-Buffers gezeichnet. Sie testen gegen die Tiefe der Szene, schreiben
+    // selbst aber keine Tiefe.
+    glBindFramebuffer(GL_FRAMEBUFFER, rendering->fb.fbo);
+    glDrawBuffer(rendering->fb.attachments[GBUFFER_COLORATTACH_FINAL]);
     glEnable(GL_BLEND);
     glEnable(GL_DEPTH_TEST);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-
-
-    // Shader aktivieren.
-    shader_useShader(data->particleDispShader);
-
-    //Kamera Position ermitteln und uebergeben
-    vec3 *camPos;
-    camPos = camera_getCameraPos(ctx->input->mainCamera);
-    shader_setVec3(data->particleDispShader, "camPos", camPos);
-
-    //Start und Endfarbe ubergeben
-    shader_setVec3(data->particleDispShader, "startColor", &ctx->input->particles.startColor);
-    shader_setVec3(data->particleDispShader, "endColor", &ctx->input->particles.endColor);
-
-    //Start und Endgroesse uebergeben
-    shader_setFloat(data->particleDispShader, "startSize", ctx->input->particles.startSize);
-    shader_setFloat(data->particleDispShader, "endSize", ctx->input->particles.endSize);
-
-    //Insgesammt Maximal moegliche Lebenszeit uebergeben
-    float temp = ctx->input->particles.lifeTime + ctx->input->particles.lifeTimeRand;
-    shader_setFloat(data->particleDispShader, "totalMaxLifeTime", temp);
-
-    //View-Projektions-Matrix uebergeben
-    mat4 vpMat;
-    glm_mat4_copy(viewProjMat, vpMat);
-    shader_setMat4(data->particleDispShader, "vpMat", &vpMat);
-
-    // Color-Lookup Textur aktivieren und binden.
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, data->lookupTexture);
-    shader_setInt(data->particleDispShader, "partTexture", 0);
+    glDepthMask(GL_FALSE);
 
+    if (data->computeSupported)
+    {
+        // Benchmark auf Anfrage vor dem eigentlichen Zeichnen ausführen.
+        if (ctx->input->particles.runBenchmark)
+        {
+            particles_benchmark(ctx, viewProjMat);
+            ctx->input->particles.runBenchmark = false;
+        }
+    }
 
-    // Punkte rendern.
-    glBindVertexArray(data->particleVAO);
-    glDrawArrays(GL_POINTS, 0, NUM_PARTICLES);
+    if (particles_useCpu(ctx))
+    {
+        // Die CPU-Simulation zeichnet Punkte aus dem Stream Buffer und
+        // sortiert die Partikel mit Alpha-Blending dabei selbst.
+        if (data->particleCpuShader && data->cpu)
+        {
+            ParticlesCpuParams params;
+            particles_fillCpuParams(ctx, &params, 0.0f);
+            particles_setDrawUniforms(ctx, data->particleCpuShader, viewProjMat);
+            particlesCpu_draw(data->cpu, rendering->streamBuffer, &params);
+        }
+    }
+    else
+    {
+        // Zuerst die sortierten Partikel von hinten nach vorne, darüber die
+        // additiven. Ohne Emitter mit Alpha-Blending entfällt die
+        // Sortierung komplett.
+        if (data->hasAlphaEmitters)
+        {
+            particles_sortParticles(ctx);
+            particles_drawSorted(ctx, viewProjMat);
+        }
+        particles_drawParticles(ctx, viewProjMat, ctx->input->particles.useInstancedQuads);
+    }
 
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_BLEND);
@@ -344,11 +1159,23 @@ void particles_cleanup(ProgContext* ctx)
     ParticleData* data = ctx->particles;
 
     shader_deleteShader(data->particleDispShader);
+    shader_deleteShader(data->particleQuadShader);
+    shader_deleteShader(data->particleCpuShader);
+    shader_deleteShader(data->particlePrepareShader);
+    shader_deleteShader(data->particleEmitShader);
     shader_deleteShader(data->particleSimShader);
-    glDeleteBuffers(1, &data->particlePosBuffer);
-    glDeleteBuffers(1, &data->particleVelBuffer);
+    shader_deleteShader(data->particleSortShader);
+    if (data->computeSupported)
+    {
+        particles_deleteBuffers(data);
+    }
+    particlesCpu_delete(data->cpu);
+    glDeleteBuffers(1, &data->emitterBuffer);
     glDeleteVertexArrays(1, &data->particleVAO);
-    glDeleteTextures(1, &data->lookupTexture);
+    glDeleteTextures(1, &data->textureArray);
 
+    free(data->emitterParams);
+    free(data->emitterLayers);
+    free(data->emitAccumulators);
     free(data);
 }
@@ -37,6 +37,17 @@ void particles_update(ProgContext* ctx);
  */
 void particles_draw(ProgContext* ctx, mat4 viewProjMat);
 
+/**
+ * Vergleicht den AVX2-Pfad der CPU-Simulation mit dem skalaren Pfad und,
+ * falls Compute Shader verfügbar sind, die CPU- mit der GPU-Simulation.
+ * Die Ergebnisse werden auf der Konsole ausgegeben, alle Partikel gehen
+ * dabei verloren.
+ * 
+ * @param ctx Programmkontext.
+ * @return true, wenn alle Vergleiche bestanden wurden
+ */
+bool particles_checkParity(ProgContext* ctx);
+
 /**
  * Entfernt alle Daten beim Beenden des Programms
  * 
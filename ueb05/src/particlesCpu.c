@@ -0,0 +1,901 @@
+/**
+ * Modul für die Partikelsimulation auf der CPU.
+ * Wird verwendet, wenn keine Compute Shader zur Verfügung stehen. Die
+ * Simulation bildet die Compute Shader der GPU-Simulation nach. Die
+ * Partikel liegen als Structure of Arrays vor, werden mit AVX2 je acht
+ * Partikel auf einmal berechnet und über das Job-System verteilt. Die
+ * Ergebnisse werden beim Zeichnen in den Stream Buffer des Renderings
+ * geschrieben.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "particlesCpu.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "jobs.h"
+
+// AVX2 wird nur mit GCC und Clang auf x86 genutzt. Die Funktion wird per
+// target-Attribut übersetzt, ob die CPU AVX2 unterstützt, wird zur Laufzeit
+// geprüft.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PARTICLESCPU_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Minimale Partikelanzahl pro Job. Muss ein Vielfaches von 8 sein, damit
+// nur der letzte Bereich skalar abgeschlossen werden muss.
+#define PARTICLESCPU_MIN_BATCH 4096
+
+// Partikel und Schritte des Vergleichs zwischen AVX2- und skalarem Pfad.
+// Die Anzahl ist kein Vielfaches von 8, damit auch der skalare Rest jedes
+// Bereichs geprüft wird.
+#define PARTICLESCPU_PARITY_COUNT 100003
+#define PARTICLESCPU_PARITY_STEPS 60
+#define PARTICLESCPU_PARITY_DT (1.0f / 60.0f)
+
+// Bits pro Durchlauf des Radix Sorts der Partikel mit Alpha-Blending.
+#define PARTICLESCPU_RADIX_BITS 8
+#define PARTICLESCPU_RADIX_SIZE (1 << PARTICLESCPU_RADIX_BITS)
+
+// Maximale Anzahl an Abschnitten beim parallelen Sortieren.
+#define PARTICLESCPU_MAX_CHUNKS 16
+
+// Sortierschlüssel der additiven Partikel. Er ist größer als der jeder
+// Tiefe, sie landen daher in ursprünglicher Reihenfolge hinter den Partikeln
+// mit Alpha-Blending.
+#define PARTICLESCPU_KEY_ADDITIVE 0xFFFFFFFFu
+
+// Erlaubte relative Abweichung von Position und Geschwindigkeit. Der
+// Compiler darf im skalaren Pfad Multiplikation und Addition zu FMA
+// zusammenfassen, die Lebenszeit wird dagegen nur subtrahiert.
+#define PARTICLESCPU_PARITY_TOLERANCE 1e-5f
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Implementierung der Datenstruktur für die CPU-Partikelsimulation.
+struct ParticlesCpu
+{
+    int capacity;
+    int aliveCount;
+
+    // Structure of Arrays, die lebenden Partikel liegen dicht am Anfang.
+    float* posX;
+    float* posY;
+    float* posZ;
+    float* velX;
+    float* velY;
+    float* velZ;
+    float* life;
+    GLuint* emitterIds; // Emitter jedes Partikels, wie velocity.w auf der GPU
+    GLuint* ids; // Kennung jedes Partikels, nur für Vergleiche
+
+    // Zeichenreihenfolge und Zwischenspeicher der Sortierung, werden erst
+    // beim ersten Emitter mit Alpha-Blending angelegt.
+    struct ParticlesCpuSortEntry* sortEntries;
+    struct ParticlesCpuSortEntry* tmpSortEntries;
+
+    bool useAvx2;
+
+    // VAO für das Zeichnen, die Daten liegen jeden Frame an einer anderen
+    // Stelle im Stream Buffer.
+    GLuint vao;
+};
+
+// Ein Partikel im Stream Buffer. Das Aussehen ist bereits aus dem Emitter
+// bestimmt, der Shader muss die Emitter daher nicht kennen.
+struct ParticlesCpuVertex
+{
+    vec3 position;
+    float size;
+    vec3 color;
+    float layer;
+    float softness;
+};
+typedef struct ParticlesCpuVertex ParticlesCpuVertex;
+
+// Sortierschlüssel und Index eines Partikels.
+struct ParticlesCpuSortEntry
+{
+    GLuint key;
+    GLuint index;
+};
+typedef struct ParticlesCpuSortEntry ParticlesCpuSortEntry;
+
+// Abschnitt der Partikel, der beim Sortieren von einem Job bearbeitet wird.
+struct ParticlesCpuSortChunk
+{
+    const ParticlesCpuSortEntry* src;
+    ParticlesCpuSortEntry* dst;
+    int begin;
+    int end;
+    unsigned int shift;
+    int histogram[PARTICLESCPU_RADIX_SIZE]; // Danach Zielpositionen
+};
+typedef struct ParticlesCpuSortChunk ParticlesCpuSortChunk;
+
+// Bearbeitet einen Teilbereich der Partikel.
+typedef void (*ParticlesCpuRangeFunc)(ParticlesCpu* cpu, const ParticlesCpuParams* params,
+                                      void* target, int begin, int end);
+
+// Auftrag für eine parallele Schleife.
+struct ParticlesCpuJob
+{
+    ParticlesCpuRangeFunc func;
+    ParticlesCpu* cpu;
+    const ParticlesCpuParams* params;
+    void* target;
+};
+typedef struct ParticlesCpuJob ParticlesCpuJob;
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Berechnet auf Basis eines 2D-Vektors einen Zufallswert, wie rand() in
+ * particleEmit.comp.
+ *
+ * @param x erste Komponente
+ * @param y zweite Komponente
+ * @return Pseudo-Zufallswert
+ */
+static float particlesCpu_rand(float x, float y)
+{
+    float v = sinf(x * 12.9898f + y * 78.233f) * 43758.5453f;
+    return v - floorf(v);
+}
+
+/**
+ * Simuliert einen Teilbereich der Partikel ohne SIMD, wie particleSim.comp.
+ *
+ * @param cpu die Simulation
+ * @param params die Parameter des Schritts
+ * @param target unbenutzt
+ * @param begin erstes Partikel
+ * @param end Ende des Bereichs (exklusiv)
+ */
+static void particlesCpu_simulateScalar(ParticlesCpu* cpu, const ParticlesCpuParams* params,
+                                        void* target, int begin, int end)
+{
+    float dt = params->dt;
+    float gx = params->gravity[0] * dt;
+    float gy = params->gravity[1] * dt;
+    float gz = params->gravity[2] * dt;
+
+    for (int i = begin; i < end; i++)
+    {
+        // Trägheit der Partikel simulieren.
+        cpu->velX[i] += gx;
+        cpu->velY[i] += gy;
+        cpu->velZ[i] += gz;
+        // Neue Position berechnen.
+        cpu->posX[i] += dt * cpu->velX[i];
+        cpu->posY[i] += dt * cpu->velY[i];
+        cpu->posZ[i] += dt * cpu->velZ[i];
+        // Verbleibene Zeit reduzieren
+        cpu->life[i] -= dt;
+    }
+}
+
+#ifdef PARTICLESCPU_HAS_AVX2
+/**
+ * Simuliert einen Teilbereich der Partikel mit AVX2, je acht Partikel pro
+ * Durchlauf. Der Rest wird skalar berechnet.
+ *
+ * @param cpu die Simulation
+ * @param params die Parameter des Schritts
+ * @param target unbenutzt
+ * @param begin erstes Partikel
+ * @param end Ende des Bereichs (exklusiv)
+ */
+__attribute__((target("avx2")))
+static void particlesCpu_simulateAvx2(ParticlesCpu* cpu, const ParticlesCpuParams* params,
+                                      void* target, int begin, int end)
+{
+    __m256 dt = _mm256_set1_ps(params->dt);
+    __m256 gx = _mm256_set1_ps(params->gravity[0] * params->dt);
+    __m256 gy = _mm256_set1_ps(params->gravity[1] * params->dt);
+    __m256 gz = _mm256_set1_ps(params->gravity[2] * params->dt);
+
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 vx = _mm256_add_ps(_mm256_loadu_ps(cpu->velX + i), gx);
+        __m256 vy = _mm256_add_ps(_mm256_loadu_ps(cpu->velY + i), gy);
+        __m256 vz = _mm256_add_ps(_mm256_loadu_ps(cpu->velZ + i), gz);
+        _mm256_storeu_ps(cpu->velX + i, vx);
+        _mm256_storeu_ps(cpu->velY + i, vy);
+        _mm256_storeu_ps(cpu->velZ + i, vz);
+
+        _mm256_storeu_ps(cpu->posX + i, _mm256_add_ps(_mm256_loadu_ps(cpu->posX + i), _mm256_mul_ps(dt, vx)));
+        _mm256_storeu_ps(cpu->posY + i, _mm256_add_ps(_mm256_loadu_ps(cpu->posY + i), _mm256_mul_ps(dt, vy)));
+        _mm256_storeu_ps(cpu->posZ + i, _mm256_add_ps(_mm256_loadu_ps(cpu->posZ + i), _mm256_mul_ps(dt, vz)));
+
+        _mm256_storeu_ps(cpu->life + i, _mm256_sub_ps(_mm256_loadu_ps(cpu->life + i), dt));
+    }
+
+    particlesCpu_simulateScalar(cpu, params, target, i, end);
+}
+#endif
+
+/**
+ * Liefert den Emitter eines Partikels. Ungültige Kennungen werden wie in
+ * den Shadern auf den letzten Emitter gelegt.
+ *
+ * @param params die Parameter mit den Emittern
+ * @param emitterId die Kennung des Emitters
+ * @return der Emitter
+ */
+static const ParticleEmitterParams* particlesCpu_getEmitter(const ParticlesCpuParams* params,
+                                                            GLuint emitterId)
+{
+    if (emitterId >= (GLuint)params->emitterCount)
+    {
+        emitterId = params->emitterCount - 1;
+    }
+    return &params->emitters[emitterId];
+}
+
+/**
+ * Schreibt ein Partikel mit dem Aussehen seines Emitters in den
+ * Zielspeicher. Farbe und Größe werden wie in particleDisp.vert über die
+ * Lebenszeit interpoliert.
+ *
+ * @param cpu die Simulation
+ * @param params die Parameter mit den Emittern
+ * @param vertex das Ziel
+ * @param i das Partikel
+ */
+static void particlesCpu_packVertex(ParticlesCpu* cpu, const ParticlesCpuParams* params,
+                                    ParticlesCpuVertex* vertex, int i)
+{
+    const ParticleEmitterParams* emitter = particlesCpu_getEmitter(params, cpu->emitterIds[i]);
+    float t = cpu->life[i] / (emitter->lifeTime + emitter->lifeTimeRand);
+
+    vertex->position[0] = cpu->posX[i];
+    vertex->position[1] = cpu->posY[i];
+    vertex->position[2] = cpu->posZ[i];
+    vertex->size = emitter->endSize + (emitter->startSize - emitter->endSize) * t;
+    for (int c = 0; c < 3; c++)
+    {
+        vertex->color[c] = emitter->endColor[c] + (emitter->startColor[c] - emitter->endColor[c]) * t;
+    }
+    vertex->layer = emitter->textureLayer;
+    vertex->softness = emitter->softness;
+}
+
+/**
+ * Schreibt einen Teilbereich der Partikel mit dem Aussehen ihres Emitters
+ * in den Zielspeicher.
+ *
+ * @param cpu die Simulation
+ * @param params die Parameter mit den Emittern
+ * @param target der Zielspeicher
+ * @param begin erstes Partikel
+ * @param end Ende des Bereichs (exklusiv)
+ */
+static void particlesCpu_pack(ParticlesCpu* cpu, const ParticlesCpuParams* params,
+                              void* target, int begin, int end)
+{
+    ParticlesCpuVertex* vertices = target;
+    for (int i = begin; i < end; i++)
+    {
+        particlesCpu_packVertex(cpu, params, &vertices[i], i);
+    }
+}
+
+/**
+ * Schreibt einen Teilbereich der Partikel in sortierter Reihenfolge in den
+ * Zielspeicher, siehe particlesCpu_pack.
+ *
+ * @param cpu die Simulation
+ * @param params die Parameter mit den Emittern
+ * @param target der Zielspeicher
+ * @param begin erste Position in der Sortierung
+ * @param end Ende des Bereichs (exklusiv)
+ */
+static void particlesCpu_packSorted(ParticlesCpu* cpu, const ParticlesCpuParams* params,
+                                    void* target, int begin, int end)
+{
+    ParticlesCpuVertex* vertices = target;
+    for (int i = begin; i < end; i++)
+    {
+        particlesCpu_packVertex(cpu, params, &vertices[i], cpu->sortEntries[i].index);
+    }
+}
+
+/**
+ * Bildet den Sortierschlüssel einer Tiefe. Die Bits eines floats werden so
+ * umgeformt, dass sie vorzeichenlos verglichen in der Reihenfolge der
+ * Zahlen liegen. Die Tiefe wird negiert, damit das entfernteste Partikel
+ * den kleinsten Schlüssel erhält.
+ *
+ * @param depth die Tiefe entlang der Blickrichtung
+ * @return der Sortierschlüssel
+ */
+static GLuint particlesCpu_depthKey(float depth)
+{
+    float key = -depth;
+    GLuint bits;
+    memcpy(&bits, &key, sizeof(GLuint));
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+/**
+ * Bestimmt die Sortierschlüssel eines Teilbereichs der Partikel, wie
+ * particleSort.comp. Additive Partikel werden hinter alle anderen gelegt.
+ *
+ * @param cpu die Simulation
+ * @param params die Parameter mit Emittern und Kamera
+ * @param target die Sortiereinträge
+ * @param begin erstes Partikel
+ * @param end Ende des Bereichs (exklusiv)
+ */
+static void particlesCpu_buildKeys(ParticlesCpu* cpu, const ParticlesCpuParams* params,
+                                   void* target, int begin, int end)
+{
+    ParticlesCpuSortEntry* entries = target;
+    for (int i = begin; i < end; i++)
+    {
+        entries[i].index = i;
+        if (particlesCpu_getEmitter(params, cpu->emitterIds[i])->alphaBlend)
+        {
+            float depth = (cpu->posX[i] - params->camPos[0]) * params->camFront[0]
+                        + (cpu->posY[i] - params->camPos[1]) * params->camFront[1]
+                        + (cpu->posZ[i] - params->camPos[2]) * params->camFront[2];
+            entries[i].key = particlesCpu_depthKey(depth);
+        }
+        else
+        {
+            entries[i].key = PARTICLESCPU_KEY_ADDITIVE;
+        }
+    }
+}
+
+/**
+ * Zählt die Häufigkeit jedes Bytes in den Abschnitten eines Bereichs.
+ *
+ * @param arg die Abschnitte
+ * @param begin erster Abschnitt
+ * @param end Ende des Bereichs (exklusiv)
+ */
+static void particlesCpu_histogramJob(void* arg, int begin, int end)
+{
+    ParticlesCpuSortChunk* chunks = arg;
+    for (int c = begin; c < end; c++)
+    {
+        ParticlesCpuSortChunk* chunk = &chunks[c];
+        memset(chunk->histogram, 0, sizeof(chunk->histogram));
+
+        for (int i = chunk->begin; i < chunk->end; i++)
+        {
+            chunk->histogram[(chunk->src[i].key >> chunk->shift)
+                             & (PARTICLESCPU_RADIX_SIZE - 1)]++;
+        }
+    }
+}
+
+/**
+ * Verteilt die Einträge der Abschnitte eines Bereichs an ihre
+ * Zielpositionen.
+ *
+ * @param arg die Abschnitte
+ * @param begin erster Abschnitt
+ * @param end Ende des Bereichs (exklusiv)
+ */
+static void particlesCpu_scatterJob(void* arg, int begin, int end)
+{
+    ParticlesCpuSortChunk* chunks = arg;
+    for (int c = begin; c < end; c++)
+    {
+        ParticlesCpuSortChunk* chunk = &chunks[c];
+        for (int i = chunk->begin; i < chunk->end; i++)
+        {
+            chunk->dst[chunk->histogram[(chunk->src[i].key >> chunk->shift)
+                                        & (PARTICLESCPU_RADIX_SIZE - 1)]++] = chunk->src[i];
+        }
+    }
+}
+
+/**
+ * Bearbeitet einen Bereich im Auftrag des Job-Systems.
+ *
+ * @param arg der auszuführende Auftrag
+ * @param begin Anfang des Bereichs
+ * @param end Ende des Bereichs
+ */
+static void particlesCpu_runJob(void* arg, int begin, int end)
+{
+    ParticlesCpuJob* job = arg;
+    job->func(job->cpu, job->params, job->target, begin, end);
+}
+
+/**
+ * Verteilt eine Funktion über alle lebenden Partikel auf das Job-System.
+ *
+ * @param cpu die Simulation
+ * @param func die auszuführende Funktion
+ * @param params die Parameter des Schritts
+ * @param target der Zielspeicher oder NULL
+ */
+static void particlesCpu_parallelFor(ParticlesCpu* cpu, ParticlesCpuRangeFunc func,
+                                     const ParticlesCpuParams* params, void* target)
+{
+    ParticlesCpuJob job = {func, cpu, params, target};
+    jobs_parallelFor(cpu->aliveCount, PARTICLESCPU_MIN_BATCH, particlesCpu_runJob, &job);
+}
+
+/**
+ * Sortiert die Partikel mit Alpha-Blending von hinten nach vorne. Danach
+ * enthalten die Sortiereinträge die Zeichenreihenfolge: zuerst die
+ * sortierten Partikel, dahinter alle additiven.
+ *
+ * @param cpu die Simulation
+ * @param params die Parameter mit Emittern und Kamera
+ * @return die Anzahl der Partikel mit Alpha-Blending
+ */
+static int particlesCpu_sortAlpha(ParticlesCpu* cpu, const ParticlesCpuParams* params)
+{
+    if (cpu->sortEntries == NULL)
+    {
+        cpu->sortEntries = malloc(cpu->capacity * sizeof(ParticlesCpuSortEntry));
+        cpu->tmpSortEntries = malloc(cpu->capacity * sizeof(ParticlesCpuSortEntry));
+    }
+
+    int count = cpu->aliveCount;
+    particlesCpu_parallelFor(cpu, particlesCpu_buildKeys, params, cpu->sortEntries);
+
+    // LSD Radix Sort wie in der Render Queue: Pro Durchlauf werden 8 Bit
+    // des Schlüssels stabil sortiert, Histogramme und Verteilung laufen je
+    // Abschnitt parallel. Durch die Stabilität behalten die additiven
+    // Partikel ihre Reihenfolge.
+    int chunkCount = count / PARTICLESCPU_MIN_BATCH;
+    if (chunkCount > jobs_getThreadCount())
+    {
+        chunkCount = jobs_getThreadCount();
+    }
+    if (chunkCount > PARTICLESCPU_MAX_CHUNKS)
+    {
+        chunkCount = PARTICLESCPU_MAX_CHUNKS;
+    }
+    if (chunkCount < 1)
+    {
+        chunkCount = 1;
+    }
+
+    ParticlesCpuSortChunk chunks[PARTICLESCPU_MAX_CHUNKS];
+    for (int c = 0; c < chunkCount; c++)
+    {
+        chunks[c].begin = (int)((int64_t)count * c / chunkCount);
+        chunks[c].end = (int)((int64_t)count * (c + 1) / chunkCount);
+    }
+
+    ParticlesCpuSortEntry* src = cpu->sortEntries;
+    ParticlesCpuSortEntry* dst = cpu->tmpSortEntries;
+
+    for (unsigned int shift = 0; shift < 32; shift += PARTICLESCPU_RADIX_BITS)
+    {
+        for (int c = 0; c < chunkCount; c++)
+        {
+            chunks[c].src = src;
+            chunks[c].dst = dst;
+            chunks[c].shift = shift;
+        }
+        jobs_parallelFor(chunkCount, 1, particlesCpu_histogramJob, chunks);
+
+        // Alle Schlüssel sind in diesem Byte gleich.
+        unsigned int firstByte = (src[0].key >> shift) & (PARTICLESCPU_RADIX_SIZE - 1);
+        int sameCount = 0;
+        for (int c = 0; c < chunkCount; c++)
+        {
+            sameCount += chunks[c].histogram[firstByte];
+        }
+        if (sameCount == count)
+        {
+            continue;
+        }
+
+        // Präfixsumme über alle Bytes und innerhalb eines Bytes über die
+        // Abschnitte bilden, um die Startpositionen zu bestimmen.
+        int offset = 0;
+        for (int b = 0; b < PARTICLESCPU_RADIX_SIZE; b++)
+        {
+            for (int c = 0; c < chunkCount; c++)
+            {
+                int n = chunks[c].histogram[b];
+                chunks[c].histogram[b] = offset;
+                offset += n;
+            }
+        }
+
+        jobs_parallelFor(chunkCount, 1, particlesCpu_scatterJob, chunks);
+
+        ParticlesCpuSortEntry* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    cpu->sortEntries = src;
+    cpu->tmpSortEntries = dst;
+
+    // Die additiven Partikel beginnen beim ersten Schlüssel ohne Tiefe.
+    int low = 0;
+    int high = count;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (src[mid].key == PARTICLESCPU_KEY_ADDITIVE)
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+/**
+ * Erzeugt die neuen Partikel aller Emitter am Ende der lebenden Partikel,
+ * wie particleEmit.comp. Reicht die Kapazität nicht, gehen die letzten
+ * Emitter leer aus.
+ *
+ * @param cpu die Simulation
+ * @param params die Parameter des Schritts
+ */
+static void particlesCpu_emit(ParticlesCpu* cpu, const ParticlesCpuParams* params)
+{
+    for (int e = 0; e < params->emitterCount; e++)
+    {
+        const ParticleEmitterParams* emitter = &params->emitters[e];
+        int emitCount = (int)emitter->emitCount;
+        if (emitCount > cpu->capacity - cpu->aliveCount)
+        {
+            emitCount = cpu->capacity - cpu->aliveCount;
+        }
+
+        float r = emitter->directionRand;
+        for (int k = 0; k < emitCount; k++)
+        {
+            int i = cpu->aliveCount++;
+            float index = (float)i;
+
+            // Startposition setzen und StartRichtung zufaelig bestimmen. Der
+            // Emitter wird fuer die Darstellung gemerkt.
+            cpu->posX[i] = emitter->position[0];
+            cpu->posY[i] = emitter->position[1];
+            cpu->posZ[i] = emitter->position[2];
+            cpu->velX[i] = emitter->direction[0] + particlesCpu_rand(index, params->seed) * r - 0.5f * r;
+            cpu->velY[i] = emitter->direction[1] + particlesCpu_rand(index + 1.0f, params->seed) * r - 0.5f * r;
+            cpu->velZ[i] = emitter->direction[2] + particlesCpu_rand(index + 2.0f, params->seed) * r - 0.5f * r;
+            // Zufaellige Zeit bestimmen
+            cpu->life[i] = emitter->lifeTime + emitter->lifeTimeRand * particlesCpu_rand(index, params->seed + 1.0f);
+            cpu->emitterIds[i] = e;
+            cpu->ids[i] = i;
+        }
+    }
+}
+
+/**
+ * Entfernt alle gestorbenen Partikel, indem sie mit dem jeweils letzten
+ * lebenden Partikel überschrieben werden.
+ *
+ * @param cpu die Simulation
+ */
+static void particlesCpu_compact(ParticlesCpu* cpu)
+{
+    int i = 0;
+    while (i < cpu->aliveCount)
+    {
+        if (cpu->life[i] > 0.0f)
+        {
+            i++;
+            continue;
+        }
+
+        int last = --cpu->aliveCount;
+        cpu->posX[i] = cpu->posX[last];
+        cpu->posY[i] = cpu->posY[last];
+        cpu->posZ[i] = cpu->posZ[last];
+        cpu->velX[i] = cpu->velX[last];
+        cpu->velY[i] = cpu->velY[last];
+        cpu->velZ[i] = cpu->velZ[last];
+        cpu->life[i] = cpu->life[last];
+        cpu->emitterIds[i] = cpu->emitterIds[last];
+        cpu->ids[i] = cpu->ids[last];
+    }
+}
+
+/**
+ * Prüft, ob zwei Werte des Paritätsvergleichs übereinstimmen.
+ *
+ * @param a Wert des AVX2-Pfads
+ * @param b Wert des skalaren Pfads
+ * @return true, wenn die Abweichung innerhalb der Toleranz liegt
+ */
+static bool particlesCpu_parityEqual(float a, float b)
+{
+    return fabsf(a - b) <= PARTICLESCPU_PARITY_TOLERANCE * fmaxf(1.0f, fabsf(a));
+}
+
+/**
+ * Legt die Partikeldaten einer Simulation ohne OpenGL Ressourcen an.
+ *
+ * @param capacity die maximale Anzahl an Partikeln
+ * @return die neue Simulation
+ */
+static ParticlesCpu* particlesCpu_allocate(int capacity)
+{
+    ParticlesCpu* cpu = malloc(sizeof(ParticlesCpu));
+    memset(cpu, 0, sizeof(ParticlesCpu));
+    cpu->capacity = capacity;
+
+    cpu->posX = malloc(capacity * sizeof(float));
+    cpu->posY = malloc(capacity * sizeof(float));
+    cpu->posZ = malloc(capacity * sizeof(float));
+    cpu->velX = malloc(capacity * sizeof(float));
+    cpu->velY = malloc(capacity * sizeof(float));
+    cpu->velZ = malloc(capacity * sizeof(float));
+    cpu->life = malloc(capacity * sizeof(float));
+    cpu->emitterIds = malloc(capacity * sizeof(GLuint));
+    cpu->ids = malloc(capacity * sizeof(GLuint));
+
+#ifdef PARTICLESCPU_HAS_AVX2
+    cpu->useAvx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    return cpu;
+}
+
+/**
+ * Gibt die Partikeldaten einer Simulation frei.
+ *
+ * @param cpu die Simulation
+ */
+static void particlesCpu_free(ParticlesCpu* cpu)
+{
+    free(cpu->posX);
+    free(cpu->posY);
+    free(cpu->posZ);
+    free(cpu->velX);
+    free(cpu->velY);
+    free(cpu->velZ);
+    free(cpu->life);
+    free(cpu->emitterIds);
+    free(cpu->ids);
+    free(cpu->sortEntries);
+    free(cpu->tmpSortEntries);
+    free(cpu);
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+ParticlesCpu* particlesCpu_create(int capacity)
+{
+    ParticlesCpu* cpu = particlesCpu_allocate(capacity);
+
+    // Position und Größe, Farbe und Texturebene sowie Weichheit der
+    // Partikel. Der Buffer wird erst beim Zeichnen gesetzt.
+    glGenVertexArrays(1, &cpu->vao);
+    glBindVertexArray(cpu->vao);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    return cpu;
+}
+
+int particlesCpu_getCapacity(ParticlesCpu* cpu)
+{
+    return cpu->capacity;
+}
+
+int particlesCpu_getAliveCount(ParticlesCpu* cpu)
+{
+    return cpu->aliveCount;
+}
+
+void particlesCpu_update(ParticlesCpu* cpu, const ParticlesCpuParams* params)
+{
+    // Wie auf der GPU werden neue Partikel bereits im selben Schritt simuliert.
+    particlesCpu_emit(cpu, params);
+
+#ifdef PARTICLESCPU_HAS_AVX2
+    particlesCpu_parallelFor(cpu, cpu->useAvx2 ? particlesCpu_simulateAvx2
+                                               : particlesCpu_simulateScalar,
+                             params, NULL);
+#else
+    particlesCpu_parallelFor(cpu, particlesCpu_simulateScalar, params, NULL);
+#endif
+
+    particlesCpu_compact(cpu);
+}
+
+void particlesCpu_draw(ParticlesCpu* cpu, StreamBuffer* stream, const ParticlesCpuParams* params)
+{
+    if (cpu->aliveCount == 0)
+    {
+        return;
+    }
+
+    // Ohne Emitter mit Alpha-Blending entfällt die Sortierung komplett.
+    bool hasAlphaEmitters = false;
+    for (int e = 0; e < params->emitterCount; e++)
+    {
+        hasAlphaEmitters |= params->emitters[e].alphaBlend != 0;
+    }
+    int alphaCount = hasAlphaEmitters ? particlesCpu_sortAlpha(cpu, params) : 0;
+
+    // Die lebenden Partikel direkt in den Stream Buffer packen. Der Bereich
+    // bleibt gültig, bis die GPU den Frame abgeschlossen hat.
+    StreamAllocation allocation;
+    streamBuffer_alloc(stream, (GLsizeiptr)cpu->aliveCount * sizeof(ParticlesCpuVertex), &allocation);
+    particlesCpu_parallelFor(cpu, hasAlphaEmitters ? particlesCpu_packSorted : particlesCpu_pack,
+                             params, allocation.memory);
+    streamBuffer_commit(stream, &allocation);
+
+    glBindVertexArray(cpu->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, allocation.buffer);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(ParticlesCpuVertex),
+                          (void*)(allocation.offset + offsetof(ParticlesCpuVertex, position)));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ParticlesCpuVertex),
+                          (void*)(allocation.offset + offsetof(ParticlesCpuVertex, color)));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(ParticlesCpuVertex),
+                          (void*)(allocation.offset + offsetof(ParticlesCpuVertex, softness)));
+
+    // Zuerst die sortierten Partikel von hinten nach vorne, darüber die
+    // additiven.
+    if (alphaCount > 0)
+    {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDrawArrays(GL_POINTS, 0, alphaCount);
+    }
+    if (alphaCount < cpu->aliveCount)
+    {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+        glDrawArrays(GL_POINTS, alphaCount, cpu->aliveCount - alphaCount);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void particlesCpu_clear(ParticlesCpu* cpu)
+{
+    cpu->aliveCount = 0;
+}
+
+void particlesCpu_setParticles(ParticlesCpu* cpu, const vec4* positions,
+                               const vec4* velocities, int count)
+{
+    cpu->aliveCount = count < cpu->capacity ? count : cpu->capacity;
+    for (int i = 0; i < cpu->aliveCount; i++)
+    {
+        cpu->posX[i] = positions[i][0];
+        cpu->posY[i] = positions[i][1];
+        cpu->posZ[i] = positions[i][2];
+        cpu->life[i] = positions[i][3];
+        cpu->velX[i] = velocities[i][0];
+        cpu->velY[i] = velocities[i][1];
+        cpu->velZ[i] = velocities[i][2];
+        cpu->emitterIds[i] = (GLuint)velocities[i][3];
+        cpu->ids[i] = i;
+    }
+}
+
+void particlesCpu_readParticles(ParticlesCpu* cpu, vec4* positions,
+                                bool* alive, int count)
+{
+    memset(alive, 0, count * sizeof(bool));
+    for (int i = 0; i < cpu->aliveCount; i++)
+    {
+        GLuint id = cpu->ids[i];
+        if (id < (GLuint)count)
+        {
+            positions[id][0] = cpu->posX[i];
+            positions[id][1] = cpu->posY[i];
+            positions[id][2] = cpu->posZ[i];
+            positions[id][3] = cpu->life[i];
+            alive[id] = true;
+        }
+    }
+}
+
+void particlesCpu_delete(ParticlesCpu* cpu)
+{
+    if (cpu == NULL)
+    {
+        return;
+    }
+
+    glDeleteVertexArrays(1, &cpu->vao);
+    particlesCpu_free(cpu);
+}
+
+bool particlesCpu_checkParity(void)
+{
+    ParticlesCpu* simd = particlesCpu_allocate(PARTICLESCPU_PARITY_COUNT);
+    if (!simd->useAvx2)
+    {
+        printf("Partikel-Paritaet AVX2/skalar: uebersprungen, AVX2 nicht verfuegbar\n");
+        particlesCpu_free(simd);
+        return true;
+    }
+
+    ParticlesCpu* scalar = particlesCpu_allocate(PARTICLESCPU_PARITY_COUNT);
+    scalar->useAvx2 = false;
+
+    // Beide Simulationen erhalten die gleichen zufälligen Partikel. Die
+    // Lebenszeiten sind so verteilt, dass während des Vergleichs laufend
+    // Partikel sterben und die Kompaktierung mitgeprüft wird.
+    for (int i = 0; i < PARTICLESCPU_PARITY_COUNT; i++)
+    {
+        simd->posX[i] = ((float)rand() / (float)RAND_MAX - 0.5f) * 10.0f;
+        simd->posY[i] = (float)rand() / (float)RAND_MAX * 10.0f;
+        simd->posZ[i] = ((float)rand() / (float)RAND_MAX - 0.5f) * 10.0f;
+        simd->velX[i] = ((float)rand() / (float)RAND_MAX - 0.5f) * 4.0f;
+        simd->velY[i] = (float)rand() / (float)RAND_MAX * 4.0f;
+        simd->velZ[i] = ((float)rand() / (float)RAND_MAX - 0.5f) * 4.0f;
+        simd->life[i] = PARTICLESCPU_PARITY_DT * ((float)(rand() % (2 * PARTICLESCPU_PARITY_STEPS)) + 0.5f);
+        simd->emitterIds[i] = 0;
+        simd->ids[i] = i;
+    }
+    simd->aliveCount = PARTICLESCPU_PARITY_COUNT;
+    memcpy(scalar->posX, simd->posX, PARTICLESCPU_PARITY_COUNT * sizeof(float));
+    memcpy(scalar->posY, simd->posY, PARTICLESCPU_PARITY_COUNT * sizeof(float));
+    memcpy(scalar->posZ, simd->posZ, PARTICLESCPU_PARITY_COUNT * sizeof(float));
+    memcpy(scalar->velX, simd->velX, PARTICLESCPU_PARITY_COUNT * sizeof(float));
+    memcpy(scalar->velY, simd->velY, PARTICLESCPU_PARITY_COUNT * sizeof(float));
+    memcpy(scalar->velZ, simd->velZ, PARTICLESCPU_PARITY_COUNT * sizeof(float));
+    memcpy(scalar->life, simd->life, PARTICLESCPU_PARITY_COUNT * sizeof(float));
+    memcpy(scalar->emitterIds, simd->emitterIds, PARTICLESCPU_PARITY_COUNT * sizeof(GLuint));
+    memcpy(scalar->ids, simd->ids, PARTICLESCPU_PARITY_COUNT * sizeof(GLuint));
+    scalar->aliveCount = PARTICLESCPU_PARITY_COUNT;
+
+    ParticlesCpuParams params;
+    memset(&params, 0, sizeof(ParticlesCpuParams));
+    params.dt = PARTICLESCPU_PARITY_DT;
+    params.gravity[1] = -9.81f;
+
+    // Beide Pfade rechnen die gleichen Operationen in gleicher Reihenfolge.
+    // Lebenszustand und Reihenfolge nach der Kompaktierung müssen daher
+    // exakt übereinstimmen.
+    bool ok = true;
+    int step = 0;
+    for (; step < PARTICLESCPU_PARITY_STEPS && ok; step++)
+    {
+        particlesCpu_update(simd, &params);
+        particlesCpu_update(scalar, &params);
+
+        ok = simd->aliveCount == scalar->aliveCount;
+        for (int i = 0; ok && i < simd->aliveCount; i++)
+        {
+            ok = simd->ids[i] == scalar->ids[i] && simd->life[i] == scalar->life[i]
+                 && particlesCpu_parityEqual(simd->posX[i], scalar->posX[i])
+                 && particlesCpu_parityEqual(simd->posY[i], scalar->posY[i])
+                 && particlesCpu_parityEqual(simd->posZ[i], scalar->posZ[i])
+                 && particlesCpu_parityEqual(simd->velX[i], scalar->velX[i])
+                 && particlesCpu_parityEqual(simd->velY[i], scalar->velY[i])
+                 && particlesCpu_parityEqual(simd->velZ[i], scalar->velZ[i]);
+        }
+    }
+
+    printf("Partikel-Paritaet AVX2/skalar (%d Partikel, %d Schritte): %s\n",
+           PARTICLESCPU_PARITY_COUNT, PARTICLESCPU_PARITY_STEPS, ok ? "OK" : "FEHLER");
+    if (!ok)
+    {
+        printf("  Erste Abweichung in Schritt %d\n", step);
+    }
+
+    particlesCpu_free(simd);
+    particlesCpu_free(scalar);
+    return ok;
+}
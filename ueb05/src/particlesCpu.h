@@ -0,0 +1,162 @@
+/**
+ * Modul für die Partikelsimulation auf der CPU.
+ * Wird verwendet, wenn keine Compute Shader zur Verfügung stehen. Die
+ * Simulation bildet die Compute Shader der GPU-Simulation nach. Die
+ * Partikel liegen als Structure of Arrays vor, werden mit AVX2 je acht
+ * Partikel auf einmal berechnet und auf mehrere Threads verteilt. Die
+ * Ergebnisse werden beim Zeichnen in den Stream Buffer des Renderings
+ * geschrieben.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef PARTICLESCPU_H
+#define PARTICLESCPU_H
+
+#include "common.h"
+#include "streamBuffer.h"
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Datenstruktur für die CPU-Partikelsimulation.
+struct ParticlesCpu;
+typedef struct ParticlesCpu ParticlesCpu;
+
+// Parameter eines Emitters. Die GPU-Simulation lädt sie in einen Shader
+// Storage Buffer, die CPU-Simulation liest sie direkt.
+// Achtung: Der Aufbau muss identisch mit Emitter in den Shadern sein (std430)!
+struct ParticleEmitterParams {
+    vec3 position;
+    float startSize;
+    vec3 direction;
+    float directionRand;
+    vec3 startColor;
+    float endSize;
+    vec3 endColor;
+    float textureLayer; //Ebene im Textur-Array
+    float lifeTime;
+    float lifeTimeRand;
+    GLuint emitOffset; //Erster Aufruf der Emission für diesen Emitter
+    GLuint emitCount; //Anzahl neuer Partikel in diesem Frame
+    float softness; //Tiefenbereich des weichen Ausblendens
+    GLuint alphaBlend; //Partikel werden sortiert und mit Alpha überblendet
+    float padding[2];
+};
+typedef struct ParticleEmitterParams ParticleEmitterParams;
+
+// Parameter eines Simulationsschritts, entsprechen den Uniforms der
+// Compute Shader. Jeder Emitter erzeugt emitCount neue Partikel. Die Kamera
+// wird nur beim Zeichnen für die Tiefensortierung benötigt.
+struct ParticlesCpuParams
+{
+    float dt;
+    vec3 gravity;
+    float seed;
+    const ParticleEmitterParams* emitters;
+    int emitterCount;
+    vec3 camPos;
+    vec3 camFront;
+};
+typedef struct ParticlesCpuParams ParticlesCpuParams;
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Erstellt eine neue, leere CPU-Partikelsimulation.
+ *
+ * @param capacity die maximale Anzahl an Partikeln
+ * @return die neue Simulation
+ */
+ParticlesCpu* particlesCpu_create(int capacity);
+
+/**
+ * Liefert die maximale Anzahl an Partikeln.
+ *
+ * @param cpu die Simulation
+ * @return die Kapazität
+ */
+int particlesCpu_getCapacity(ParticlesCpu* cpu);
+
+/**
+ * Liefert die Anzahl der lebenden Partikel.
+ *
+ * @param cpu die Simulation
+ * @return die Anzahl der lebenden Partikel
+ */
+int particlesCpu_getAliveCount(ParticlesCpu* cpu);
+
+/**
+ * Führt einen Simulationsschritt aus: Emission, Simulation aller lebenden
+ * Partikel und Entfernen der gestorbenen Partikel.
+ *
+ * @param cpu die Simulation
+ * @param params die Parameter des Schritts
+ */
+void particlesCpu_update(ParticlesCpu* cpu, const ParticlesCpuParams* params);
+
+/**
+ * Schreibt alle lebenden Partikel in den Stream Buffer und zeichnet sie
+ * als Punkte. Farbe, Größe und Texturebene werden dabei aus dem Emitter
+ * jedes Partikels bestimmt. Partikel mit Alpha-Blending werden von hinten
+ * nach vorne sortiert und zuerst gezeichnet, die additiven unsortiert
+ * darüber. Die Blend-Funktion wird je Bereich gesetzt, der passende Shader
+ * muss bereits aktiviert sein.
+ *
+ * @param cpu die Simulation
+ * @param stream der Stream Buffer des aktuellen Frames
+ * @param params Emitter (mindestens einer) und Kamera des Frames
+ */
+void particlesCpu_draw(ParticlesCpu* cpu, StreamBuffer* stream, const ParticlesCpuParams* params);
+
+/**
+ * Entfernt alle Partikel.
+ *
+ * @param cpu die Simulation
+ */
+void particlesCpu_clear(ParticlesCpu* cpu);
+
+/**
+ * Ersetzt alle Partikel durch die übergebenen. Das Partikel an Stelle i
+ * erhält dabei die Kennung i. Wird für den Vergleich mit der GPU-Simulation
+ * benötigt.
+ *
+ * @param cpu die Simulation
+ * @param positions Positionen, w enthält die Restlebenszeit
+ * @param velocities Geschwindigkeiten, w enthält den Emitter
+ * @param count Anzahl der Partikel
+ */
+void particlesCpu_setParticles(ParticlesCpu* cpu, const vec4* positions,
+                               const vec4* velocities, int count);
+
+/**
+ * Liest die Partikel sortiert nach ihrer Kennung aus. Gegenstück zu
+ * particlesCpu_setParticles.
+ *
+ * @param cpu die Simulation
+ * @param positions Ziel für die Positionen, w enthält die Restlebenszeit
+ * @param alive Ziel für den Lebenszustand
+ * @param count Anzahl der Partikel
+ */
+void particlesCpu_readParticles(ParticlesCpu* cpu, vec4* positions,
+                                bool* alive, int count);
+
+/**
+ * Löscht eine CPU-Partikelsimulation.
+ *
+ * @param cpu die zu löschende Simulation
+ */
+void particlesCpu_delete(ParticlesCpu* cpu);
+
+/**
+ * Vergleicht den AVX2-Pfad der Simulation mit dem skalaren Pfad. Beide
+ * simulieren die gleichen zufälligen Partikel, Lebenszustand und
+ * Reihenfolge müssen danach exakt, Positionen und Geschwindigkeiten bis auf
+ * Rundung übereinstimmen. Das Ergebnis wird auf der Konsole ausgegeben. Benötigt
+ * keinen OpenGL Kontext.
+ *
+ * @return true, wenn beide Pfade übereinstimmen oder AVX2 nicht verfügbar ist
+ */
+bool particlesCpu_checkParity(void);
+
+#endif // PARTICLESCPU_H
@@ -1,5 +1,59 @@
 #include "postProcessing.h"
 
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// Anzahl der Durchläufe pro Verfahren im Blur-Benchmark.
+#define BLUR_BENCHMARK_RUNS 50
+
+// Aufbau des Uniform Buffers mit den Blur-Gewichten (std140).
+struct BlurWeights
+{
+    GLint radius;
+    GLint padding[3];
+    GLfloat weights[(BLUR_MAX_RADIUS + 4) / 4 * 4];
+};
+typedef struct BlurWeights BlurWeights;
+
+/**
+ * Berechnet die Gauss-Gewichte fuer einen Radius und laedt sie in den
+ * Uniform Buffer. Die Gewichte werden nur neu berechnet, wenn sich der
+ * Radius geaendert hat.
+ * 
+ * @param data Renderingdaten
+ * @param radius der Radius des Blurs in Pixeln
+ */
+static void postProcessing_updateBlurWeights(RenderingData *data, int radius)
+{
+    if (radius == data->blurWeightsRadius)
+    {
+        return;
+    }
+
+    BlurWeights weights;
+    memset(&weights, 0, sizeof(BlurWeights));
+    weights.radius = radius;
+
+    //Sigma so waehlen, dass der Radius etwa drei Standardabweichungen umfasst
+    float sigma = fmaxf((float)radius / 3.0f, 0.5f);
+    float sum = 0.0f;
+    for (int i = 0; i <= radius; i++)
+    {
+        weights.weights[i] = expf(-(float)(i * i) / (2.0f * sigma * sigma));
+        sum += i == 0 ? weights.weights[i] : 2.0f * weights.weights[i];
+    }
+    for (int i = 0; i <= radius; i++)
+    {
+        weights.weights[i] /= sum;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, data->blurWeightsUbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(BlurWeights), &weights);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    data->blurWeightsRadius = radius;
+}
+
 /**
  * Extrahiert die hellen Bereiche im Bild
  * 
@@ -33,11 +87,12 @@ void postProcessing_extractBrightColors(ProgContext *ctx)
 }
 
 /**
- * Fuehrt einen Blur-PostFX anhand des PingPong Systems durch
+ * Fuehrt einen Blur-PostFX mit dem Fragment-Shader ueber das PingPong
+ * System durch
  * 
  * @param ctx Programmkontext
  */
-void postProcessing_blur(ProgContext *ctx)
+static void postProcessing_blurFragment(ProgContext *ctx)
 {
     // ---------------------- Blur - SHADER ---------------------------------- //
     RenderingData *data = ctx->rendering;
@@ -62,10 +117,211 @@ void postProcessing_blur(ProgContext *ctx)
         if (first_iteration)
             first_iteration = false;
     }
+
+    //Nach einer geraden Anzahl an Durchlaeufen liegt das Ergebnis in Buffer 0
+    data->bloomResult = data->pingPong.buffer[0];
+}
+
+/**
+ * Fuehrt einen Blur-PostFX mit dem Compute-Shader durch. Es wird ein
+ * horizontaler und ein vertikaler Durchlauf mit beliebigem Radius
+ * ausgefuehrt, ohne den PingPong-Framebuffer zu binden.
+ * 
+ * @param ctx Programmkontext
+ */
+static void postProcessing_blurCompute(ProgContext *ctx)
+{
+    // ---------------------- Blur - COMPUTE ---------------------------------- //
+    RenderingData *data = ctx->rendering;
+    int width = ctx->winData->width;
+    int height = ctx->winData->height;
+
+    postProcessing_updateBlurWeights(data, ctx->input->postProcessing.blurRadius);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, data->blurWeightsUbo);
+
+    shader_useShader(data->blurCompute);
+    shader_setInt(data->blurCompute, "srcTex", 10);
+    glActiveTexture(GL_TEXTURE10);
+
+    //Horizontal: Brightness -> Buffer 1
+    shader_setBool(data->blurCompute, "horizontal", true);
+    glBindTexture(GL_TEXTURE_2D, data->fb.textures[GBUFFER_COLORATTACH_BRIGHTNESS]);
+    glBindImageTexture(0, data->pingPong.buffer[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glDispatchCompute((width + BLUR_TILE_SIZE - 1) / BLUR_TILE_SIZE, height, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    //Vertikal: Buffer 1 -> Buffer 0
+    shader_setBool(data->blurCompute, "horizontal", false);
+    glBindTexture(GL_TEXTURE_2D, data->pingPong.buffer[1]);
+    glBindImageTexture(0, data->pingPong.buffer[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glDispatchCompute((height + BLUR_TILE_SIZE - 1) / BLUR_TILE_SIZE, width, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    data->bloomResult = data->pingPong.buffer[0];
+}
+
+/**
+ * Fuehrt einen Blur-PostFX durch. Abhaengig von der Einstellung wird der
+ * Fragment-Shader oder der Compute-Shader verwendet.
+ * 
+ * @param ctx Programmkontext
+ */
+void postProcessing_blur(ProgContext *ctx)
+{
+    if (ctx->input->postProcessing.bloomMode == BLOOM_MODE_GAUSSIAN_COMPUTE
+        && ctx->rendering->blurCompute)
+    {
+        postProcessing_blurCompute(ctx);
+    }
+    else if (ctx->rendering->blur)
+    {
+        postProcessing_blurFragment(ctx);
+    }
 }
 
 /**
- * Finale Render Stage der Szene
+ * Berechnet den Bloom-Effekt ueber eine Downsample/Upsample-Kette.
+ * Das Bild wird schrittweise auf 1/2, 1/4 und 1/8 der Aufloesung
+ * verkleinert und anschliessend wieder vergroessert, wobei jede Stufe
+ * additiv auf die naechstgroessere geblendet wird. Der Threshhold wird in
+ * der ersten Downsample-Stufe direkt auf dem Final- und Emission-Attachment
+ * berechnet, ein vorheriger Threshhold-Pass ist nicht noetig.
+ * 
+ * @param ctx Programmkontext
+ */
+void postProcessing_bloomChain(ProgContext *ctx)
+{
+    // ---------------------- Bloom - SHADER ---------------------------------- //
+    RenderingData *data = ctx->rendering;
+    InputData *input = ctx->input;
+    BloomChain *chain = &data->bloomChain;
+
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glBindFramebuffer(GL_FRAMEBUFFER, chain->fbo);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glActiveTexture(GL_TEXTURE10);
+
+    //Downsample: Die erste Stufe liest aus dem Final- und Emission-Attachment
+    //und berechnet dabei den Threshhold
+    shader_useShader(data->bloomDownsample);
+    shader_setInt(data->bloomDownsample, "srcTexture", 10);
+    shader_setInt(data->bloomDownsample, "finalTex", 11);
+    shader_setInt(data->bloomDownsample, "emissionTex", 12);
+    shader_setFloat(data->bloomDownsample, "colorWeight", input->postProcessing.colorWeight);
+    shader_setFloat(data->bloomDownsample, "emissionWeight", input->postProcessing.emissionWeight);
+    shader_setFloat(data->bloomDownsample, "threshholdValue", input->postProcessing.threshhold);
+    glActiveTexture(GL_TEXTURE11);
+    glBindTexture(GL_TEXTURE_2D, data->fb.textures[GBUFFER_COLORATTACH_FINAL]);
+    glActiveTexture(GL_TEXTURE12);
+    glBindTexture(GL_TEXTURE_2D, data->fb.textures[GBUFFER_COLORATTACH_EMISSION]);
+    glActiveTexture(GL_TEXTURE10);
+    for (int i = 0; i < BLOOM_MIP_COUNT; i++)
+    {
+        glViewport(0, 0, chain->widths[i], chain->heights[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, chain->mips[i], 0);
+        shader_setBool(data->bloomDownsample, "useKarisAverage", i == 0);
+        shader_setBool(data->bloomDownsample, "fuseThreshhold", i == 0);
+        mesh_drawMeshTris(data->displayQuad, data->bloomDownsample);
+
+        glBindTexture(GL_TEXTURE_2D, chain->mips[i]);
+    }
+
+    //Upsample: Jede Stufe wird additiv auf die naechstgroessere geblendet
+    shader_useShader(data->bloomUpsample);
+    shader_setInt(data->bloomUpsample, "srcTexture", 10);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glBlendEquation(GL_FUNC_ADD);
+    for (int i = BLOOM_MIP_COUNT - 1; i > 0; i--)
+    {
+        vec2 filterRadius = {
+            input->postProcessing.bloomFilterRadius / (float)chain->widths[i],
+            input->postProcessing.bloomFilterRadius / (float)chain->heights[i]};
+        shader_setVec2(data->bloomUpsample, "filterRadius", &filterRadius);
+
+        glBindTexture(GL_TEXTURE_2D, chain->mips[i]);
+        glViewport(0, 0, chain->widths[i - 1], chain->heights[i - 1]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, chain->mips[i - 1], 0);
+        mesh_drawMeshTris(data->displayQuad, data->bloomUpsample);
+    }
+    glDisable(GL_BLEND);
+
+    //Viewport wieder auf die volle Aufloesung setzen
+    glViewport(0, 0, ctx->winData->width, ctx->winData->height);
+
+    data->bloomResult = chain->mips[0];
+}
+
+/**
+ * Misst die GPU-Zeit aller Blur-Verfahren und gibt sie auf der Konsole aus.
+ * Jedes Verfahren wird mehrfach auf das aktuelle Brightness-Attachment
+ * angewendet. Da auf die Ergebnisse gewartet wird, ist diese Funktion nur
+ * fuer einmalige Messungen gedacht.
+ * 
+ * @param ctx Programmkontext
+ */
+void postProcessing_benchmarkBlur(ProgContext *ctx)
+{
+    RenderingData *data = ctx->rendering;
+    InputData *input = ctx->input;
+    BloomMode oldMode = input->postProcessing.bloomMode;
+
+    const char *names[BLOOM_NUM_MODES] = {"Fragment-Shader", "Compute-Shader", "Mip-Kette"};
+    bool available[BLOOM_NUM_MODES] = {data->blur != NULL, data->blurCompute != NULL,
+                                       data->bloomDownsample && data->bloomUpsample};
+    double times[BLOOM_NUM_MODES] = {0};
+
+    GLuint query;
+    glGenQueries(1, &query);
+
+    for (int mode = 0; mode < BLOOM_NUM_MODES; mode++)
+    {
+        if (!available[mode])
+        {
+            continue;
+        }
+        input->postProcessing.bloomMode = mode;
+
+        glFinish();
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (int i = 0; i < BLUR_BENCHMARK_RUNS; i++)
+        {
+            if (mode == BLOOM_MODE_MIPCHAIN)
+            {
+                postProcessing_bloomChain(ctx);
+            }
+            else
+            {
+                postProcessing_blur(ctx);
+            }
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+
+        //Auf das Ergebnis warten
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        times[mode] = (double)elapsed / 1000000.0 / BLUR_BENCHMARK_RUNS;
+    }
+
+    glDeleteQueries(1, &query);
+    input->postProcessing.bloomMode = oldMode;
+
+    printf("Blur-Benchmark (%dx%d, %d Durchlaeufe):\n",
+           ctx->winData->width, ctx->winData->height, BLUR_BENCHMARK_RUNS);
+    printf("  %-16s %8.3f ms (%d Iterationen)\n", names[BLOOM_MODE_GAUSSIAN],
+           times[BLOOM_MODE_GAUSSIAN], input->postProcessing.blurIterations);
+    printf("  %-16s %8.3f ms (Radius %d)\n", names[BLOOM_MODE_GAUSSIAN_COMPUTE],
+           times[BLOOM_MODE_GAUSSIAN_COMPUTE], input->postProcessing.blurRadius);
+    printf("  %-16s %8.3f ms (%d Stufen)\n", names[BLOOM_MODE_MIPCHAIN],
+           times[BLOOM_MODE_MIPCHAIN], BLOOM_MIP_COUNT);
+}
+
+/**
+ * Finale Render Stage der Szene. Tone Mapping und Gamma-Korrektur schreiben
+ * direkt in den Default-Framebuffer.
  * 
  * @param ctx Programmkontext
  */
@@ -75,10 +331,8 @@ void postProcessing_finalRender(ProgContext *ctx)
     RenderingData *data = ctx->rendering;
     InputData *input = ctx->input;
 
-    //GBuffer aktivieren
-    glBindFramebuffer(GL_FRAMEBUFFER, data->fb.fbo);
-    //Ergebnis ins Result Attachment schreiben
-    glDrawBuffer(data->fb.attachments[GBUFFER_COLORATTACH_RESULT]);
+    //Ergebnis direkt in den Default-Framebuffer schreiben
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     //PostProcessing Shader aktivieren
     shader_useShader(data->postProcessing);
@@ -5,9 +5,20 @@
 #include "rendering.h"
 #include "input.h"
 
+// Anzahl der Pixel, die eine Arbeitsgruppe des Compute-Blurs bearbeitet.
+// Muss mit TILE_SIZE in blurCompute.comp übereinstimmen.
+#define BLUR_TILE_SIZE 128
+// Maximaler Radius des Compute-Blurs. Muss mit MAX_RADIUS in
+// blurCompute.comp übereinstimmen.
+#define BLUR_MAX_RADIUS 32
+
 void postProcessing_extractBrightColors(ProgContext *ctx);
 
 void postProcessing_blur(ProgContext *ctx);
 
+void postProcessing_bloomChain(ProgContext *ctx);
+
+void postProcessing_benchmarkBlur(ProgContext *ctx);
+
 void postProcessing_finalRender(ProgContext *ctx);
 #endif //POSTPROCESSING_H
\ No newline at end of file
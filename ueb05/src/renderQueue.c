@@ -0,0 +1,410 @@
+/**
+ * Modul für das Sortieren von Drawcalls.
+ * Jeder Drawcall erhält einen 64 Bit Sortierschlüssel, der sich aus Pass,
+ * Shaderprogramm, Texturen, Material und Tiefe zusammensetzt. Nach dem
+ * Sortieren liegen Drawcalls mit gleichem Zustand direkt hintereinander,
+ * sodass Programm- und Materialwechsel nur noch bei Bedarf erfolgen.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "renderQueue.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "jobs.h"
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Aufbau des Sortierschlüssels (vom höchstwertigen Bit an):
+// | Pass (4) | Programm (12) | Texturen (16) | Material (16) | Tiefe (16) |
+// Texturen werden vor dem Material einsortiert, da Texturwechsel teurer sind
+// und sich Materialien über den Texturcache Texturen teilen können.
+#define RENDERQUEUE_SHIFT_PASS 60
+#define RENDERQUEUE_SHIFT_PROGRAM 48
+#define RENDERQUEUE_SHIFT_TEXTURES 32
+#define RENDERQUEUE_SHIFT_MATERIAL 16
+#define RENDERQUEUE_SHIFT_DEPTH 0
+
+#define RENDERQUEUE_MASK_PASS 0xFull
+#define RENDERQUEUE_MASK_PROGRAM 0xFFFull
+#define RENDERQUEUE_MASK_16 0xFFFFull
+
+// Startkapazität der Queue.
+#define RENDERQUEUE_INITIAL_CAPACITY 64
+
+// Anzahl der Bits, die pro Radix Sort Durchlauf sortiert werden.
+#define RENDERQUEUE_RADIX_BITS 8
+#define RENDERQUEUE_RADIX_SIZE (1 << RENDERQUEUE_RADIX_BITS)
+
+// Ab dieser Anzahl an Drawcalls wird über das Job-System sortiert.
+#define RENDERQUEUE_PARALLEL_MIN 8192
+
+// Maximale Anzahl an Abschnitten beim parallelen Sortieren.
+#define RENDERQUEUE_MAX_CHUNKS 16
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Ein einzelner Drawcall in der Queue.
+struct RenderItem
+{
+    uint64_t key;
+    Shader* shader;
+    Mesh* mesh;
+    int lod;
+    int instanceBase;
+    int instanceCount;
+    int command; // Indirekter Drawcall oder -1
+};
+typedef struct RenderItem RenderItem;
+
+// Datenstruktur für eine Liste von sortierbaren Drawcalls.
+struct RenderQueue
+{
+    RenderItem* items;
+    RenderItem* tmpItems; // Zwischenspeicher für den Radix Sort
+    unsigned int count;
+    unsigned int capacity;
+};
+
+// Abschnitt der Queue, der beim Sortieren von einem Job bearbeitet wird.
+struct RenderQueueChunk
+{
+    const RenderItem* src;
+    RenderItem* dst;
+    unsigned int begin;
+    unsigned int end;
+    unsigned int shift;
+    unsigned int histogram[RENDERQUEUE_RADIX_SIZE]; // Danach Zielpositionen
+};
+typedef struct RenderQueueChunk RenderQueueChunk;
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Faltet einen 32 Bit Wert auf 16 Bit zusammen.
+ *
+ * @param value der zu faltende Wert
+ * @return der gefaltete Wert
+ */
+static uint64_t renderQueue_fold16(unsigned int value)
+{
+    return (uint64_t)((value ^ (value >> 16)) & RENDERQUEUE_MASK_16);
+}
+
+/**
+ * Baut den Sortierschlüssel für einen Drawcall zusammen.
+ *
+ * @param pass der Pass des Drawcalls
+ * @param shader der verwendete Shader
+ * @param mesh das zu zeichnende Mesh
+ * @param depth die normalisierte Tiefe
+ * @return der Sortierschlüssel
+ */
+static uint64_t renderQueue_buildKey(RenderPass pass, Shader* shader,
+                                     Mesh* mesh, float depth)
+{
+    Material* mat = mesh_getMaterial(mesh);
+    uint64_t quantDepth = (uint64_t)(glm_clamp(depth, 0.0f, 1.0f) * 65535.0f);
+
+    return (((uint64_t)pass & RENDERQUEUE_MASK_PASS) << RENDERQUEUE_SHIFT_PASS)
+        | (((uint64_t)shader_getId(shader) & RENDERQUEUE_MASK_PROGRAM)
+            << RENDERQUEUE_SHIFT_PROGRAM)
+        | (renderQueue_fold16(material_getTextureKey(mat))
+            << RENDERQUEUE_SHIFT_TEXTURES)
+        | (((uint64_t)material_getId(mat) & RENDERQUEUE_MASK_16)
+            << RENDERQUEUE_SHIFT_MATERIAL)
+        | (quantDepth << RENDERQUEUE_SHIFT_DEPTH);
+}
+
+/**
+ * Stellt sicher, dass die Queue mindestens die angegebene Anzahl an
+ * Drawcalls aufnehmen kann.
+ *
+ * @param queue die Queue
+ * @param capacity die benötigte Kapazität
+ * @return true, wenn genug Speicher vorhanden ist
+ */
+static bool renderQueue_reserve(RenderQueue* queue, unsigned int capacity)
+{
+    if (capacity <= queue->capacity)
+    {
+        return true;
+    }
+
+    unsigned int newCapacity = queue->capacity * 2;
+    if (newCapacity < capacity)
+    {
+        newCapacity = capacity;
+    }
+
+    // Der Zwischenspeicher muss nicht erhalten bleiben, der alte wird aber
+    // erst freigegeben, wenn beide Buffer die neue Größe haben. Schlägt eine
+    // Anforderung fehl, bleibt die Queue mit der alten Kapazität gültig.
+    RenderItem* tmpItems = malloc(newCapacity * sizeof(RenderItem));
+    if (tmpItems == NULL)
+    {
+        fprintf(stderr, "Error: Could not grow render queue!\n");
+        return false;
+    }
+
+    RenderItem* items = realloc(queue->items, newCapacity * sizeof(RenderItem));
+    if (items == NULL)
+    {
+        fprintf(stderr, "Error: Could not grow render queue!\n");
+        free(tmpItems);
+        return false;
+    }
+
+    free(queue->tmpItems);
+    queue->items = items;
+    queue->tmpItems = tmpItems;
+    queue->capacity = newCapacity;
+    return true;
+}
+
+/**
+ * Zählt die Häufigkeit jedes Bytes im Abschnitt.
+ *
+ * @param arg der Abschnitt
+ */
+static void renderQueue_histogramJob(void* arg)
+{
+    RenderQueueChunk* chunk = arg;
+    memset(chunk->histogram, 0, sizeof(chunk->histogram));
+
+    for (unsigned int i = chunk->begin; i < chunk->end; i++)
+    {
+        chunk->histogram[(chunk->src[i].key >> chunk->shift)
+                         & (RENDERQUEUE_RADIX_SIZE - 1)]++;
+    }
+}
+
+/**
+ * Verteilt die Drawcalls des Abschnitts an ihre Zielpositionen.
+ *
+ * @param arg der Abschnitt
+ */
+static void renderQueue_scatterJob(void* arg)
+{
+    RenderQueueChunk* chunk = arg;
+
+    for (unsigned int i = chunk->begin; i < chunk->end; i++)
+    {
+        chunk->dst[chunk->histogram[(chunk->src[i].key >> chunk->shift)
+                                    & (RENDERQUEUE_RADIX_SIZE - 1)]++] = chunk->src[i];
+    }
+}
+
+/**
+ * Führt eine Funktion für alle Abschnitte aus, die Abschnitte ab dem
+ * zweiten über das Job-System.
+ *
+ * @param chunks die Abschnitte
+ * @param chunkCount die Anzahl der Abschnitte
+ * @param func die auszuführende Funktion
+ */
+static void renderQueue_runChunks(RenderQueueChunk* chunks, int chunkCount,
+                                  JobFunction func)
+{
+    JobCounter counter;
+    jobs_initCounter(&counter);
+    for (int c = 1; c < chunkCount; c++)
+    {
+        jobs_run(&counter, func, &chunks[c]);
+    }
+    func(&chunks[0]);
+    jobs_wait(&counter);
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+RenderQueue* renderQueue_createQueue(void)
+{
+    RenderQueue* queue = malloc(sizeof(RenderQueue));
+    memset(queue, 0, sizeof(RenderQueue));
+
+    queue->items = malloc(RENDERQUEUE_INITIAL_CAPACITY * sizeof(RenderItem));
+    queue->tmpItems = malloc(RENDERQUEUE_INITIAL_CAPACITY * sizeof(RenderItem));
+    queue->capacity = RENDERQUEUE_INITIAL_CAPACITY;
+
+    return queue;
+}
+
+void renderQueue_clear(RenderQueue* queue)
+{
+    queue->count = 0;
+}
+
+void renderQueue_push(RenderQueue* queue, RenderPass pass, Shader* shader,
+                      Mesh* mesh, float depth, int lod, int instanceBase,
+                      int instanceCount, int command)
+{
+    if (mesh == NULL || instanceCount <= 0
+        || !renderQueue_reserve(queue, queue->count + 1))
+    {
+        return;
+    }
+
+    RenderItem* item = &queue->items[queue->count++];
+    item->key = renderQueue_buildKey(pass, shader, mesh, depth);
+    item->shader = shader;
+    item->mesh = mesh;
+    item->lod = lod;
+    item->instanceBase = instanceBase;
+    item->instanceCount = instanceCount;
+    item->command = command;
+}
+
+void renderQueue_sort(RenderQueue* queue)
+{
+    // LSD Radix Sort: Pro Durchlauf werden 8 Bit des Schlüssels stabil
+    // sortiert. Durchläufe, in denen alle Schlüssel das gleiche Byte
+    // besitzen, werden übersprungen. Große Queues werden in Abschnitte
+    // geteilt, deren Histogramme und Verteilung parallel laufen. Da die
+    // Zielpositionen in der Reihenfolge der Abschnitte vergeben werden,
+    // bleibt die Sortierung stabil.
+    unsigned int count = queue->count;
+    if (count < 2)
+    {
+        return;
+    }
+
+    int chunkCount = 1;
+    if (count >= RENDERQUEUE_PARALLEL_MIN)
+    {
+        chunkCount = jobs_getThreadCount();
+        if (chunkCount > RENDERQUEUE_MAX_CHUNKS)
+        {
+            chunkCount = RENDERQUEUE_MAX_CHUNKS;
+        }
+    }
+
+    RenderQueueChunk chunks[RENDERQUEUE_MAX_CHUNKS];
+    for (int c = 0; c < chunkCount; c++)
+    {
+        chunks[c].begin = (unsigned int)((uint64_t)count * c / chunkCount);
+        chunks[c].end = (unsigned int)((uint64_t)count * (c + 1) / chunkCount);
+    }
+
+    RenderItem* src = queue->items;
+    RenderItem* dst = queue->tmpItems;
+
+    for (unsigned int shift = 0; shift < 64; shift += RENDERQUEUE_RADIX_BITS)
+    {
+        for (int c = 0; c < chunkCount; c++)
+        {
+            chunks[c].src = src;
+            chunks[c].dst = dst;
+            chunks[c].shift = shift;
+        }
+        renderQueue_runChunks(chunks, chunkCount, renderQueue_histogramJob);
+
+        // Alle Schlüssel sind in diesem Byte gleich.
+        unsigned int firstByte = (src[0].key >> shift) & (RENDERQUEUE_RADIX_SIZE - 1);
+        unsigned int sameCount = 0;
+        for (int c = 0; c < chunkCount; c++)
+        {
+            sameCount += chunks[c].histogram[firstByte];
+        }
+        if (sameCount == count)
+        {
+            continue;
+        }
+
+        // Präfixsumme über alle Bytes und innerhalb eines Bytes über die
+        // Abschnitte bilden, um die Startpositionen zu bestimmen.
+        unsigned int offset = 0;
+        for (int b = 0; b < RENDERQUEUE_RADIX_SIZE; b++)
+        {
+            for (int c = 0; c < chunkCount; c++)
+            {
+                unsigned int n = chunks[c].histogram[b];
+                chunks[c].histogram[b] = offset;
+                offset += n;
+            }
+        }
+
+        renderQueue_runChunks(chunks, chunkCount, renderQueue_scatterJob);
+
+        RenderItem* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    // Das Ergebnis muss wieder im Hauptspeicher der Queue liegen.
+    if (src != queue->items)
+    {
+        queue->tmpItems = queue->items;
+        queue->items = src;
+    }
+}
+
+void renderQueue_draw(RenderQueue* queue, RenderPass pass,
+                      RenderQueueShaderSetup setup, void* userData)
+{
+    Shader* lastShader = NULL;
+    Material* lastMaterial = NULL;
+    int lastInstanceBase = -1;
+
+    for (unsigned int i = 0; i < queue->count; i++)
+    {
+        RenderItem* item = &queue->items[i];
+        if ((item->key >> RENDERQUEUE_SHIFT_PASS) != (uint64_t)pass)
+        {
+            continue;
+        }
+
+        // Programmwechsel: Uniforms des Passes neu setzen. Da die
+        // Materialuniforms pro Programm gespeichert werden, muss auch das
+        // Material erneut gesetzt werden.
+        if (item->shader != lastShader)
+        {
+            shader_useShader(item->shader);
+            if (setup != NULL)
+            {
+                setup(item->shader, userData);
+            }
+            lastShader = item->shader;
+            lastMaterial = NULL;
+            lastInstanceBase = -1;
+        }
+
+        // Materialwechsel nur, wenn sich das Material tatsächlich ändert.
+        Material* mat = mesh_getMaterial(item->mesh);
+        if (mat != lastMaterial)
+        {
+            material_useMaterial(item->shader, mat);
+            lastMaterial = mat;
+        }
+
+        if (item->instanceBase != lastInstanceBase)
+        {
+            shader_setInt(item->shader, "instanceBase", item->instanceBase);
+            lastInstanceBase = item->instanceBase;
+        }
+
+        if (item->command >= 0)
+        {
+            mesh_drawMeshGeometryIndirect(item->mesh, item->shader, item->command);
+        }
+        else
+        {
+            mesh_drawMeshGeometry(item->mesh, item->shader, item->lod, item->instanceCount);
+        }
+    }
+}
+
+void renderQueue_deleteQueue(RenderQueue* queue)
+{
+    if (queue == NULL)
+    {
+        return;
+    }
+
+    free(queue->items);
+    free(queue->tmpItems);
+    free(queue);
+}
@@ -0,0 +1,105 @@
+/**
+ * Modul für das Sortieren von Drawcalls.
+ * Jeder Drawcall erhält einen 64 Bit Sortierschlüssel, der sich aus Pass,
+ * Shaderprogramm, Texturen, Material und Tiefe zusammensetzt. Nach dem
+ * Sortieren liegen Drawcalls mit gleichem Zustand direkt hintereinander,
+ * sodass Programm- und Materialwechsel nur noch bei Bedarf erfolgen.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include "common.h"
+
+#include "shader.h"
+#include "mesh.h"
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Die Passes, für die Drawcalls gesammelt werden können.
+enum RenderPass
+{
+    RENDERQUEUE_PASS_DEPTH,
+    RENDERQUEUE_PASS_OPAQUE,
+    RENDERQUEUE_PASS_DEPTH_LATE,  // Erst nach dem Occlusion Culling sichtbar
+    RENDERQUEUE_PASS_OPAQUE_LATE,
+    RENDERQUEUE_NUM_PASSES
+};
+typedef enum RenderPass RenderPass;
+
+// Datenstruktur für eine Liste von sortierbaren Drawcalls.
+struct RenderQueue;
+typedef struct RenderQueue RenderQueue;
+
+// Callback, der aufgerufen wird, sobald ein neues Shaderprogramm aktiviert
+// wurde. Darüber können die passabhängigen Uniforms gesetzt werden.
+typedef void (*RenderQueueShaderSetup)(Shader* shader, void* userData);
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Erstellt eine neue, leere Render Queue.
+ *
+ * @return die neue Render Queue
+ */
+RenderQueue* renderQueue_createQueue(void);
+
+/**
+ * Entfernt alle Drawcalls aus der Queue. Der Speicher bleibt dabei für den
+ * nächsten Frame erhalten.
+ *
+ * @param queue die zu leerende Queue
+ */
+void renderQueue_clear(RenderQueue* queue);
+
+/**
+ * Fügt einen Drawcall in die Queue ein.
+ *
+ * @param queue die Queue
+ * @param pass der Pass, in dem das Mesh gezeichnet wird
+ * @param shader der zu verwendende Shader
+ * @param mesh das zu zeichnende Mesh
+ * @param depth die normalisierte Tiefe des Meshes (0 = nah, 1 = fern)
+ * @param lod die zu zeichnende Detailstufe des Meshes
+ * @param instanceBase erster Eintrag in der Liste der sichtbaren Instanzen
+ * @param instanceCount Anzahl der Instanzen
+ * @param command indirekter Drawcall mit der Instanzanzahl oder -1
+ */
+void renderQueue_push(RenderQueue* queue, RenderPass pass, Shader* shader,
+                      Mesh* mesh, float depth, int lod, int instanceBase,
+                      int instanceCount, int command);
+
+/**
+ * Sortiert alle Drawcalls der Queue anhand ihres Schlüssels.
+ * Dafür wird ein Radix Sort über die 64 Bit Schlüssel verwendet, der
+ * große Queues über das Job-System verteilt.
+ *
+ * @param queue die zu sortierende Queue
+ */
+void renderQueue_sort(RenderQueue* queue);
+
+/**
+ * Zeichnet alle Drawcalls eines Passes in sortierter Reihenfolge.
+ * Programme und Materialien werden nur gewechselt, wenn sie sich vom
+ * vorherigen Drawcall unterscheiden. Der erste Eintrag im Instanzbuffer
+ * wird über das Uniform instanceBase übergeben.
+ *
+ * @param queue die zuvor sortierte Queue
+ * @param pass der zu zeichnende Pass
+ * @param setup Callback für das Setzen der Uniforms eines neuen Programms
+ * @param userData Daten, die an den Callback übergeben werden
+ */
+void renderQueue_draw(RenderQueue* queue, RenderPass pass,
+                      RenderQueueShaderSetup setup, void* userData);
+
+/**
+ * Löscht eine Render Queue.
+ *
+ * @param queue die zu löschende Queue
+ */
+void renderQueue_deleteQueue(RenderQueue* queue);
+
+#endif // RENDERQUEUE_H
@@ -20,35 +20,207 @@
 #include "skybox.h"
 #include "shadowMapping.h"
 #include "particles.h"
+#include "instrumentation.h"
+#include "jobs.h"
 
 #define ROTATION_STEPS (3)
 #define M_PI_F 3.14159265358979323846f
+//Minimale Anzahl an Punktlichtern pro Job
+#define RENDERING_LIGHT_BATCH 16
+
+// Defines der Merkmale der Modell-Shader, Index entspricht dem Bit.
+// Die Hoehentextur des Materials wird von keinem Shader gelesen.
+static const char *const g_modelFeatures[RENDERING_MODEL_FEATURE_COUNT] = {
+    "MATERIAL_DIFFUSE_MAP", "MATERIAL_SPECULAR_MAP", "MATERIAL_NORMAL_MAP", NULL,
+    "MATERIAL_EMISSION_MAP", "MODEL_NORMAL_MAPPING", "MODEL_PARALLAX",
+    "MODEL_NO_TESSELLATION"};
+
+// Der Depth Pre-Pass braucht nur den Alpha-Test der Diffuse-Textur.
+static const char *const g_depthPrePassFeatures[RENDERING_MODEL_FEATURE_COUNT] = {
+    "MATERIAL_DIFFUSE_MAP", NULL, NULL, NULL, NULL, NULL, NULL,
+    "MODEL_NO_TESSELLATION"};
+
+// Defines der Merkmale der Licht-Shader, Index entspricht dem Bit.
+static const char *const g_dirLightFeatures[RENDERING_LIGHT_FEATURE_COUNT] = {
+    "LIGHT_SHADOWS", "LIGHT_PCF", "LIGHT_BILINEAR_FILTERING"};
+static const char *const g_pointLightFeatures[RENDERING_LIGHT_FEATURE_COUNT] = {
+    "LIGHT_SHADOWS", "LIGHT_PCF", NULL};
+
+// Ohne Tessellation entfallen Control- und Evaluation-Shader.
+static const ShaderStage g_modelStages[] = {
+    {GL_VERTEX_SHADER, UTILS_CONST_RES("shader/model/model.vert"), 0},
+    {GL_TESS_CONTROL_SHADER, UTILS_CONST_RES("shader/model/model.tesc"), MODEL_FEATURE_NO_TESSELLATION},
+    {GL_TESS_EVALUATION_SHADER, UTILS_CONST_RES("shader/model/model.tese"), MODEL_FEATURE_NO_TESSELLATION},
+    {GL_FRAGMENT_SHADER, UTILS_CONST_RES("shader/model/model.frag"), 0}};
+static const ShaderStage g_depthPrePassStages[] = {
+    {GL_VERTEX_SHADER, UTILS_CONST_RES("shader/model/model.vert"), 0},
+    {GL_TESS_CONTROL_SHADER, UTILS_CONST_RES("shader/model/model.tesc"), MODEL_FEATURE_NO_TESSELLATION},
+    {GL_TESS_EVALUATION_SHADER, UTILS_CONST_RES("shader/model/model.tese"), MODEL_FEATURE_NO_TESSELLATION},
+    {GL_FRAGMENT_SHADER, UTILS_CONST_RES("shader/depthPrePass/depthPrePass.frag"), 0}};
+static const ShaderStage g_dirLightStages[] = {
+    {GL_VERTEX_SHADER, UTILS_CONST_RES("shader/dirLight/dirLight.vert"), 0},
+    {GL_FRAGMENT_SHADER, UTILS_CONST_RES("shader/dirLight/dirLight.frag"), 0}};
+static const ShaderStage g_pointLightStages[] = {
+    {GL_VERTEX_SHADER, UTILS_CONST_RES("shader/pointLight/pointLight.vert"), 0},
+    {GL_FRAGMENT_SHADER, UTILS_CONST_RES("shader/pointLight/pointLight.frag"), 0}};
+
+#define RENDERING_STAGE_COUNT(stages) ((int)(sizeof(stages) / sizeof((stages)[0])))
 ////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
 GLuint g_depthMap;
 mat4 g_lightSpaceMat;
 mat4 g_pointLightProj;
-mat4 g_pointLightTransforms[6];
+
+// Auftrag fuer das Berechnen der Punktlicht-Matrizen
+struct RenderingLightJob
+{
+    RenderingData *data;
+    Scene *scene;
+    mat4 *viewProjMatrix;
+    bool shadows;
+};
+typedef struct RenderingLightJob RenderingLightJob;
 ////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
 
 /**
- * Rendert das Finale Bild mit allen Lichtberechnungen und PostFX-Effekten
+ * Berechnet die Matrizen eines Bereichs von Punktlichtern.
+ * 
+ * @param arg der Auftrag
+ * @param begin erstes Punktlicht
+ * @param end Ende des Bereichs
+ */
+static void rendering_lightMatricesJob(void *arg, int begin, int end)
+{
+    RenderingLightJob *job = arg;
+    for (int i = begin; i < end; i++)
+    {
+        PointLight *light = job->scene->pointLights[i];
+        deferredShader_calcLightVolumeMVP(light, *job->viewProjMatrix, job->data->lightMVPs[i]);
+        if (job->shadows)
+        {
+            shadowMapping_createPointLightTransforms(light, g_pointLightProj,
+                                                     &job->data->pointShadowTransforms[i * 6]);
+        }
+    }
+}
+
+/**
+ * Berechnet die Matrizen aller Punktlichter der Szene vorab ueber das
+ * Job-System, damit der Light-Pass nur noch zeichnen muss.
+ * 
+ * @param data Rendering-Daten
+ * @param scene die Szene
+ * @param viewProjMatrix View-Projection-Matrix der Szene
+ * @param shadows true, wenn auch die Schatten-Matrizen benoetigt werden
+ */
+static void rendering_computeLightMatrices(RenderingData *data, Scene *scene,
+                                           mat4 viewProjMatrix, bool shadows)
+{
+    int count = scene->countPointLights;
+    if (count > data->lightMatrixCapacity)
+    {
+        free(data->lightMVPs);
+        free(data->pointShadowTransforms);
+        data->lightMVPs = malloc(count * sizeof(mat4));
+        data->pointShadowTransforms = malloc(count * 6 * sizeof(mat4));
+        data->lightMatrixCapacity = count;
+    }
+
+    RenderingLightJob job = {data, scene, (mat4 *)viewProjMatrix, shadows};
+    jobs_parallelFor(count, RENDERING_LIGHT_BATCH, rendering_lightMatricesJob, &job);
+}
+
+/**
+ * Prueft, ob das Occlusion Culling eingeschaltet ist und seine Shader
+ * geladen wurden.
  * 
  * @param ctx Programmkontext
+ * @return true, wenn das Occlusion Culling verwendet wird
  */
-static void rendering_drawFinalTex(ProgContext *ctx)
+static bool rendering_useOcclusion(ProgContext *ctx)
 {
     RenderingData *data = ctx->rendering;
-    // Framebuffer binden: Lesen aus dem gBuffer-FBO, schreiben in das Default-FBO.
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, data->fb.fbo);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-    glClear(GL_COLOR_BUFFER_BIT);
-    // Es soll aus dem Final-Attachment gelesen werden.
-    glReadBuffer(data->fb.attachments[GBUFFER_COLORATTACH_RESULT]);
-    // Zum Schluss wird geblitted.
-    glBlitFramebuffer(
-        0, 0, ctx->winData->width, ctx->winData->height,
-        0, 0, ctx->winData->width, ctx->winData->height,
-        GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    return ctx->input->rendering.useOcclusionCulling
+        && data->hiz.build && data->hiz.cull && data->hiz.commands;
+}
+
+/**
+ * Bestimmt die sichtbaren Instanzen fuer Kamera und Schatten ueber die BVH
+ * der Szene und laedt alle Listen gemeinsam hoch. Die Kugeln der Punktlichter
+ * entsprechen der Far-Plane ihrer Schatten. Mit Occlusion Culling werden
+ * Kamera- und Schattenliste anschliessend gegen die Pyramiden des letzten
+ * Frames getestet und die Listen der fruehen Phase zurueckgegeben.
+ * 
+ * @param ctx Programmkontext
+ * @param scene die Szene
+ * @param viewProjMatrix View-Projection-Matrix der Kamera
+ * @param dirShadows true, wenn die Schatten des Richtungslichtes gerendert werden
+ * @param dirList Ausgabe fuer die Liste des Richtungslichtes
+ * @return die Liste der Kamera
+ */
+static int rendering_cullScene(ProgContext *ctx, Scene *scene, mat4 viewProjMatrix,
+                               bool dirShadows, int *dirList)
+{
+    RenderingData *data = ctx->rendering;
+    InputData *input = ctx->input;
+
+    scene_beginVisibility(scene);
+
+    int cameraList = input->rendering.useFrustumCulling
+        ? scene_cullFrustum(scene, viewProjMatrix)
+        : scene_cullAll(scene);
+
+    *dirList = dirShadows ? scene_cullFrustum(scene, g_lightSpaceMat) : -1;
+
+    if (input->lighting.pointLightActive && input->shadows.createPointLightShadows)
+    {
+        if (scene->countPointLights > data->pointShadowListCapacity)
+        {
+            free(data->pointShadowLists);
+            data->pointShadowLists = malloc(scene->countPointLights * sizeof(int));
+            data->pointShadowListCapacity = scene->countPointLights;
+        }
+        for (int i = 0; i < scene->countPointLights; i++)
+        {
+            data->pointShadowLists[i] = scene_cullSphere(scene, scene->pointLights[i]->position, 25.0f);
+        }
+    }
+
+    instrumentation_setValue(ctx, INSTRUMENTATION_VISIBLE_INSTANCES,
+                             (double)scene_getListCount(scene, cameraList));
+
+    // Kamera und gerichtetes Licht zeichnen nur, was die Pyramide durchlässt.
+    // Die Listen der GPU müssen vor dem Hochladen angelegt werden.
+    bool occlusion = rendering_useOcclusion(ctx);
+    if (occlusion)
+    {
+        cameraList = occlusion_prepare(data->cameraOcclusion, scene, cameraList, 0);
+        if (dirShadows)
+        {
+            *dirList = occlusion_prepare(data->shadowOcclusion, scene, *dirList,
+                                         data->shadowLodBias);
+        }
+    }
+
+    scene_uploadVisibility(scene);
+
+    if (occlusion)
+    {
+        occlusion_cullEarly(data->cameraOcclusion, scene, &data->hiz);
+        if (dirShadows)
+        {
+            occlusion_cullEarly(data->shadowOcclusion, scene, &data->hiz);
+        }
+
+        //Die Zaehler stammen aus einem der letzten Frames
+        OcclusionStats stats;
+        occlusion_getStats(data->cameraOcclusion, &stats);
+        instrumentation_setValue(ctx, INSTRUMENTATION_OCCLUDED_INSTANCES, (double)stats.occluded);
+        instrumentation_setValue(ctx, INSTRUMENTATION_LATE_INSTANCES, (double)stats.late);
+        occlusion_getStats(data->shadowOcclusion, &stats);
+        instrumentation_setValue(ctx, INSTRUMENTATION_OCCLUDED_SHADOW_INSTANCES, (double)stats.occluded);
+    }
+
+    return cameraList;
 }
 
 /**
@@ -108,20 +280,21 @@ static void rendering_drawDebugMode(ProgContext *ctx)
  */
 static void rendering_loadShaders(RenderingData *data)
 {
-    data->modelShader = shader_createVeCoEvFrShader(
-        UTILS_CONST_RES("shader/model/model.vert"),
-        UTILS_CONST_RES("shader/model/model.frag"),
-        UTILS_CONST_RES("shader/model/model.tesc"),
-        UTILS_CONST_RES("shader/model/model.tese"));
+    data->modelShader = shader_createPermutations(
+        "model", g_modelStages, RENDERING_STAGE_COUNT(g_modelStages),
+        g_modelFeatures, RENDERING_MODEL_FEATURE_COUNT);
+    data->depthPrePass = shader_createPermutations(
+        "depthPrePass", g_depthPrePassStages, RENDERING_STAGE_COUNT(g_depthPrePassStages),
+        g_depthPrePassFeatures, RENDERING_MODEL_FEATURE_COUNT);
     data->skyboxShader = shader_createVeFrShader(
         UTILS_CONST_RES("shader/skybox/skybox.vert"),
         UTILS_CONST_RES("shader/skybox/skybox.frag"));
-    data->dirLight = shader_createVeFrShader(
-        UTILS_CONST_RES("shader/dirLight/dirLight.vert"),
-        UTILS_CONST_RES("shader/dirLight/dirLight.frag"));
-    data->pointLight = shader_createVeFrShader(
-        UTILS_CONST_RES("shader/pointLight/pointLight.vert"),
-        UTILS_CONST_RES("shader/pointLight/pointLight.frag"));
+    data->dirLight = shader_createPermutations(
+        "dirLight", g_dirLightStages, RENDERING_STAGE_COUNT(g_dirLightStages),
+        g_dirLightFeatures, RENDERING_LIGHT_FEATURE_COUNT);
+    data->pointLight = shader_createPermutations(
+        "pointLight", g_pointLightStages, RENDERING_STAGE_COUNT(g_pointLightStages),
+        g_pointLightFeatures, RENDERING_LIGHT_FEATURE_COUNT);
     data->postProcessing = shader_createVeFrShader(
         UTILS_CONST_RES("shader/postProcessing/postProcessing.vert"),
         UTILS_CONST_RES("shader/postProcessing/postProcessing.frag"));
@@ -134,6 +307,14 @@ static void rendering_loadShaders(RenderingData *data)
     data->blur = shader_createVeFrShader(
         UTILS_CONST_RES("shader/blur/blur.vert"),
         UTILS_CONST_RES("shader/blur/blur.frag"));
+    data->blurCompute = shader_createCompShader(
+        UTILS_CONST_RES("shader/blurCompute/blurCompute.comp"));
+    data->bloomDownsample = shader_createVeFrShader(
+        UTILS_CONST_RES("shader/bloomDownsample/bloomDownsample.vert"),
+        UTILS_CONST_RES("shader/bloomDownsample/bloomDownsample.frag"));
+    data->bloomUpsample = shader_createVeFrShader(
+        UTILS_CONST_RES("shader/bloomUpsample/bloomUpsample.vert"),
+        UTILS_CONST_RES("shader/bloomUpsample/bloomUpsample.frag"));
     data->dirShadow = shader_createVeFrShader(
         UTILS_CONST_RES("shader/dirShadow/dirShadow.vert"),
         UTILS_CONST_RES("shader/dirShadow/dirShadow.frag"));
@@ -141,6 +322,12 @@ static void rendering_loadShaders(RenderingData *data)
         UTILS_CONST_RES("shader/pointShadow/pointShadow.vert"),
         UTILS_CONST_RES("shader/pointShadow/pointShadow.geom"),
         UTILS_CONST_RES("shader/pointShadow/pointShadow.frag"));
+    data->hiz.build = shader_createCompShader(
+        UTILS_CONST_RES("shader/hiz/hizBuild.comp"));
+    data->hiz.cull = shader_createCompShader(
+        UTILS_CONST_RES("shader/hiz/hizCull.comp"));
+    data->hiz.commands = shader_createCompShader(
+        UTILS_CONST_RES("shader/hiz/hizCommands.comp"));
 }
 
 void rendering_initWidthHeight(ProgContext *ctx)
@@ -165,24 +352,17 @@ void rendering_initWidthHeight(ProgContext *ctx)
 
 void rendering_reRenderShaders(ProgContext *ctx)
 {
-    Shader *tempModel = shader_createVeCoEvFrShader(
-        UTILS_CONST_RES("shader/model/model.vert"),
-        UTILS_CONST_RES("shader/model/model.frag"),
-        UTILS_CONST_RES("shader/model/model.tesc"),
-        UTILS_CONST_RES("shader/model/model.tese"));
+    // Die Permutationen ersetzen jede bereits gebaute Variante selbst nur
+    // dann, wenn der neue Code fehlerfrei uebersetzt werden konnte.
+    shader_reloadPermutations(ctx->rendering->modelShader);
+    shader_reloadPermutations(ctx->rendering->depthPrePass);
+    shader_reloadPermutations(ctx->rendering->dirLight);
+    shader_reloadPermutations(ctx->rendering->pointLight);
 
     Shader *tempSkyBox = shader_createVeFrShader(
         UTILS_CONST_RES("shader/skybox/skybox.vert"),
         UTILS_CONST_RES("shader/skybox/skybox.frag"));
 
-    Shader *tempDirLight = shader_createVeFrShader(
-        UTILS_CONST_RES("shader/dirLight/dirLight.vert"),
-        UTILS_CONST_RES("shader/dirLight/dirLight.frag"));
-
-    Shader *tempPointLight = shader_createVeFrShader(
-        UTILS_CONST_RES("shader/pointLight/pointLight.vert"),
-        UTILS_CONST_RES("shader/pointLight/pointLight.frag"));
-
     Shader *tempPostProcess = shader_createVeFrShader(
         UTILS_CONST_RES("shader/postProcessing/postProcessing.vert"),
         UTILS_CONST_RES("shader/postProcessing/postProcessing.frag"));
@@ -199,6 +379,17 @@ void rendering_reRenderShaders(ProgContext *ctx)
         UTILS_CONST_RES("shader/blur/blur.vert"),
         UTILS_CONST_RES("shader/blur/blur.frag"));
 
+    Shader *tempBlurCompute = shader_createCompShader(
+        UTILS_CONST_RES("shader/blurCompute/blurCompute.comp"));
+
+    Shader *tempBloomDownsample = shader_createVeFrShader(
+        UTILS_CONST_RES("shader/bloomDownsample/bloomDownsample.vert"),
+        UTILS_CONST_RES("shader/bloomDownsample/bloomDownsample.frag"));
+
+    Shader *tempBloomUpsample = shader_createVeFrShader(
+        UTILS_CONST_RES("shader/bloomUpsample/bloomUpsample.vert"),
+        UTILS_CONST_RES("shader/bloomUpsample/bloomUpsample.frag"));
+
     Shader *tempDirShadow = shader_createVeFrShader(
         UTILS_CONST_RES("shader/dirShadow/dirShadow.vert"),
         UTILS_CONST_RES("shader/dirShadow/dirShadow.frag"));
@@ -208,11 +399,14 @@ void rendering_reRenderShaders(ProgContext *ctx)
         UTILS_CONST_RES("shader/pointShadow/pointShadow.geom"),
         UTILS_CONST_RES("shader/pointShadow/pointShadow.frag"));
 
-    if (tempModel != NULL)
-    {
-        shader_deleteShader(ctx->rendering->modelShader);
-        ctx->rendering->modelShader = tempModel;
-    }
+    Shader *tempHizBuild = shader_createCompShader(
+        UTILS_CONST_RES("shader/hiz/hizBuild.comp"));
+
+    Shader *tempHizCull = shader_createCompShader(
+        UTILS_CONST_RES("shader/hiz/hizCull.comp"));
+
+    Shader *tempHizCommands = shader_createCompShader(
+        UTILS_CONST_RES("shader/hiz/hizCommands.comp"));
 
     if (tempSkyBox != NULL)
     {
@@ -220,18 +414,6 @@ void rendering_reRenderShaders(ProgContext *ctx)
         ctx->rendering->skyboxShader = tempSkyBox;
     }
 
-    if (tempDirLight != NULL)
-    {
-        shader_deleteShader(ctx->rendering->dirLight);
-        ctx->rendering->dirLight = tempDirLight;
-    }
-
-    if (tempPointLight != NULL)
-    {
-        shader_deleteShader(ctx->rendering->pointLight);
-        ctx->rendering->pointLight = tempPointLight;
-    }
-
     if (tempPostProcess != NULL)
     {
         shader_deleteShader(ctx->rendering->postProcessing);
@@ -256,6 +438,24 @@ void rendering_reRenderShaders(ProgContext *ctx)
         ctx->rendering->blur = tempBlur;
     }
 
+    if (tempBlurCompute != NULL)
+    {
+        shader_deleteShader(ctx->rendering->blurCompute);
+        ctx->rendering->blurCompute = tempBlurCompute;
+    }
+
+    if (tempBloomDownsample != NULL)
+    {
+        shader_deleteShader(ctx->rendering->bloomDownsample);
+        ctx->rendering->bloomDownsample = tempBloomDownsample;
+    }
+
+    if (tempBloomUpsample != NULL)
+    {
+        shader_deleteShader(ctx->rendering->bloomUpsample);
+        ctx->rendering->bloomUpsample = tempBloomUpsample;
+    }
+
     if (tempDirShadow != NULL)
     {
         shader_deleteShader(ctx->rendering->dirShadow);
@@ -267,6 +467,24 @@ void rendering_reRenderShaders(ProgContext *ctx)
         shader_deleteShader(ctx->rendering->pointShadow);
         ctx->rendering->pointShadow = tempPointShadow;
     }
+
+    if (tempHizBuild != NULL)
+    {
+        shader_deleteShader(ctx->rendering->hiz.build);
+        ctx->rendering->hiz.build = tempHizBuild;
+    }
+
+    if (tempHizCull != NULL)
+    {
+        shader_deleteShader(ctx->rendering->hiz.cull);
+        ctx->rendering->hiz.cull = tempHizCull;
+    }
+
+    if (tempHizCommands != NULL)
+    {
+        shader_deleteShader(ctx->rendering->hiz.commands);
+        ctx->rendering->hiz.commands = tempHizCommands;
+    }
 }
 
 void rendering_init(ProgContext *ctx)
@@ -298,12 +516,36 @@ void rendering_init(ProgContext *ctx)
     framebuffer_initPingPongBuffer(&data->pingPong,
                                    ctx->winData->width,
                                    ctx->winData->height);
+    framebuffer_initBloomChain(&data->bloomChain,
+                               ctx->winData->width,
+                               ctx->winData->height);
+    data->fbWidth = ctx->winData->width;
+    data->fbHeight = ctx->winData->height;
+
+    //Uniform Buffer fuer die Gewichte des Compute-Blurs anlegen
+    glGenBuffers(1, &data->blurWeightsUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, data->blurWeightsUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(GLint) * 4 + sizeof(GLfloat) * ((BLUR_MAX_RADIUS + 4) / 4 * 4),
+                 NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    data->blurWeightsRadius = -1;
+
     framebuffer_initDepthFBO(&data->depthFBO);
     framebuffer_initDepthCubeFBO(&data->depthCubeFBO, g_pointLightProj);
 
     //Erstellt ein ViewPort fuellendes Quad
     data->displayQuad = mesh_createQuad();
 
+    //Render Queue fuer die sortierten Drawcalls anlegen
+    data->renderQueue = renderQueue_createQueue();
+
+    //Ring fuer alle Daten, die jeden Frame neu hochgeladen werden
+    data->streamBuffer = streamBuffer_create(RENDERING_STREAM_BUFFER_SIZE);
+
+    //Pyramiden fuer das Occlusion Culling von Kamera und Richtungslicht
+    data->cameraOcclusion = occlusion_createOcclusion();
+    data->shadowOcclusion = occlusion_createOcclusion();
+
     //Laedt eine DepthMap
     g_depthMap = texture_loadTexture(UTILS_CONST_RES("textures/depthMap.dds"), GL_REPEAT, GL_FALSE);
 }
@@ -313,10 +555,16 @@ void rendering_draw(ProgContext *ctx)
     RenderingData *data = ctx->rendering;
     InputData *input = ctx->input;
     //Framebuffer anpassen, wenn Fenster skaliert wird
-    framebuffer_resizeFramebuffer(&data->pingPong,
-                                  &data->fb,
-                                  ctx->winData->width,
-                                  ctx->winData->height);
+    if (data->fbWidth != ctx->winData->width || data->fbHeight != ctx->winData->height)
+    {
+        framebuffer_resizeFramebuffer(&data->pingPong,
+                                      &data->fb,
+                                      &data->bloomChain,
+                                      ctx->winData->width,
+                                      ctx->winData->height);
+        data->fbWidth = ctx->winData->width;
+        data->fbHeight = ctx->winData->height;
+    }
 
     // Bildschirm leeren.
     glClearColor(
@@ -341,7 +589,7 @@ void rendering_draw(ProgContext *ctx)
     mat4 projectionMatrix;
     float aspect = (float)ctx->winData->width / (float)ctx->winData->height;
     float zoom = camera_getZoom(input->mainCamera);
-    glm_perspective(glm_rad(zoom), aspect, 0.1f, 200.0f, projectionMatrix);
+    glm_perspective(glm_rad(zoom), aspect, RENDERING_NEAR_PLANE, RENDERING_FAR_PLANE, projectionMatrix);
 
     // Dann die View-Matrix bestimmen.
     mat4 viewMatrix;
@@ -367,8 +615,45 @@ void rendering_draw(ProgContext *ctx)
         //Modell skalieren
         glm_scale_uni(objectMatrix, input->rendering.scale);
 
-        // Das Nutzermodell nur dann Rendern, wenn es existiert.
-        if (input->rendering.userScene->model)
+        //objectMatrix als Wurzel des Szenengraphen verwenden und nur die
+        //geaenderten Instanzmatrizen neu berechnen und hochladen
+        Scene *userScene = input->rendering.userScene;
+        scene_updateTransforms(userScene, objectMatrix);
+        scene_uploadInstances(userScene, data->streamBuffer);
+
+        //Detailstufen anhand des projizierten Fehlers waehlen. Ohne LODs
+        //wird immer das Original gezeichnet, auch fuer die Schatten.
+        float pixelsPerUnit = (float)data->fbHeight / (2.0f * tanf(glm_rad(zoom) * 0.5f));
+        scene_selectLods(userScene, *camera_getCameraPos(input->mainCamera), pixelsPerUnit,
+                         input->rendering.useLod ? input->rendering.lodPixelError : 0.0f);
+        data->shadowLodBias = input->rendering.useLod ? input->shadows.lodBias : 0;
+
+        //Sichtbare Instanzen fuer Kamera und Schatten ueber die BVH bestimmen
+        bool dirShadows = input->lighting.dirLightActive
+            && (input->shadows.createDirShadows || input->shadows.realtimeDirShadows);
+        if (dirShadows)
+        {
+            shadowMapping_createDirLightSpaceMat(g_lightSpaceMat, input->lighting.dirLight.direction);
+        }
+        int dirList;
+        int cameraList = rendering_cullScene(ctx, userScene, viewProjMatrix, dirShadows, &dirList);
+        bool occlusion = rendering_useOcclusion(ctx);
+
+        //Texturen der sichtbaren Modelle in der benoetigten Aufloesung
+        //nachladen und bei vollem Budget die unwichtigsten verdraengen
+        scene_requestTextures(userScene, cameraList, *camera_getCameraPos(input->mainCamera),
+                              pixelsPerUnit);
+        texture_updateStreaming((size_t)input->rendering.textureBudget * 1024 * 1024);
+
+        size_t textureResident, textureRequested;
+        texture_getStreamingStats(&textureResident, &textureRequested);
+        instrumentation_setValue(ctx, INSTRUMENTATION_TEXTURE_RESIDENT,
+                                 (double)textureResident / (1024.0 * 1024.0));
+        instrumentation_setValue(ctx, INSTRUMENTATION_TEXTURE_REQUESTED,
+                                 (double)textureRequested / (1024.0 * 1024.0));
+
+        // Die Nutzermodelle nur dann Rendern, wenn sie existieren.
+        if (userScene->countModels > 0)
         {
             //Daten fuer Displacement an Shader uebergeben
             glActiveTexture(GL_TEXTURE5);
@@ -377,31 +662,36 @@ void rendering_draw(ProgContext *ctx)
             if ((data->modelShader) && (data->null) && (data->pointLight) && (data->dirLight))
             {
                 /*------------------------- Geometry-PASS -------------------------*/
-                deferredShader_doGeometryPass(ctx, &objectMatrix, &projectionMatrix, &viewMatrix);
+                deferredShader_doGeometryPass(ctx, cameraList,
+                                              occlusion ? data->cameraOcclusion : NULL,
+                                              &projectionMatrix, &viewMatrix);
 
                 Scene *currScene = input->rendering.userScene;
                 if (input->lighting.pointLightActive)
                 {
+                    //Matrizen aller Punktlichter vorab parallel berechnen
+                    rendering_computeLightMatrices(data, currScene, viewProjMatrix,
+                                                   input->shadows.createPointLightShadows);
+
                     //Deferred Shading fuer alle Punktlichter in der Szene durchfuehren
                     for (int i = 0; i < currScene->countPointLights; i++)
                     {
                         //Aktuelle Punktlichtquelle
                         PointLight *currPtLight = currScene->pointLights[i];
                         //MVP-Matrix des aktuellen Light-Volumes
-                        mat4 lightMVP;
+                        mat4 *lightMVP = &data->lightMVPs[i];
 
                         //Schatten der Punktlichtquellen
                         if(input->shadows.createPointLightShadows)
                         {
-                            shadowMapping_createPointLightTransforms(currPtLight, g_pointLightProj, g_pointLightTransforms);
-                            shadowMapping_renderPointLightShadowMap(ctx, &objectMatrix, g_pointLightTransforms, currPtLight);
+                            shadowMapping_renderPointLightShadowMap(ctx, data->pointShadowLists[i], &data->pointShadowTransforms[i * 6], currPtLight);
                         }
                         /*------------------------- Stencil-PASS -------------------------*/
-                        deferredShader_doStencilPass(ctx, currPtLight, projectionMatrix, viewMatrix, &lightMVP);
+                        deferredShader_doStencilPass(ctx, lightMVP);
 
                         /*------------------------- Point-PASS -------------------------*/
                         deferredShader_activateTexturesLighting(data);
-                        deferredShader_doPointPass(ctx, &lightMVP, currPtLight);
+                        deferredShader_doPointPass(ctx, lightMVP, currPtLight);
                     }
                     
                     //Stencil-Testing deaktivieren
@@ -412,10 +702,11 @@ void rendering_draw(ProgContext *ctx)
                 if (input->lighting.dirLightActive)
                 {
                     //Schatten der Richtungslichtquelle
-                    if (input->shadows.createDirShadows || input->shadows.realtimeDirShadows)
+                    if (dirShadows)
                     {
-                        shadowMapping_createDirLightSpaceMat(g_lightSpaceMat, input->lighting.dirLight.direction);
-                        shadowMapping_renderDirLightShadowMap(ctx, &objectMatrix, &g_lightSpaceMat);
+                        shadowMapping_renderDirLightShadowMap(ctx, dirList,
+                                                          occlusion ? data->shadowOcclusion : NULL,
+                                                          &g_lightSpaceMat);
                     }
 
                     deferredShader_activateTexturesLighting(data);
@@ -425,35 +716,44 @@ void rendering_draw(ProgContext *ctx)
 
 
             /* ---------------------- Particle - SHADER ---------------------------------- */
+            instrumentation_beginQuery(ctx, INSTRUMENTATION_PARTICLE_TIME);
             if (!input->particles.pauseSim){
                 particles_update(ctx);
             }
             particles_draw(ctx, viewProjMatrix);
+            instrumentation_endQuery(ctx, INSTRUMENTATION_PARTICLE_TIME);
             
 
             /* ---------------------- Threshhold - SHADER ---------------------------------- */
-            if (data->threshhold)
+            if (data->threshhold && input->postProcessing.useBloom)
             {
-                deferredShader_activateTexturesThreshhold(data);
-                postProcessing_extractBrightColors(ctx);
-            }
-
-            /* ---------------------- Blur - SHADER ---------------------------------- */
+                instrumentation_beginQuery(ctx, INSTRUMENTATION_BLOOM_TIME);
 
-            if (data->blur)
-            {
-                postProcessing_blur(ctx);
-            }
+                /* ---------------------- Blur - SHADER ---------------------------------- */
+                if (input->postProcessing.bloomMode == BLOOM_MODE_MIPCHAIN)
+                {
+                    //Der Threshhold ist Teil der ersten Downsample-Stufe
+                    if (data->bloomDownsample && data->bloomUpsample)
+                    {
+                        postProcessing_bloomChain(ctx);
+                    }
+                }
+                else
+                {
+                    deferredShader_activateTexturesThreshhold(data);
+                    postProcessing_extractBrightColors(ctx);
+                    postProcessing_blur(ctx);
+                }
+                instrumentation_endQuery(ctx, INSTRUMENTATION_BLOOM_TIME);
 
-            /* ---------------------- Post-Process - SHADER ---------------------------------- */
-            if (data->postProcessing)
-            {
-                deferredShader_activateTexturesFinalRender(data);
-                postProcessing_finalRender(ctx);
+                //Benchmark auf Anfrage im Anschluss ausfuehren
+                if (input->postProcessing.runBlurBenchmark)
+                {
+                    postProcessing_benchmarkBlur(ctx);
+                    input->postProcessing.runBlurBenchmark = false;
+                }
             }
 
-            
-
             // Tiefentest nach der 3D Szene wieder deaktivieren.
             glDisable(GL_DEPTH_TEST);
 
@@ -465,10 +765,12 @@ void rendering_draw(ProgContext *ctx)
                 //Debug Modus rendern
                 rendering_drawDebugMode(ctx);
             }
-            else
+            /* ---------------------- Post-Process - SHADER ---------------------------------- */
+            else if (data->postProcessing)
             {
-                //Finales Bild mit SkyBox rendern
-                rendering_drawFinalTex(ctx);
+                //Finales Bild direkt in den Default-Framebuffer rendern
+                deferredShader_activateTexturesFinalRender(data);
+                postProcessing_finalRender(ctx);
             }
         }
     }
@@ -481,21 +783,37 @@ void rendering_cleanup(ProgContext *ctx)
     RenderingData *data = ctx->rendering;
 
     // Zum Schluss müssen noch die belegten Ressourcen freigegeben werden.
-    shader_deleteShader(data->modelShader);
+    shader_deletePermutations(data->modelShader);
+    shader_deletePermutations(data->depthPrePass);
     shader_deleteShader(data->skyboxShader);
-    shader_deleteShader(data->dirLight);
-    shader_deleteShader(data->pointLight);
+    shader_deletePermutations(data->dirLight);
+    shader_deletePermutations(data->pointLight);
     shader_deleteShader(data->null);
     shader_deleteShader(data->threshhold);
     shader_deleteShader(data->postProcessing);
     shader_deleteShader(data->blur);
+    shader_deleteShader(data->blurCompute);
+    shader_deleteShader(data->bloomDownsample);
+    shader_deleteShader(data->bloomUpsample);
     shader_deleteShader(data->dirShadow);
     shader_deleteShader(data->pointShadow);
+    shader_deleteShader(data->hiz.build);
+    shader_deleteShader(data->hiz.cull);
+    shader_deleteShader(data->hiz.commands);
     particles_cleanup(ctx);
     framebuffer_deleteFrameBuffer(&data->fb);
     framebuffer_deletePingPongBuffer(&data->pingPong);
+    framebuffer_deleteBloomChain(&data->bloomChain);
+    glDeleteBuffers(1, &data->blurWeightsUbo);
     framebuffer_deleteDepthFrameBuffer(&data->depthFBO);
     framebuffer_deleteDepthCubeFrameBuffer(&data->depthCubeFBO);
     skybox_deleteSkyBox(&data->skyBox);
+    renderQueue_deleteQueue(data->renderQueue);
+    streamBuffer_delete(data->streamBuffer);
+    occlusion_deleteOcclusion(data->cameraOcclusion);
+    occlusion_deleteOcclusion(data->shadowOcclusion);
+    free(data->lightMVPs);
+    free(data->pointShadowTransforms);
+    free(data->pointShadowLists);
     free(ctx->rendering);
 }
\ No newline at end of file
@@ -13,29 +13,90 @@
 #include "shader.h"
 #include "mesh.h"
 #include "skybox.h"
+#include "renderQueue.h"
+#include "occlusion.h"
+#include "material.h"
+#include "streamBuffer.h"
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Near und Far Plane der Kameraprojektion.
+#define RENDERING_NEAR_PLANE 0.1f
+#define RENDERING_FAR_PLANE 200.0f
+
+// Anzahl der Bits in den Merkmalsmasken der Modell- und Licht-Shader.
+#define RENDERING_MODEL_FEATURE_COUNT (MATERIAL_MAP_COUNT + 3)
+#define RENDERING_LIGHT_FEATURE_COUNT 3
+
+// Bindungspunkt des Uniform Blocks mit den Konstanten des Geometry-Passes,
+// muss mit res/shader/include/passUniforms.glsl uebereinstimmen.
+#define RENDERING_PASS_UNIFORM_BINDING 1
+
+// Anfangsgroesse des Stream Buffers fuer Daten, die sich jeden Frame aendern.
+#define RENDERING_STREAM_BUFFER_SIZE (4 * 1024 * 1024)
 
 //////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
 
+// Merkmale der Permutationen des Modell-Shaders und des Depth Pre-Pass.
+// Die unteren Bits belegen die Texturen des Materials (MaterialMap).
+enum ModelFeature
+{
+    MODEL_FEATURE_NORMAL_MAPPING = 1 << (MATERIAL_MAP_COUNT + 0),
+    MODEL_FEATURE_PARALLAX = 1 << (MATERIAL_MAP_COUNT + 1),
+    MODEL_FEATURE_NO_TESSELLATION = 1 << (MATERIAL_MAP_COUNT + 2)
+};
+typedef enum ModelFeature ModelFeature;
+
+// Merkmale der Permutationen der Licht-Shader.
+enum LightFeature
+{
+    LIGHT_FEATURE_SHADOWS = 1 << 0,
+    LIGHT_FEATURE_PCF = 1 << 1,
+    LIGHT_FEATURE_BILINEAR = 1 << 2
+};
+typedef enum LightFeature LightFeature;
+
 // Datentyp für alle persistenten Daten des Renderers.
 struct RenderingData
 {
     Framebuffer fb;
     PingPong pingPong;
+    BloomChain bloomChain;
+    GLuint bloomResult; // Textur mit dem Ergebnis des Bloom-Effekts
+    GLuint blurWeightsUbo;  // Gewichte des Compute-Blurs
+    int blurWeightsRadius;  // Radius, für den die Gewichte berechnet wurden
+    int fbWidth;        // Aktuelle Größe der Framebuffer
+    int fbHeight;
     depthFBO depthFBO;
     depthCubeFBO depthCubeFBO;
-    Shader *modelShader;
+    ShaderPermutations *modelShader;  // Permutationen über ModelFeature
+    ShaderPermutations *depthPrePass;
     Shader *skyboxShader;
     SkyBox skyBox;
-    Shader *dirLight;
-    Shader *pointLight;
+    ShaderPermutations *dirLight;     // Permutationen über LightFeature
+    ShaderPermutations *pointLight;
     Shader *postProcessing;
     Shader *null;
     Shader *threshhold;
     Shader *blur;
+    Shader *blurCompute;
+    Shader *bloomDownsample;
+    Shader *bloomUpsample;
     Shader *dirShadow;
     Shader *pointShadow;
     Shader *particles;
+    OcclusionShaders hiz;       // Compute-Shader des Occlusion Cullings
+    Occlusion *cameraOcclusion; // Pyramide der Kamera
+    Occlusion *shadowOcclusion; // Pyramide des gerichteten Lichts
     Mesh *displayQuad;
+    RenderQueue *renderQueue;
+    StreamBuffer *streamBuffer; // Ring fuer Konstanten, Instanzmatrizen und GUI
+    mat4 *lightMVPs;            // MVP-Matrizen der Light-Volumes pro Punktlicht
+    mat4 *pointShadowTransforms; // Je 6 Schatten-Matrizen pro Punktlicht
+    int lightMatrixCapacity;
+    int *pointShadowLists;      // Sichtbarkeitsliste der Schatten pro Punktlicht
+    int pointShadowListCapacity;
+    int shadowLodBias;          // Zusätzliche Detailstufen der Schatten im Frame
 };
 typedef struct RenderingData RenderingData;
 
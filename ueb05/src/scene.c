@@ -1,9 +1,10 @@
 /**
  * Modul für das Verarbeiten und Laden von 3D Szenen.
  * Eine Szene ist dabei ein serialisiertes Datenobjekt, das festlegt:
- * -> welche 3D Modelle angezeigt werden (nur eins zur Zeit)
+ * -> welche 3D Modelle angezeigt werden und wo sie platziert sind
  * -> welche Skybox verwendet werden soll (nicht implementiert)
  * -> welche Lichter (inklusiver Eigenschaften dieser) in der Szene sind
+ * -> welche Partikel-Emitter in der Szene sind
  * -> ggf. weitere Eigenschaften
  * 
  * Szenen werden dabei aus JSON Dateien geladen.
@@ -14,6 +15,7 @@
 
 #include "scene.h"
 
+#include <float.h>
 #include <string.h>
 #include <sesp/json.h>
 
@@ -25,7 +27,9 @@
 // Struktur, die beim Parsen der JSON Hilft.
 struct SceneParsingState {
     bool ok;
-    char* model;
+    int countModels;
+    char** models; // Relative Pfade der referenzierten Modelle
+    char* directory;
     Scene* scene;
 };
 typedef struct SceneParsingState SceneParsingState;
@@ -57,32 +61,45 @@ static void scene_parseSceneName(struct json_value_s* nameVal, Scene* scene)
 }
 
 /**
- * Diese Funktion ließt den Modellnamen aus der JSON Datei.
+ * Diese Funktion ließt einen Modellnamen aus der JSON Datei. Mehrfach
+ * referenzierte Modelle werden nur einmal eingetragen.
  * 
  * @param modelVal der JSON String mit dem Modellnamen
  * @param st der Parsing Status
- * @return true bei erfolg, false wenn der Eintrag korrupt war
+ * @return der Index des Modells oder -1 wenn der Eintrag korrupt war
  */
-static bool scene_parseModelName(struct json_value_s* modelVal, 
-                                 SceneParsingState* st)
+static int scene_parseModelName(struct json_value_s* modelVal, 
+                                SceneParsingState* st)
 {
     struct json_string_s* modelStr = json_value_as_string(modelVal);
-    if (modelStr)
-    {
-        printf("[JSON] Found scene model: %s\n", modelStr->string);
-        st->model = malloc(modelStr->string_size + 1);
-        memcpy(st->model, modelStr->string, modelStr->string_size + 1);
-    }
-    else
+    if (!modelStr)
     {
         fprintf(
             stderr, 
             "[JSON] Error: Modelname needs to be a string!\n"
         );
-        return false;
+        return -1;
     }
 
-    return true;
+    for (int i = 0; i < st->countModels; i++)
+    {
+        if (strcmp(st->models[i], modelStr->string) == 0)
+        {
+            return i;
+        }
+    }
+
+    printf("[JSON] Found scene model: %s\n", modelStr->string);
+    st->countModels++;
+    st->models = realloc(st->models, sizeof(char*) * st->countModels);
+    st->models[st->countModels - 1] = malloc(modelStr->string_size + 1);
+    memcpy(
+        st->models[st->countModels - 1], 
+        modelStr->string, 
+        modelStr->string_size + 1
+    );
+
+    return st->countModels - 1;
 }
 
 /**
@@ -139,6 +156,519 @@ static bool scene_parseVec3(struct json_value_s* v, const char* keys, vec3 out)
     return true;
 }
 
+/**
+ * Diese Funktion liest eine Zahl aus einer JSON Datei aus.
+ * 
+ * @param v der JSON Wert
+ * @param out die Ausgabe, bleibt bei einem Fehler unverändert
+ * @return true bei Erfolg, false wenn der Wert keine Zahl ist
+ */
+static bool scene_parseFloat(struct json_value_s* v, float* out)
+{
+    struct json_number_s* number = json_value_as_number(v);
+    if (!number)
+    {
+        fprintf(
+            stderr, 
+            "[JSON] Warning: Expected a number!\n"
+        );
+        return false;
+    }
+
+    *out = (float) atof(number->number);
+    return true;
+}
+
+/**
+ * Baut eine Matrix aus Position, Eulerwinkeln und Skalierung zusammen.
+ * Die Reihenfolge der Rotationen entspricht der globalen Modellrotation.
+ * 
+ * @param position die Verschiebung
+ * @param rotation die Eulerwinkel in Grad
+ * @param scale die Skalierung
+ * @param out die Ausgabematrix
+ */
+static void scene_composeTransform(vec3 position, vec3 rotation, vec3 scale,
+                                   mat4 out)
+{
+    vec3 xAxis = {1.0f, 0.0f, 0.0f};
+    vec3 yAxis = {0.0f, 1.0f, 0.0f};
+    vec3 zAxis = {0.0f, 0.0f, 1.0f};
+
+    glm_translate_make(out, position);
+    glm_rotate(out, glm_rad(rotation[0]), xAxis);
+    glm_rotate(out, glm_rad(rotation[1]), yAxis);
+    glm_rotate(out, glm_rad(rotation[2]), zAxis);
+    glm_scale(out, scale);
+}
+
+/**
+ * Prüft, ob ein JSON Schlüssel eine Transformation beschreibt, und liest
+ * sie dann ein. Die Skalierung darf auch als einzelne Zahl angegeben
+ * werden.
+ * 
+ * @param elem das JSON Element
+ * @param position die Verschiebung, wird bei "pos" gesetzt
+ * @param rotation die Eulerwinkel, werden bei "rot" gesetzt
+ * @param scale die Skalierung, wird bei "scale" gesetzt
+ * @return true, wenn der Schlüssel eine Transformation war
+ */
+static bool scene_parseTransformKey(struct json_object_element_s* elem,
+                                    vec3 position, vec3 rotation, vec3 scale)
+{
+    const char* key = elem->name->string;
+    if (strcmp(key, "pos") == 0)
+    {
+        scene_parseVec3(elem->value, "xyz", position);
+    }
+    else if (strcmp(key, "rot") == 0)
+    {
+        scene_parseVec3(elem->value, "xyz", rotation);
+    }
+    else if (strcmp(key, "scale") == 0)
+    {
+        float uniform;
+        if (json_value_as_number(elem->value) 
+            && scene_parseFloat(elem->value, &uniform))
+        {
+            scale[0] = scale[1] = scale[2] = uniform;
+        }
+        else
+        {
+            scene_parseVec3(elem->value, "xyz", scale);
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Legt einen neuen Knoten mit neutraler Transformation an. Referenziert
+ * der Knoten ein Modell, erhält er eine Instanz ohne eigene Transformation.
+ * 
+ * @param scene die Szene
+ * @param parent der Index des Elternknotens oder -1
+ * @param model der Index des Modells oder -1
+ * @return der Index des neuen Knotens
+ */
+static int scene_addNode(Scene* scene, int parent, int model)
+{
+    scene->countNodes++;
+    scene->nodes = realloc(
+        scene->nodes, 
+        sizeof(SceneNode) * scene->countNodes
+    );
+
+    SceneNode* node = &scene->nodes[scene->countNodes - 1];
+    memset(node, 0, sizeof(SceneNode));
+    node->parent = parent;
+    node->model = model;
+    glm_vec3_one(node->scale);
+    glm_mat4_identity(node->world);
+    node->dirty = true;
+
+    if (model >= 0)
+    {
+        node->countInstances = 1;
+        node->instances = malloc(sizeof(mat4));
+        glm_mat4_identity(node->instances[0]);
+    }
+
+    return scene->countNodes - 1;
+}
+
+/**
+ * Liest die Instanzen eines Knotens ein. Jede Instanz ist ein Objekt mit
+ * optionaler Position, Rotation und Skalierung relativ zum Knoten.
+ * 
+ * @param instancesVal das JSON Array mit den Instanzen
+ * @param node der Knoten, der die Instanzen erhält
+ */
+static void scene_parseInstances(struct json_value_s* instancesVal, 
+                                 SceneNode* node)
+{
+    struct json_array_s* instanceArr = json_value_as_array(instancesVal);
+    if (!instanceArr)
+    {
+        fprintf(
+            stderr, 
+            "[JSON] Warning: instances needs to be an array!\n"
+        );
+        return;
+    }
+
+    free(node->instances);
+    node->countInstances = 0;
+    node->instances = malloc(sizeof(mat4) * (instanceArr->length + 1));
+
+    struct json_array_element_s* instanceElem = instanceArr->start;
+    while (instanceElem)
+    {
+        struct json_object_s* instanceObj = json_value_as_object(instanceElem->value);
+        if (instanceObj)
+        {
+            vec3 position = {0.0f, 0.0f, 0.0f};
+            vec3 rotation = {0.0f, 0.0f, 0.0f};
+            vec3 scale = {1.0f, 1.0f, 1.0f};
+
+            struct json_object_element_s* elem = instanceObj->start;
+            while (elem)
+            {
+                if (!scene_parseTransformKey(elem, position, rotation, scale))
+                {
+                    fprintf(
+                        stderr, 
+                        "[JSON] Warning: Found unsupported instance key: %s\n", 
+                        elem->name->string
+                    );
+                }
+                elem = elem->next;
+            }
+
+            scene_composeTransform(
+                position, rotation, scale,
+                node->instances[node->countInstances++]
+            );
+        }
+        else
+        {
+            fprintf(
+                stderr, 
+                "[JSON] Warning: Found non-object instance!\n"
+            );
+        }
+
+        instanceElem = instanceElem->next;
+    }
+}
+
+static void scene_parseNodeArray(struct json_value_s* nodes, int parent,
+                                 SceneParsingState* st);
+
+/**
+ * Liest einen Knoten des Szenengraphen samt seiner Kinder ein.
+ * Alle Eigenschaften sind optional. Die Kinder werden erst nach dem
+ * Knoten selbst eingetragen, damit Elternknoten im Array vorne liegen.
+ * 
+ * @param nodeVal das JSON Knoten Objekt
+ * @param parent der Index des Elternknotens oder -1
+ * @param st der Parsing-State mit der Szene
+ */
+static void scene_parseNode(struct json_value_s* nodeVal, int parent,
+                            SceneParsingState* st)
+{
+    struct json_object_s* nodeObj = json_value_as_object(nodeVal);
+    if (!nodeObj)
+    {
+        fprintf(
+            stderr, 
+            "[JSON] Warning: Found non-object node!\n"
+        );
+        return;
+    }
+
+    // Im ersten Durchlauf das Modell suchen, da die Instanzen davon
+    // abhängen und die Reihenfolge der Schlüssel beliebig ist.
+    int model = -1;
+    struct json_object_element_s* elem = nodeObj->start;
+    while (elem)
+    {
+        if (strcmp(elem->name->string, "model") == 0)
+        {
+            model = scene_parseModelName(elem->value, st);
+            if (model < 0)
+            {
+                st->ok = false;
+                return;
+            }
+        }
+        elem = elem->next;
+    }
+
+    int index = scene_addNode(st->scene, parent, model);
+
+    elem = nodeObj->start;
+    while (elem)
+    {
+        // Der Knoten muss jedes Mal neu geholt werden, da das Array beim
+        // Einlesen der Kinder vergrößert wird.
+        SceneNode* node = &st->scene->nodes[index];
+        const char* key = elem->name->string;
+        if (strcmp(key, "model") == 0 || strcmp(key, "name") == 0)
+        {
+            // Bereits verarbeitet bzw. nur zur Beschreibung
+        }
+        else if (scene_parseTransformKey(elem, node->position, 
+                                         node->rotation, node->scale))
+        {
+            // Transformation des Knotens
+        }
+        else if (strcmp(key, "instances") == 0)
+        {
+            if (model >= 0)
+            {
+                scene_parseInstances(elem->value, node);
+            }
+            else
+            {
+                fprintf(
+                    stderr, 
+                    "[JSON] Warning: Instances without model are ignored!\n"
+                );
+            }
+        }
+        else if (strcmp(key, "children") == 0)
+        {
+            scene_parseNodeArray(elem->value, index, st);
+        }
+        else
+        {
+            fprintf(
+                stderr, 
+                "[JSON] Warning: Found unsupported node key: %s\n", 
+                key
+            );
+        }
+
+        elem = elem->next;
+    }
+}
+
+/**
+ * Funktion zum Einlesen aller Knoten in einem Array.
+ * 
+ * @param nodes das Array mit allen Knoten
+ * @param parent der Index des Elternknotens oder -1
+ * @param st der Parsing-State mit der Szene
+ */
+static void scene_parseNodeArray(struct json_value_s* nodes, int parent,
+                                 SceneParsingState* st)
+{
+    struct json_array_s* nodeArr = json_value_as_array(nodes);
+    if (nodeArr)
+    {
+        struct json_array_element_s* nodeElem = nodeArr->start;
+        while (nodeElem && st->ok)
+        {
+            scene_parseNode(nodeElem->value, parent, st);
+            nodeElem = nodeElem->next;
+        }
+    }
+    else
+    {
+        fprintf(
+            stderr, 
+            "[JSON] Warning: nodes/children needs to be an array!\n"
+        );
+    }
+}
+
+/**
+ * Verteilt die Instanzen aller Knoten auf den Instanzbuffer. Die Instanzen
+ * eines Modells liegen dabei direkt hintereinander. Alle Knoten werden als
+ * geändert markiert.
+ * 
+ * @param scene die Szene mit fertig geladenen Modellen
+ */
+static void scene_buildInstances(Scene* scene)
+{
+    scene->batches = malloc(sizeof(SceneBatch) * (scene->countModels + 1));
+    scene->countSlots = 0;
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        scene->batches[m].first = scene->countSlots;
+        for (int i = 0; i < scene->countNodes; i++)
+        {
+            SceneNode* node = &scene->nodes[i];
+            if (node->model == m)
+            {
+                node->firstSlot = scene->countSlots;
+                scene->countSlots += node->countInstances;
+            }
+        }
+        scene->batches[m].count = scene->countSlots - scene->batches[m].first;
+    }
+
+    scene->instanceMatrices = malloc(sizeof(mat4) * (scene->countSlots + 1));
+    scene->slotModels = malloc(sizeof(int) * (scene->countSlots + 1));
+    scene->instanceBounds = malloc(sizeof(BvhBounds) * (scene->countSlots + 1));
+    scene->movedSlots = malloc(sizeof(int) * (scene->countSlots + 1));
+    scene->queryResult = malloc(sizeof(int) * (scene->countSlots + 1));
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        SceneBatch* batch = &scene->batches[m];
+        for (int i = batch->first; i < batch->first + batch->count; i++)
+        {
+            glm_mat4_identity(scene->instanceMatrices[i]);
+            scene->slotModels[i] = m;
+        }
+    }
+
+    scene->modelBounds = malloc(sizeof(BvhBounds) * (scene->countModels + 1));
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        model_getBounds(scene->models[m], scene->modelBounds[m].min, 
+                        scene->modelBounds[m].max);
+    }
+
+    for (int i = 0; i < scene->countNodes; i++)
+    {
+        scene->nodes[i].dirty = true;
+    }
+    scene->rootValid = false;
+    scene->dirtyBegin = 0;
+    scene->dirtyEnd = scene->countSlots;
+
+    // Erstes Update ohne Wurzeltransformation, dabei wird auch die BVH noch
+    // im Lade-Thread aufgebaut.
+    mat4 identity;
+    glm_mat4_identity(identity);
+    scene_updateTransforms(scene, identity);
+
+    printf("Scene: %i models, %i nodes, %i instances\n", 
+           scene->countModels, scene->countNodes, scene->countSlots);
+}
+
+/**
+ * Stellt Platz für eine weitere Liste mit count Einträgen bereit.
+ * 
+ * @param scene die Szene
+ * @param count die Anzahl der Einträge der neuen Liste
+ */
+static void scene_reserveVisible(Scene* scene, int count)
+{
+    if (scene->countLists + 1 > scene->listCapacity)
+    {
+        scene->listCapacity = scene->listCapacity > 0 
+            ? scene->listCapacity * 2 : 4;
+        size_t batchSize = sizeof(SceneBatch) * scene->listCapacity 
+            * (scene->countModels + 1);
+        scene->visibleBatches = realloc(scene->visibleBatches, batchSize);
+        scene->uploadBatches = realloc(scene->uploadBatches, batchSize);
+        scene->listCommands = realloc(
+            scene->listCommands,
+            sizeof(int) * scene->listCapacity * (scene->countModels + 1)
+        );
+        scene->listOrigins = realloc(
+            scene->listOrigins, 
+            sizeof(int) * scene->listCapacity
+        );
+    }
+    if (scene->countVisible + count > scene->visibleCapacity)
+    {
+        scene->visibleCapacity *= 2;
+        if (scene->visibleCapacity < scene->countVisible + count)
+        {
+            scene->visibleCapacity = scene->countVisible + count;
+        }
+        scene->visibleSlots = realloc(
+            scene->visibleSlots, 
+            sizeof(int) * scene->visibleCapacity
+        );
+    }
+}
+
+/**
+ * Bestimmt, wie groß eine Instanz im Verhältnis zu ihrem Abstand von der
+ * Kamera erscheint. Der Abstand wird zur Box gemessen, damit große
+ * Instanzen in der Nähe nicht unterschätzt werden.
+ * 
+ * @param scene die Szene
+ * @param slot die Instanz
+ * @param camPos die Position der Kamera
+ * @return größte Skalierung der Instanz geteilt durch ihren Abstand
+ */
+static float scene_instanceScale(Scene* scene, int slot, vec3 camPos)
+{
+    BvhBounds* bounds = &scene->instanceBounds[slot];
+    vec3 closest;
+    glm_vec3_maxv(bounds->min, camPos, closest);
+    glm_vec3_minv(bounds->max, closest, closest);
+    float dist = glm_vec3_distance(closest, camPos);
+
+    mat4* matrix = &scene->instanceMatrices[slot];
+    float scale = glm_vec3_norm((*matrix)[0]);
+    scale = fmaxf(scale, glm_vec3_norm((*matrix)[1]));
+    scale = fmaxf(scale, glm_vec3_norm((*matrix)[2]));
+
+    return dist > 1e-4f ? scale / dist : FLT_MAX;
+}
+
+/**
+ * Fügt eine neue Sichtbarkeitsliste hinzu. Die Instanzen werden dabei
+ * nach ihren Modellen gruppiert.
+ * 
+ * @param scene die Szene
+ * @param slots die Instanzen der Liste
+ * @param count die Anzahl der Instanzen
+ * @return die Nummer der Liste
+ */
+static int scene_addList(Scene* scene, const int* slots, int count)
+{
+    scene_reserveVisible(scene, count);
+
+    // Zählen, Startpositionen bestimmen und die Instanzen verteilen.
+    int list = scene->countLists;
+    SceneBatch* batches = &scene->visibleBatches[list * scene->countModels];
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        batches[m].count = 0;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        batches[scene->slotModels[slots[i]]].count++;
+    }
+
+    int first = scene->countVisible;
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        batches[m].first = first;
+        first += batches[m].count;
+        batches[m].count = 0;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        SceneBatch* batch = &batches[scene->slotModels[slots[i]]];
+        scene->visibleSlots[batch->first + batch->count++] = slots[i];
+    }
+
+    // Die Liste wird vollständig von der CPU übertragen.
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        scene->uploadBatches[list * scene->countModels + m] = batches[m];
+        scene->listCommands[list * scene->countModels + m] = -1;
+    }
+    scene->listOrigins[list] = list;
+
+    scene->countVisible += count;
+    return scene->countLists++;
+}
+
+/**
+ * Genauer Schnitttest eines Strahls mit einer Instanz. Der Strahl wird
+ * dafür in den Objektraum der Instanz transformiert.
+ */
+static bool scene_intersectInstance(void* arg, int slot, vec3 origin, vec3 dir,
+                                    float maxT, float* t)
+{
+    Scene* scene = arg;
+
+    mat4 inverse;
+    glm_mat4_inv(scene->instanceMatrices[slot], inverse);
+
+    // Die Richtung wird nicht normiert, damit t im Weltraum gültig bleibt.
+    vec3 localOrigin, localDir;
+    glm_mat4_mulv3(inverse, origin, 1.0f, localOrigin);
+    glm_mat4_mulv3(inverse, dir, 0.0f, localDir);
+
+    return model_intersectRay(scene->models[scene->slotModels[slot]], 
+                              localOrigin, localDir, maxT, t);
+}
+
 /**
  * Liest ein Richtungslicht aus der JSON Datei ein.
  * Wenn das Licht komplett geladen werden konnte wird es direkt der Szene
@@ -241,42 +771,195 @@ static void scene_parsePointLight(struct json_value_s* lightVal, Scene* scene)
         return;
     }
 
-    PointLight* light = light_createPointLight(pos, color);
-    scene_addPointLight(scene, light);
+    PointLight* light = light_createPointLight(pos, color);
+    scene_addPointLight(scene, light);
+}
+
+/**
+ * Funktion zum Einlesen aller Lichtquellen in einem Array.
+ * 
+ * @param lights das Array mit allen Lichtern
+ * @param scene die Szene, zu der die Lichter hinzugefügt werden sollen
+ * @param dirLights bei true werden Richtungs-, sonst Punktlichter eingelesen
+ */
+static void scene_parseLightArray(struct json_value_s* lights, Scene* scene, 
+    	                          bool dirLights)
+{
+    struct json_array_s* lightArr = json_value_as_array(lights);
+    if (lightArr)
+    {
+        struct json_array_element_s* lightElem = lightArr->start;
+        while (lightElem)
+        {
+            if (dirLights)
+            {
+                scene_parseDirLight(lightElem->value, scene);
+            }
+            else
+            {
+                scene_parsePointLight(lightElem->value, scene);
+            }
+            lightElem = lightElem->next;
+        }
+    }
+    else
+    {
+        fprintf(
+            stderr, 
+            "[JSON] Warning: [dir/point]lights needs to be an array!\n"
+        );
+    }
+}
+
+/**
+ * Liest einen Partikel-Emitter aus der JSON Datei ein.
+ * Alle Eigenschaften sind optional, fehlende Werte behalten die
+ * Standardwerte des Emitters. Der Pfad der Textur ist relativ zur
+ * Szenendatei.
+ * 
+ * @param emitterVal das JSON Emitter Objekt
+ * @param st der Parsing-State mit der Szene und ihrem Verzeichnis
+ */
+static void scene_parseEmitter(struct json_value_s* emitterVal, 
+                               SceneParsingState* st)
+{
+    struct json_object_s* emitterObj = json_value_as_object(emitterVal);
+    if (!emitterObj)
+    {
+        fprintf(
+            stderr, 
+            "[JSON] Warning: Found non-object emitter!\n"
+        );
+        return;
+    }
+
+    ParticleEmitter* emitter = emitter_createEmitter();
+
+    struct json_object_element_s* emitterElem = emitterObj->start;
+    while (emitterElem)
+    {
+        const char* key = emitterElem->name->string;
+        if (strcmp(key, "pos") == 0)
+        {
+            scene_parseVec3(emitterElem->value, "xyz", emitter->position);
+        }
+        else if (strcmp(key, "dir") == 0)
+        {
+            scene_parseVec3(emitterElem->value, "xyz", emitter->direction);
+        }
+        else if (strcmp(key, "dirRand") == 0)
+        {
+            scene_parseFloat(emitterElem->value, &emitter->directionRand);
+        }
+        else if (strcmp(key, "rate") == 0)
+        {
+            scene_parseFloat(emitterElem->value, &emitter->rate);
+        }
+        else if (strcmp(key, "lifeTime") == 0)
+        {
+            scene_parseFloat(emitterElem->value, &emitter->lifeTime);
+        }
+        else if (strcmp(key, "lifeTimeRand") == 0)
+        {
+            scene_parseFloat(emitterElem->value, &emitter->lifeTimeRand);
+        }
+        else if (strcmp(key, "startColor") == 0)
+        {
+            scene_parseVec3(emitterElem->value, "rgb", emitter->startColor);
+        }
+        else if (strcmp(key, "endColor") == 0)
+        {
+            scene_parseVec3(emitterElem->value, "rgb", emitter->endColor);
+        }
+        else if (strcmp(key, "startSize") == 0)
+        {
+            scene_parseFloat(emitterElem->value, &emitter->startSize);
+        }
+        else if (strcmp(key, "endSize") == 0)
+        {
+            scene_parseFloat(emitterElem->value, &emitter->endSize);
+        }
+        else if (strcmp(key, "blend") == 0)
+        {
+            struct json_string_s* blendStr = json_value_as_string(emitterElem->value);
+            if (blendStr && strcmp(blendStr->string, "alpha") == 0)
+            {
+                emitter->alphaBlend = true;
+            }
+            else if (blendStr && strcmp(blendStr->string, "additive") == 0)
+            {
+                emitter->alphaBlend = false;
+            }
+            else
+            {
+                fprintf(
+                    stderr, 
+                    "[JSON] Warning: Emitter blend needs to be \"alpha\" or \"additive\"!\n"
+                );
+            }
+        }
+        else if (strcmp(key, "softness") == 0)
+        {
+            scene_parseFloat(emitterElem->value, &emitter->softness);
+        }
+        else if (strcmp(key, "texture") == 0)
+        {
+            struct json_string_s* textureStr = json_value_as_string(emitterElem->value);
+            if (textureStr)
+            {
+                char* path = malloc(strlen(st->directory) + textureStr->string_size + 1);
+                strcpy(path, st->directory);
+                strcat(path, textureStr->string);
+                emitter_setTexture(emitter, path);
+                free(path);
+            }
+            else
+            {
+                fprintf(
+                    stderr, 
+                    "[JSON] Warning: Emitter texture needs to be a string!\n"
+                );
+            }
+        }
+        else
+        {
+            fprintf(
+                stderr, 
+                "[JSON] Warning: Found unsupported emitter key: %s\n", 
+                key
+            );
+        }
+
+        emitterElem = emitterElem->next;
+    }
+
+    scene_addEmitter(st->scene, emitter);
 }
 
 /**
- * Funktion zum Einlesen aller Lichtquellen in einem Array.
+ * Funktion zum Einlesen aller Partikel-Emitter in einem Array.
  * 
- * @param lights das Array mit allen Lichtern
- * @param scene die Szene, zu der die Lichter hinzugefügt werden sollen
- * @param dirLights bei true werden Richtungs-, sonst Punktlichter eingelesen
+ * @param emitters das Array mit allen Emittern
+ * @param st der Parsing-State mit der Szene und ihrem Verzeichnis
  */
-static void scene_parseLightArray(struct json_value_s* lights, Scene* scene, 
-    	                          bool dirLights)
+static void scene_parseEmitterArray(struct json_value_s* emitters, 
+                                    SceneParsingState* st)
 {
-    struct json_array_s* lightArr = json_value_as_array(lights);
-    if (lightArr)
+    struct json_array_s* emitterArr = json_value_as_array(emitters);
+    if (emitterArr)
     {
-        struct json_array_element_s* lightElem = lightArr->start;
-        while (lightElem)
+        struct json_array_element_s* emitterElem = emitterArr->start;
+        while (emitterElem)
         {
-            if (dirLights)
-            {
-                scene_parseDirLight(lightElem->value, scene);
-            }
-            else
-            {
-                scene_parsePointLight(lightElem->value, scene);
-            }
-            lightElem = lightElem->next;
+            scene_parseEmitter(emitterElem->value, st);
+            emitterElem = emitterElem->next;
         }
     }
     else
     {
         fprintf(
             stderr, 
-            "[JSON] Warning: [dir/point]lights needs to be an array!\n"
+            "[JSON] Warning: emitters needs to be an array!\n"
         );
     }
 }
@@ -313,11 +996,22 @@ static void scene_parseJson(struct json_value_s* root, SceneParsingState* st)
         }
         else if (strcmp(elem->name->string, "model") == 0)
         {
-            if (!scene_parseModelName(elem->value, st))
+            // Ein einzelnes Modell wird zu einem Wurzelknoten.
+            int model = scene_parseModelName(elem->value, st);
+            if (model < 0)
             {
                 st->ok = false;
                 return;
             }
+            scene_addNode(st->scene, -1, model);
+        }
+        else if (strcmp(elem->name->string, "nodes") == 0)
+        {
+            scene_parseNodeArray(elem->value, -1, st);
+            if (!st->ok)
+            {
+                return;
+            }
         }
         else if (strcmp(elem->name->string, "dirlights") == 0)
         {
@@ -327,6 +1021,10 @@ static void scene_parseJson(struct json_value_s* root, SceneParsingState* st)
         {
             scene_parseLightArray(elem->value, st->scene, false);
         }
+        else if (strcmp(elem->name->string, "emitters") == 0)
+        {
+            scene_parseEmitterArray(elem->value, st);
+        }
         else
         {
             fprintf(
@@ -342,7 +1040,7 @@ static void scene_parseJson(struct json_value_s* root, SceneParsingState* st)
     }
 
     // Prüfen, ob überhaupt ein Modell gesetzt wurde.
-    if (!st->model)
+    if (st->countModels == 0)
     {
         fprintf(
             stderr, 
@@ -362,9 +1060,14 @@ static void scene_parseJson(struct json_value_s* root, SceneParsingState* st)
  */
 static void scene_deleteParsingState(SceneParsingState* st)
 {
-    if (st->model)
+    for (int i = 0; i < st->countModels; i++)
+    {
+        free(st->models[i]);
+    }
+    free(st->models);
+    if (st->directory)
     {
-        free(st->model);
+        free(st->directory);
     }
     if (st->scene)
     {
@@ -417,6 +1120,7 @@ Scene* scene_loadScene(const char* filename)
     memset(&state, 0, sizeof(SceneParsingState));
     state.scene = malloc(sizeof(Scene));
     memset(state.scene, 0, sizeof(Scene));
+    state.directory = utils_getDirectory(filename);
 
     // Dann parsen wir die gesammte JSON Datei in einer Unterfunktion.
     scene_parseJson(root, &state);
@@ -425,24 +1129,41 @@ Scene* scene_loadScene(const char* filename)
     Scene* scene = NULL;
     if (state.ok)
     {
-        // Verzeichnis anhängen um den relativen Pfad zu korrigieren.
-        char* modelPath = utils_getDirectory(filename);
-        modelPath = realloc(
-            modelPath, 
-            strlen(modelPath) + strlen(state.model) + 1
-        );
-        strcat(modelPath, state.model);
-        
-        Model* model = model_loadModel(modelPath);
-        if (model)
+        Scene* loaded = state.scene;
+        loaded->models = malloc(sizeof(Model*) * state.countModels);
+
+        // Jedes referenzierte Modell wird genau einmal geladen.
+        bool modelsOk = true;
+        for (int i = 0; i < state.countModels && modelsOk; i++)
+        {
+            // Verzeichnis anhängen um den relativen Pfad zu korrigieren.
+            char* modelPath = malloc(
+                strlen(state.directory) + strlen(state.models[i]) + 1
+            );
+            strcpy(modelPath, state.directory);
+            strcat(modelPath, state.models[i]);
+
+            Model* model = model_loadModel(modelPath);
+            if (model)
+            {
+                loaded->models[loaded->countModels++] = model;
+            }
+            else
+            {
+                modelsOk = false;
+            }
+            free(modelPath);
+        }
+
+        if (modelsOk)
         {
             // Zuerst die Szene verschieben, damit sie nicht mit dem
             // ParsingState gelöscht wird.
-            scene = state.scene;
+            scene = loaded;
             state.scene = NULL;
 
-            // Dann das 3D Modell setzen.
-            scene->model = model;
+            // Dann die Instanzen auf den Instanzbuffer verteilen.
+            scene_buildInstances(scene);
         }
     }
 
@@ -462,15 +1183,502 @@ Scene* scene_fromModel(const char* filename)
     {
         scene = malloc(sizeof(Scene));
         memset(scene, 0, sizeof(Scene));
-        scene->model = model;
+        scene->countModels = 1;
+        scene->models = malloc(sizeof(Model*));
+        scene->models[0] = model;
         scene->name = malloc(strlen(filename) + 1);
         strcpy(scene->name, filename);
         scene->countPointLights = 0;
+
+        scene_addNode(scene, -1, 0);
+        scene_buildInstances(scene);
     }
 
     return scene;
 }
 
+void scene_setNodeTransform(Scene* scene, int node, vec3 position,
+                            vec3 rotation, vec3 scale)
+{
+    if (node < 0 || node >= scene->countNodes)
+    {
+        return;
+    }
+
+    glm_vec3_copy(position, scene->nodes[node].position);
+    glm_vec3_copy(rotation, scene->nodes[node].rotation);
+    glm_vec3_copy(scale, scene->nodes[node].scale);
+    scene->nodes[node].dirty = true;
+}
+
+void scene_updateTransforms(Scene* scene, mat4 rootMatrix)
+{
+    // Eine neue Wurzeltransformation betrifft alle Wurzelknoten.
+    bool rootChanged = !scene->rootValid 
+        || memcmp(scene->rootMatrix, rootMatrix, sizeof(mat4)) != 0;
+    glm_mat4_copy(rootMatrix, scene->rootMatrix);
+    scene->rootValid = true;
+    scene->countMoved = 0;
+
+    // Da Elternknoten vor ihren Kindern liegen, ist der Elternknoten beim
+    // Besuch eines Kindes immer schon aktuell.
+    for (int i = 0; i < scene->countNodes; i++)
+    {
+        SceneNode* node = &scene->nodes[i];
+        bool parentUpdated = node->parent >= 0 
+            ? scene->nodes[node->parent].updated 
+            : rootChanged;
+
+        node->updated = node->dirty || parentUpdated;
+        if (!node->updated)
+        {
+            continue;
+        }
+        node->dirty = false;
+
+        mat4 local;
+        scene_composeTransform(node->position, node->rotation, node->scale, local);
+        if (node->parent >= 0)
+        {
+            glm_mat4_mul(scene->nodes[node->parent].world, local, node->world);
+        }
+        else
+        {
+            glm_mat4_mul(scene->rootMatrix, local, node->world);
+        }
+
+        // Die Instanzen des Knotens liegen zusammenhängend im Buffer.
+        if (node->model >= 0 && node->countInstances > 0)
+        {
+            vec3* modelBox = (vec3*)&scene->modelBounds[node->model];
+            for (int k = 0; k < node->countInstances; k++)
+            {
+                int slot = node->firstSlot + k;
+                glm_mat4_mul(node->world, node->instances[k], 
+                             scene->instanceMatrices[slot]);
+                glm_aabb_transform(modelBox, scene->instanceMatrices[slot],
+                                   (vec3*)&scene->instanceBounds[slot]);
+                scene->movedSlots[scene->countMoved++] = slot;
+            }
+            if (node->firstSlot < scene->dirtyBegin)
+            {
+                scene->dirtyBegin = node->firstSlot;
+            }
+            if (node->firstSlot + node->countInstances > scene->dirtyEnd)
+            {
+                scene->dirtyEnd = node->firstSlot + node->countInstances;
+            }
+        }
+    }
+
+    // Die BVH wird einmal aufgebaut und danach nur noch angepasst.
+    if (scene->bvh == NULL)
+    {
+        scene->bvh = bvh_build(scene->instanceBounds, scene->countSlots);
+    }
+    else if (scene->countMoved > 0)
+    {
+        bvh_refit(scene->bvh, scene->instanceBounds, scene->movedSlots, 
+                  scene->countMoved);
+    }
+}
+
+void scene_uploadInstances(Scene* scene, StreamBuffer* stream)
+{
+    if (scene->countSlots == 0)
+    {
+        return;
+    }
+
+    // Der Buffer wird erst im Hauptthread angelegt, damit er nicht vom
+    // Lade-Thread aus synchronisiert werden muss.
+    if (scene->instanceBuffer == 0)
+    {
+        glGenBuffers(1, &scene->instanceBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->instanceBuffer);
+        glBufferData(
+            GL_SHADER_STORAGE_BUFFER, 
+            sizeof(mat4) * scene->countSlots,
+            scene->instanceMatrices, 
+            GL_DYNAMIC_DRAW
+        );
+    }
+    else if (scene->dirtyBegin < scene->dirtyEnd)
+    {
+        // Nur den geänderten Bereich über den Stream Buffer übertragen.
+        // Die Kopie auf der GPU wird nach den Drawcalls des letzten Frames
+        // ausgeführt, ohne dass der Treiber den Buffer zurückhalten muss.
+        StreamAllocation allocation;
+        GLsizeiptr size = sizeof(mat4) * (scene->dirtyEnd - scene->dirtyBegin);
+        streamBuffer_alloc(stream, size, &allocation);
+        memcpy(allocation.memory, scene->instanceMatrices[scene->dirtyBegin], size);
+        streamBuffer_commit(stream, &allocation);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, allocation.buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, scene->instanceBuffer);
+        glCopyBufferSubData(
+            GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+            allocation.offset,
+            sizeof(mat4) * scene->dirtyBegin,
+            size
+        );
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    scene->dirtyBegin = scene->countSlots;
+    scene->dirtyEnd = 0;
+
+    // Die Modellboxen ändern sich nie und werden nur einmal übertragen.
+    if (scene->boundsBuffer == 0)
+    {
+        glGenBuffers(1, &scene->boundsBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->boundsBuffer);
+        glBufferData(
+            GL_SHADER_STORAGE_BUFFER,
+            sizeof(BvhBounds) * scene->countModels,
+            scene->modelBounds,
+            GL_STATIC_DRAW
+        );
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SCENE_INSTANCE_BINDING, 
+                     scene->instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SCENE_BOUNDS_BINDING, 
+                     scene->boundsBuffer);
+}
+
+void scene_beginVisibility(Scene* scene)
+{
+    scene->countVisible = 0;
+    scene->countLists = 0;
+    scene->countCommands = 0;
+}
+
+int scene_cullAll(Scene* scene)
+{
+    for (int i = 0; i < scene->countSlots; i++)
+    {
+        scene->queryResult[i] = i;
+    }
+    return scene_addList(scene, scene->queryResult, scene->countSlots);
+}
+
+int scene_cullFrustum(Scene* scene, mat4 viewProjMatrix)
+{
+    vec4 planes[6];
+    glm_frustum_planes(viewProjMatrix, planes);
+
+    int count = scene->bvh 
+        ? bvh_queryFrustum(scene->bvh, planes, scene->queryResult) : 0;
+    return scene_addList(scene, scene->queryResult, count);
+}
+
+int scene_cullSphere(Scene* scene, vec3 center, float radius)
+{
+    int count = scene->bvh 
+        ? bvh_querySphere(scene->bvh, center, radius, scene->queryResult) : 0;
+    return scene_addList(scene, scene->queryResult, count);
+}
+
+int scene_reserveList(Scene* scene, int source, int lodBias)
+{
+    int total = scene_getListCount(scene, source);
+    scene_reserveVisible(scene, total);
+
+    // Die Bereiche liegen wie in der Quellliste hintereinander.
+    int list = scene->countLists;
+    SceneBatch* sourceBatches = &scene->visibleBatches[source * scene->countModels];
+    SceneBatch* batches = &scene->visibleBatches[list * scene->countModels];
+    int first = scene->countVisible;
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        int index = list * scene->countModels + m;
+        batches[m].first = first;
+        batches[m].count = sourceBatches[m].count;
+        first += batches[m].count;
+
+        // Die Anzahl zählt erst die GPU hoch.
+        scene->uploadBatches[index].first = batches[m].first;
+        scene->uploadBatches[index].count = 0;
+
+        scene->listCommands[index] = -1;
+        if (batches[m].count == 0)
+        {
+            continue;
+        }
+
+        int meshCount = model_getMeshCount(scene->models[m]);
+        if (scene->countCommands + meshCount > scene->commandCapacity)
+        {
+            scene->commandCapacity = (scene->countCommands + meshCount) * 2;
+            scene->commands = realloc(
+                scene->commands, 
+                sizeof(MeshDrawCommand) * scene->commandCapacity
+            );
+            scene->commandBatches = realloc(
+                scene->commandBatches,
+                sizeof(int) * scene->commandCapacity
+            );
+        }
+
+        scene->listCommands[index] = scene->countCommands;
+        model_initDrawCommands(scene->models[m], lodBias,
+                               &scene->commands[scene->countCommands]);
+        for (int k = 0; k < meshCount; k++)
+        {
+            scene->commandBatches[scene->countCommands++] = index;
+        }
+    }
+
+    // Die Einträge schreibt die GPU, sie werden nur definiert vorbelegt.
+    memset(&scene->visibleSlots[scene->countVisible], 0, sizeof(int) * total);
+    scene->listOrigins[list] = scene->listOrigins[source];
+
+    scene->countVisible += total;
+    return scene->countLists++;
+}
+
+int scene_getListCount(Scene* scene, int list)
+{
+    int count = 0;
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        count += scene->visibleBatches[list * scene->countModels + m].count;
+    }
+    return count;
+}
+
+void scene_uploadVisibility(Scene* scene)
+{
+    if (scene->visibleBuffer == 0)
+    {
+        glGenBuffers(1, &scene->visibleBuffer);
+    }
+
+    // Der Buffer wird jeden Frame neu angelegt, damit der Treiber nicht
+    // auf Drawcalls des letzten Frames warten muss.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->visibleBuffer);
+    glBufferData(
+        GL_SHADER_STORAGE_BUFFER,
+        sizeof(int) * (scene->countVisible + 1),
+        NULL,
+        GL_STREAM_DRAW
+    );
+    glBufferSubData(
+        GL_SHADER_STORAGE_BUFFER, 
+        0, 
+        sizeof(int) * scene->countVisible, 
+        scene->visibleSlots
+    );
+
+    // Bereiche aller Listen, die Anzahl der GPU-Listen startet bei 0.
+    if (scene->listBuffer == 0)
+    {
+        glGenBuffers(1, &scene->listBuffer);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->listBuffer);
+    glBufferData(
+        GL_SHADER_STORAGE_BUFFER,
+        sizeof(SceneBatch) * (scene->countLists * scene->countModels + 1),
+        NULL,
+        GL_STREAM_DRAW
+    );
+    glBufferSubData(
+        GL_SHADER_STORAGE_BUFFER,
+        0,
+        sizeof(SceneBatch) * scene->countLists * scene->countModels,
+        scene->uploadBatches
+    );
+
+    // Indirekte Drawcalls und ihre Listenbereiche
+    if (scene->commandBuffer == 0)
+    {
+        glGenBuffers(1, &scene->commandBuffer);
+        glGenBuffers(1, &scene->commandBatchBuffer);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->commandBuffer);
+    glBufferData(
+        GL_SHADER_STORAGE_BUFFER,
+        sizeof(MeshDrawCommand) * (scene->countCommands + 1),
+        NULL,
+        GL_STREAM_DRAW
+    );
+    glBufferSubData(
+        GL_SHADER_STORAGE_BUFFER,
+        0,
+        sizeof(MeshDrawCommand) * scene->countCommands,
+        scene->commands
+    );
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->commandBatchBuffer);
+    glBufferData(
+        GL_SHADER_STORAGE_BUFFER,
+        sizeof(int) * (scene->countCommands + 1),
+        NULL,
+        GL_STREAM_DRAW
+    );
+    glBufferSubData(
+        GL_SHADER_STORAGE_BUFFER,
+        0,
+        sizeof(int) * scene->countCommands,
+        scene->commandBatches
+    );
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SCENE_VISIBLE_BINDING, 
+                     scene->visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SCENE_LIST_BINDING, 
+                     scene->listBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SCENE_COMMAND_BINDING, 
+                     scene->commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SCENE_COMMAND_BATCH_BINDING, 
+                     scene->commandBatchBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene->commandBuffer);
+}
+
+bool scene_pick(Scene* scene, vec3 origin, vec3 dir, int* node,
+                int* instance, float* t)
+{
+    if (scene->bvh == NULL)
+    {
+        return false;
+    }
+
+    int slot = bvh_raycast(scene->bvh, origin, dir, scene_intersectInstance, 
+                           scene, t);
+    if (slot < 0)
+    {
+        return false;
+    }
+
+    // Knoten der Instanz suchen, das passiert nur einmal pro Klick.
+    for (int i = 0; i < scene->countNodes; i++)
+    {
+        SceneNode* n = &scene->nodes[i];
+        if (n->model == scene->slotModels[slot] && slot >= n->firstSlot 
+            && slot < n->firstSlot + n->countInstances)
+        {
+            *node = i;
+            *instance = slot - n->firstSlot;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void scene_selectLods(Scene* scene, vec3 camPos, float pixelsPerUnit,
+                      float maxPixelError)
+{
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        // Die Instanz, auf der das Modell am größten erscheint, bestimmt
+        // die Stufe.
+        float maxScale = 0.0f;
+        SceneBatch* batch = &scene->batches[m];
+        for (int i = batch->first; i < batch->first + batch->count; i++)
+        {
+            maxScale = fmaxf(maxScale, scene_instanceScale(scene, i, camPos));
+        }
+
+        float modelPixels = maxScale < FLT_MAX / pixelsPerUnit
+            ? maxScale * pixelsPerUnit : FLT_MAX;
+        model_selectLods(scene->models[m], modelPixels, maxPixelError);
+    }
+}
+
+void scene_requestTextures(Scene* scene, int list, vec3 camPos,
+                           float pixelsPerUnit)
+{
+    SceneBatch* origins = &scene->visibleBatches[scene->listOrigins[list] * scene->countModels];
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        SceneBatch* origin = &origins[m];
+        if (origin->count == 0)
+        {
+            continue;
+        }
+
+        float maxScale = 0.0f;
+        for (int i = origin->first; i < origin->first + origin->count; i++)
+        {
+            maxScale = fmaxf(maxScale, scene_instanceScale(scene, scene->visibleSlots[i], camPos));
+        }
+
+        float modelPixels = maxScale < FLT_MAX / pixelsPerUnit
+            ? maxScale * pixelsPerUnit : FLT_MAX;
+        model_requestTextures(scene->models[m], modelPixels);
+    }
+}
+
+void scene_enqueueScene(Scene* scene, int list, RenderQueue* queue,
+                        RenderPass pass, ShaderPermutations* shaders,
+                        unsigned int features, int lodBias,
+                        vec3 camPos, float farPlane)
+{
+    SceneBatch* batches = &scene->visibleBatches[list * scene->countModels];
+    SceneBatch* origins = &scene->visibleBatches[scene->listOrigins[list] * scene->countModels];
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        SceneBatch* batch = &batches[m];
+        if (batch->count == 0)
+        {
+            continue;
+        }
+
+        // Die Tiefe des Drawcalls bestimmt die nächste sichtbare Instanz.
+        // Bei GPU-Listen sind nur die Instanzen der Ursprungsliste bekannt.
+        SceneBatch* origin = &origins[m];
+        int nearest = scene->visibleSlots[origin->first];
+        float nearestDist = FLT_MAX;
+        for (int i = origin->first; i < origin->first + origin->count; i++)
+        {
+            int slot = scene->visibleSlots[i];
+            vec3 center;
+            glm_vec3_center(scene->instanceBounds[slot].min, 
+                            scene->instanceBounds[slot].max, center);
+            float dist = glm_vec3_distance(center, camPos);
+            if (dist < nearestDist)
+            {
+                nearestDist = dist;
+                nearest = slot;
+            }
+        }
+
+        model_enqueueModel(
+            scene->models[m], queue, pass, shaders, features,
+            scene->instanceMatrices[nearest], batch->first, batch->count,
+            scene->listCommands[list * scene->countModels + m], lodBias,
+            camPos, farPlane
+        );
+    }
+}
+
+void scene_drawSceneTris(Scene* scene, int list, Shader* shader, int lodBias)
+{
+    SceneBatch* batches = &scene->visibleBatches[list * scene->countModels];
+    for (int m = 0; m < scene->countModels; m++)
+    {
+        if (batches[m].count == 0)
+        {
+            continue;
+        }
+
+        shader_setInt(shader, "instanceBase", batches[m].first);
+        int command = scene->listCommands[list * scene->countModels + m];
+        if (command >= 0)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene->commandBuffer);
+            model_drawModelTrisIndirect(scene->models[m], shader, command);
+        }
+        else
+        {
+            model_drawModelTrisInstanced(scene->models[m], shader, lodBias,
+                                         batches[m].count);
+        }
+    }
+}
+
 void scene_addDirLight(Scene* scene, DirLight* light)
 {
     scene->countDirLights++;
@@ -491,6 +1699,16 @@ void scene_addPointLight(Scene* scene, PointLight* light)
     scene->pointLights[scene->countPointLights - 1] = light;
 }
 
+void scene_addEmitter(Scene* scene, ParticleEmitter* emitter)
+{
+    scene->countEmitters++;
+    scene->emitters = realloc(
+        scene->emitters, 
+        sizeof(ParticleEmitter*) * scene->countEmitters
+    );
+    scene->emitters[scene->countEmitters - 1] = emitter;
+}
+
 void scene_deleteScene(Scene* scene)
 {
     // Erst den Namen löschen
@@ -500,11 +1718,63 @@ void scene_deleteScene(Scene* scene)
         scene->name = NULL;
     }
 
-    // Dann das Modell löschen
-    if (scene->model)
+    // Dann alle Modelle löschen
+    if (scene->models)
+    {
+        for (int i = 0; i < scene->countModels; i++)
+        {
+            model_deleteModel(scene->models[i]);
+        }
+        free(scene->models);
+        scene->models = NULL;
+    }
+    free(scene->batches);
+    scene->batches = NULL;
+
+    // Dann den Szenengraphen und die Instanzen
+    if (scene->nodes)
     {
-        model_deleteModel(scene->model);
-        scene->model = NULL;
+        for (int i = 0; i < scene->countNodes; i++)
+        {
+            free(scene->nodes[i].instances);
+        }
+        free(scene->nodes);
+        scene->nodes = NULL;
+    }
+    free(scene->instanceMatrices);
+    scene->instanceMatrices = NULL;
+    if (scene->instanceBuffer != 0)
+    {
+        glDeleteBuffers(1, &scene->instanceBuffer);
+    }
+
+    // Dann die BVH und die Sichtbarkeitslisten
+    bvh_deleteBvh(scene->bvh);
+    free(scene->slotModels);
+    free(scene->modelBounds);
+    free(scene->instanceBounds);
+    free(scene->movedSlots);
+    free(scene->visibleSlots);
+    free(scene->visibleBatches);
+    free(scene->uploadBatches);
+    free(scene->listOrigins);
+    free(scene->listCommands);
+    free(scene->queryResult);
+    free(scene->commands);
+    free(scene->commandBatches);
+    if (scene->visibleBuffer != 0)
+    {
+        glDeleteBuffers(1, &scene->visibleBuffer);
+        glDeleteBuffers(1, &scene->listBuffer);
+    }
+    if (scene->commandBuffer != 0)
+    {
+        glDeleteBuffers(1, &scene->commandBuffer);
+        glDeleteBuffers(1, &scene->commandBatchBuffer);
+    }
+    if (scene->boundsBuffer != 0)
+    {
+        glDeleteBuffers(1, &scene->boundsBuffer);
     }
 
     // Dann alle Richtungslichter
@@ -529,6 +1799,17 @@ void scene_deleteScene(Scene* scene)
         scene->pointLights = NULL;
     }
 
+    // Dann alle Partikel-Emitter
+    if (scene->emitters)
+    {
+        for (int i = 0; i < scene->countEmitters; i++)
+        {
+            emitter_deleteEmitter(scene->emitters[i]);
+        }
+        free(scene->emitters);
+        scene->emitters = NULL;
+    }
+
     // Und zum Schluss die Szene selbst
     free(scene);
 }
@@ -1,13 +1,29 @@
 /**
  * Modul für das Verarbeiten und Laden von 3D Szenen.
  * Eine Szene ist dabei ein serialisiertes Datenobjekt, das festlegt:
- * -> welche 3D Modelle angezeigt werden (nur eins zur Zeit)
+ * -> welche 3D Modelle angezeigt werden und wo sie platziert sind
  * -> welche Skybox verwendet werden soll (nicht implementiert)
  * -> welche Lichter (inklusiver Eigenschaften dieser) in der Szene sind
+ * -> welche Partikel-Emitter in der Szene sind
  * -> ggf. weitere Eigenschaften
  * 
  * Szenen werden dabei aus JSON Dateien geladen.
  * 
+ * Die Modelle werden über einen Szenengraphen platziert. Jeder Knoten
+ * besitzt eine Transformation relativ zu seinem Elternknoten und kann ein
+ * Modell mit beliebig vielen Instanzen referenzieren. Jedes Modell wird nur
+ * einmal geladen. Die Weltmatrizen aller Instanzen eines Modells liegen
+ * zusammenhängend in einem Shader Storage Buffer, sodass ein Modell mit
+ * einem instanzierten Drawcall pro Mesh gezeichnet wird.
+ * 
+ * Über die Weltboxen aller Instanzen wird eine BVH gelegt. Sichtbarkeits-
+ * abfragen (Kamera, Lichter) erzeugen pro Frame Listen der betroffenen
+ * Instanzen, nach Modellen gruppiert. Alle Listen eines Frames liegen in
+ * einem zweiten Buffer, über den die Shader ihre Instanzen nachschlagen.
+ * Listen können auch erst auf der GPU gefüllt werden (Occlusion Culling).
+ * Ihre Meshes werden dann über indirekte Drawcalls gezeichnet, deren
+ * Instanzanzahl ebenfalls auf der GPU gesetzt wird.
+ * 
  * Copyright (C) 2020, FH Wedel
  * Autor: Nicolas Hollmann
  */
@@ -19,20 +35,116 @@
 
 #include "model.h"
 #include "light.h"
+#include "emitter.h"
+#include "bvh.h"
+#include "streamBuffer.h"
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Binding des Shader Storage Buffers mit den Matrizen der Instanzen.
+#define SCENE_INSTANCE_BINDING 8
+
+// Binding des Shader Storage Buffers mit den Listen sichtbarer Instanzen.
+#define SCENE_VISIBLE_BINDING 9
+
+// Binding der Bereiche aller Listen (erster Eintrag und Anzahl pro Modell).
+#define SCENE_LIST_BINDING 10
+
+// Bindings der indirekten Drawcalls und ihrer Listenbereiche.
+#define SCENE_COMMAND_BINDING 11
+#define SCENE_COMMAND_BATCH_BINDING 12
+
+// Binding der Modellboxen im Objektraum (6 Floats pro Modell).
+#define SCENE_BOUNDS_BINDING 13
 
 //////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
 
+// Ein Knoten des Szenengraphen. Elternknoten liegen im Array immer vor
+// ihren Kindern, sodass die Weltmatrizen in einem Durchlauf entstehen.
+struct SceneNode
+{
+    int parent; // Index des Elternknotens oder -1
+    int model;  // Index des Modells oder -1
+
+    vec3 position;
+    vec3 rotation; // Eulerwinkel in Grad
+    vec3 scale;
+
+    mat4 world;   // Zwischengespeicherte Weltmatrix
+    bool dirty;   // Lokale Transformation hat sich geändert
+    bool updated; // Weltmatrix wurde im letzten Update neu berechnet
+
+    int countInstances;
+    mat4* instances; // Matrizen der Instanzen relativ zum Knoten
+    int firstSlot;   // Erster Eintrag der Instanzen im Instanzbuffer
+};
+typedef struct SceneNode SceneNode;
+
+// Zusammenhängender Bereich des Instanzbuffers, der zu einem Modell gehört.
+struct SceneBatch
+{
+    int first;
+    int count;
+};
+typedef struct SceneBatch SceneBatch;
+
 // Datenstruktur zum Speichern einer kompletten Szene.
 struct Scene
 {
     char* name;
-    Model* model;
+
+    int countModels;
+    Model** models;
+    SceneBatch* batches; // Ein Bereich pro Modell
+
+    int countNodes;
+    SceneNode* nodes;
+
+    int countSlots;
+    mat4* instanceMatrices;   // Weltmatrizen aller Instanzen
+    GLuint instanceBuffer;    // Kopie der Weltmatrizen auf der GPU
+    int dirtyBegin, dirtyEnd; // Noch nicht hochgeladener Bereich
+    mat4 rootMatrix;          // Transformation der gesamten Szene
+    bool rootValid;
+
+    int* slotModels;           // Modell jedes Eintrags im Instanzbuffer
+    BvhBounds* modelBounds;    // Boxen der Modelle im Objektraum
+    BvhBounds* instanceBounds; // Weltboxen aller Instanzen
+    Bvh* bvh;
+    int countMoved;
+    int* movedSlots;           // Im letzten Update bewegte Instanzen
+
+    // Sichtbarkeitslisten des aktuellen Frames
+    int countVisible;
+    int visibleCapacity;
+    int* visibleSlots;         // Instanzen aller Listen, nach Modell gruppiert
+    int countLists;
+    int listCapacity;
+    SceneBatch* visibleBatches; // countModels Bereiche pro Liste
+    SceneBatch* uploadBatches;  // Wie visibleBatches, GPU-Listen sind leer
+    int* listOrigins;           // CPU-Liste, deren Einträge die Liste umfasst
+    int* listCommands;          // Erster Drawcall pro Liste und Modell oder -1
+    int* queryResult;           // Zwischenspeicher für BVH-Abfragen
+    GLuint visibleBuffer;
+    GLuint listBuffer;
+
+    // Indirekte Drawcalls der auf der GPU gefüllten Listen
+    int countCommands;
+    int commandCapacity;
+    MeshDrawCommand* commands;
+    int* commandBatches;        // Listenbereich (Liste * Modelle + Modell)
+    GLuint commandBuffer;
+    GLuint commandBatchBuffer;
+    GLuint boundsBuffer;
 
     int countDirLights;
     DirLight** dirLights;
 
     int countPointLights;
     PointLight** pointLights;
+
+    int countEmitters;
+    ParticleEmitter** emitters;
 };
 typedef struct Scene Scene;
 
@@ -60,6 +172,186 @@ Scene* scene_loadScene(const char* filename);
  */
 Scene* scene_fromModel(const char* filename);
 
+/**
+ * Setzt die Transformation eines Knotens. Die Weltmatrizen des Knotens,
+ * seiner Kinder und ihrer Instanzen werden beim nächsten Update neu
+ * berechnet.
+ * 
+ * @param scene die Szene
+ * @param node der Index des Knotens
+ * @param position die Position relativ zum Elternknoten
+ * @param rotation die Eulerwinkel in Grad
+ * @param scale die Skalierung
+ */
+void scene_setNodeTransform(Scene* scene, int node, vec3 position,
+                            vec3 rotation, vec3 scale);
+
+/**
+ * Berechnet die Weltmatrizen aller geänderten Knoten und ihrer Instanzen
+ * neu. Ändert sich die Wurzeltransformation, wird der gesamte Graph neu
+ * berechnet. Die BVH wird an die bewegten Instanzen angepasst.
+ * 
+ * @param scene die Szene
+ * @param rootMatrix die Transformation der gesamten Szene
+ */
+void scene_updateTransforms(Scene* scene, mat4 rootMatrix);
+
+/**
+ * Überträgt die geänderten Instanzmatrizen auf die GPU und bindet den
+ * Instanzbuffer an SCENE_INSTANCE_BINDING. Der geänderte Bereich wird in
+ * den Stream Buffer geschrieben und auf der GPU in den Instanzbuffer
+ * kopiert, sodass nie auf Drawcalls des letzten Frames gewartet wird.
+ * Muss im Hauptthread aufgerufen werden.
+ * 
+ * @param scene die Szene
+ * @param stream Stream Buffer des aktuellen Frames
+ */
+void scene_uploadInstances(Scene* scene, StreamBuffer* stream);
+
+/**
+ * Verwirft alle Sichtbarkeitslisten des letzten Frames.
+ * 
+ * @param scene die Szene
+ */
+void scene_beginVisibility(Scene* scene);
+
+/**
+ * Erstellt eine Liste mit allen Instanzen der Szene.
+ * 
+ * @param scene die Szene
+ * @return die Nummer der Liste
+ */
+int scene_cullAll(Scene* scene);
+
+/**
+ * Erstellt eine Liste mit allen Instanzen, die ein Frustum schneiden.
+ * 
+ * @param scene die Szene
+ * @param viewProjMatrix die View-Projection-Matrix des Frustums
+ * @return die Nummer der Liste
+ */
+int scene_cullFrustum(Scene* scene, mat4 viewProjMatrix);
+
+/**
+ * Erstellt eine Liste mit allen Instanzen, die eine Kugel schneiden, z.B.
+ * den Einflussbereich eines Punktlichts.
+ * 
+ * @param scene die Szene
+ * @param center der Mittelpunkt der Kugel
+ * @param radius der Radius der Kugel
+ * @return die Nummer der Liste
+ */
+int scene_cullSphere(Scene* scene, vec3 center, float radius);
+
+/**
+ * Legt eine Liste mit dem Aufbau einer bestehenden Liste an, deren
+ * Einträge erst auf der GPU geschrieben werden. Jeder Bereich bietet Platz
+ * für alle Instanzen des Bereichs der Quellliste. Die Anzahl eines Bereichs
+ * liegt im Listenbuffer und wird dort atomar erhöht. Für jedes Mesh wird
+ * ein indirekter Drawcall angelegt.
+ * 
+ * @param scene die Szene
+ * @param source die Liste, deren Aufbau übernommen wird
+ * @param lodBias zusätzliche Detailstufen der Drawcalls gegenüber der Kamera
+ * @return die Nummer der neuen Liste
+ */
+int scene_reserveList(Scene* scene, int source, int lodBias);
+
+/**
+ * Liefert die Anzahl der Instanzen in einer Liste. Bei auf der GPU
+ * gefüllten Listen ist das die Kapazität.
+ * 
+ * @param scene die Szene
+ * @param list die Nummer der Liste
+ * @return die Anzahl der Instanzen
+ */
+int scene_getListCount(Scene* scene, int list);
+
+/**
+ * Überträgt alle Listen des Frames auf die GPU und bindet sie an
+ * SCENE_VISIBLE_BINDING und SCENE_LIST_BINDING, die indirekten Drawcalls
+ * zusätzlich an GL_DRAW_INDIRECT_BUFFER. Muss nach der letzten Abfrage und
+ * vor dem ersten Zeichnen im Hauptthread aufgerufen werden.
+ * 
+ * @param scene die Szene
+ */
+void scene_uploadVisibility(Scene* scene);
+
+/**
+ * Sucht die nächste Instanz entlang eines Strahls. Die Dreiecke der
+ * Modelle werden dabei exakt getestet.
+ * 
+ * @param scene die Szene
+ * @param origin der Ursprung des Strahls in Weltkoordinaten
+ * @param dir die normierte Richtung des Strahls
+ * @param node Ausgabe für den Knoten der Instanz
+ * @param instance Ausgabe für den Index der Instanz im Knoten
+ * @param t Ausgabe für die Entfernung des Treffers
+ * @return true, wenn eine Instanz getroffen wurde
+ */
+bool scene_pick(Scene* scene, vec3 origin, vec3 dir, int* node,
+                int* instance, float* t);
+
+/**
+ * Wählt die Detailstufen aller Meshes für die Kamera. Maßgeblich ist pro
+ * Modell die Instanz, deren Fehler am stärksten auf den Bildschirm
+ * projiziert wird. Muss vor dem Anlegen der GPU-Listen aufgerufen werden,
+ * da deren Drawcalls die Stufe übernehmen.
+ * 
+ * @param scene die Szene
+ * @param camPos die Position der Kamera
+ * @param pixelsPerUnit Pixel pro Längeneinheit im Abstand 1 zur Kamera
+ * @param maxPixelError der erlaubte Fehler in Pixeln, 0 erzwingt Stufe 0
+ */
+void scene_selectLods(Scene* scene, vec3 camPos, float pixelsPerUnit,
+                      float maxPixelError);
+
+/**
+ * Meldet die Texturen aller Modelle einer Sichtbarkeitsliste für das
+ * Streaming an. Wie bei den Detailstufen bestimmt pro Modell die am größten
+ * erscheinende sichtbare Instanz die benötigte Auflösung. Bei GPU-Listen
+ * werden die Instanzen der Ursprungsliste verwendet.
+ * 
+ * @param scene die Szene
+ * @param list die Nummer der Sichtbarkeitsliste
+ * @param camPos die Position der Kamera
+ * @param pixelsPerUnit Pixel pro Längeneinheit im Abstand 1 zur Kamera
+ */
+void scene_requestTextures(Scene* scene, int list, vec3 camPos,
+                           float pixelsPerUnit);
+
+/**
+ * Fügt die Modelle einer Sichtbarkeitsliste als instanzierte Drawcalls in
+ * eine Render Queue ein. Jedes Mesh erhält die Permutation, die zu den
+ * Texturen seines Materials passt.
+ * 
+ * @param scene die Szene
+ * @param list die Nummer der Sichtbarkeitsliste
+ * @param queue die Render Queue
+ * @param pass der Pass, in dem die Szene gezeichnet wird
+ * @param shaders die Permutationen des zu verwendenden Shaders
+ * @param features Merkmale der Permutation ohne die Texturen der Materialien
+ * @param lodBias zusätzliche Detailstufen gegenüber der Kamera
+ * @param camPos die Position der Kamera
+ * @param farPlane die Entfernung der Far Plane
+ */
+void scene_enqueueScene(Scene* scene, int list, RenderQueue* queue,
+                        RenderPass pass, ShaderPermutations* shaders,
+                        unsigned int features, int lodBias,
+                        vec3 camPos, float farPlane);
+
+/**
+ * Zeichnet die Modelle einer Sichtbarkeitsliste instanziert als Dreiecke,
+ * z.B. für Shadow Maps. Der Shader muss bereits aktiviert sein.
+ * 
+ * @param scene die Szene
+ * @param list die Nummer der Sichtbarkeitsliste
+ * @param shader der zu verwendende Shader
+ * @param lodBias zusätzliche Detailstufen gegenüber der Kamera, muss bei
+ *                GPU-Listen dem Wert beim Anlegen entsprechen
+ */
+void scene_drawSceneTris(Scene* scene, int list, Shader* shader, int lodBias);
+
 /**
  * Fügt ein neues Richtungslicht zu einer Szene hinzu.
  * 
@@ -76,6 +368,14 @@ void scene_addDirLight(Scene* scene, DirLight* light);
  */
 void scene_addPointLight(Scene* scene, PointLight* light);
 
+/**
+ * Fügt einen neuen Partikel-Emitter zu einer Szene hinzu.
+ * 
+ * @param scene die Szene an die der Emitter gehängt werden soll
+ * @param emitter der Emitter, der hinzugefügt werden soll
+ */
+void scene_addEmitter(Scene* scene, ParticleEmitter* emitter);
+
 /**
  * Löscht eine Szene und alle damit verknüpften Ressourcen.
  * 
@@ -8,10 +8,29 @@
 #include "shader.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <sesp/stb_ds.h>
 
+#ifdef _WIN32
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+#endif
+
 #include "utils.h"
 
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Kennung am Anfang jeder Datei im Programm-Cache.
+#define SHADER_CACHE_MAGIC 0x50485353u
+
+// Startwert der FNV-1a Hashes.
+#define SHADER_HASH_BASIS 2166136261u
+
+// Maximale Länge eines Pfades in einer #include Anweisung.
+#define SHADER_INCLUDE_PATH_LENGTH 256
+
 ////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
 
 // Implementierung der Datenstruktur, die einen Shader repräsentiert.
@@ -21,6 +40,8 @@ struct Shader
 {
     GLuint id;
     bool linked;
+    bool tessellated; // Enthält Tessellation-Stufen und zeichnet Patches
+    bool retrievable; // Programmbinary soll nach dem Linken abrufbar sein
     int fileCount;
     GLuint *shaderFiles;
     struct UniformHashmap
@@ -30,37 +51,378 @@ struct Shader
     } * uniforms;
 };
 
+// Eine vom Präprozessor gelesene Datei mit dem Hash ihres Inhalts.
+struct ShaderSourceFile
+{
+    char *file;
+    unsigned int hash;
+};
+typedef struct ShaderSourceFile ShaderSourceFile;
+
+// Ergebnis des Präprozessors: der zusammengesetzte Quellcode und alle
+// gelesenen Dateien. Der Index einer Datei ist ihre Quellnummer in den
+// #line Anweisungen und damit auch in den Fehlermeldungen des Treibers.
+struct ShaderSource
+{
+    char *text;              // stb_ds Array, nullterminiert
+    ShaderSourceFile *files; // stb_ds Array, Index 0 ist die Hauptdatei
+    bool success;
+};
+typedef struct ShaderSource ShaderSource;
+
+// Implementierung der Permutationen eines Programms.
+struct ShaderPermutations
+{
+    char *name;
+    ShaderStage *stages;      // Kopien der Stufen inklusive der Pfade
+    int stageCount;
+    char **features;          // Namen der Merkmale, NULL für ungenutzte Bits
+    int featureCount;
+    unsigned int featureMask; // Alle Bits mit einem Namen
+    unsigned int sourceHash;  // Hash über Quellcode und Treiber
+    ShaderSourceFile *dependencies; // Alle Dateien inklusive der Includes
+    struct ShaderVariant
+    {
+        unsigned int key;
+        Shader *value;        // NULL, wenn das Bauen fehlgeschlagen ist
+    } * variants;
+};
+
+// Kopf einer Datei im Programm-Cache, dahinter folgt das Programmbinary.
+struct ShaderCacheHeader
+{
+    unsigned int magic;
+    unsigned int hash;
+    GLenum format;
+    GLint length;
+};
+typedef struct ShaderCacheHeader ShaderCacheHeader;
+
 ////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
 
+/**
+ * Erweitert einen FNV-1a Hash um eine Zeichenkette.
+ * 
+ * @param hash der bisherige Hash
+ * @param str die Zeichenkette oder NULL
+ * @return der erweiterte Hash
+ */
+static unsigned int shader_hashString(unsigned int hash, const char *str)
+{
+    for (const char *c = str; c && *c; c++)
+    {
+        hash ^= (unsigned char)*c;
+        hash *= 16777619u;
+    }
+    // Trenner, damit "ab"+"c" und "a"+"bc" verschieden sind
+    hash ^= 0xFFu;
+    hash *= 16777619u;
+    return hash;
+}
+
+/**
+ * Prüft, ob eine Datei gelesen werden kann. utils_readFile beendet das
+ * Programm bei fehlenden Dateien, was beim Neuladen nicht passieren darf.
+ * 
+ * @param file der Pfad zur Datei
+ * @return true, wenn die Datei geöffnet werden kann
+ */
+static bool shader_fileExists(const char *file)
+{
+    FILE *f = fopen(file, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+    fclose(f);
+    return true;
+}
+
+/**
+ * Hängt Text an den zusammengesetzten Quellcode an.
+ * 
+ * @param text das stb_ds Array des Quellcodes
+ * @param str der anzuhängende Text
+ * @param length die Länge des Textes
+ */
+static void shader_appendText(char **text, const char *str, size_t length)
+{
+    if (length > 0)
+    {
+        memcpy(stbds_arraddnptr(*text, length), str, length);
+    }
+}
+
+/**
+ * Hängt eine #line Anweisung an den zusammengesetzten Quellcode an.
+ * 
+ * @param text das stb_ds Array des Quellcodes
+ * @param line die Nummer der nächsten Zeile
+ * @param source die Quellnummer der nächsten Zeile
+ */
+static void shader_appendLineDirective(char **text, int line, int source)
+{
+    char directive[32];
+    int length = snprintf(directive, sizeof(directive), "#line %d %d\n", line, source);
+    shader_appendText(text, directive, (size_t)length);
+}
+
+/**
+ * Prüft, ob eine Zeile mit einer bestimmten Präprozessor-Anweisung beginnt.
+ * 
+ * @param line der Anfang der Zeile
+ * @param end das Ende der Zeile
+ * @param name der Name der Anweisung ohne #
+ * @return die Position hinter dem Namen oder NULL
+ */
+static const char *shader_matchDirective(const char *line, const char *end, const char *name)
+{
+    while (line < end && (*line == ' ' || *line == '\t'))
+    {
+        line++;
+    }
+    if (line == end || *line != '#')
+    {
+        return NULL;
+    }
+    line++;
+    while (line < end && (*line == ' ' || *line == '\t'))
+    {
+        line++;
+    }
+
+    size_t length = strlen(name);
+    if ((size_t)(end - line) < length || strncmp(line, name, length) != 0)
+    {
+        return NULL;
+    }
+    return line + length;
+}
+
+/**
+ * Liest den Pfad einer Zeile der Form #include "pfad".
+ * 
+ * @param line der Anfang der Zeile
+ * @param end das Ende der Zeile
+ * @param path Ziel für den Pfad
+ * @return true, wenn die Zeile eine gültige #include Anweisung ist
+ */
+static bool shader_parseInclude(const char *line, const char *end,
+                                char path[SHADER_INCLUDE_PATH_LENGTH])
+{
+    const char *c = shader_matchDirective(line, end, "include");
+    if (c == NULL)
+    {
+        return false;
+    }
+    while (c < end && (*c == ' ' || *c == '\t'))
+    {
+        c++;
+    }
+    if (c == end || *c != '"')
+    {
+        return false;
+    }
+
+    const char *start = ++c;
+    while (c < end && *c != '"')
+    {
+        c++;
+    }
+    if (c == end || c - start >= SHADER_INCLUDE_PATH_LENGTH)
+    {
+        return false;
+    }
+
+    memcpy(path, start, (size_t)(c - start));
+    path[c - start] = '\0';
+    return true;
+}
+
+/**
+ * Sucht eine bereits gelesene Datei.
+ * 
+ * @param files das stb_ds Array der Dateien
+ * @param file der Pfad zur Datei
+ * @return der Index der Datei oder -1
+ */
+static int shader_findSourceFile(ShaderSourceFile *files, const char *file)
+{
+    for (int i = 0; i < (int)stbds_arrlen(files); i++)
+    {
+        if (strcmp(files[i].file, file) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Hängt eine Datei an den zusammengesetzten Quellcode an und löst dabei
+ * ihre #include Anweisungen rekursiv auf. Pfade in #include Anweisungen
+ * sind relativ zu RESOURCE_PATH.
+ * 
+ * Jede Datei wird nur beim ersten #include eingefügt, alle weiteren werden
+ * zu Leerzeilen. Dadurch brauchen die eingebundenen Dateien keine eigenen
+ * Include Guards und zyklische Includes sind ausgeschlossen.
+ * 
+ * @param source der entstehende Quellcode
+ * @param file der Pfad zur Datei
+ * @param defines Defines hinter der #version Zeile oder NULL
+ * @param parent die einbindende Datei oder NULL für die Hauptdatei
+ * @param parentLine die Zeile der #include Anweisung in der einbindenden Datei
+ */
+static void shader_preprocessFile(ShaderSource *source, const char *file, const char *defines,
+                                  const char *parent, int parentLine)
+{
+    if (!shader_fileExists(file))
+    {
+        if (parent)
+        {
+            fprintf(stderr, "Error: Could not open shader include \"%s\" (from \"%s\", line %d).\n",
+                    file, parent, parentLine);
+        }
+        else
+        {
+            fprintf(stderr, "Error: Could not open shader file \"%s\".\n", file);
+        }
+        source->success = false;
+        return;
+    }
+
+    char *content = utils_readFile(file);
+    int index = (int)stbds_arrlen(source->files);
+    ShaderSourceFile entry = {malloc(strlen(file) + 1), shader_hashString(SHADER_HASH_BASIS, content)};
+    strcpy(entry.file, file);
+    stbds_arrput(source->files, entry);
+
+    int line = 1;
+    const char *c = content;
+    while (*c)
+    {
+        const char *end = strchr(c, '\n');
+        const char *next = end ? end + 1 : c + strlen(c);
+        end = end ? end : next;
+
+        char path[SHADER_INCLUDE_PATH_LENGTH];
+        if (shader_parseInclude(c, end, path))
+        {
+            char *includeFile = utils_getResourcePath(path);
+            if (shader_findSourceFile(source->files, includeFile) < 0)
+            {
+                // Die eingebundene Datei bekommt eine eigene Quellnummer,
+                // danach geht es hinter der #include Zeile weiter.
+                shader_appendLineDirective(&source->text, 1, (int)stbds_arrlen(source->files));
+                shader_preprocessFile(source, includeFile, NULL, file, line);
+                shader_appendText(&source->text, "\n", 1);
+                shader_appendLineDirective(&source->text, line + 1, index);
+            }
+            else
+            {
+                // Bereits eingebunden, die Leerzeile erhält die Zeilennummern.
+                shader_appendText(&source->text, "\n", 1);
+            }
+            free(includeFile);
+        }
+        else
+        {
+            shader_appendText(&source->text, c, (size_t)(next - c));
+
+            // Die #version Zeile muss die erste Anweisung bleiben, deswegen
+            // werden die Defines erst dahinter eingefügt. Über #line stimmen
+            // die Zeilennummern in Fehlermeldungen weiterhin mit der Datei überein.
+            if (defines && shader_matchDirective(c, end, "version"))
+            {
+                if (*end != '\n')
+                {
+                    shader_appendText(&source->text, "\n", 1);
+                }
+                shader_appendText(&source->text, defines, strlen(defines));
+                shader_appendText(&source->text, "\n", 1);
+                shader_appendLineDirective(&source->text, line + 1, index);
+                defines = NULL;
+            }
+        }
+
+        line++;
+        c = next;
+    }
+
+    free(content);
+}
+
+/**
+ * Setzt den Quellcode eines Shaders aus seiner Datei und allen
+ * eingebundenen Dateien zusammen.
+ * Das Ergebnis muss mit shader_freeSource wieder freigegeben werden.
+ * 
+ * @param file der Pfad zum Shader-Quellcode
+ * @param defines Defines hinter der #version Zeile oder NULL
+ * @return der zusammengesetzte Quellcode
+ */
+static ShaderSource shader_preprocess(const char *file, const char *defines)
+{
+    ShaderSource source = {NULL, NULL, true};
+    shader_preprocessFile(&source, file, defines, NULL, 0);
+    stbds_arrput(source.text, '\0');
+    return source;
+}
+
+/**
+ * Gibt einen zusammengesetzten Quellcode wieder frei.
+ * 
+ * @param source der Quellcode
+ */
+static void shader_freeSource(ShaderSource *source)
+{
+    for (int i = 0; i < (int)stbds_arrlen(source->files); i++)
+    {
+        free(source->files[i].file);
+    }
+    stbds_arrfree(source->files);
+    stbds_arrfree(source->text);
+}
+
 /**
  * Hilfsfunktion zum Laden eines Shaders aus einer Datei.
  * Der Shader wird direkt kompiliert.
  * 
+ * #include Anweisungen werden vorher aufgelöst. Optional können Defines
+ * angegeben werden, die direkt hinter der #version Zeile eingefügt werden.
+ * 
  * @param type die Art Shader, die erzeugt werden soll
  * @param file der Pfad zum Shader-Quellcode
+ * @param defines zusätzliche Defines oder NULL
  * @param success signalisiert, ob die erzeugung erfolgreich war
  * @return die ID des neu erzeugten Shaders
  */
 static GLuint shader_createGLSLShader(GLenum type, const char *file,
-                                      bool *success)
+                                      const char *defines, bool *success)
 {
     // Grundsätzlich gehen wir von einem Erfolg aus.
     *success = true;
 
-    // Zuerst erstellen wir einen neuen, leeren Shader.
-    GLuint shader = glCreateShader(type);
+    // Zuerst setzen wir den Quellcode aus der angegebenen Datei und allen
+    // eingebundenen Dateien zusammen. Fehlt eine davon, gibt es nichts
+    // zu kompilieren.
+    ShaderSource source = shader_preprocess(file, defines);
+    if (!source.success)
+    {
+        shader_freeSource(&source);
+        *success = false;
+        return 0;
+    }
 
-    // Danach laden wir den Quellcode des Shaders aus der
-    // angegebenen Datei. Dieser wird dem neuen Shader zugewiesen.
-    const char *source = utils_readFile(file);
-    glShaderSource(shader, 1, &source, NULL);
+    // Danach erstellen wir einen neuen, leeren Shader und weisen ihm den
+    // Quellcode zu.
+    GLuint shader = glCreateShader(type);
+    const char *text = source.text;
+    glShaderSource(shader, 1, &text, NULL);
 
     // Als nächstes kann der Shader kompiliert werden.
     glCompileShader(shader);
 
-    // Außerdem kann der Speicher für den Quellcode wieder freigegeben werden.
-    free((void *)source);
-
     // Zum Schluss muss festgestellt werden, ob Fehler beim Kompilieren
     // aufgetreten sind.
     GLint successId;
@@ -83,6 +445,17 @@ static GLuint shader_createGLSLShader(GLenum type, const char *file,
             "Error on shader compilation of file \"%s\":\n\t%s\n",
             file, buffer);
 
+        // Die Meldungen nennen nur Quellnummern, deswegen werden die
+        // zugehörigen Dateien mit ausgegeben.
+        if (stbds_arrlen(source.files) > 1)
+        {
+            fprintf(stderr, "\tSource strings:\n");
+            for (int i = 0; i < (int)stbds_arrlen(source.files); i++)
+            {
+                fprintf(stderr, "\t\t%d: %s\n", i, source.files[i].file);
+            }
+        }
+
         // Nach der Meldung geben wir die neu erstellten Ressourcen wieder frei.
         free(buffer);
         glDeleteShader(shader);
@@ -91,10 +464,82 @@ static GLuint shader_createGLSLShader(GLenum type, const char *file,
         *success = false;
     }
 
+    // Außerdem kann der Speicher für den Quellcode wieder freigegeben werden.
+    shader_freeSource(&source);
+
     // Bei Erfolg geben wir die ID des neuen Shaders zurück.
     return shader;
 }
 
+/**
+ * Bestimmt alle Dateien, aus denen die Stufen der Permutationen bestehen,
+ * und berechnet daraus den Hash über Quellcode und Treiber. Ändert sich
+ * einer davon, passen die Binaries im Cache nicht mehr.
+ * 
+ * @param permutations die Permutationen
+ */
+static void shader_updateDependencies(ShaderPermutations *permutations)
+{
+    for (int i = 0; i < (int)stbds_arrlen(permutations->dependencies); i++)
+    {
+        free(permutations->dependencies[i].file);
+    }
+    stbds_arrsetlen(permutations->dependencies, 0);
+
+    unsigned int hash = SHADER_HASH_BASIS;
+    hash = shader_hashString(hash, (const char *)glGetString(GL_VENDOR));
+    hash = shader_hashString(hash, (const char *)glGetString(GL_RENDERER));
+    hash = shader_hashString(hash, (const char *)glGetString(GL_VERSION));
+
+    for (int i = 0; i < permutations->stageCount; i++)
+    {
+        // Der zusammengesetzte Code enthält auch alle eingebundenen Dateien.
+        ShaderSource source = shader_preprocess(permutations->stages[i].file, NULL);
+        hash = shader_hashString(hash, permutations->stages[i].file);
+        hash = shader_hashString(hash, source.text);
+
+        // Dateien, die mehrere Stufen einbinden, nur einmal merken.
+        for (int j = 0; j < (int)stbds_arrlen(source.files); j++)
+        {
+            if (shader_findSourceFile(permutations->dependencies, source.files[j].file) < 0)
+            {
+                stbds_arrput(permutations->dependencies, source.files[j]);
+                source.files[j].file = NULL;
+            }
+        }
+        shader_freeSource(&source);
+    }
+
+    permutations->sourceHash = hash;
+}
+
+/**
+ * Prüft, ob sich eine der Dateien der Permutationen geändert hat.
+ * 
+ * @param permutations die Permutationen
+ * @return true, wenn eine Datei geändert wurde oder fehlt
+ */
+static bool shader_dependenciesChanged(ShaderPermutations *permutations)
+{
+    for (int i = 0; i < (int)stbds_arrlen(permutations->dependencies); i++)
+    {
+        const ShaderSourceFile *dependency = &permutations->dependencies[i];
+        if (!shader_fileExists(dependency->file))
+        {
+            return true;
+        }
+
+        char *content = utils_readFile(dependency->file);
+        unsigned int hash = shader_hashString(SHADER_HASH_BASIS, content);
+        free(content);
+        if (hash != dependency->hash)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
  * Hilfsfunktion zum Abrufen einer Uniform Location.
  * Im Hintergrund wird ein Cache verwendet, um die Zugriffe zu beschleunigen.
@@ -121,6 +566,232 @@ static GLint shader_getUniformLocation(Shader *shader, const char *name)
     return location;
 }
 
+/**
+ * Setzt die Defines einer Permutation zusammen.
+ * Der zurückgegebene String muss mit free wieder freigegeben werden.
+ * 
+ * @param permutations die Permutationen
+ * @param features die Merkmale der Permutation
+ * @return die Defines, jeweils in einer eigenen Zeile
+ */
+static char *shader_buildDefines(ShaderPermutations *permutations, unsigned int features)
+{
+    size_t length = 1;
+    for (int i = 0; i < permutations->featureCount; i++)
+    {
+        if ((features & (1u << i)) && permutations->features[i])
+        {
+            length += strlen("#define \n") + strlen(permutations->features[i]);
+        }
+    }
+
+    char *defines = malloc(length);
+    defines[0] = '\0';
+    for (int i = 0; i < permutations->featureCount; i++)
+    {
+        if ((features & (1u << i)) && permutations->features[i])
+        {
+            strcat(defines, "#define ");
+            strcat(defines, permutations->features[i]);
+            strcat(defines, "\n");
+        }
+    }
+
+    return defines;
+}
+
+/**
+ * Prüft, ob der Treiber Programmbinaries unterstützt.
+ * 
+ * @return true, wenn mindestens ein Binärformat existiert
+ */
+static bool shader_binaryCacheSupported(void)
+{
+    static GLint formatCount = -1;
+    if (formatCount < 0)
+    {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    }
+    return formatCount > 0;
+}
+
+/**
+ * Bestimmt den Pfad der Cache-Datei einer Permutation.
+ * 
+ * @param permutations die Permutationen
+ * @param features die Merkmale der Permutation
+ * @param path Ziel für den Pfad
+ * @param size die Größe des Ziels
+ */
+static void shader_cachePath(ShaderPermutations *permutations, unsigned int features,
+                             char *path, size_t size)
+{
+    snprintf(path, size, "%s/%s_%08x.bin", SHADER_CACHE_DIR, permutations->name, features);
+}
+
+/**
+ * Lädt eine Permutation aus dem Programm-Cache.
+ * 
+ * @param permutations die Permutationen
+ * @param features die Merkmale der Permutation
+ * @param tessellated ob die Permutation Tessellation-Stufen enthält
+ * @return die geladene Permutation oder NULL, wenn kein passendes Binary
+ *         existiert oder der Treiber es ablehnt
+ */
+static Shader *shader_loadCachedPermutation(ShaderPermutations *permutations,
+                                            unsigned int features, bool tessellated)
+{
+    char path[512];
+    shader_cachePath(permutations, features, path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return NULL;
+    }
+
+    // Nur Binaries aus demselben Quellcode und mit demselben Treiber verwenden.
+    ShaderCacheHeader header;
+    void *binary = NULL;
+    bool valid = fread(&header, sizeof(header), 1, f) == 1 &&
+                 header.magic == SHADER_CACHE_MAGIC &&
+                 header.hash == (permutations->sourceHash ^ features) &&
+                 header.length > 0;
+    if (valid)
+    {
+        binary = malloc((size_t)header.length);
+        valid = fread(binary, 1, (size_t)header.length, f) == (size_t)header.length;
+    }
+    fclose(f);
+
+    Shader *shader = NULL;
+    if (valid)
+    {
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.format, binary, header.length);
+
+        // Ein Treiber-Update kann ein Binary trotz gleicher Kennung ablehnen,
+        // dann wird die Permutation aus dem Quellcode gebaut.
+        GLint isLinked;
+        glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+        if (isLinked)
+        {
+            shader = shader_createShader();
+            shader->id = program;
+            shader->linked = true;
+            shader->tessellated = tessellated;
+        }
+        else
+        {
+            glDeleteProgram(program);
+        }
+    }
+
+    free(binary);
+    return shader;
+}
+
+/**
+ * Legt das Binary einer gerade gebauten Permutation im Programm-Cache ab.
+ * Fehler beim Schreiben werden nur gemeldet, die Permutation bleibt nutzbar.
+ * 
+ * @param permutations die Permutationen
+ * @param features die Merkmale der Permutation
+ * @param shader die gebaute Permutation
+ */
+static void shader_storeCachedPermutation(ShaderPermutations *permutations,
+                                          unsigned int features, Shader *shader)
+{
+    ShaderCacheHeader header = {SHADER_CACHE_MAGIC, permutations->sourceHash ^ features, 0, 0};
+    glGetProgramiv(shader->id, GL_PROGRAM_BINARY_LENGTH, &header.length);
+    if (header.length <= 0)
+    {
+        return;
+    }
+
+    void *binary = malloc((size_t)header.length);
+    glGetProgramBinary(shader->id, header.length, &header.length, &header.format, binary);
+
+#ifdef _WIN32
+    int dirResult = _mkdir(SHADER_CACHE_DIR);
+#else
+    int dirResult = mkdir(SHADER_CACHE_DIR, 0755);
+#endif
+
+    char path[512];
+    shader_cachePath(permutations, features, path, sizeof(path));
+    FILE *f = (dirResult == 0 || errno == EEXIST) ? fopen(path, "wb") : NULL;
+    if (f == NULL)
+    {
+        fprintf(stderr, "Warning: Could not write shader cache file \"%s\".\n", path);
+        free(binary);
+        return;
+    }
+
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(binary, 1, (size_t)header.length, f);
+    fclose(f);
+    free(binary);
+}
+
+/**
+ * Baut eine Permutation aus dem Quellcode.
+ * 
+ * @param permutations die Permutationen
+ * @param features die Merkmale der Permutation
+ * @return die gebaute Permutation oder NULL bei einem Fehler
+ */
+static Shader *shader_compilePermutation(ShaderPermutations *permutations, unsigned int features)
+{
+    char *defines = shader_buildDefines(permutations, features);
+    Shader *shader = shader_createShader();
+    shader->retrievable = shader_binaryCacheSupported();
+
+    // Alle Stufen werden übersetzt, auch wenn eine davon fehlschlägt, damit
+    // alle Fehlermeldungen auf einmal erscheinen.
+    bool success = true;
+    for (int i = 0; i < permutations->stageCount; i++)
+    {
+        const ShaderStage *stage = &permutations->stages[i];
+        if ((stage->excludeFeatures & features) == 0)
+        {
+            success &= shader_attachShaderFileWithDefines(shader, stage->type,
+                                                          stage->file, defines);
+        }
+    }
+    free(defines);
+
+    if (!success || !shader_buildShader(shader))
+    {
+        fprintf(stderr, "Error: Could not build permutation 0x%x of shader \"%s\".\n",
+                features, permutations->name);
+        shader_deleteShader(shader);
+        return NULL;
+    }
+
+    return shader;
+}
+
+/**
+ * Prüft, ob eine Permutation Tessellation-Stufen enthält.
+ * 
+ * @param permutations die Permutationen
+ * @param features die Merkmale der Permutation
+ * @return true, wenn eine Tessellation-Stufe nicht ausgeschlossen ist
+ */
+static bool shader_permutationTessellated(ShaderPermutations *permutations, unsigned int features)
+{
+    for (int i = 0; i < permutations->stageCount; i++)
+    {
+        const ShaderStage *stage = &permutations->stages[i];
+        if ((stage->excludeFeatures & features) == 0 &&
+            (stage->type == GL_TESS_CONTROL_SHADER || stage->type == GL_TESS_EVALUATION_SHADER))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 //////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
 
 Shader *shader_createShader()
@@ -129,6 +800,8 @@ Shader *shader_createShader()
     Shader *shader = malloc(sizeof(Shader));
     shader->id = 0;
     shader->linked = false;
+    shader->tessellated = false;
+    shader->retrievable = false;
     shader->fileCount = 0;
     shader->shaderFiles = NULL;
     shader->uniforms = NULL;
@@ -139,6 +812,12 @@ Shader *shader_createShader()
 }
 
 bool shader_attachShaderFile(Shader *shader, GLenum type, const char *file)
+{
+    return shader_attachShaderFileWithDefines(shader, type, file, NULL);
+}
+
+bool shader_attachShaderFileWithDefines(Shader *shader, GLenum type,
+                                        const char *file, const char *defines)
 {
     // Wenn der Shader bereits gelinkt wurde, darf keine neue Datei
     // hinzugefügt werden.
@@ -150,7 +829,7 @@ bool shader_attachShaderFile(Shader *shader, GLenum type, const char *file)
 
     // Zuerst laden und kompilieren wir die angegebene Datei.
     bool success;
-    GLuint glslShader = shader_createGLSLShader(type, file, &success);
+    GLuint glslShader = shader_createGLSLShader(type, file, defines, &success);
 
     // Danach wird geprüft, ob die Operation erfolgreich war.
     if (success)
@@ -161,6 +840,11 @@ bool shader_attachShaderFile(Shader *shader, GLenum type, const char *file)
             shader->shaderFiles,
             sizeof(GLuint) * shader->fileCount);
         shader->shaderFiles[shader->fileCount - 1] = glslShader;
+
+        if (type == GL_TESS_CONTROL_SHADER || type == GL_TESS_EVALUATION_SHADER)
+        {
+            shader->tessellated = true;
+        }
     }
 
     return success;
@@ -186,6 +870,10 @@ bool shader_buildShader(Shader *shader)
     bool success = true;
     int i;
     GLuint newProgram = glCreateProgram();
+    if (shader->retrievable)
+    {
+        glProgramParameteri(newProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
 
     // Wir iterieren über alle Shader-Dateien und hängen sie an das neue
     // Programm mit an.
@@ -258,6 +946,16 @@ void shader_useShader(Shader *shader)
     glUseProgram(shader->id);
 }
 
+GLuint shader_getId(Shader *shader)
+{
+    return shader->id;
+}
+
+bool shader_isTessellated(Shader *shader)
+{
+    return shader->tessellated;
+}
+
 void shader_deleteShader(Shader *shader)
 {
     // Wenn kein Shader existiert muss nichts gelöscht werden.
@@ -290,11 +988,16 @@ void shader_deleteShader(Shader *shader)
 }
 
 Shader* shader_createCompShader(const char* comp)
+{
+    return shader_createCompShaderWithDefines(comp, NULL);
+}
+
+Shader* shader_createCompShaderWithDefines(const char* comp, const char* defines)
 {
     // Zuerst werden alle benötigten Bestandteile des Shaders angelegt,
     // egal ob einer Fehler verursacht.
     Shader* newShader = shader_createShader();
-    bool compOk = shader_attachShaderFile(newShader, GL_COMPUTE_SHADER, comp);
+    bool compOk = shader_attachShaderFileWithDefines(newShader, GL_COMPUTE_SHADER, comp, defines);
 
     // Danach wird auf mögliche Fehler geprüft.
     if (compOk)
@@ -403,6 +1106,138 @@ Shader *shader_createVeCoEvFrShader(const char *vert, const char *frag, const ch
     return NULL;
 }
 
+ShaderPermutations *shader_createPermutations(const char *name,
+                                              const ShaderStage *stages, int stageCount,
+                                              const char *const *features, int featureCount)
+{
+    ShaderPermutations *permutations = malloc(sizeof(ShaderPermutations));
+    permutations->name = malloc(strlen(name) + 1);
+    strcpy(permutations->name, name);
+
+    // Pfade und Namen kopieren, damit der Aufrufer keine Literale übergeben muss.
+    permutations->stageCount = stageCount;
+    permutations->stages = malloc(sizeof(ShaderStage) * stageCount);
+    for (int i = 0; i < stageCount; i++)
+    {
+        char *file = malloc(strlen(stages[i].file) + 1);
+        strcpy(file, stages[i].file);
+        permutations->stages[i] = stages[i];
+        permutations->stages[i].file = file;
+    }
+
+    permutations->featureCount = featureCount;
+    permutations->featureMask = 0;
+    permutations->features = malloc(sizeof(char *) * featureCount);
+    for (int i = 0; i < featureCount; i++)
+    {
+        permutations->features[i] = NULL;
+        if (features[i])
+        {
+            permutations->features[i] = malloc(strlen(features[i]) + 1);
+            strcpy(permutations->features[i], features[i]);
+            permutations->featureMask |= 1u << i;
+        }
+    }
+
+    permutations->dependencies = NULL;
+    shader_updateDependencies(permutations);
+    permutations->variants = NULL;
+
+    return permutations;
+}
+
+Shader *shader_getPermutation(ShaderPermutations *permutations, unsigned int features)
+{
+    // Merkmale ohne Namen ändern den Quellcode nicht.
+    features &= permutations->featureMask;
+
+    ptrdiff_t index = stbds_hmgeti(permutations->variants, features);
+    if (index >= 0)
+    {
+        return permutations->variants[index].value;
+    }
+
+    // Erste Anfrage: zuerst im Cache suchen, sonst aus dem Quellcode bauen.
+    Shader *shader = NULL;
+    if (shader_binaryCacheSupported())
+    {
+        shader = shader_loadCachedPermutation(
+            permutations, features, shader_permutationTessellated(permutations, features));
+    }
+    if (shader == NULL)
+    {
+        shader = shader_compilePermutation(permutations, features);
+        if (shader != NULL && shader->retrievable)
+        {
+            shader_storeCachedPermutation(permutations, features, shader);
+        }
+    }
+
+    // Auch Fehlschläge merken, damit nicht jeder Frame neu übersetzt.
+    stbds_hmput(permutations->variants, features, shader);
+    return shader;
+}
+
+void shader_reloadPermutations(ShaderPermutations *permutations)
+{
+    // Ohne geänderte Datei bleiben Permutationen und Cache gültig.
+    if (!shader_dependenciesChanged(permutations))
+    {
+        return;
+    }
+    shader_updateDependencies(permutations);
+
+    for (ptrdiff_t i = 0; i < stbds_hmlen(permutations->variants); i++)
+    {
+        unsigned int features = permutations->variants[i].key;
+        Shader *shader = shader_compilePermutation(permutations, features);
+        if (shader == NULL)
+        {
+            continue;
+        }
+
+        if (shader->retrievable)
+        {
+            shader_storeCachedPermutation(permutations, features, shader);
+        }
+        shader_deleteShader(permutations->variants[i].value);
+        permutations->variants[i].value = shader;
+    }
+}
+
+void shader_deletePermutations(ShaderPermutations *permutations)
+{
+    if (!permutations)
+    {
+        return;
+    }
+
+    for (ptrdiff_t i = 0; i < stbds_hmlen(permutations->variants); i++)
+    {
+        shader_deleteShader(permutations->variants[i].value);
+    }
+    stbds_hmfree(permutations->variants);
+
+    for (int i = 0; i < (int)stbds_arrlen(permutations->dependencies); i++)
+    {
+        free(permutations->dependencies[i].file);
+    }
+    stbds_arrfree(permutations->dependencies);
+
+    for (int i = 0; i < permutations->stageCount; i++)
+    {
+        free((void *)permutations->stages[i].file);
+    }
+    for (int i = 0; i < permutations->featureCount; i++)
+    {
+        free(permutations->features[i]);
+    }
+    free(permutations->stages);
+    free(permutations->features);
+    free(permutations->name);
+    free(permutations);
+}
+
 void shader_setMat4(Shader *shader, char *name, mat4 *mat)
 {
     GLint location = shader_getUniformLocation(shader, name);
@@ -427,6 +1262,12 @@ void shader_setInt(Shader *shader, char *name, int val)
     glUniform1i(location, val);
 }
 
+void shader_setUInt(Shader *shader, char *name, unsigned int val)
+{
+    GLint location = shader_getUniformLocation(shader, name);
+    glUniform1ui(location, val);
+}
+
 void shader_setFloat(Shader *shader, char *name, float val)
 {
     GLint location = shader_getUniformLocation(shader, name);
@@ -10,12 +10,32 @@
 
 #include "common.h"
 
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Verzeichnis für die Programmbinaries der Permutationen.
+#define SHADER_CACHE_DIR "shadercache"
+
 //////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
 
 // Datenstruktur, die einen Shader repräsentiert.
 struct Shader;
 typedef struct Shader Shader;
 
+// Eine Datei eines Programms mit Permutationen.
+struct ShaderStage
+{
+    GLenum type;                  // Shadertyp der Datei
+    const char *file;             // Pfad zur Datei
+    unsigned int excludeFeatures; // Merkmale, mit denen die Stufe entfällt
+};
+typedef struct ShaderStage ShaderStage;
+
+// Alle Permutationen eines Programms. Jede Permutation wird durch eine
+// Bitmaske von Merkmalen bestimmt, die als Defines in den Quellcode
+// eingefügt werden.
+struct ShaderPermutations;
+typedef struct ShaderPermutations ShaderPermutations;
+
 //////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
 
 /**
@@ -30,6 +50,12 @@ Shader* shader_createShader();
  * Der Code wird dabei auch sofort übersetzt und nur bei erfolg an den
  * Shader gehängt.
  * 
+ * Zeilen der Form #include "pfad" werden vorher durch die Datei unter
+ * RESOURCE_PATH ersetzt, jede Datei wird dabei nur einmal eingefügt.
+ * Über #line Anweisungen nennen Fehlermeldungen die Zeile in der
+ * jeweiligen Datei, die Zuordnung der Quellnummern zu den Dateien wird
+ * zusammen mit der Meldung ausgegeben.
+ * 
  * Bei Misserfolg gibt die Funktion eine Fehlermeldung aus.
  * 
  * @param shader der Shader an den die Datei angehängt werden soll.
@@ -39,6 +65,22 @@ Shader* shader_createShader();
  */
 bool shader_attachShaderFile(Shader* shader, GLenum type, const char* file);
 
+/**
+ * Hängt eine GLSL Datei an einen bestehenden Shader an und fügt dabei
+ * zusätzliche Defines direkt hinter der #version Zeile ein. Darüber können
+ * Konstanten wie Workgroup-Größen zur Laufzeit festgelegt werden.
+ * 
+ * Bei Misserfolg gibt die Funktion eine Fehlermeldung aus.
+ * 
+ * @param shader der Shader an den die Datei angehängt werden soll.
+ * @param type der Shadertyp der Datei.
+ * @param file der Pfad zur Datei.
+ * @param defines die einzufügenden Zeilen (z.B. "#define A 1\n") oder NULL
+ * @return true, wenn die operation erfolgreich war, false wenn nicht.
+ */
+bool shader_attachShaderFileWithDefines(Shader* shader, GLenum type,
+                                        const char* file, const char* defines);
+
 /**
  * Baut einen Shader zusammen (linken) nachdem mehrere Dateien an ihn
  * gehängt wurden.
@@ -58,6 +100,23 @@ bool shader_buildShader(Shader* shader);
  */
 void shader_useShader(Shader* shader);
 
+/**
+ * Liefert die OpenGL ID des Programms hinter einem Shader.
+ * 
+ * @param shader der Shader
+ * @return die Programm ID
+ */
+GLuint shader_getId(Shader* shader);
+
+/**
+ * Gibt an, ob ein Shader Tessellation-Stufen enthält. Solche Programme
+ * müssen mit GL_PATCHES statt GL_TRIANGLES gezeichnet werden.
+ * 
+ * @param shader der Shader
+ * @return true, wenn der Shader Tessellation-Stufen enthält
+ */
+bool shader_isTessellated(Shader* shader);
+
 /**
  * Löscht einen bestehenden Shader und gibt alle Ressourcen wieder frei.
  * Dabei ist es egal, ob der Shader bereits gebaut wurde oder nicht.
@@ -89,6 +148,71 @@ Shader* shader_createVeCoEvFrShader(const char* vert, const char* frag, const ch
  */
 Shader* shader_createCompShader(const char* comp);
 
+/**
+ * Hilfsfunktion zum Anlegen eines Compute-Shaders mit zusätzlichen Defines.
+ * 
+ * Bei Misserfolg gibt die Funktion eine Fehlermeldung aus.
+ * 
+ * @param comp der Pfad zum Compute-Shader
+ * @param defines die einzufügenden Zeilen oder NULL
+ * @return ein Shader, der aus der übergebenen Datei gebaut wurde oder NULL
+ *         wenn etwas schief gegangen ist.
+ */
+Shader* shader_createCompShaderWithDefines(const char* comp, const char* defines);
+
+/**
+ * Legt die Permutationen eines Programms an. Kompiliert wird dabei noch
+ * nichts, jede Permutation entsteht erst bei ihrer ersten Anfrage.
+ * 
+ * Das Bit i einer Merkmalsmaske fügt "#define features[i]" hinter der
+ * #version Zeile aller Stufen ein. Merkmale mit NULL als Namen werden
+ * ignoriert, sodass sich mehrere Programme eine Bitbelegung teilen können,
+ * ohne unnötige Permutationen zu erzeugen.
+ * 
+ * Gebaute Permutationen werden zusätzlich als Programmbinary im Verzeichnis
+ * SHADER_CACHE_DIR abgelegt und beim nächsten Start von dort geladen,
+ * solange sich Quellcode und Treiber nicht geändert haben. Zum Quellcode
+ * zählen auch alle per #include eingebundenen Dateien.
+ * 
+ * @param name eindeutiger Name des Programms für den Cache
+ * @param stages die Dateien des Programms
+ * @param stageCount die Anzahl der Dateien
+ * @param features die Namen der Merkmale, Index entspricht dem Bit
+ * @param featureCount die Anzahl der Merkmale
+ * @return die neuen Permutationen
+ */
+ShaderPermutations* shader_createPermutations(const char* name,
+                                              const ShaderStage* stages, int stageCount,
+                                              const char* const* features, int featureCount);
+
+/**
+ * Liefert die Permutation zu einer Merkmalsmaske und baut sie bei Bedarf.
+ * Schlägt das Bauen fehl, wird dies bis zum nächsten Neuladen nicht erneut
+ * versucht.
+ * 
+ * @param permutations die Permutationen des Programms
+ * @param features die gewünschten Merkmale
+ * @return die Permutation oder NULL, wenn sie nicht gebaut werden konnte
+ */
+Shader* shader_getPermutation(ShaderPermutations* permutations, unsigned int features);
+
+/**
+ * Baut alle bisher angefragten Permutationen aus dem aktuellen Quellcode
+ * neu, sofern sich eine ihrer Dateien oder der eingebundenen Dateien
+ * geändert hat. Eine Permutation wird nur ersetzt, wenn der neue Code
+ * fehlerfrei übersetzt werden konnte.
+ * 
+ * @param permutations die Permutationen des Programms
+ */
+void shader_reloadPermutations(ShaderPermutations* permutations);
+
+/**
+ * Löscht alle Permutationen eines Programms.
+ * 
+ * @param permutations die zu löschenden Permutationen
+ */
+void shader_deletePermutations(ShaderPermutations* permutations);
+
 Shader *shader_createVeGeomFrShader(const char *vert, const char *geom, const char *frag);
 /**
  * Hilfsfunktion zum Anlegen eines SkyboxShaders, der aus einem Vertex- und
@@ -140,6 +264,17 @@ void shader_setVec3(Shader* shader, char* name, vec3* vec3);
  */
 void shader_setInt(Shader* shader, char* name, int val);
 
+/**
+ * Übergibt einen vorzeichenlosen Integer an einen Shader über eine
+ * Uniform-Variable.
+ * Der Shader muss zuvor mit shader_useShader aktiviert worden sein!
+ * 
+ * @param shader der Shader, bei dem die Uniform Variable gesetzt werden soll
+ * @param name der Name der Uniform Variable
+ * @param val der zu setzende Wert
+ */
+void shader_setUInt(Shader* shader, char* name, unsigned int val);
+
 /**
  * Übergibt einen Float an einen Shader über eine Uniform-Variable.
  * Der Shader muss zuvor mit shader_useShader aktiviert worden sein!
@@ -35,13 +35,17 @@ void shadowMapping_createDirLightSpaceMat(mat4 lightSpaceMat, vec3 lightDir)
 }
 
 /**
- * Rendert die Schatten des Richtungslichtes
+ * Rendert die Schatten des Richtungslichtes. Mit Occlusion Culling wird nach
+ * der fruehen Liste die Pyramide aus der Shadow-Map aufgebaut und die spaete
+ * Liste nachgezeichnet.
  *
  * @param ctx Programmkontext
- * @param objectMatrix Objekt-Matrix der Szene
+ * @param list Sichtbarkeitsliste des Lichtes
+ * @param occlusion Occlusion Culling des Lichtes oder NULL
  * @param lightSpaceMat aktuelle LightSpaceMatrix
  */ 
-void shadowMapping_renderDirLightShadowMap(ProgContext *ctx, mat4 *objectMatrix, mat4 *lightSpaceMat)
+void shadowMapping_renderDirLightShadowMap(ProgContext *ctx, int list, Occlusion *occlusion,
+                                           mat4 *lightSpaceMat)
 {
     RenderingData *data = ctx->rendering;
     InputData *input = ctx->input;
@@ -50,7 +54,6 @@ void shadowMapping_renderDirLightShadowMap(ProgContext *ctx, mat4 *objectMatrix,
     shader_useShader(data->dirShadow);
     //Uniforms übergeben
     shader_setMat4(data->dirShadow, "lightSpaceMat", lightSpaceMat);
-    shader_setMat4(data->dirShadow, "modelMat", objectMatrix);
     //Viewport auf Texturdimensionen der Shadowmap setzen
     glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
     //Framebuffer aktiveren
@@ -62,7 +65,18 @@ void shadowMapping_renderDirLightShadowMap(ProgContext *ctx, mat4 *objectMatrix,
     glClear(GL_DEPTH_BUFFER_BIT);
 
     //Tiefeninformationen aus Sicht des Lichts in Depth-Textur schreiben
-    model_drawModelTris(input->rendering.userScene->model, data->dirShadow);
+    scene_drawSceneTris(input->rendering.userScene, list, data->dirShadow,
+                        data->shadowLodBias);
+    if (occlusion)
+    {
+        occlusion_buildPyramid(occlusion, &data->hiz, data->depthFBO.depthMap,
+                               SHADOW_WIDTH, SHADOW_HEIGHT, *lightSpaceMat);
+        occlusion_cullLate(occlusion, input->rendering.userScene, &data->hiz);
+
+        shader_useShader(data->dirShadow);
+        scene_drawSceneTris(input->rendering.userScene, occlusion_getLateList(occlusion),
+                            data->dirShadow, data->shadowLodBias);
+    }
     printf("Loaded Directional Shadow-Map\n");
     //ViewPort zurücksetzen
     glViewport(0, 0, ctx->winData->width, ctx->winData->height);
@@ -73,7 +87,7 @@ void shadowMapping_renderDirLightShadowMap(ProgContext *ctx, mat4 *objectMatrix,
     glDepthMask(GL_FALSE);
 }
 
-void shadowMapping_renderPointLightShadowMap(ProgContext *ctx, mat4 *objectMatrix, mat4 pointLightTransforms[6], PointLight *currPointLight)
+void shadowMapping_renderPointLightShadowMap(ProgContext *ctx, int list, mat4 pointLightTransforms[6], PointLight *currPointLight)
 {
     RenderingData *data = ctx->rendering;
     InputData *input = ctx->input;
@@ -81,7 +95,6 @@ void shadowMapping_renderPointLightShadowMap(ProgContext *ctx, mat4 *objectMatri
     //Directional Shadow Shader aktivieren
     shader_useShader(data->pointShadow);
     //Uniforms übergeben
-    shader_setMat4(data->pointShadow, "model", objectMatrix);
     for (int i = 0; i < 6; i++)
     {
         char buffer[64];
@@ -101,7 +114,8 @@ void shadowMapping_renderPointLightShadowMap(ProgContext *ctx, mat4 *objectMatri
     glClear(GL_DEPTH_BUFFER_BIT);
 
     //Tiefeninformationen aus Sicht des Lichts in Depth-Textur schreiben
-    model_drawModelTris(input->rendering.userScene->model, data->pointShadow);
+    scene_drawSceneTris(input->rendering.userScene, list, data->pointShadow,
+                        data->shadowLodBias);
     //ViewPort zurücksetzen
     glViewport(0, 0, ctx->winData->width, ctx->winData->height);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -0,0 +1,572 @@
+/**
+ * Modul für das Vereinfachen von Meshes zu Detailstufen (LODs).
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "simplify.h"
+
+#include <math.h>
+#include <string.h>
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Meshes mit weniger Dreiecken werden nicht vereinfacht.
+#define SIMPLIFY_MIN_TRIANGLES 64
+
+// Anteil der Dreiecke, den jede Stufe gegenüber der vorherigen anstrebt.
+#define SIMPLIFY_LOD_RATIO 0.5f
+
+// Erreicht eine Stufe nicht mindestens diesen Anteil, wird sie verworfen.
+#define SIMPLIFY_MIN_REDUCTION 0.85f
+
+// Maximaler Fehler einer Stufe relativ zur Diagonale der Bounding Box.
+#define SIMPLIFY_MAX_ERROR 0.05f
+
+// Mindestwert für den Kosinus zwischen alter und neuer Dreiecksnormale.
+// Darunter gilt ein Dreieck durch den Kollaps als umgeklappt.
+#define SIMPLIFY_MIN_NORMAL_DOT 0.2f
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Symmetrische 4x4 Fehlerquadrik mit dem Gewicht der enthaltenen Ebenen.
+struct SimplifyQuadric
+{
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+    double w;
+};
+typedef struct SimplifyQuadric SimplifyQuadric;
+
+// Ein möglicher Kantenkollaps von Vertex from auf Vertex to.
+struct SimplifyCollapse
+{
+    float cost;
+    GLint from;
+    GLint to;
+};
+typedef struct SimplifyCollapse SimplifyCollapse;
+
+// Ungerichtete Kante zwischen zwei Vertices, a ist immer der kleinere Index.
+struct SimplifyEdge
+{
+    GLint a;
+    GLint b;
+};
+typedef struct SimplifyEdge SimplifyEdge;
+
+// Position eines Vertex zum Finden von Nähten.
+struct SimplifyPosition
+{
+    float x, y, z;
+    GLint index;
+};
+typedef struct SimplifyPosition SimplifyPosition;
+
+// Arbeitsdaten der Vereinfachung eines Meshes.
+struct Simplifier
+{
+    const Vertex* vertices;
+    GLuint vertexCount;
+
+    SimplifyQuadric* quadrics; // Quadrik pro Vertex
+    bool* locked;              // Vertex darf nicht verschoben werden
+    bool* touched;             // Vertex wurde im aktuellen Durchlauf verändert
+    GLint* remap;              // Ziel jedes Vertex im aktuellen Durchlauf
+
+    GLuint* adjOffsets;        // Dreiecke pro Vertex (CSR)
+    GLuint* adjTriangles;
+    GLuint adjCapacity;
+
+    SimplifyCollapse* collapses;
+    GLuint collapseCapacity;
+};
+typedef struct Simplifier Simplifier;
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Addiert die Quadrik einer Ebene n * p + d = 0 mit Gewicht w.
+ *
+ * @param q die Quadrik
+ * @param n die normierte Ebenennormale
+ * @param d der Abstand der Ebene
+ * @param w das Gewicht der Ebene
+ */
+static void simplify_addPlane(SimplifyQuadric* q, const vec3 n, float d, float w)
+{
+    double a = n[0], b = n[1], c = n[2];
+    q->a2 += w * a * a; q->ab += w * a * b; q->ac += w * a * c; q->ad += w * a * d;
+    q->b2 += w * b * b; q->bc += w * b * c; q->bd += w * b * d;
+    q->c2 += w * c * c; q->cd += w * c * d;
+    q->d2 += w * (double)d * d;
+    q->w += w;
+}
+
+/**
+ * Addiert eine Quadrik auf eine andere.
+ *
+ * @param dst die Zielquadrik
+ * @param src die zu addierende Quadrik
+ */
+static void simplify_addQuadric(SimplifyQuadric* dst, const SimplifyQuadric* src)
+{
+    dst->a2 += src->a2; dst->ab += src->ab; dst->ac += src->ac; dst->ad += src->ad;
+    dst->b2 += src->b2; dst->bc += src->bc; dst->bd += src->bd;
+    dst->c2 += src->c2; dst->cd += src->cd;
+    dst->d2 += src->d2;
+    dst->w += src->w;
+}
+
+/**
+ * Berechnet den mittleren quadratischen Abstand eines Punktes zu den Ebenen
+ * zweier Quadriken.
+ *
+ * @param q0 die erste Quadrik
+ * @param q1 die zweite Quadrik
+ * @param p der Punkt
+ * @return der Fehler
+ */
+static float simplify_error(const SimplifyQuadric* q0, const SimplifyQuadric* q1,
+                            const vec3 p)
+{
+    SimplifyQuadric q = *q0;
+    simplify_addQuadric(&q, q1);
+
+    double x = p[0], y = p[1], z = p[2];
+    double e = q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x
+             + q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y
+             + q.c2 * z * z + 2.0 * q.cd * z
+             + q.d2;
+
+    if (q.w > 0.0)
+    {
+        e /= q.w;
+    }
+    return e > 0.0 ? (float)e : 0.0f;
+}
+
+/**
+ * Vergleicht zwei Positionen für qsort.
+ */
+static int simplify_comparePositions(const void* a, const void* b)
+{
+    const SimplifyPosition* pa = a;
+    const SimplifyPosition* pb = b;
+    if (pa->x != pb->x) return pa->x < pb->x ? -1 : 1;
+    if (pa->y != pb->y) return pa->y < pb->y ? -1 : 1;
+    if (pa->z != pb->z) return pa->z < pb->z ? -1 : 1;
+    return 0;
+}
+
+/**
+ * Vergleicht zwei Kanten für qsort.
+ */
+static int simplify_compareEdges(const void* a, const void* b)
+{
+    const SimplifyEdge* ea = a;
+    const SimplifyEdge* eb = b;
+    if (ea->a != eb->a) return ea->a < eb->a ? -1 : 1;
+    if (ea->b != eb->b) return ea->b < eb->b ? -1 : 1;
+    return 0;
+}
+
+/**
+ * Vergleicht zwei Kollapse nach ihren Kosten für qsort.
+ */
+static int simplify_compareCollapses(const void* a, const void* b)
+{
+    float ca = ((const SimplifyCollapse*)a)->cost;
+    float cb = ((const SimplifyCollapse*)b)->cost;
+    return ca < cb ? -1 : (ca > cb ? 1 : 0);
+}
+
+/**
+ * Sperrt alle Vertices an Nähten, offenen Rändern und nicht-mannigfaltigen
+ * Kanten.
+ *
+ * @param s die Arbeitsdaten
+ * @param indices die Indices des Originals
+ * @param triCount die Anzahl der Dreiecke
+ */
+static void simplify_lockVertices(Simplifier* s, const GLint* indices, GLuint triCount)
+{
+    // Nähte: mehrere Vertices mit gleicher Position
+    SimplifyPosition* positions = malloc(sizeof(SimplifyPosition) * s->vertexCount);
+    for (GLuint i = 0; i < s->vertexCount; i++)
+    {
+        positions[i].x = s->vertices[i].position[0];
+        positions[i].y = s->vertices[i].position[1];
+        positions[i].z = s->vertices[i].position[2];
+        positions[i].index = (GLint)i;
+    }
+    qsort(positions, s->vertexCount, sizeof(SimplifyPosition), simplify_comparePositions);
+    for (GLuint i = 1; i < s->vertexCount; i++)
+    {
+        if (simplify_comparePositions(&positions[i - 1], &positions[i]) == 0)
+        {
+            s->locked[positions[i - 1].index] = true;
+            s->locked[positions[i].index] = true;
+        }
+    }
+    free(positions);
+
+    // Ränder: Kanten, die nicht genau zwei Dreiecke besitzen
+    GLuint edgeCount = triCount * 3;
+    SimplifyEdge* edges = malloc(sizeof(SimplifyEdge) * edgeCount);
+    for (GLuint t = 0; t < triCount; t++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            GLint a = indices[t * 3 + k];
+            GLint b = indices[t * 3 + (k + 1) % 3];
+            edges[t * 3 + k].a = a < b ? a : b;
+            edges[t * 3 + k].b = a < b ? b : a;
+        }
+    }
+    qsort(edges, edgeCount, sizeof(SimplifyEdge), simplify_compareEdges);
+    for (GLuint i = 0; i < edgeCount;)
+    {
+        GLuint run = 1;
+        while (i + run < edgeCount
+               && simplify_compareEdges(&edges[i], &edges[i + run]) == 0)
+        {
+            run++;
+        }
+        if (run != 2)
+        {
+            s->locked[edges[i].a] = true;
+            s->locked[edges[i].b] = true;
+        }
+        i += run;
+    }
+    free(edges);
+}
+
+/**
+ * Baut die Quadriken aller Vertices aus den Dreiecken des Originals auf.
+ * Jede Ebene wird mit der Fläche ihres Dreiecks gewichtet.
+ *
+ * @param s die Arbeitsdaten
+ * @param indices die Indices des Originals
+ * @param triCount die Anzahl der Dreiecke
+ */
+static void simplify_initQuadrics(Simplifier* s, const GLint* indices, GLuint triCount)
+{
+    memset(s->quadrics, 0, sizeof(SimplifyQuadric) * s->vertexCount);
+    for (GLuint t = 0; t < triCount; t++)
+    {
+        const float* p0 = s->vertices[indices[t * 3]].position;
+        const float* p1 = s->vertices[indices[t * 3 + 1]].position;
+        const float* p2 = s->vertices[indices[t * 3 + 2]].position;
+
+        vec3 e1, e2, n;
+        glm_vec3_sub((float*)p1, (float*)p0, e1);
+        glm_vec3_sub((float*)p2, (float*)p0, e2);
+        glm_vec3_cross(e1, e2, n);
+        float length = glm_vec3_norm(n);
+        if (length <= 0.0f)
+        {
+            continue;
+        }
+        glm_vec3_scale(n, 1.0f / length, n);
+        float d = -glm_vec3_dot(n, (float*)p0);
+        float area = length * 0.5f;
+
+        for (int k = 0; k < 3; k++)
+        {
+            simplify_addPlane(&s->quadrics[indices[t * 3 + k]], n, d, area);
+        }
+    }
+}
+
+/**
+ * Baut die Liste der Dreiecke pro Vertex auf.
+ *
+ * @param s die Arbeitsdaten
+ * @param indices die aktuellen Indices
+ * @param triCount die Anzahl der Dreiecke
+ */
+static void simplify_buildAdjacency(Simplifier* s, const GLint* indices, GLuint triCount)
+{
+    memset(s->adjOffsets, 0, sizeof(GLuint) * (s->vertexCount + 1));
+    for (GLuint i = 0; i < triCount * 3; i++)
+    {
+        s->adjOffsets[indices[i] + 1]++;
+    }
+    for (GLuint v = 0; v < s->vertexCount; v++)
+    {
+        s->adjOffsets[v + 1] += s->adjOffsets[v];
+    }
+
+    if (triCount * 3 > s->adjCapacity)
+    {
+        s->adjCapacity = triCount * 3;
+        free(s->adjTriangles);
+        s->adjTriangles = malloc(sizeof(GLuint) * s->adjCapacity);
+    }
+
+    // Die Offsets werden beim Einfügen hochgezählt und danach zurückgesetzt.
+    for (GLuint t = 0; t < triCount; t++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            s->adjTriangles[s->adjOffsets[indices[t * 3 + k]]++] = t;
+        }
+    }
+    for (GLuint v = s->vertexCount; v > 0; v--)
+    {
+        s->adjOffsets[v] = s->adjOffsets[v - 1];
+    }
+    s->adjOffsets[0] = 0;
+}
+
+/**
+ * Prüft, ob ein Kollaps ein Dreieck umklappen oder entarten lässt.
+ *
+ * @param s die Arbeitsdaten
+ * @param indices die aktuellen Indices
+ * @param from der zu verschiebende Vertex
+ * @param to der Zielvertex
+ * @param removed Ausgabe für die Anzahl der wegfallenden Dreiecke
+ * @return true, wenn der Kollaps nicht erlaubt ist
+ */
+static bool simplify_flips(Simplifier* s, const GLint* indices, GLint from, GLint to,
+                           GLuint* removed)
+{
+    *removed = 0;
+    for (GLuint k = s->adjOffsets[from]; k < s->adjOffsets[from + 1]; k++)
+    {
+        const GLint* tri = &indices[s->adjTriangles[k] * 3];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+        {
+            (*removed)++;
+            continue;
+        }
+
+        vec3 p[3], q[3];
+        for (int i = 0; i < 3; i++)
+        {
+            glm_vec3_copy((float*)s->vertices[tri[i]].position, p[i]);
+            glm_vec3_copy(tri[i] == from ? (float*)s->vertices[to].position : p[i], q[i]);
+        }
+
+        vec3 e1, e2, nOld, nNew;
+        glm_vec3_sub(p[1], p[0], e1);
+        glm_vec3_sub(p[2], p[0], e2);
+        glm_vec3_cross(e1, e2, nOld);
+        glm_vec3_sub(q[1], q[0], e1);
+        glm_vec3_sub(q[2], q[0], e2);
+        glm_vec3_cross(e1, e2, nNew);
+
+        float limit = SIMPLIFY_MIN_NORMAL_DOT * glm_vec3_norm(nOld) * glm_vec3_norm(nNew);
+        if (glm_vec3_dot(nOld, nNew) <= limit)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Vereinfacht die Dreiecke in mehreren Durchläufen, bis die Zielanzahl
+ * oder der maximale Fehler erreicht ist. In jedem Durchlauf werden alle
+ * möglichen Kollapse nach Kosten sortiert und gierig ausgeführt, wobei
+ * jeder Vertex nur einmal verändert werden darf.
+ *
+ * @param s die Arbeitsdaten
+ * @param indices die Indices, werden an Ort und Stelle verkleinert
+ * @param triCount die Anzahl der Dreiecke
+ * @param target die angestrebte Anzahl der Dreiecke
+ * @param maxCost die maximalen Kosten eines Kollapses
+ * @param worstCost Ein- und Ausgabe für die höchsten ausgeführten Kosten
+ * @return die neue Anzahl der Dreiecke
+ */
+static GLuint simplify_reduce(Simplifier* s, GLint* indices, GLuint triCount,
+                              GLuint target, float maxCost, float* worstCost)
+{
+    while (triCount > target)
+    {
+        simplify_buildAdjacency(s, indices, triCount);
+
+        // Für jede Kante die günstigere erlaubte Richtung sammeln.
+        if (triCount * 3 > s->collapseCapacity)
+        {
+            s->collapseCapacity = triCount * 3;
+            free(s->collapses);
+            s->collapses = malloc(sizeof(SimplifyCollapse) * s->collapseCapacity);
+        }
+        GLuint collapseCount = 0;
+        for (GLuint t = 0; t < triCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                GLint a = indices[t * 3 + k];
+                GLint b = indices[t * 3 + (k + 1) % 3];
+                float costAB = s->locked[a] ? INFINITY
+                    : simplify_error(&s->quadrics[a], &s->quadrics[b], s->vertices[b].position);
+                float costBA = s->locked[b] ? INFINITY
+                    : simplify_error(&s->quadrics[a], &s->quadrics[b], s->vertices[a].position);
+
+                SimplifyCollapse c = costAB <= costBA
+                    ? (SimplifyCollapse){costAB, a, b}
+                    : (SimplifyCollapse){costBA, b, a};
+                if (c.cost <= maxCost)
+                {
+                    s->collapses[collapseCount++] = c;
+                }
+            }
+        }
+        qsort(s->collapses, collapseCount, sizeof(SimplifyCollapse),
+              simplify_compareCollapses);
+
+        for (GLuint v = 0; v < s->vertexCount; v++)
+        {
+            s->remap[v] = (GLint)v;
+        }
+        memset(s->touched, 0, sizeof(bool) * s->vertexCount);
+
+        GLuint remaining = triCount;
+        GLuint applied = 0;
+        for (GLuint i = 0; i < collapseCount && remaining > target; i++)
+        {
+            SimplifyCollapse* c = &s->collapses[i];
+            if (s->touched[c->from] || s->touched[c->to])
+            {
+                continue;
+            }
+
+            GLuint removed;
+            if (simplify_flips(s, indices, c->from, c->to, &removed))
+            {
+                continue;
+            }
+
+            // Alle Vertices der betroffenen Dreiecke bis zum nächsten
+            // Durchlauf sperren, damit die Prüfung oben gültig bleibt.
+            for (GLuint k = s->adjOffsets[c->from]; k < s->adjOffsets[c->from + 1]; k++)
+            {
+                const GLint* tri = &indices[s->adjTriangles[k] * 3];
+                s->touched[tri[0]] = s->touched[tri[1]] = s->touched[tri[2]] = true;
+            }
+
+            s->remap[c->from] = c->to;
+            simplify_addQuadric(&s->quadrics[c->to], &s->quadrics[c->from]);
+            if (c->cost > *worstCost)
+            {
+                *worstCost = c->cost;
+            }
+            remaining = remaining > removed ? remaining - removed : 0;
+            applied++;
+        }
+
+        if (applied == 0)
+        {
+            break;
+        }
+
+        // Indices umschreiben und entartete Dreiecke entfernen.
+        GLuint newCount = 0;
+        for (GLuint t = 0; t < triCount; t++)
+        {
+            GLint a = s->remap[indices[t * 3]];
+            GLint b = s->remap[indices[t * 3 + 1]];
+            GLint c = s->remap[indices[t * 3 + 2]];
+            if (a == b || b == c || a == c)
+            {
+                continue;
+            }
+            indices[newCount * 3] = a;
+            indices[newCount * 3 + 1] = b;
+            indices[newCount * 3 + 2] = c;
+            newCount++;
+        }
+        triCount = newCount;
+    }
+
+    return triCount;
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+int simplify_buildLods(const Vertex* vertices, GLuint vertexCount,
+                       GLint** indices, GLuint* indexCount,
+                       MeshLod* lods, int maxLods)
+{
+    GLuint triCount = *indexCount / 3;
+    lods[0].firstIndex = 0;
+    lods[0].indexCount = *indexCount;
+    lods[0].error = 0.0f;
+
+    if (maxLods < 2 || triCount < SIMPLIFY_MIN_TRIANGLES || vertexCount == 0)
+    {
+        return 1;
+    }
+
+    Simplifier s;
+    memset(&s, 0, sizeof(Simplifier));
+    s.vertices = vertices;
+    s.vertexCount = vertexCount;
+    s.quadrics = malloc(sizeof(SimplifyQuadric) * vertexCount);
+    s.locked = calloc(vertexCount, sizeof(bool));
+    s.touched = malloc(sizeof(bool) * vertexCount);
+    s.remap = malloc(sizeof(GLint) * vertexCount);
+    s.adjOffsets = malloc(sizeof(GLuint) * (vertexCount + 1));
+
+    simplify_lockVertices(&s, *indices, triCount);
+    simplify_initQuadrics(&s, *indices, triCount);
+
+    // Der zulässige Fehler hängt von der Größe des Meshes ab.
+    vec3 min, max;
+    glm_vec3_copy((float*)vertices[0].position, min);
+    glm_vec3_copy(min, max);
+    for (GLuint i = 1; i < vertexCount; i++)
+    {
+        glm_vec3_minv(min, (float*)vertices[i].position, min);
+        glm_vec3_maxv(max, (float*)vertices[i].position, max);
+    }
+    float maxError = SIMPLIFY_MAX_ERROR * glm_vec3_distance(min, max);
+
+    // Jede Stufe entsteht aus der vorherigen, die Quadriken und der Fehler
+    // werden dabei weitergeführt.
+    GLint* work = malloc(sizeof(GLint) * triCount * 3);
+    memcpy(work, *indices, sizeof(GLint) * triCount * 3);
+    float worstCost = 0.0f;
+
+    int lodCount = 1;
+    while (lodCount < maxLods)
+    {
+        GLuint target = (GLuint)((float)triCount * SIMPLIFY_LOD_RATIO);
+        GLuint reduced = simplify_reduce(&s, work, triCount, target,
+                                         maxError * maxError, &worstCost);
+        if ((float)reduced > (float)triCount * SIMPLIFY_MIN_REDUCTION || reduced == 0)
+        {
+            break;
+        }
+
+        GLuint first = *indexCount;
+        *indexCount += reduced * 3;
+        *indices = realloc(*indices, sizeof(GLint) * *indexCount);
+        memcpy(&(*indices)[first], work, sizeof(GLint) * reduced * 3);
+
+        lods[lodCount].firstIndex = first;
+        lods[lodCount].indexCount = reduced * 3;
+        lods[lodCount].error = sqrtf(worstCost);
+        lodCount++;
+        triCount = reduced;
+    }
+
+    free(work);
+    free(s.quadrics);
+    free(s.locked);
+    free(s.touched);
+    free(s.remap);
+    free(s.adjOffsets);
+    free(s.adjTriangles);
+    free(s.collapses);
+
+    return lodCount;
+}
@@ -0,0 +1,42 @@
+/**
+ * Modul für das Vereinfachen von Meshes zu Detailstufen (LODs).
+ * Die Vereinfachung kollabiert Kanten nach der Quadric Error Metric von
+ * Garland und Heckbert. Ein Vertex wird dabei immer auf einen bestehenden
+ * Nachbarn gezogen, sodass alle Stufen die Vertices des Originals
+ * weiterverwenden und nur eigene Indexbereiche benötigen. Vertices an
+ * offenen Rändern und an Nähten (gleiche Position mit unterschiedlichen
+ * Attributen) bleiben fest, damit keine Löcher oder verschobenen
+ * Texturkoordinaten entstehen.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include "common.h"
+
+#include "mesh.h"
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Erzeugt bis zu maxLods Detailstufen eines Meshes. Jede Stufe hat etwa
+ * halb so viele Dreiecke wie die vorherige. Die Indices aller Stufen werden
+ * hinter die Indices des Originals gehängt, das Array wird dafür
+ * vergrößert. Stufe 0 ist immer das unveränderte Original.
+ *
+ * @param vertices die Vertices des Meshes
+ * @param vertexCount die Anzahl der Vertices
+ * @param indices Ein- und Ausgabe für das Indexarray
+ * @param indexCount Ein- und Ausgabe für die Anzahl aller Indices
+ * @param lods Ziel für die Bereiche der Stufen
+ * @param maxLods die maximale Anzahl an Stufen inklusive des Originals
+ * @return die Anzahl der erzeugten Stufen, mindestens 1
+ */
+int simplify_buildLods(const Vertex* vertices, GLuint vertexCount,
+                       GLint** indices, GLuint* indexCount,
+                       MeshLod* lods, int maxLods);
+
+#endif // SIMPLIFY_H
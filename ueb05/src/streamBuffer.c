@@ -0,0 +1,387 @@
+/**
+ * Modul für das Hochladen von Daten, die sich jeden Frame ändern.
+ * Ein großer Buffer wird als Ring benutzt, aus dem Konstanten eines Passes,
+ * geänderte Instanzmatrizen, die Geometrie der GUI oder die Partikel der
+ * CPU-Simulation fortlaufend Speicher anfordern. Wenn möglich ist der Buffer dauerhaft und kohärent
+ * gemappt, die Daten werden also direkt geschrieben, ohne Map/Unmap und
+ * ohne dass der Treiber implizit auf die GPU wartet. Am Ende jedes Frames
+ * wird ein Fence gesetzt, erst danach wird der Speicher des Frames wieder
+ * vergeben. Höchstens STREAMBUFFER_MAX_FRAMES Frames sind gleichzeitig in
+ * Arbeit.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "streamBuffer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sesp/stb_ds.h>
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Mindestausrichtung jeder Anforderung in Bytes.
+#define STREAMBUFFER_MIN_ALIGNMENT 16
+
+// Wartezeit auf den Fence eines alten Frames (Nanosekunden).
+#define STREAMBUFFER_FENCE_TIMEOUT 1000000000
+
+// Nicht in glad enthalten (GL 4.4 / ARB_buffer_storage).
+#define STREAMBUFFER_GL_MAP_PERSISTENT_BIT 0x0040
+#define STREAMBUFFER_GL_MAP_COHERENT_BIT 0x0080
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Funktionszeiger für glBufferStorage, wird zur Laufzeit geladen.
+typedef void (APIENTRYP StreamBufferStorageProc)(GLenum target, GLsizeiptr size,
+                                                 const void* data, GLbitfield flags);
+
+// Ein Frame, dessen Daten die GPU noch lesen kann.
+struct StreamFrame
+{
+    GLsync fence;
+    GLintptr end;     // Ende der Daten des Frames im Ring
+    GLsizeiptr bytes; // Belegte Bytes inklusive Verschnitt
+};
+typedef struct StreamFrame StreamFrame;
+
+// Ein zu klein gewordener Buffer, der bis zum Ende des Frames gültig bleibt.
+struct StreamRetired
+{
+    GLuint buffer;
+    unsigned char* staging;
+};
+typedef struct StreamRetired StreamRetired;
+
+// Implementierung des Ringbuffers.
+struct StreamBuffer
+{
+    GLuint buffer;
+    GLsizeiptr capacity;
+    unsigned char* memory; // Dauerhaft gemappter Speicher oder Zwischenspeicher
+    bool persistent;
+    GLsizeiptr alignment;
+    StreamBufferStorageProc bufferStorage;
+
+    GLintptr head;         // Nächstes freies Byte
+    GLintptr tail;         // Anfang der ältesten noch benutzten Daten
+    GLsizeiptr used;       // Belegte Bytes inklusive Verschnitt
+    GLsizeiptr frameBytes; // Davon im aktuellen Frame belegt
+
+    StreamFrame frames[STREAMBUFFER_MAX_FRAMES];
+    int firstFrame;
+    int frameCount;
+
+    StreamRetired* retired; // stb_ds Array
+};
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Legt den OpenGL Buffer an und mappt ihn, wenn möglich, dauerhaft.
+ *
+ * @param stream der Ringbuffer
+ * @param capacity die Größe in Bytes
+ */
+static void streamBuffer_createStorage(StreamBuffer* stream, GLsizeiptr capacity)
+{
+    stream->capacity = capacity;
+    stream->memory = NULL;
+    stream->persistent = false;
+
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+
+    if (stream->bufferStorage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | STREAMBUFFER_GL_MAP_PERSISTENT_BIT
+                           | STREAMBUFFER_GL_MAP_COHERENT_BIT;
+        stream->bufferStorage(GL_COPY_WRITE_BUFFER, capacity, NULL, flags);
+        stream->memory = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, capacity, flags);
+        stream->persistent = stream->memory != NULL;
+    }
+
+    if (!stream->persistent)
+    {
+        // Ohne dauerhaftes Mapping wird in einen Zwischenspeicher geschrieben
+        // und beim Commit mit glBufferSubData übertragen.
+        if (stream->bufferStorage)
+        {
+            glDeleteBuffers(1, &stream->buffer);
+            glGenBuffers(1, &stream->buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+        }
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+        stream->memory = malloc(capacity);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    stream->head = 0;
+    stream->tail = 0;
+    stream->used = 0;
+    stream->frameBytes = 0;
+}
+
+/**
+ * Versucht, einen Bereich zwischen dem freien Ende und den ältesten Daten
+ * zu belegen. Passt der Bereich nicht mehr vor das Ende des Buffers, wird
+ * am Anfang weitergemacht und der Rest als Verschnitt mitgezählt.
+ *
+ * @param stream der Ringbuffer
+ * @param size Größe in Bytes
+ * @param offset Ziel für den Anfang des Bereichs
+ * @return false, wenn nicht genug zusammenhängender Speicher frei ist
+ */
+static bool streamBuffer_tryAlloc(StreamBuffer* stream, GLsizeiptr size, GLintptr* offset)
+{
+    if (stream->used == 0)
+    {
+        stream->head = 0;
+        stream->tail = 0;
+    }
+    else if (stream->head == stream->tail)
+    {
+        return false;
+    }
+
+    GLintptr start = (stream->head + stream->alignment - 1) / stream->alignment * stream->alignment;
+    if (stream->used == 0 || stream->head > stream->tail)
+    {
+        // Frei sind das Ende ab head und der Anfang bis tail.
+        if (start + size > stream->capacity)
+        {
+            if (size > stream->tail)
+            {
+                return false;
+            }
+            start = 0;
+        }
+    }
+    else if (start + size > stream->tail)
+    {
+        return false;
+    }
+
+    GLsizeiptr consumed = start >= stream->head ? start + size - stream->head
+                                                : stream->capacity - stream->head + size;
+    stream->used += consumed;
+    stream->frameBytes += consumed;
+    stream->head = start + size;
+    *offset = start;
+    return true;
+}
+
+/**
+ * Gibt den Speicher des ältesten Frames frei, sobald die GPU ihn nicht mehr
+ * liest.
+ *
+ * @param stream der Ringbuffer
+ * @param wait true, um auf den Fence zu warten
+ * @return false, wenn der Frame noch nicht fertig ist
+ */
+static bool streamBuffer_retireFrame(StreamBuffer* stream, bool wait)
+{
+    StreamFrame* frame = &stream->frames[stream->firstFrame];
+    GLenum result = glClientWaitSync(frame->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                     wait ? STREAMBUFFER_FENCE_TIMEOUT : 0);
+    if (result == GL_TIMEOUT_EXPIRED && !wait)
+    {
+        return false;
+    }
+    if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+    {
+        fprintf(stderr, "Error: Stream buffer frame did not finish in time!\n");
+    }
+
+    glDeleteSync(frame->fence);
+    frame->fence = NULL;
+    stream->used -= frame->bytes;
+    stream->tail = frame->end;
+    stream->firstFrame = (stream->firstFrame + 1) % STREAMBUFFER_MAX_FRAMES;
+    stream->frameCount--;
+    return true;
+}
+
+/**
+ * Ersetzt den Buffer durch einen größeren. Bisherige Anforderungen des
+ * Frames bleiben bis zum Ende des Frames im alten Buffer gültig. Die Fences
+ * älterer Frames werden nicht mehr gebraucht, da OpenGL das Löschen des
+ * alten Buffers verzögert, bis die GPU ihn nicht mehr benutzt.
+ *
+ * @param stream der Ringbuffer
+ * @param size Größe der Anforderung, die nicht mehr passt
+ */
+static void streamBuffer_grow(StreamBuffer* stream, GLsizeiptr size)
+{
+    GLsizeiptr needed = (stream->frameBytes + size + stream->alignment) * STREAMBUFFER_MAX_FRAMES;
+    GLsizeiptr capacity = stream->capacity;
+    while (capacity < needed)
+    {
+        capacity *= 2;
+    }
+
+    StreamRetired retired = {stream->buffer, stream->persistent ? NULL : stream->memory};
+    stbds_arrput(stream->retired, retired);
+
+    while (stream->frameCount > 0)
+    {
+        glDeleteSync(stream->frames[stream->firstFrame].fence);
+        stream->firstFrame = (stream->firstFrame + 1) % STREAMBUFFER_MAX_FRAMES;
+        stream->frameCount--;
+    }
+
+    streamBuffer_createStorage(stream, capacity);
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+StreamBuffer* streamBuffer_create(GLsizeiptr capacity)
+{
+    StreamBuffer* stream = malloc(sizeof(StreamBuffer));
+    memset(stream, 0, sizeof(StreamBuffer));
+
+    // Bereiche sollen als UBO und SSBO gebunden werden können.
+    GLint uniformAlignment = 0, storageAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    stream->alignment = STREAMBUFFER_MIN_ALIGNMENT;
+    while (stream->alignment < uniformAlignment || stream->alignment < storageAlignment)
+    {
+        stream->alignment *= 2;
+    }
+
+    if (glfwExtensionSupported("GL_ARB_buffer_storage"))
+    {
+        stream->bufferStorage = (StreamBufferStorageProc)glfwGetProcAddress("glBufferStorage");
+    }
+
+    streamBuffer_createStorage(stream, capacity);
+    return stream;
+}
+
+void streamBuffer_beginFrame(StreamBuffer* stream)
+{
+    while (stream->frameCount > 0 && streamBuffer_retireFrame(stream, false))
+    {
+    }
+
+    // Mehr Frames dürfen nicht gleichzeitig in Arbeit sein.
+    if (stream->frameCount == STREAMBUFFER_MAX_FRAMES)
+    {
+        streamBuffer_retireFrame(stream, true);
+    }
+}
+
+void streamBuffer_alloc(StreamBuffer* stream, GLsizeiptr size, StreamAllocation* allocation)
+{
+    // Verbraucht ein Frame mehr als seinen Anteil am Ring, würde das Warten
+    // auf alte Frames jeden Frame bremsen, dann wächst der Buffer.
+    GLintptr offset;
+    while (!streamBuffer_tryAlloc(stream, size, &offset))
+    {
+        if (stream->frameCount > 0
+            && stream->frameBytes + size <= stream->capacity / STREAMBUFFER_MAX_FRAMES)
+        {
+            streamBuffer_retireFrame(stream, true);
+        }
+        else
+        {
+            streamBuffer_grow(stream, size);
+        }
+    }
+
+    allocation->memory = stream->memory + offset;
+    allocation->buffer = stream->buffer;
+    allocation->offset = offset;
+    allocation->size = size;
+}
+
+void streamBuffer_trim(StreamBuffer* stream, StreamAllocation* allocation, GLsizeiptr size)
+{
+    // Nur die letzte Anforderung kann zurückgegeben werden.
+    if (allocation->buffer != stream->buffer
+        || allocation->offset + allocation->size != stream->head
+        || size > allocation->size)
+    {
+        return;
+    }
+
+    GLsizeiptr unused = allocation->size - size;
+    stream->head -= unused;
+    stream->used -= unused;
+    stream->frameBytes -= unused;
+    allocation->size = size;
+}
+
+void streamBuffer_commit(StreamBuffer* stream, const StreamAllocation* allocation)
+{
+    if (stream->persistent || allocation->size == 0)
+    {
+        return;
+    }
+
+    // Der Bereich wird von keinem Frame mehr benutzt, der Treiber muss
+    // also nicht warten.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, allocation->buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation->offset, allocation->size,
+                    allocation->memory);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void streamBuffer_bindRange(StreamBuffer* stream, const StreamAllocation* allocation,
+                            GLenum target, GLuint index)
+{
+    streamBuffer_commit(stream, allocation);
+    glBindBufferRange(target, index, allocation->buffer, allocation->offset, allocation->size);
+}
+
+void streamBuffer_endFrame(StreamBuffer* stream)
+{
+    if (stream->frameCount == STREAMBUFFER_MAX_FRAMES)
+    {
+        streamBuffer_retireFrame(stream, true);
+    }
+
+    int index = (stream->firstFrame + stream->frameCount) % STREAMBUFFER_MAX_FRAMES;
+    stream->frames[index].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->frames[index].end = stream->head;
+    stream->frames[index].bytes = stream->frameBytes;
+    stream->frameCount++;
+    stream->frameBytes = 0;
+
+    // Alle Drawcalls mit alten Buffern sind abgeschickt, OpenGL gibt sie
+    // frei, sobald die GPU fertig ist.
+    for (int i = 0; i < stbds_arrlen(stream->retired); i++)
+    {
+        glDeleteBuffers(1, &stream->retired[i].buffer);
+        free(stream->retired[i].staging);
+    }
+    stbds_arrsetlen(stream->retired, 0);
+}
+
+void streamBuffer_delete(StreamBuffer* stream)
+{
+    while (stream->frameCount > 0)
+    {
+        glDeleteSync(stream->frames[stream->firstFrame].fence);
+        stream->firstFrame = (stream->firstFrame + 1) % STREAMBUFFER_MAX_FRAMES;
+        stream->frameCount--;
+    }
+
+    for (int i = 0; i < stbds_arrlen(stream->retired); i++)
+    {
+        glDeleteBuffers(1, &stream->retired[i].buffer);
+        free(stream->retired[i].staging);
+    }
+    stbds_arrfree(stream->retired);
+
+    // Das Löschen hebt auch ein dauerhaftes Mapping auf.
+    glDeleteBuffers(1, &stream->buffer);
+    if (!stream->persistent)
+    {
+        free(stream->memory);
+    }
+    free(stream);
+}
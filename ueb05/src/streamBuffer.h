@@ -0,0 +1,123 @@
+/**
+ * Modul für das Hochladen von Daten, die sich jeden Frame ändern.
+ * Ein großer Buffer wird als Ring benutzt, aus dem Konstanten eines Passes,
+ * geänderte Instanzmatrizen, die Geometrie der GUI oder die Partikel der
+ * CPU-Simulation fortlaufend Speicher anfordern. Wenn möglich ist der Buffer dauerhaft und kohärent
+ * gemappt, die Daten werden also direkt geschrieben, ohne Map/Unmap und
+ * ohne dass der Treiber implizit auf die GPU wartet. Am Ende jedes Frames
+ * wird ein Fence gesetzt, erst danach wird der Speicher des Frames wieder
+ * vergeben. Höchstens STREAMBUFFER_MAX_FRAMES Frames sind gleichzeitig in
+ * Arbeit.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include "common.h"
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Anzahl der Frames, deren Daten gleichzeitig im Ring liegen dürfen.
+#define STREAMBUFFER_MAX_FRAMES 3
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Der Ringbuffer.
+struct StreamBuffer;
+typedef struct StreamBuffer StreamBuffer;
+
+// Ein Speicherbereich im Ringbuffer, gültig bis zum Ende des Frames.
+struct StreamAllocation
+{
+    void* memory;      // Hierhin werden die Daten geschrieben
+    GLuint buffer;     // Der OpenGL Buffer, in dem der Bereich liegt
+    GLintptr offset;   // Anfang des Bereichs im Buffer in Bytes
+    GLsizeiptr size;   // Größe des Bereichs in Bytes
+};
+typedef struct StreamAllocation StreamAllocation;
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Erstellt einen neuen Ringbuffer. Ist GL_ARB_buffer_storage verfügbar,
+ * wird er dauerhaft gemappt, sonst wird über einen Zwischenspeicher und
+ * glBufferSubData hochgeladen.
+ *
+ * @param capacity die Anfangsgröße in Bytes, wächst bei Bedarf
+ * @return der neue Ringbuffer
+ */
+StreamBuffer* streamBuffer_create(GLsizeiptr capacity);
+
+/**
+ * Beginnt einen neuen Frame. Gibt den Speicher fertiger Frames frei und
+ * wartet, falls bereits STREAMBUFFER_MAX_FRAMES Frames in Arbeit sind.
+ *
+ * @param stream der Ringbuffer
+ */
+void streamBuffer_beginFrame(StreamBuffer* stream);
+
+/**
+ * Fordert Speicher für den aktuellen Frame an. Der Anfang ist so
+ * ausgerichtet, dass der Bereich als Uniform Buffer oder Shader Storage
+ * Buffer gebunden werden kann. Reicht der Ring nicht aus, wird auf ältere
+ * Frames gewartet oder ein größerer Buffer angelegt, die Anforderung
+ * schlägt also nie fehl.
+ *
+ * @param stream der Ringbuffer
+ * @param size Größe in Bytes
+ * @param allocation Ziel für den Speicherbereich
+ */
+void streamBuffer_alloc(StreamBuffer* stream, GLsizeiptr size, StreamAllocation* allocation);
+
+/**
+ * Verkleinert die letzte Anforderung des Frames, z.B. wenn erst nach dem
+ * Schreiben feststeht, wie viel Speicher benötigt wurde.
+ *
+ * @param stream der Ringbuffer
+ * @param allocation die letzte Anforderung
+ * @param size die tatsächlich benutzte Größe in Bytes
+ */
+void streamBuffer_trim(StreamBuffer* stream, StreamAllocation* allocation, GLsizeiptr size);
+
+/**
+ * Macht die geschriebenen Daten für die GPU sichtbar. Muss nach dem
+ * Schreiben und vor dem ersten Drawcall aufgerufen werden, der die Daten
+ * benutzt. Bei einem dauerhaft gemappten Buffer passiert dabei nichts.
+ *
+ * @param stream der Ringbuffer
+ * @param allocation der geschriebene Speicherbereich
+ */
+void streamBuffer_commit(StreamBuffer* stream, const StreamAllocation* allocation);
+
+/**
+ * Macht die Daten sichtbar und bindet den Bereich an einen indizierten
+ * Bindungspunkt, z.B. GL_UNIFORM_BUFFER.
+ *
+ * @param stream der Ringbuffer
+ * @param allocation der geschriebene Speicherbereich
+ * @param target das Ziel
+ * @param index der Bindungspunkt
+ */
+void streamBuffer_bindRange(StreamBuffer* stream, const StreamAllocation* allocation,
+                            GLenum target, GLuint index);
+
+/**
+ * Beendet den Frame und setzt den Fence, nach dem der Speicher des Frames
+ * wieder vergeben werden darf. Muss nach dem letzten Drawcall des Frames
+ * aufgerufen werden.
+ *
+ * @param stream der Ringbuffer
+ */
+void streamBuffer_endFrame(StreamBuffer* stream);
+
+/**
+ * Gibt den Ringbuffer frei.
+ *
+ * @param stream der Ringbuffer
+ */
+void streamBuffer_delete(StreamBuffer* stream);
+
+#endif // STREAMBUFFER_H
@@ -9,10 +9,14 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
 #include <sesp/stb_image.h>
+#include <sesp/stb_ds.h>
 
 #include "utils.h"
+#include "thread.h"
+#include "jobs.h"
+#include "ktx.h"
+#include "mipmap.h"
 
 // Wir prüfen ersteinaml, ob die Extension überhaupt gesetzt ist. Das heißt
 // nicht, dass sie geladen wurde, nur dass sie überhaupt definiert ist.
@@ -23,45 +27,135 @@
 ////////////////////////////////// KONSTANTEN //////////////////////////////////
 
 // DDS Konstanten
+#define DDS_MAGIC 0x20534444 //(MAKEFOURCC('D','D','S',' '))
+#define DDS_HEADER_SIZE 124
+#define DDS_PIXELFORMAT_SIZE 32
+
+// Magic, Header und DX10 Header zusammen
+#define DDS_MAX_HEADER_BYTES (4 + DDS_HEADER_SIZE + 20)
+
+// Flags im Header und im Pixelformat
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDPF_FOURCC 0x4
+#define DDSCAPS2_CUBEMAP 0x200
+#define DDSCAPS2_CUBEMAP_ALLFACES 0xFC00
+#define DDSCAPS2_VOLUME 0x200000
+
+// FourCC Codes der unterstützten Formate
 #define FOURCC_DXT1 0x31545844 //(MAKEFOURCC('D','X','T','1'))
 #define FOURCC_DXT3 0x33545844 //(MAKEFOURCC('D','X','T','3'))
 #define FOURCC_DXT5 0x35545844 //(MAKEFOURCC('D','X','T','5'))
+#define FOURCC_ATI1 0x31495441 //(MAKEFOURCC('A','T','I','1'))
 #define FOURCC_ATI2 0x32495441 //(MAKEFOURCC('A','T','I','2'))
-
-// Maximale Länge des Screenshot-Dateinamens
-#define SCREENSHOT_FILENAME_SIZE 40
+#define FOURCC_BC4U 0x55344342 //(MAKEFOURCC('B','C','4','U'))
+#define FOURCC_BC4S 0x53344342 //(MAKEFOURCC('B','C','4','S'))
+#define FOURCC_BC5U 0x55354342 //(MAKEFOURCC('B','C','5','U'))
+#define FOURCC_BC5S 0x53354342 //(MAKEFOURCC('B','C','5','S'))
+#define FOURCC_DX10 0x30315844 //(MAKEFOURCC('D','X','1','0'))
+
+// Werte aus dem DX10 Header
+#define DXGI_FORMAT_BC1_UNORM 71
+#define DXGI_FORMAT_BC1_UNORM_SRGB 72
+#define DXGI_FORMAT_BC2_UNORM 74
+#define DXGI_FORMAT_BC2_UNORM_SRGB 75
+#define DXGI_FORMAT_BC3_UNORM 77
+#define DXGI_FORMAT_BC3_UNORM_SRGB 78
+#define DXGI_FORMAT_BC4_UNORM 80
+#define DXGI_FORMAT_BC4_SNORM 81
+#define DXGI_FORMAT_BC5_UNORM 83
+#define DXGI_FORMAT_BC5_SNORM 84
+#define DXGI_FORMAT_BC6H_UF16 95
+#define DXGI_FORMAT_BC6H_SF16 96
+#define DXGI_FORMAT_BC7_UNORM 98
+#define DXGI_FORMAT_BC7_UNORM_SRGB 99
+#define DDS_DIMENSION_TEXTURE2D 3
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4
+
+// Größte Kantenlänge einer DDS oder KTX2 Textur, schützt vor Überläufen
+// bei der Berechnung der Datengröße aus defekten Headern.
+#define TEXTURE_MAX_SIZE 16384
+
+// Mipmaps bis zu dieser Kantenlänge werden beim Laden einer KTX2 Textur
+// sofort hochgeladen, alle größeren erst, wenn sie gebraucht werden.
+#define TEXTURE_STREAMING_MIN_SIZE 64
+
+// Maximale Anzahl an Mipmaps, die gleichzeitig im Hintergrund gelesen werden.
+#define TEXTURE_STREAMING_MAX_LOADS 4
+
+// Durchläufe des DDS Benchmarks. Die Testdatei wird im Arbeitsverzeichnis
+// angelegt und danach wieder gelöscht.
+#define TEXTURE_DDS_FUZZ_RUNS 100000
+#define TEXTURE_DDS_BENCHMARK_SIZE 2048
+#define TEXTURE_DDS_BENCHMARK_LOADS 16
+#define TEXTURE_DDS_BENCHMARK_CHUNK (1 << 20)
+#define TEXTURE_DDS_BENCHMARK_FILE "dds_benchmark.dds"
 
 ////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
 // DDS Pixelformat
 typedef struct
 {
-    int dwSize;
-    int dwFlags;
-    int dwFourCC;
-    int dwRGBBitCount;
-    int dwRBitMask;
-    int dwGBitMask;
-    int dwBBitMask;
-    int dwABitMask;
+    uint32_t dwSize;
+    uint32_t dwFlags;
+    uint32_t dwFourCC;
+    uint32_t dwRGBBitCount;
+    uint32_t dwRBitMask;
+    uint32_t dwGBitMask;
+    uint32_t dwBBitMask;
+    uint32_t dwABitMask;
 } DDS_PIXELFORMAT;
 
 // DDS Header Format
 typedef struct
 {
-    int dwSize;
-    int dwFlags;
-    int dwHeight;
-    int dwWidth;
-    int dwLinearSize;
-    int dwDepth;
-    int dwMipMapCount;
-    int dwReserved1[11];
+    uint32_t dwSize;
+    uint32_t dwFlags;
+    uint32_t dwHeight;
+    uint32_t dwWidth;
+    uint32_t dwLinearSize;
+    uint32_t dwDepth;
+    uint32_t dwMipMapCount;
+    uint32_t dwReserved1[11];
     DDS_PIXELFORMAT ddpfPixelFormat;
-    int dwCaps1;
-    int dwCaps2;
-    int dwReserved2[3];
+    uint32_t dwCaps1;
+    uint32_t dwCaps2;
+    uint32_t dwReserved2[3];
 } DDSURFACEDESC2;
 
+// Erweiterter Header, folgt bei dem FourCC "DX10" direkt auf DDSURFACEDESC2
+typedef struct
+{
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+} DDS_HEADER_DXT10;
+
+// Ergebnis der Prüfung eines DDS Headers.
+typedef enum
+{
+    DDS_HEADER_VALID,       // Die Datei kann geladen werden
+    DDS_HEADER_INVALID,     // Keine DDS Datei oder defekter Header
+    DDS_HEADER_UNSUPPORTED, // Nicht unterstütztes Format oder Abmessungen
+    DDS_HEADER_TRUNCATED    // Weniger Bilddaten, als der Header verspricht
+} DdsHeaderResult;
+
+// Aus dem Header einer DDS Datei bestimmter Aufbau der Textur.
+typedef struct
+{
+    GLenum format;
+    GLsizei blockSize;   // Bytes pro 4x4 Block
+    bool cube;
+    uint32_t faces;      // 6 bei Cube Maps, sonst 1
+    uint32_t layers;     // Array-Elemente
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;     // Mipmaps in der Datei
+    uint32_t maxLevels;  // Länge der vollständigen Mipmap-Kette
+    uint64_t dataStart;  // Beginn der Bilddaten in der Datei
+    uint64_t dataSize;   // Exakte Größe aller Bilddaten
+} DdsLayout;
+
 typedef struct
 {
     GLuint textureId;
@@ -75,142 +169,982 @@ typedef struct
 } TextureCache;
 
 TextureCache g_textureCache = {NULL, 0};
+
+// Schützt den Cache, da Texturen auch im Lade-Thread geladen werden.
+static Mutex* g_textureCacheMutex = NULL;
+
+// Zustand einer KTX2 Textur, deren große Mipmaps gestreamt werden.
+// Geladen sind immer die Mipmaps ab residentLevel, über GL_TEXTURE_BASE_LEVEL
+// wird nur auf diese zugegriffen.
+typedef struct
+{
+    GLuint textureId;
+    char *filename;
+    GLenum format;
+    GLsizei width;
+    GLsizei height;
+    Ktx2Level *levels;              // Lage der Mipmaps in der Datei
+    int levelCount;
+    int tailLevel;                  // Ab hier bleiben die Mipmaps immer geladen
+    int firstLevel;                 // Größte Mipmap, die gelesen werden kann
+    int residentLevel;              // Größte hochgeladene Mipmap
+
+    int requestLevel;               // Im aktuellen Frame angeforderte Mipmap
+    float requestPixels;            // Größte Bildschirmgröße im aktuellen Frame
+    unsigned long lastRequestFrame; // Letzter Frame, in dem sie sichtbar war
+
+    // Eine im Hintergrund gelesene Mipmap.
+    JobCounter job;
+    int loadLevel;                  // -1, wenn nichts gelesen wird
+    unsigned char *loadData;
+    bool loadFailed;
+} TextureStream;
+
+// Alle gestreamten Texturen nach Textur-ID. Da Texturen im Lade-Thread
+// angelegt und gelöscht werden, ist die Tabelle durch einen Mutex geschützt.
+static struct
+{
+    GLuint key;
+    TextureStream *value;
+} *g_textureStreams = NULL;
+static Mutex* g_textureStreamMutex = NULL;
+
+// Frame des Streamings, wird bei jeder Aktualisierung erhöht.
+static unsigned long g_streamFrame = 1;
+
+// Zwischenspeicher für die nachzuladenden Texturen einer Aktualisierung.
+static TextureStream **g_streamCandidates = NULL;
+
+// Speicher der gestreamten Texturen bei der letzten Aktualisierung.
+static size_t g_streamResident = 0;
+static size_t g_streamRequested = 0;
 ////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
 
+/**
+ * Bestimmt das OpenGL Format zu einem DDS Format. Der FourCC Code wird nur
+ * verwendet, wenn kein DX10 Header vorhanden ist (dxgiFormat ist dann 0).
+ * Ob ein Format als sRGB interpretiert wird, entscheidet wie bisher der
+ * Aufrufer über diffuse.
+ *
+ * @param fourCC der FourCC Code aus dem Pixelformat
+ * @param dxgiFormat das Format aus dem DX10 Header oder 0
+ * @param diffuse true, wenn die Textur sRGB Farben enthält
+ * @param blockSize Ziel für die Größe eines 4x4 Blocks in Bytes
+ * @return das OpenGL Format oder 0, wenn es nicht unterstützt wird
+ */
+static GLenum texture_ddsFormat(uint32_t fourCC, uint32_t dxgiFormat, GLboolean diffuse, GLsizei *blockSize)
+{
+    // Alte FourCC Codes auf das entsprechende DXGI Format abbilden, damit
+    // nur eine Tabelle gepflegt werden muss.
+    if (fourCC != FOURCC_DX10)
+    {
+        switch (fourCC)
+        {
+        case FOURCC_DXT1: dxgiFormat = DXGI_FORMAT_BC1_UNORM; break;
+        case FOURCC_DXT3: dxgiFormat = DXGI_FORMAT_BC2_UNORM; break;
+        case FOURCC_DXT5: dxgiFormat = DXGI_FORMAT_BC3_UNORM; break;
+        case FOURCC_ATI1:
+        case FOURCC_BC4U: dxgiFormat = DXGI_FORMAT_BC4_UNORM; break;
+        case FOURCC_BC4S: dxgiFormat = DXGI_FORMAT_BC4_SNORM; break;
+        case FOURCC_ATI2:
+        case FOURCC_BC5U: dxgiFormat = DXGI_FORMAT_BC5_UNORM; break;
+        case FOURCC_BC5S: dxgiFormat = DXGI_FORMAT_BC5_SNORM; break;
+        default: return 0;
+        }
+    }
+
+    *blockSize = 16;
+    switch (dxgiFormat)
+    {
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+        *blockSize = 8;
+        return diffuse ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+        return diffuse ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT : GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+        return diffuse ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+    case DXGI_FORMAT_BC4_UNORM:
+        *blockSize = 8;
+        return GL_COMPRESSED_RED_RGTC1;
+
+    case DXGI_FORMAT_BC4_SNORM:
+        *blockSize = 8;
+        return GL_COMPRESSED_SIGNED_RED_RGTC1;
+
+    case DXGI_FORMAT_BC5_UNORM:
+        return GL_COMPRESSED_RG_RGTC2;
+
+    case DXGI_FORMAT_BC5_SNORM:
+        return GL_COMPRESSED_SIGNED_RG_RGTC2;
+
+    case DXGI_FORMAT_BC6H_UF16:
+        return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+
+    case DXGI_FORMAT_BC6H_SF16:
+        return GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return diffuse ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Prüft den Header einer DDS Datei und bestimmt daraus den Aufbau der
+ * Textur. Die Größe jeder Mipmap wird exakt aus den Abmessungen berechnet
+ * und gegen die Dateigröße geprüft. Die Funktion benutzt kein OpenGL und
+ * gibt keine Fehler aus, damit sie auch im Benchmark mit beliebig
+ * veränderten Headern aufgerufen werden kann.
+ *
+ * @param header die ersten Bytes der Datei
+ * @param headerSize Anzahl der gültigen Bytes in header
+ * @param fileSize die Größe der gesamten Datei in Bytes
+ * @param diffuse true, wenn die Textur sRGB Farben enthält
+ * @param layout Ziel für den Aufbau der Textur
+ * @return DDS_HEADER_VALID, wenn die Datei geladen werden kann
+ */
+static DdsHeaderResult texture_parseDDSHeader(const unsigned char *header, size_t headerSize,
+                                              uint64_t fileSize, GLboolean diffuse, DdsLayout *layout)
+{
+    // Den Datentyp der Datei verifizieren und den Datei-Header auslesen.
+    uint32_t magic = 0;
+    DDSURFACEDESC2 ddsDesc;
+    DDS_HEADER_DXT10 dx10 = {0};
+    size_t descEnd = sizeof(magic) + sizeof(DDSURFACEDESC2);
+    if (headerSize < descEnd)
+    {
+        return DDS_HEADER_INVALID;
+    }
+    memcpy(&magic, header, sizeof(magic));
+    memcpy(&ddsDesc, header + sizeof(magic), sizeof(DDSURFACEDESC2));
+
+    bool dx10Header = (ddsDesc.ddpfPixelFormat.dwFlags & DDPF_FOURCC) &&
+                      ddsDesc.ddpfPixelFormat.dwFourCC == FOURCC_DX10;
+    if (magic != DDS_MAGIC || ddsDesc.dwSize != DDS_HEADER_SIZE ||
+        ddsDesc.ddpfPixelFormat.dwSize != DDS_PIXELFORMAT_SIZE ||
+        (dx10Header && headerSize < descEnd + sizeof(DDS_HEADER_DXT10)))
+    {
+        return DDS_HEADER_INVALID;
+    }
+    if (dx10Header)
+    {
+        memcpy(&dx10, header + descEnd, sizeof(DDS_HEADER_DXT10));
+    }
+    layout->dataStart = descEnd + (dx10Header ? sizeof(DDS_HEADER_DXT10) : 0);
+
+    // Als nächstes muss das Format der Bilddaten bestimmt werden.
+    // Unkomprimierte DDS Dateien werden nicht unterstützt.
+    layout->blockSize = 16;
+    layout->format = (ddsDesc.ddpfPixelFormat.dwFlags & DDPF_FOURCC)
+                         ? texture_ddsFormat(ddsDesc.ddpfPixelFormat.dwFourCC, dx10.dxgiFormat, diffuse, &layout->blockSize)
+                         : 0;
+
+    // Aufbau der Textur bestimmen. Ein DX10 Header beschreibt Arrays und
+    // Cube Maps selbst, bei alten Dateien steht es in den Caps.
+    layout->cube = dx10Header ? (dx10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0
+                              : (ddsDesc.dwCaps2 & DDSCAPS2_CUBEMAP) != 0;
+    layout->faces = layout->cube ? 6 : 1;
+    layout->layers = dx10Header ? dx10.arraySize : 1;
+    layout->width = ddsDesc.dwWidth;
+    layout->height = ddsDesc.dwHeight;
+
+    // Die Anzahl der Mipmaps ist nur gültig, wenn das Flag gesetzt ist.
+    // Mehr Mipmaps, als die Kette bis 1x1 lang ist, darf es nicht geben.
+    layout->maxLevels = 1;
+    while (layout->maxLevels < 32 && ((layout->width | layout->height) >> layout->maxLevels) > 0)
+    {
+        layout->maxLevels++;
+    }
+    layout->levels = (ddsDesc.dwFlags & DDSD_MIPMAPCOUNT) && ddsDesc.dwMipMapCount > 0
+                         ? ddsDesc.dwMipMapCount
+                         : 1;
+
+    if (layout->format == 0 || layout->width == 0 || layout->height == 0 ||
+        layout->width > TEXTURE_MAX_SIZE || layout->height > TEXTURE_MAX_SIZE ||
+        layout->levels > layout->maxLevels || layout->layers == 0 || layout->layers > TEXTURE_MAX_SIZE ||
+        (ddsDesc.dwCaps2 & DDSCAPS2_VOLUME) ||
+        (dx10Header && dx10.resourceDimension != DDS_DIMENSION_TEXTURE2D) ||
+        (layout->cube && (layout->width != layout->height ||
+                          (!dx10Header && (ddsDesc.dwCaps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES))))
+    {
+        return DDS_HEADER_UNSUPPORTED;
+    }
+
+    // Die exakte Größe der Bilddaten bestimmen. In der Datei folgen für
+    // jedes Array-Element und jede Seite alle Mipmaps hintereinander.
+    uint64_t chainSize = 0;
+    for (uint32_t level = 0; level < layout->levels; level++)
+    {
+        uint64_t w = utils_maxInt((int)(layout->width >> level), 1);
+        uint64_t h = utils_maxInt((int)(layout->height >> level), 1);
+        chainSize += ((w + 3) / 4) * ((h + 3) / 4) * (uint64_t)layout->blockSize;
+    }
+    layout->dataSize = chainSize * layout->faces * layout->layers;
+
+    // Defekte Dateien enthalten weniger Daten, als der Header verspricht.
+    if (fileSize < layout->dataStart || fileSize - layout->dataStart < layout->dataSize)
+    {
+        return DDS_HEADER_TRUNCATED;
+    }
+
+    return DDS_HEADER_VALID;
+}
+
 /**
  * Lädt eine DDS Textur aus einer Datei.
- * Diese Funktion modifiziert das übergebene Textur-Objekt und gibt deshalb
- * nicht zurück.
+ * Unterstützt werden BC1 bis BC7 mit klassischem oder DX10 Header, auch als
+ * Array, Cube Map oder Cube Map Array. Der Header wird vor dem Lesen der
+ * Bilddaten mit texture_parseDDSHeader geprüft.
+ * Die Bilddaten werden ohne Zwischenkopie direkt in einen Pixel Unpack
+ * Buffer gelesen, aus dem OpenGL anschließend alle Mipmaps übernimmt.
+ * Diese Funktion modifiziert das übergebene Textur-Objekt.
  * 
  * @param textureId eine valide OpenGL Textur-ID
  * @param filename der Dateiname aus der die Bilddaten geladen werden sollen
+ * @return das Target, an das die Textur gebunden werden muss
  */
-static void texture_loadFromDDS(GLuint textureId, const char *filename, GLboolean diffuse)
+static GLenum texture_loadFromDDS(GLuint textureId, const char *filename, GLboolean diffuse)
 {
-    // Zuerst prüfen wir, ob die DDS Extension überhaupt geladen werden
-    // konnte. Wenn nicht liegt dies an der fehlenden Treiberunterstützung und
-    // wir können nichts dagegen tun außer eine Fehlermeldung auszugeben.
-    if (!GLAD_GL_EXT_texture_compression_s3tc)
-    {
-        fprintf(stderr, "Error: No support for DDS textures!\n");
-        return;
-    }
-
     // Die Datei zum Lesen öffnen.
     FILE *f = fopen(filename, "rb");
     if (f == NULL)
     {
         fprintf(stderr, "Error: Could not open image file \"%s\"!\n", filename);
-        return;
+        return GL_TEXTURE_2D;
     }
 
-    // Den Datentyp der Datei verifizieren.
-    char filecode[4];
-    fread(filecode, 1, 4, f);
-    if (strncmp(filecode, "DDS ", 4) != 0)
+    // Den Header inklusive eines möglichen DX10 Headers und die Größe der
+    // Datei bestimmen. Kleine Dateien können kürzer als der Puffer sein.
+    unsigned char header[DDS_MAX_HEADER_BYTES];
+    size_t headerSize = fread(header, 1, DDS_MAX_HEADER_BYTES, f);
+    long fileSize = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+
+    DdsLayout layout = {0};
+    DdsHeaderResult result = fileSize < 0
+                                 ? DDS_HEADER_TRUNCATED
+                                 : texture_parseDDSHeader(header, headerSize, (uint64_t)fileSize, diffuse, &layout);
+    if (result == DDS_HEADER_INVALID)
     {
         fprintf(
             stderr,
             "Error: Could not verifiy image file \"%s\"!\n",
             filename);
         fclose(f);
-        return;
+        return GL_TEXTURE_2D;
+    }
+    if (result == DDS_HEADER_UNSUPPORTED)
+    {
+        fprintf(
+            stderr,
+            "Error: Unsupported image format in image file \"%s\"!\n",
+            filename);
+        fclose(f);
+        return GL_TEXTURE_2D;
     }
 
-    // Den Datei-Header auslesen.
-    DDSURFACEDESC2 ddsDesc;
-    fread(&ddsDesc, sizeof(DDSURFACEDESC2), 1, f);
+    // BC1 bis BC3 sind nur über die S3TC Erweiterung verfügbar. Fehlt sie,
+    // liegt dies an der fehlenden Treiberunterstützung und wir können nichts
+    // dagegen tun außer eine Fehlermeldung auszugeben.
+    GLenum format = layout.format;
+    bool needsS3TC = format >= GL_COMPRESSED_RGB_S3TC_DXT1_EXT && format <= GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    needsS3TC |= format >= GL_COMPRESSED_SRGB_S3TC_DXT1_EXT && format <= GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    if (result == DDS_HEADER_VALID && needsS3TC && !GLAD_GL_EXT_texture_compression_s3tc)
+    {
+        fprintf(stderr, "Error: No support for DDS textures!\n");
+        fclose(f);
+        return GL_TEXTURE_2D;
+    }
 
-    // Die benötigte Größe des Datenbuffers feststellen.
-    // Wenn Mipmaps verfügbar sind, wird die Größe der Datei doppelt sein.
-    size_t bufferSize = ddsDesc.dwLinearSize;
-    if (ddsDesc.dwMipMapCount > 1)
+    if (result != DDS_HEADER_VALID || fseek(f, (long)layout.dataStart, SEEK_SET) != 0)
     {
-        bufferSize *= 2;
+        fprintf(stderr, "Error: Could not read image file \"%s\"!\n", filename);
+        fclose(f);
+        return GL_TEXTURE_2D;
     }
 
-    // Den Speicher für die Bilddaten reservieren und diese einlesen.
-    unsigned char *data = malloc(bufferSize);
-    fread(data, 1, bufferSize, f);
+    bool cube = layout.cube;
+    uint32_t faces = layout.faces;
+    uint32_t layers = layout.layers;
+    uint32_t width = layout.width;
+    uint32_t height = layout.height;
+    uint32_t levels = layout.levels;
+    uint32_t maxLevels = layout.maxLevels;
+    GLsizei blockSize = layout.blockSize;
+    uint64_t dataSize = layout.dataSize;
+
+    // Das Target ergibt sich aus Seiten und Array-Elementen.
+    GLenum target = cube ? (layers > 1 ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_CUBE_MAP)
+                         : (layers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D);
+
+    // Die Bilddaten direkt in einen Pixel Unpack Buffer lesen. Der Treiber
+    // kopiert sie von dort, ohne dass eine Kopie auf dem Heap entsteht.
+    GLuint pbo;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)dataSize, NULL, GL_STREAM_DRAW);
+    void *mapped = glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)dataSize,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    bool success = mapped != NULL && fread(mapped, 1, (size_t)dataSize, f) == (size_t)dataSize;
+    if (mapped != NULL)
+    {
+        // Kann beim Unmappen der Inhalt verloren gehen (z.B. bei einem
+        // Moduswechsel), sind die Daten unbrauchbar.
+        success = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) && success;
+    }
 
     // Da sie nicht mehr benötigt wird, kann die Datei geschlossen werden.
     fclose(f);
 
-    // Als nächstes muss das Format der Bilddaten bestimmt werden.
-    GLenum format;
-    switch (ddsDesc.ddpfPixelFormat.dwFourCC)
+    if (!success)
     {
-    case FOURCC_DXT1:
-        format = diffuse ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
-        break;
+        fprintf(stderr, "Error: Could not read image file \"%s\"!\n", filename);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &pbo);
+        return GL_TEXTURE_2D;
+    }
 
-    case FOURCC_DXT3:
-        format = diffuse ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT : GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
-        break;
+    // Das neue Textur-Objekt binden und den Speicher einmalig anlegen. Hat
+    // die Datei nur eine Mipmap, wird wie bisher die ganze Kette angelegt
+    // und anschließend erzeugt.
+    GLsizei storageLevels = levels > 1 ? (GLsizei)levels : (GLsizei)maxLevels;
+    glBindTexture(target, textureId);
+    if (target == GL_TEXTURE_2D || target == GL_TEXTURE_CUBE_MAP)
+    {
+        glTexStorage2D(target, storageLevels, format, (GLsizei)width, (GLsizei)height);
+    }
+    else
+    {
+        glTexStorage3D(target, storageLevels, format, (GLsizei)width, (GLsizei)height, (GLsizei)(layers * faces));
+    }
 
-    case FOURCC_DXT5:
-        format = diffuse ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
-        break;
+    // In dieser Schleife werden alle Mipmaps aus dem Buffer an die Textur
+    // übergeben. Der Zeiger ist dabei ein Offset in den gebundenen Buffer.
+    uint64_t offset = 0;
+    for (uint32_t layer = 0; layer < layers; layer++)
+    {
+        for (uint32_t face = 0; face < faces; face++)
+        {
+            for (uint32_t level = 0; level < levels; level++)
+            {
+                GLsizei w = utils_maxInt((int)(width >> level), 1);
+                GLsizei h = utils_maxInt((int)(height >> level), 1);
+                GLsizei size = ((w + 3) / 4) * ((h + 3) / 4) * blockSize;
+                const void *data = (const void *)(uintptr_t)offset;
+
+                if (target == GL_TEXTURE_2D || target == GL_TEXTURE_CUBE_MAP)
+                {
+                    GLenum faceTarget = cube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+                    glCompressedTexSubImage2D(faceTarget, (GLint)level, 0, 0, w, h, format, size, data);
+                }
+                else
+                {
+                    GLint zOffset = (GLint)(layer * faces + face);
+                    glCompressedTexSubImage3D(target, (GLint)level, 0, 0, zOffset, w, h, 1, format, size, data);
+                }
+
+                offset += (uint64_t)size;
+            }
+        }
+    }
 
-    case FOURCC_ATI2:
-        format = GL_COMPRESSED_RG_RGTC2;
-        break;
+    // Der Buffer kann sofort gelöscht werden, OpenGL hält ihn bis zum Ende
+    // der Übertragung am Leben.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &pbo);
+
+    // Wenn nötig, automatisch die Mipmaps erstellen lassen.
+    if (levels <= 1)
+    {
+        glGenerateMipmap(target);
+    }
+
+    return target;
+}
+
+/**
+ * Einfacher Zufallsgenerator (Xorshift) für den DDS Benchmark.
+ *
+ * @param state der Zustand des Generators, darf nicht 0 sein
+ * @return die nächste Zufallszahl
+ */
+static uint32_t texture_random(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/**
+ * Schreibt einen gültigen DDS Header für den Benchmark. Ohne DXGI Format
+ * entsteht ein klassischer BC1 Header, sonst ein DX10 Header.
+ *
+ * @param header Ziel mit Platz für DDS_MAX_HEADER_BYTES Bytes
+ * @param width die Breite der Textur
+ * @param height die Höhe der Textur
+ * @param levels die Anzahl der Mipmaps
+ * @param dxgiFormat das Format im DX10 Header oder 0
+ * @param layers die Anzahl der Array-Elemente, nur mit DX10 Header
+ * @param cube true für eine Cube Map
+ * @return die Größe des Headers in Bytes
+ */
+static size_t texture_writeDDSHeader(unsigned char *header, uint32_t width, uint32_t height, uint32_t levels,
+                                     uint32_t dxgiFormat, uint32_t layers, bool cube)
+{
+    uint32_t magic = DDS_MAGIC;
+    DDSURFACEDESC2 ddsDesc;
+    memset(&ddsDesc, 0, sizeof(DDSURFACEDESC2));
+    ddsDesc.dwSize = DDS_HEADER_SIZE;
+    ddsDesc.dwFlags = DDSD_MIPMAPCOUNT;
+    ddsDesc.dwWidth = width;
+    ddsDesc.dwHeight = height;
+    ddsDesc.dwMipMapCount = levels;
+    ddsDesc.ddpfPixelFormat.dwSize = DDS_PIXELFORMAT_SIZE;
+    ddsDesc.ddpfPixelFormat.dwFlags = DDPF_FOURCC;
+    ddsDesc.ddpfPixelFormat.dwFourCC = dxgiFormat ? FOURCC_DX10 : FOURCC_DXT1;
+    if (cube && !dxgiFormat)
+    {
+        ddsDesc.dwCaps2 = DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES;
+    }
+
+    size_t size = 0;
+    memcpy(header, &magic, sizeof(magic));
+    size += sizeof(magic);
+    memcpy(header + size, &ddsDesc, sizeof(DDSURFACEDESC2));
+    size += sizeof(DDSURFACEDESC2);
+
+    if (dxgiFormat)
+    {
+        DDS_HEADER_DXT10 dx10 = {0};
+        dx10.dxgiFormat = dxgiFormat;
+        dx10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+        dx10.miscFlag = cube ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+        dx10.arraySize = layers;
+        memcpy(header + size, &dx10, sizeof(DDS_HEADER_DXT10));
+        size += sizeof(DDS_HEADER_DXT10);
+    }
+
+    return size;
+}
+
+/**
+ * Prüft, ob ein angenommener DDS Header einen Aufbau liefert, mit dem
+ * texture_loadFromDDS sicher arbeiten kann.
+ *
+ * @param layout der Aufbau der Textur
+ * @param headerSize Anzahl der gültigen Bytes im Header
+ * @param fileSize die angenommene Größe der Datei
+ * @return true, wenn alle Grenzen eingehalten werden
+ */
+static bool texture_checkDDSLayout(const DdsLayout *layout, size_t headerSize, uint64_t fileSize)
+{
+    return layout->format != 0 &&
+           layout->width >= 1 && layout->width <= TEXTURE_MAX_SIZE &&
+           layout->height >= 1 && layout->height <= TEXTURE_MAX_SIZE &&
+           layout->levels >= 1 && layout->levels <= layout->maxLevels &&
+           layout->layers >= 1 && layout->layers <= TEXTURE_MAX_SIZE &&
+           (!layout->cube || (layout->faces == 6 && layout->width == layout->height)) &&
+           layout->dataStart <= headerSize &&
+           layout->dataSize > 0 && layout->dataStart + layout->dataSize <= fileSize;
+}
+
+/**
+ * Sperrt die Tabelle der gestreamten Texturen.
+ */
+static void texture_lockStreams(void)
+{
+    if (g_textureStreamMutex)
+    {
+        thread_lockMutex(g_textureStreamMutex);
+    }
+}
+
+/**
+ * Gibt die Tabelle der gestreamten Texturen wieder frei.
+ */
+static void texture_unlockStreams(void)
+{
+    if (g_textureStreamMutex)
+    {
+        thread_unlockMutex(g_textureStreamMutex);
+    }
+}
+
+/**
+ * Berechnet den Speicher aller Mipmaps einer gestreamten Textur ab einer
+ * bestimmten Mipmap.
+ *
+ * @param stream die Textur
+ * @param level die größte mitgezählte Mipmap
+ * @return der Speicher in Bytes
+ */
+static size_t texture_streamBytes(TextureStream *stream, int level)
+{
+    size_t bytes = 0;
+    for (int i = level; i < stream->levelCount; i++)
+    {
+        bytes += (size_t)stream->levels[i].byteLength;
+    }
+    return bytes;
+}
+
+/**
+ * Liefert die Mipmap, die eine gestreamte Textur im aktuellen Frame
+ * mindestens benötigt. Nicht sichtbare Texturen benötigen nur die immer
+ * geladenen kleinen Mipmaps.
+ *
+ * @param stream die Textur
+ * @return die größte benötigte Mipmap
+ */
+static int texture_wantedLevel(TextureStream *stream)
+{
+    int level = stream->lastRequestFrame == g_streamFrame ? stream->requestLevel
+                                                          : stream->tailLevel;
+    return utils_maxInt(level, stream->firstLevel);
+}
+
+/**
+ * Job, der eine Mipmap einer gestreamten Textur aus der Datei liest.
+ * Hochgeladen wird sie erst im Hauptthread.
+ *
+ * @param arg die gestreamte Textur
+ */
+static void texture_streamJob(void *arg)
+{
+    TextureStream *stream = arg;
+    Ktx2Level *level = &stream->levels[stream->loadLevel];
+
+    FILE *f = fopen(stream->filename, "rb");
+    stream->loadFailed = f == NULL ||
+                         fseek(f, (long)level->byteOffset, SEEK_SET) != 0 ||
+                         fread(stream->loadData, 1, (size_t)level->byteLength, f) != (size_t)level->byteLength;
+    if (f)
+    {
+        fclose(f);
+    }
+}
+
+/**
+ * Lädt eine fertig gelesene Mipmap hoch und gibt sie zum Sampeln frei.
+ * Schlägt das Lesen fehl, wird die Mipmap nicht erneut versucht.
+ *
+ * @param stream die Textur mit abgeschlossenem Lesevorgang
+ */
+static void texture_finishStream(TextureStream *stream)
+{
+    int level = stream->loadLevel;
+    if (stream->loadFailed)
+    {
+        fprintf(stderr, "Error: Could not stream mipmap %d of image file \"%s\"!\n",
+                level, stream->filename);
+        stream->firstLevel = level + 1;
+    }
+    else
+    {
+        glBindTexture(GL_TEXTURE_2D, stream->textureId);
+        glCompressedTexImage2D(
+            GL_TEXTURE_2D, level, stream->format,
+            utils_maxInt(stream->width >> level, 1),
+            utils_maxInt(stream->height >> level, 1), 0,
+            (GLsizei)stream->levels[level].byteLength, stream->loadData);
+
+        // Erst jetzt darf die neue Mipmap gesampelt werden.
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        stream->residentLevel = level;
+    }
+
+    free(stream->loadData);
+    stream->loadData = NULL;
+    stream->loadLevel = -1;
+}
+
+/**
+ * Gibt die größte geladene Mipmap einer gestreamten Textur frei. Der
+ * Zugriff wird zuerst auf die nächstkleinere Mipmap beschränkt, dann wird
+ * die Mipmap mit der Größe 0 neu angelegt, wodurch der Treiber ihren
+ * Speicher freigibt.
+ *
+ * @param stream die Textur
+ */
+static void texture_evictLevel(TextureStream *stream)
+{
+    int level = stream->residentLevel;
+    glBindTexture(GL_TEXTURE_2D, stream->textureId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+    glCompressedTexImage2D(GL_TEXTURE_2D, level, stream->format, 0, 0, 0, 0, NULL);
+    stream->residentLevel = level + 1;
+}
+
+/**
+ * Sucht die Textur, deren größte Mipmap als nächstes freigegeben wird.
+ * Zuerst werden Mipmaps verdrängt, die im aktuellen Frame nicht benötigt
+ * werden, davon die am längsten nicht mehr benötigten. Danach benötigte
+ * Mipmaps von Texturen, die kleiner als die nachzuladende erscheinen.
+ *
+ * @param candidate die nachzuladende Textur oder NULL, wenn das Budget
+ *        überschritten ist und jede Textur verdrängt werden darf
+ * @return die zu verdrängende Textur oder NULL, wenn es keine gibt
+ */
+static TextureStream *texture_findVictim(TextureStream *candidate)
+{
+    TextureStream *best = NULL;
+    bool bestExcess = false;
+    for (ptrdiff_t i = 0; i < stbds_hmlen(g_textureStreams); i++)
+    {
+        TextureStream *stream = g_textureStreams[i].value;
+        if (stream == candidate || stream->loadLevel >= 0 ||
+            stream->residentLevel >= stream->tailLevel)
+        {
+            continue;
+        }
+
+        bool excess = stream->residentLevel < texture_wantedLevel(stream);
+        if (!excess && candidate != NULL && stream->requestPixels >= candidate->requestPixels)
+        {
+            continue;
+        }
+
+        bool better = best == NULL || (excess && !bestExcess);
+        if (!better && excess == bestExcess)
+        {
+            better = stream->lastRequestFrame < best->lastRequestFrame ||
+                     (stream->lastRequestFrame == best->lastRequestFrame &&
+                      stream->requestPixels < best->requestPixels);
+        }
+        if (better)
+        {
+            best = stream;
+            bestExcess = excess;
+        }
+    }
+    return best;
+}
+
+/**
+ * Vergleicht zwei nachzuladende Texturen für qsort. Texturen, die größer
+ * auf dem Bildschirm erscheinen, werden zuerst geladen.
+ */
+static int texture_compareStreams(const void *a, const void *b)
+{
+    const TextureStream *streamA = *(TextureStream *const *)a;
+    const TextureStream *streamB = *(TextureStream *const *)b;
+    return (streamA->requestPixels < streamB->requestPixels) -
+           (streamA->requestPixels > streamB->requestPixels);
+}
+
+/**
+ * Trägt eine KTX2 Textur, deren kleine Mipmaps bereits hochgeladen sind,
+ * für das Streaming ein.
+ *
+ * @param textureId die Textur
+ * @param filename die Datei, aus der weitere Mipmaps gelesen werden
+ * @param format das OpenGL Format der Mipmaps
+ * @param width die Breite der größten Mipmap
+ * @param height die Höhe der größten Mipmap
+ * @param levels der Level-Index der Datei, geht in den Besitz des Eintrags über
+ * @param levelCount die Anzahl der Mipmaps
+ * @param tailLevel die größte bereits geladene Mipmap
+ */
+static void texture_registerStream(GLuint textureId, const char *filename, GLenum format,
+                                   GLsizei width, GLsizei height, Ktx2Level *levels,
+                                   int levelCount, int tailLevel)
+{
+    TextureStream *stream = malloc(sizeof(TextureStream));
+    stream->textureId = textureId;
+    stream->filename = malloc(strlen(filename) + 1);
+    strcpy(stream->filename, filename);
+    stream->format = format;
+    stream->width = width;
+    stream->height = height;
+    stream->levels = levels;
+    stream->levelCount = levelCount;
+    stream->tailLevel = tailLevel;
+    stream->firstLevel = 0;
+    stream->residentLevel = tailLevel;
+    stream->requestLevel = tailLevel;
+    stream->requestPixels = 0.0f;
+    stream->lastRequestFrame = 0;
+    jobs_initCounter(&stream->job);
+    stream->loadLevel = -1;
+    stream->loadData = NULL;
+    stream->loadFailed = false;
+
+    texture_lockStreams();
+    stbds_hmput(g_textureStreams, textureId, stream);
+    texture_unlockStreams();
+}
+
+/**
+ * Gibt den Eintrag einer gestreamten Textur frei. Ein laufender
+ * Lesevorgang wird vorher abgewartet, da er in den Eintrag schreibt.
+ *
+ * @param stream der Eintrag
+ */
+static void texture_freeStream(TextureStream *stream)
+{
+    jobs_wait(&stream->job);
+    free(stream->loadData);
+    free(stream->levels);
+    free(stream->filename);
+    free(stream);
+}
+
+/**
+ * Bestimmt das OpenGL Format zu einem KTX2 Format. Wie bei DDS entscheidet
+ * der Aufrufer, ob die Farben als sRGB interpretiert werden.
+ *
+ * @param vkFormat das Format aus dem KTX2 Header
+ * @param diffuse true, wenn die Textur sRGB Farben enthält
+ * @param blockSize Ziel für die Größe eines 4x4 Blocks in Bytes
+ * @return das OpenGL Format oder 0, wenn es nicht unterstützt wird
+ */
+static GLenum texture_ktx2Format(uint32_t vkFormat, GLboolean diffuse, GLsizei *blockSize)
+{
+    *blockSize = 16;
+    switch (vkFormat)
+    {
+    case KTX2_FORMAT_BC1_RGB_UNORM:
+    case KTX2_FORMAT_BC1_RGB_SRGB:
+        *blockSize = 8;
+        return diffuse ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+    case KTX2_FORMAT_BC1_RGBA_UNORM:
+    case KTX2_FORMAT_BC1_RGBA_SRGB:
+        *blockSize = 8;
+        return diffuse ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+
+    case KTX2_FORMAT_BC3_UNORM:
+    case KTX2_FORMAT_BC3_SRGB:
+        return diffuse ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+    case KTX2_FORMAT_BC4_UNORM:
+        *blockSize = 8;
+        return GL_COMPRESSED_RED_RGTC1;
+
+    case KTX2_FORMAT_BC5_UNORM:
+        return GL_COMPRESSED_RG_RGTC2;
+
+    case KTX2_FORMAT_BC7_UNORM:
+    case KTX2_FORMAT_BC7_SRGB:
+        return diffuse ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
 
     default:
+        return 0;
+    }
+}
+
+/**
+ * Lädt eine blockkomprimierte KTX2 Textur aus einer Datei, wie sie der
+ * Konverter in tools/ktxconv erzeugt.
+ * Die Mipmaps werden einzeln gelesen und direkt hochgeladen, sodass nie die
+ * ganze Datei im Speicher liegt. Bei großen Texturen werden zunächst nur die
+ * kleinen Mipmaps geladen, die größeren streamt texture_updateStreaming,
+ * sobald die Textur groß genug auf dem Bildschirm erscheint.
+ *
+ * @param textureId eine valide OpenGL Textur-ID
+ * @param filename der Dateiname aus der die Bilddaten geladen werden sollen
+ */
+static void texture_loadFromKTX2(GLuint textureId, const char *filename, GLboolean diffuse)
+{
+    // Die Datei zum Lesen öffnen.
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Error: Could not open image file \"%s\"!\n", filename);
+        return;
+    }
+
+    // Kennung und Header lesen und prüfen. Unterstützt werden nur
+    // einfache 2D-Texturen ohne Superkompression.
+    const unsigned char expected[KTX2_IDENTIFIER_SIZE] = KTX2_IDENTIFIER;
+    unsigned char identifier[KTX2_IDENTIFIER_SIZE];
+    Ktx2Header header;
+    Ktx2Index index;
+    if (fread(identifier, 1, sizeof(identifier), f) != sizeof(identifier) ||
+        memcmp(identifier, expected, sizeof(identifier)) != 0 ||
+        fread(&header, sizeof(header), 1, f) != 1 ||
+        fread(&index, sizeof(index), 1, f) != 1)
+    {
+        fprintf(stderr, "Error: Could not verifiy image file \"%s\"!\n", filename);
+        fclose(f);
+        return;
+    }
+
+    GLsizei blockSize;
+    GLenum format = texture_ktx2Format(header.vkFormat, diffuse, &blockSize);
+    // BC1 und BC3 sind nur über die S3TC Erweiterung verfügbar.
+    bool needsS3TC = header.vkFormat <= KTX2_FORMAT_BC3_SRGB;
+
+    // Mehr Mipmaps als bis zur Größe 1x1 nimmt glTexStorage2D nicht an.
+    uint32_t maxSize = header.pixelWidth > header.pixelHeight ? header.pixelWidth : header.pixelHeight;
+    uint32_t maxLevels = 1;
+    while ((maxSize >> maxLevels) > 0)
+    {
+        maxLevels++;
+    }
+
+    if (format == 0 || header.supercompressionScheme != KTX2_SUPERCOMPRESSION_NONE ||
+        header.pixelDepth != 0 || header.layerCount != 0 || header.faceCount != 1 ||
+        header.pixelWidth == 0 || header.pixelHeight == 0 ||
+        header.pixelWidth > TEXTURE_MAX_SIZE || header.pixelHeight > TEXTURE_MAX_SIZE ||
+        header.levelCount == 0 || header.levelCount > maxLevels ||
+        (needsS3TC && !GLAD_GL_EXT_texture_compression_s3tc))
+    {
         fprintf(
             stderr,
             "Error: Unsupported image format in image file \"%s\"!\n",
             filename);
-        free(data);
+        fclose(f);
         return;
     }
 
-    // Das neue Textur-Objekt binden/aktivieren.
-    glBindTexture(GL_TEXTURE_2D, textureId);
-
-    // Als nächstes extrahieren wir relevante Informationen, um die
-    // Textur und die Mipmaps an OpenGL zu übergeben.
-    GLsizei blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) || (format == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT) ? 8 : 16;
-    GLsizei width = ddsDesc.dwWidth;
-    GLsizei height = ddsDesc.dwHeight;
-    unsigned int offset = 0;
+    // Den Level-Index lesen, er enthält für jede Mipmap Lage und Größe.
+    int levelCount = (int)header.levelCount;
+    Ktx2Level *levels = malloc(sizeof(Ktx2Level) * levelCount);
+    if (levels == NULL ||
+        fread(levels, sizeof(Ktx2Level), levelCount, f) != (size_t)levelCount)
+    {
+        fprintf(stderr, "Error: Could not read image file \"%s\"!\n", filename);
+        free(levels);
+        fclose(f);
+        return;
+    }
 
-    // In dieser Schleife wird die Textur und alle Mipmaps an OpenGL übergeben,
-    for (
-        int level = 0;
-        (level <= ddsDesc.dwMipMapCount) && (width || height);
-        level++)
+    // Die Größe jeder Mipmap ergibt sich aus ihren Blöcken und muss mit dem
+    // Level-Index übereinstimmen. Geprüft werden alle Mipmaps, damit
+    // gestreamte Mipmaps nicht erst beim Nachladen als defekt auffallen.
+    GLsizei width = (GLsizei)header.pixelWidth;
+    GLsizei height = (GLsizei)header.pixelHeight;
+    for (int level = 0; level < levelCount; level++)
     {
-        // Verhindern, dass nur width oder nur height 0 wird.
-        width = utils_maxInt(width, 1);
-        height = utils_maxInt(height, 1);
+        GLsizei w = utils_maxInt(width >> level, 1);
+        GLsizei h = utils_maxInt(height >> level, 1);
+        size_t size = (size_t)((w + 3) / 4) * (size_t)((h + 3) / 4) * (size_t)blockSize;
+        if (levels[level].byteLength != (uint64_t)size)
+        {
+            fprintf(stderr, "Error: Corrupt mipmap %d in image file \"%s\"!\n", level, filename);
+            free(levels);
+            fclose(f);
+            return;
+        }
+    }
 
-        // Die Größe der Daten bestimmen und diese an OpenGL übergeben.
-        GLsizei size = ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
-        glCompressedTexImage2D(
-            GL_TEXTURE_2D, // Das Ziel
-            level,         // Das zu setzende Mipmap Level
-            format,        // Das interne Datenformat
-            width, height, // Die Bildgröße
-            0,             // "border" muss laut Dokumentation auf 0 stehen
-            size,          // Die Größe der komprimierten Daten
-            data + offset  // Ein Zeiger auf die Daten ab dem Offset
-        );
+    // Sofort geladen werden nur die Mipmaps bis TEXTURE_STREAMING_MIN_SIZE.
+    int tailLevel = 0;
+    while (tailLevel + 1 < levelCount &&
+           utils_maxInt(width >> tailLevel, height >> tailLevel) > TEXTURE_STREAMING_MIN_SIZE)
+    {
+        tailLevel++;
+    }
 
-        // Den Offset verschieben und die Größe anpassen.
-        offset += size;
-        width /= 2;
-        height /= 2;
+    // Das neue Textur-Objekt binden. Kleine Texturen erhalten einmalig
+    // Speicher für alle Mipmaps. Gestreamte Texturen brauchen veränderbaren
+    // Speicher, damit große Mipmaps später angelegt und wieder freigegeben
+    // werden können.
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    if (tailLevel == 0)
+    {
+        glTexStorage2D(GL_TEXTURE_2D, levelCount, format, width, height);
+    }
+    else
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, tailLevel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
     }
 
-    // Wenn nötig, automatisch die Mipmaps erstellen lassen.
-    if (ddsDesc.dwMipMapCount <= 1)
+    // Ein Buffer reicht für alle Mipmaps, die größte wird zuerst geladen.
+    unsigned char *data = malloc((size_t)levels[tailLevel].byteLength);
+    if (data == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate memory for image file \"%s\"!\n", filename);
+        free(levels);
+        fclose(f);
+        return;
+    }
+    bool success = true;
+    for (int level = tailLevel; level < levelCount; level++)
     {
-        glGenerateMipmap(GL_TEXTURE_2D);
+        GLsizei w = utils_maxInt(width >> level, 1);
+        GLsizei h = utils_maxInt(height >> level, 1);
+        GLsizei size = (GLsizei)levels[level].byteLength;
+        if (fseek(f, (long)levels[level].byteOffset, SEEK_SET) != 0 ||
+            fread(data, 1, (size_t)size, f) != (size_t)size)
+        {
+            fprintf(stderr, "Error: Corrupt mipmap %d in image file \"%s\"!\n", level, filename);
+            success = false;
+            break;
+        }
+
+        if (tailLevel == 0)
+        {
+            glCompressedTexSubImage2D(
+                GL_TEXTURE_2D, // Das Ziel
+                level,         // Das zu setzende Mipmap Level
+                0, 0,          // Der Versatz innerhalb der Mipmap
+                w, h,          // Die Bildgröße
+                format,        // Das Datenformat
+                size,          // Die Größe der komprimierten Daten
+                data           // Ein Zeiger auf die Daten
+            );
+        }
+        else
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, format, w, h, 0, size, data);
+        }
     }
 
-    // Zum Schluss muss noch der Speicher für die Bilddaten freigegeben werden.
     free(data);
+    fclose(f);
+
+    // Die restlichen Mipmaps werden gestreamt, der Level-Index wird dafür
+    // weiter benötigt.
+    if (success && tailLevel > 0)
+    {
+        texture_registerStream(textureId, filename, format, width, height, levels,
+                               levelCount, tailLevel);
+    }
+    else
+    {
+        free(levels);
+    }
+}
+
+/**
+ * Sucht eine mit tools/ktxconv erzeugte KTX2 Datei neben einer Bilddatei,
+ * z.B. "wall.ktx2" für "wall.png".
+ *
+ * @param filename der Pfad zur Bilddatei
+ * @return der Pfad zur KTX2 Datei oder NULL, wenn es keine gibt. Muss mit
+ *         free wieder freigegeben werden.
+ */
+static char *texture_findKTX2(const char *filename)
+{
+    const char *dot = strrchr(filename, '.');
+    const char *slash = strrchr(filename, '/');
+    size_t length = (dot && (!slash || dot > slash)) ? (size_t)(dot - filename) : strlen(filename);
+
+    char *path = malloc(length + strlen(".ktx2") + 1);
+    memcpy(path, filename, length);
+    strcpy(path + length, ".ktx2");
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        free(path);
+        return NULL;
+    }
+    fclose(f);
+    return path;
 }
 
 /**
@@ -226,9 +1160,14 @@ static void texture_loadFromImage(GLuint textureId, const char *filename, GLbool
     // Wir aktivieren vertikales Spiegeln für das Laden von Bildern.
     stbi_set_flip_vertically_on_load(true);
 
-    // Dann laden wir die Textur aus der angegebenen Datei.
+    // RGB Bilder werden mit Alpha geladen, damit die Mipmaps mit den
+    // schnelleren RGBA Kerneln erzeugt werden können. Das interne Format
+    // bleibt RGB.
     int width, height, channels;
-    unsigned char *data = stbi_load(filename, &width, &height, &channels, 0);
+    int wanted = stbi_info(filename, &width, &height, &channels) && channels == 3 ? 4 : 0;
+
+    // Dann laden wir die Textur aus der angegebenen Datei.
+    unsigned char *data = stbi_load(filename, &width, &height, &channels, wanted);
     if (!data)
     {
         fprintf(stderr, "Error: Could not read image file \"%s\"!\n", filename);
@@ -237,23 +1176,28 @@ static void texture_loadFromImage(GLuint textureId, const char *filename, GLbool
 
     // Als nächstes bestimmen wir das OpenGL Bilddatenformat anhand der Anzahl
     // der Kanäle.
+    GLenum internalFormat;
     GLenum format;
     switch (channels)
     {
     case 1:
+        internalFormat = GL_R8;
         format = GL_RED;
         break;
 
     case 2:
+        internalFormat = GL_RG8;
         format = GL_RG;
         break;
 
     case 3:
-        format = diffuse ? GL_SRGB : GL_RGB;
+        internalFormat = diffuse ? GL_SRGB8 : GL_RGB8;
+        format = GL_RGBA;
         break;
 
     case 4:
-        format = diffuse ? GL_SRGB_ALPHA : GL_RGBA;
+        internalFormat = diffuse ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        format = GL_RGBA;
         break;
 
     default:
@@ -264,33 +1208,115 @@ static void texture_loadFromImage(GLuint textureId, const char *filename, GLbool
         stbi_image_free(data);
         return;
     }
+    if (wanted)
+    {
+        channels = wanted;
+    }
+
+    // Die Mipmaps werden auf der CPU erzeugt statt über glGenerateMipmap.
+    // So werden sRGB Farben immer linear gemittelt und die Arbeit läuft
+    // parallel im Ladethread statt auf dem Render-Thread des Treibers.
+    MipmapChain chain;
+    mipmap_generate(&chain, data, width, height, channels, diffuse);
 
     // Das neue Textur-Objekt binden/aktivieren.
     glBindTexture(GL_TEXTURE_2D, textureId);
 
-    // Die Texturdaten an OpenGL übergeben.
-    glTexImage2D(
-        GL_TEXTURE_2D,    // Das Ziel
-        0,                // Das zu setzende Mipmap Level
-        format,           // Das interne Datenformat
-        width, height,    // Die Bildgröße
-        0,                // "border" muss laut Dokumentation auf 0 stehen
-        format,           // Das Format der übergebenen Pixeldaten
-        GL_UNSIGNED_BYTE, // Der Datentyp der übergebenen Daten
-        data              // Die Bilddaten
-    );
-
-    // Automatisch die Mipmaps erstellen lassen.
-    glGenerateMipmap(GL_TEXTURE_2D);
+    // Speicher für alle Mipmaps anlegen und die Texturdaten an OpenGL
+    // übergeben. Die Zeilen sind nicht aufgefüllt, bei ein oder zwei
+    // Kanälen sind sie daher nicht immer an 4 Byte ausgerichtet.
+    glTexStorage2D(GL_TEXTURE_2D, chain.levelCount, internalFormat, width, height);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = 0; level < chain.levelCount; level++)
+    {
+        glTexSubImage2D(
+            GL_TEXTURE_2D,      // Das Ziel
+            level,              // Das zu setzende Mipmap Level
+            0, 0,               // Der Versatz innerhalb des Levels
+            chain.width[level], // Die Größe des Levels
+            chain.height[level],
+            format,             // Das Format der übergebenen Pixeldaten
+            GL_UNSIGNED_BYTE,   // Der Datentyp der übergebenen Daten
+            chain.levels[level] // Die Bilddaten
+        );
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
     // Zum Schluss müssen die geladenen Bilddaten wieder freigegeben.
     // OpenGL hat selbst eine Kopie der Daten angelegt.
+    mipmap_free(&chain);
     stbi_image_free(data);
 }
 
+/**
+ * Sperrt den Texture Cache, sofern er bereits initialisiert wurde.
+ */
+static void texture_lockCache(void)
+{
+    if (g_textureCacheMutex)
+    {
+        thread_lockMutex(g_textureCacheMutex);
+    }
+}
+
+/**
+ * Gibt den Texture Cache wieder frei.
+ */
+static void texture_unlockCache(void)
+{
+    if (g_textureCacheMutex)
+    {
+        thread_unlockMutex(g_textureCacheMutex);
+    }
+}
+
+/**
+ * Sucht eine Datei im Texture Cache. Der Cache muss dabei gesperrt sein.
+ *
+ * @param filename der Dateiname der Textur
+ * @return die ID der Textur oder 0, falls sie noch nicht geladen wurde
+ */
+static GLuint texture_findCached(const char *filename)
+{
+    for (GLint i = 0; i < g_textureCache.count; i++)
+    {
+        if (strcmp(g_textureCache.data[i].filename, filename) == 0)
+        {
+            return g_textureCache.data[i].textureId;
+        }
+    }
+
+    return 0;
+}
+
 //////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
 
+void texture_initCache(void)
+{
+    mipmap_init();
+    g_textureCacheMutex = thread_createMutex();
+    g_textureStreamMutex = thread_createMutex();
+}
+
+void texture_cleanupCache(void)
+{
+    deleteTextureCache();
+    thread_deleteMutex(g_textureCacheMutex);
+    g_textureCacheMutex = NULL;
+
+    // Texturen, die nicht gelöscht wurden, werden nicht mehr gestreamt.
+    for (ptrdiff_t i = 0; i < stbds_hmlen(g_textureStreams); i++)
+    {
+        texture_freeStream(g_textureStreams[i].value);
+    }
+    stbds_hmfree(g_textureStreams);
+    stbds_arrfree(g_streamCandidates);
+    thread_deleteMutex(g_textureStreamMutex);
+    g_textureStreamMutex = NULL;
+}
+
 void deleteTextureCache(){
+    texture_lockCache();
     if(g_textureCache.count > 0){
         for (GLint i = 0; i < g_textureCache.count; i++)
         {
@@ -300,16 +1326,19 @@ void deleteTextureCache(){
         g_textureCache.data = NULL;
         g_textureCache.count = 0;
     }
+    texture_unlockCache();
 }
 
 GLuint texture_loadTexture(const char *filename, GLenum wrapping, GLboolean diffuse)
 {
-    for (GLint i = 0; i < g_textureCache.count; i++)
+    // Der Cache ist nur beim Suchen und Eintragen gesperrt, damit das
+    // Laden selbst den anderen Thread nicht blockiert.
+    texture_lockCache();
+    GLuint cachedId = texture_findCached(filename);
+    texture_unlockCache();
+    if (cachedId)
     {
-        if (strcmp(g_textureCache.data[i].filename, filename) == 0)
-        {
-            return g_textureCache.data[i].textureId;
-        }
+        return cachedId;
     }
 
     // Zuerst erstellen wir ein Textur-Objekt, damit wir immer eine valide
@@ -317,11 +1346,26 @@ GLuint texture_loadTexture(const char *filename, GLenum wrapping, GLboolean diff
     GLuint textureId;
     glGenTextures(1, &textureId);
 
-    // Danach muss geprüft werden, ob eine DDS Datei oder ein anderes Format
-    // vorliegt, da DDS Dateien anders geladen werden müssen.
+    // Danach muss geprüft werden, ob eine DDS Datei, eine KTX2 Datei oder
+    // ein anderes Format vorliegt, da komprimierte Dateien anders geladen
+    // werden müssen. Liegt neben einem Bild eine konvertierte KTX2 Datei,
+    // wird diese bevorzugt.
+    // DDS Dateien können auch Arrays und Cube Maps enthalten, alle anderen
+    // Formate sind immer 2D-Texturen.
+    GLenum target = GL_TEXTURE_2D;
+    char *ktx2 = NULL;
     if (utils_hasSuffix(filename, ".dds"))
     {
-        texture_loadFromDDS(textureId, filename, diffuse);
+        target = texture_loadFromDDS(textureId, filename, diffuse);
+    }
+    else if (utils_hasSuffix(filename, ".ktx2"))
+    {
+        texture_loadFromKTX2(textureId, filename, diffuse);
+    }
+    else if ((ktx2 = texture_findKTX2(filename)) != NULL)
+    {
+        texture_loadFromKTX2(textureId, ktx2, diffuse);
+        free(ktx2);
     }
     else
     {
@@ -332,19 +1376,23 @@ GLuint texture_loadTexture(const char *filename, GLenum wrapping, GLboolean diff
     // Wir stellen noch einmal sicher, dass die Textur auch gebunden ist.
     // Eigentlich sollte sie bereits in den Ladefunktionen gebunden worden sein.
     // Wenn jedoch ein Fehler aufgetreten ist, findet das Binden nicht statt.
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    glBindTexture(target, textureId);
 
     // Danach stellen wir ein, welcher Texture-Wrapping Modus verwendet werden
     // soll. Dieser findet verwendung, wenn Texturdaten an Koordinaten
     // ausgelesen werden, die außerhalb von 0 und 1 liegen.
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapping);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapping);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, wrapping);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, wrapping);
+    if (target != GL_TEXTURE_2D)
+    {
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, wrapping);
+    }
 
     // Desweiteren setzen wir die Filter für weit entfernte und nahe Ansichten.
     // GL_LINEAR heißt, dass zwischen den Farbwerten interpoliert werden soll.
     // Wir benutzen diesen Modus, wenn die Textur größer als möglich angezeigt
     // wird.
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     // Wenn die Textur kleiner angezeigt wird, verwenden wir Mipmaps.
     // Das sind spezielle verkleinerte Texturen. Explizit verwenden wir den
@@ -352,67 +1400,329 @@ GLuint texture_loadTexture(const char *filename, GLenum wrapping, GLboolean diff
     // Mipmaps, die am besten passen, und interpoliert dann nochmal den
     // korrekten Farbwert.
     glTexParameteri(
-        GL_TEXTURE_2D,
+        target,
         GL_TEXTURE_MIN_FILTER,
         GL_LINEAR_MIPMAP_LINEAR);
 
+    // Während wir geladen haben, kann ein anderer Thread dieselbe Datei
+    // geladen und eingetragen haben. Dann gewinnt der vorhandene Eintrag und
+    // unsere Kopie wird wieder gelöscht.
+    texture_lockCache();
+    cachedId = texture_findCached(filename);
+    if (cachedId)
+    {
+        texture_unlockCache();
+        texture_deleteTexture(textureId);
+        return cachedId;
+    }
+
     g_textureCache.count++;
     g_textureCache.data = realloc(g_textureCache.data, sizeof(TextureCacheEntry) * g_textureCache.count);
     g_textureCache.data[g_textureCache.count - 1].textureId = textureId;
     g_textureCache.data[g_textureCache.count - 1].filename = malloc(strlen(filename) + 1);
     strcpy(g_textureCache.data[g_textureCache.count - 1].filename, filename);
+    texture_unlockCache();
 
     return textureId;
 }
 
 void texture_deleteTexture(GLuint textureId)
 {
-    // Aktuell ist die Funktion nur ein Wrapper um die native OpenGL Funktion.
-    // Dadurch entsteht aber ein einheitliches Interface. Außerdem kann diese
-    // Funktion später auch genutzt werden, um zusätzliche Ressourcen frei zu
-    // geben (z.B. das entfernen der Textur aus einem Cache).
+    // Gestreamte Texturen werden zuerst ausgetragen, damit die Aktualisierung
+    // im Hauptthread sie nicht mehr anfasst.
+    TextureStream *stream = NULL;
+    texture_lockStreams();
+    ptrdiff_t index = stbds_hmgeti(g_textureStreams, textureId);
+    if (index >= 0)
+    {
+        stream = g_textureStreams[index].value;
+        stbds_hmdel(g_textureStreams, textureId);
+    }
+    texture_unlockStreams();
+
+    if (stream)
+    {
+        texture_freeStream(stream);
+    }
+
     glDeleteTextures(1, &textureId);
 }
 
-void texture_saveScreenshot(ProgContext *ctx)
+void texture_requestSize(GLuint textureId, float pixels)
+{
+    texture_lockStreams();
+    ptrdiff_t index = stbds_hmgeti(g_textureStreams, textureId);
+    if (index >= 0)
+    {
+        TextureStream *stream = g_textureStreams[index].value;
+        if (stream->lastRequestFrame != g_streamFrame)
+        {
+            stream->lastRequestFrame = g_streamFrame;
+            stream->requestLevel = stream->tailLevel;
+            stream->requestPixels = 0.0f;
+        }
+
+        // Die kleinste Mipmap wählen, die noch mindestens so groß wie die
+        // Darstellung auf dem Bildschirm ist.
+        int size = utils_maxInt(stream->width, stream->height);
+        int level = 0;
+        while (level < stream->tailLevel && (float)(size >> (level + 1)) >= pixels)
+        {
+            level++;
+        }
+
+        stream->requestLevel = utils_minInt(stream->requestLevel, level);
+        stream->requestPixels = fmaxf(stream->requestPixels, pixels);
+    }
+    texture_unlockStreams();
+}
+
+void texture_updateStreaming(size_t budget)
+{
+    texture_lockStreams();
+
+    // Die Uploads verändern die Bindung der aktiven Textureinheit.
+    GLint previous;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+
+    // Fertig gelesene Mipmaps hochladen und den Speicher der noch laufenden
+    // Lesevorgänge bestimmen.
+    size_t loading = 0;
+    int loadCount = 0;
+    for (ptrdiff_t i = 0; i < stbds_hmlen(g_textureStreams); i++)
+    {
+        TextureStream *stream = g_textureStreams[i].value;
+        if (stream->loadLevel < 0)
+        {
+            continue;
+        }
+        if (jobs_isDone(&stream->job))
+        {
+            texture_finishStream(stream);
+        }
+        else
+        {
+            loading += (size_t)stream->levels[stream->loadLevel].byteLength;
+            loadCount++;
+        }
+    }
+
+    // Geladenen und angeforderten Speicher bestimmen und alle Texturen
+    // sammeln, die eine größere Mipmap benötigen.
+    size_t resident = 0;
+    size_t requested = 0;
+    stbds_arrsetlen(g_streamCandidates, 0);
+    for (ptrdiff_t i = 0; i < stbds_hmlen(g_textureStreams); i++)
+    {
+        TextureStream *stream = g_textureStreams[i].value;
+        int wanted = texture_wantedLevel(stream);
+        resident += texture_streamBytes(stream, stream->residentLevel);
+        requested += texture_streamBytes(stream, wanted);
+        if (wanted < stream->residentLevel && stream->loadLevel < 0)
+        {
+            stbds_arrput(g_streamCandidates, stream);
+        }
+    }
+
+    // Wurde das Budget verkleinert, werden zuerst nicht benötigte Mipmaps
+    // freigegeben, danach die der am kleinsten dargestellten Texturen.
+    TextureStream *victim;
+    while (resident + loading > budget && (victim = texture_findVictim(NULL)) != NULL)
+    {
+        resident -= (size_t)victim->levels[victim->residentLevel].byteLength;
+        texture_evictLevel(victim);
+    }
+
+    // Die am größten dargestellten Texturen zuerst um jeweils eine Mipmap
+    // verfeinern. Passt sie nicht mehr in das Budget, werden Mipmaps weniger
+    // wichtiger Texturen verdrängt.
+    qsort(g_streamCandidates, stbds_arrlen(g_streamCandidates), sizeof(TextureStream *),
+          texture_compareStreams);
+    for (ptrdiff_t i = 0; i < stbds_arrlen(g_streamCandidates) && loadCount < TEXTURE_STREAMING_MAX_LOADS; i++)
+    {
+        TextureStream *stream = g_streamCandidates[i];
+        int level = stream->residentLevel - 1;
+        size_t bytes = (size_t)stream->levels[level].byteLength;
+        while (resident + loading + bytes > budget && (victim = texture_findVictim(stream)) != NULL)
+        {
+            resident -= (size_t)victim->levels[victim->residentLevel].byteLength;
+            texture_evictLevel(victim);
+        }
+        if (resident + loading + bytes > budget)
+        {
+            break;
+        }
+
+        // Gelesen wird im Hintergrund, hochgeladen in einem der nächsten
+        // Frames. Ohne Worker-Threads wird direkt gelesen.
+        stream->loadLevel = level;
+        stream->loadData = malloc(bytes);
+        jobs_run(&stream->job, texture_streamJob, stream);
+        if (jobs_getThreadCount() == 1)
+        {
+            jobs_wait(&stream->job);
+        }
+        loading += bytes;
+        loadCount++;
+    }
+
+    g_streamResident = resident;
+    g_streamRequested = requested;
+    g_streamFrame++;
+
+    glBindTexture(GL_TEXTURE_2D, (GLuint)previous);
+    texture_unlockStreams();
+}
+
+void texture_getStreamingStats(size_t *resident, size_t *requested)
 {
-    // Wir brauchen die Größe des Framebuffers.
-    int width = ctx->winData->width;
-    int height = ctx->winData->height;
+    texture_lockStreams();
+    *resident = g_streamResident;
+    *requested = g_streamRequested;
+    texture_unlockStreams();
+}
 
-    // Als nächstes muss der notwendige Speicher für die Bilddaten reserviert
-    // werden.
-    char *imageData = malloc(width * height * 3);
+void texture_benchmarkDDS(void)
+{
+    printf("DDS-Benchmark:\n");
+    bool ok = true;
+
+    // Gültige Ausgangsdateien: eine Cube Map mit klassischem BC1 Header und
+    // ein BC7 Array mit DX10 Header. Beide müssen angenommen werden, mit
+    // einem Byte weniger Bilddaten aber abgelehnt.
+    unsigned char bases[2][DDS_MAX_HEADER_BYTES];
+    size_t baseSizes[2];
+    uint64_t baseFileSizes[2];
+    baseSizes[0] = texture_writeDDSHeader(bases[0], 64, 64, 7, 0, 1, true);
+    baseSizes[1] = texture_writeDDSHeader(bases[1], 256, 128, 9, DXGI_FORMAT_BC7_UNORM, 3, false);
+
+    DdsLayout layout;
+    for (int b = 0; b < 2; b++)
+    {
+        ok &= texture_parseDDSHeader(bases[b], baseSizes[b], UINT64_MAX, GL_FALSE, &layout) == DDS_HEADER_VALID;
+        baseFileSizes[b] = layout.dataStart + layout.dataSize;
+        ok &= texture_parseDDSHeader(bases[b], baseSizes[b], baseFileSizes[b] - 1, GL_FALSE, &layout) == DDS_HEADER_TRUNCATED;
+    }
 
-    // Die folgende Anweisung entfernt ein mögliches Padding der Daten.
-    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // Fuzzing: zufällige Bytes und Felder des Headers überschreiben, den
+    // Header oder die Datei kürzen. Jeder angenommene Header muss einen
+    // Aufbau innerhalb aller Grenzen liefern. Der Header liegt dabei in
+    // einem Speicherblock passender Größe, damit Zugriffe hinter sein Ende
+    // mit dem AddressSanitizer auffallen.
+    uint32_t seed = 12345u;
+    int accepted = 0;
+    int failed = 0;
+    double start = glfwGetTime();
+    for (int run = 0; run < TEXTURE_DDS_FUZZ_RUNS; run++)
+    {
+        int b = run & 1;
+        unsigned char header[DDS_MAX_HEADER_BYTES];
+        memcpy(header, bases[b], DDS_MAX_HEADER_BYTES);
 
-    // Mit glReadPixels können wir den aktiven Framebuffer auslesen.
-    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, imageData);
+        int changes = 1 + (int)(texture_random(&seed) % 4);
+        for (int i = 0; i < changes; i++)
+        {
+            uint32_t pos = texture_random(&seed) % (uint32_t)baseSizes[b];
+            uint32_t value = texture_random(&seed);
+            if (value & 1)
+            {
+                header[pos] = (unsigned char)(value >> 8);
+            }
+            else
+            {
+                memcpy(header + (pos & ~3u), &value, sizeof(value));
+            }
+        }
 
-    // Als nächstes muss der Dateiname des neuen Screenshots bestimmt werden.
-    char filename[SCREENSHOT_FILENAME_SIZE];
-    time_t now = time(NULL);
-    strftime(
-        filename,
-        SCREENSHOT_FILENAME_SIZE - 1,
-        "screenshot_%Y-%m-%d_%H-%M-%S.png",
-        localtime(&now));
+        size_t headerSize = baseSizes[b];
+        if (texture_random(&seed) % 8 == 0)
+        {
+            headerSize = texture_random(&seed) % (headerSize + 1);
+        }
+        uint64_t fileSize = baseFileSizes[b];
+        switch (texture_random(&seed) % 4)
+        {
+        case 0: fileSize = texture_random(&seed) % (fileSize + 1); break;
+        case 1: fileSize = ((uint64_t)texture_random(&seed) << 32) | texture_random(&seed); break;
+        default: break;
+        }
 
-    // Wir aktivieren hier vertikales Spiegeln, falls eine andere Funktion es
-    // zuvor deaktiviert hat. Die Spiegelung ist nötig, da OpenGL ein anderes
-    // Koordinatensystem als PNG bzw. stb_image_write verwendet.
-    stbi_flip_vertically_on_write(true);
+        unsigned char *copy = malloc(headerSize > 0 ? headerSize : 1);
+        memcpy(copy, header, headerSize);
+        if (texture_parseDDSHeader(copy, headerSize, fileSize, GL_FALSE, &layout) == DDS_HEADER_VALID)
+        {
+            accepted++;
+            failed += !texture_checkDDSLayout(&layout, headerSize, fileSize);
+        }
+        free(copy);
+    }
+    double fuzzTime = (glfwGetTime() - start) * 1e3;
+    ok &= failed == 0;
+
+    // Durchsatz: eine BC7 Textur mit allen Mipmaps schreiben und mehrfach
+    // laden. Die Datei liegt danach im Dateicache, gemessen wird also das
+    // Lesen in den Pixel Unpack Buffer und die Übergabe an OpenGL.
+    unsigned char header[DDS_MAX_HEADER_BYTES];
+    size_t headerSize = texture_writeDDSHeader(header, TEXTURE_DDS_BENCHMARK_SIZE, TEXTURE_DDS_BENCHMARK_SIZE, 12,
+                                               DXGI_FORMAT_BC7_UNORM, 1, false);
+    texture_parseDDSHeader(header, headerSize, UINT64_MAX, GL_FALSE, &layout);
+
+    FILE *f = fopen(TEXTURE_DDS_BENCHMARK_FILE, "wb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Error: Could not create \"%s\"!\n", TEXTURE_DDS_BENCHMARK_FILE);
+        return;
+    }
+    bool written = fwrite(header, 1, headerSize, f) == headerSize;
+    unsigned char *chunk = malloc(TEXTURE_DDS_BENCHMARK_CHUNK);
+    for (int i = 0; i < TEXTURE_DDS_BENCHMARK_CHUNK; i++)
+    {
+        chunk[i] = (unsigned char)texture_random(&seed);
+    }
+    for (uint64_t left = layout.dataSize; left > 0 && written;)
+    {
+        size_t count = left < TEXTURE_DDS_BENCHMARK_CHUNK ? (size_t)left : TEXTURE_DDS_BENCHMARK_CHUNK;
+        written = fwrite(chunk, 1, count, f) == count;
+        left -= count;
+    }
+    free(chunk);
+    written = fclose(f) == 0 && written;
 
-    // Als nächstes schreiben wir die Bilddaten. Sollte es zu einem Fehler
-    // kommen, wird eine Fehlermeldung ausgegeben.
-    if (!stbi_write_png(filename, width, height, 3, imageData, 0))
+    // Alte Fehler verwerfen, damit nur die des Benchmarks gezählt werden.
+    while (glGetError() != GL_NO_ERROR)
     {
-        fprintf(stderr, "Error on saving screenshot: Could not write file!");
     }
 
-    // Zum Schluss muss noch der belegte Speicher wieder freigegeben werden.
-    free(imageData);
+    int loaded = 0;
+    start = glfwGetTime();
+    for (int i = 0; i < TEXTURE_DDS_BENCHMARK_LOADS && written; i++)
+    {
+        GLuint textureId;
+        glGenTextures(1, &textureId);
+        GLenum target = texture_loadFromDDS(textureId, TEXTURE_DDS_BENCHMARK_FILE, GL_FALSE);
+
+        // Nur bei Erfolg wurde unveränderlicher Speicher angelegt.
+        GLint immutable = GL_FALSE;
+        glBindTexture(target, textureId);
+        glGetTexParameteriv(target, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+        loaded += immutable == GL_TRUE;
+
+        glBindTexture(target, 0);
+        glDeleteTextures(1, &textureId);
+    }
+    glFinish();
+    double loadTime = (glfwGetTime() - start) * 1e3 / TEXTURE_DDS_BENCHMARK_LOADS;
+    remove(TEXTURE_DDS_BENCHMARK_FILE);
+
+    ok &= written && loaded == TEXTURE_DDS_BENCHMARK_LOADS && glGetError() == GL_NO_ERROR;
+
+    double megabytes = (double)(headerSize + layout.dataSize) / (1024.0 * 1024.0);
+    printf("  Header-Fuzzing: %8.2f ms (%d Header, %d angenommen, %d fehlerhaft)\n",
+           fuzzTime, TEXTURE_DDS_FUZZ_RUNS, accepted, failed);
+    printf("  Laden BC7:      %8.2f ms (%dx%d, %.1f MB/s)\n",
+           loadTime, TEXTURE_DDS_BENCHMARK_SIZE, TEXTURE_DDS_BENCHMARK_SIZE,
+           loadTime > 0.0 ? megabytes * 1e3 / loadTime : 0.0);
+    printf("  Ergebnis: %s\n", ok ? "OK" : "FEHLER");
 }
 
 static void load_cube_map_side(GLenum side_target, const char *file_name, GLuint *texture)
@@ -14,7 +14,10 @@
 
 /**
  * Erzeugt eine OpenGL Textur aus einer Bilddatei.
- * Es werden auch DDS Dateien unterstützt.
+ * Es werden auch DDS und KTX2 Dateien unterstützt. Liegt neben einer
+ * Bilddatei eine mit tools/ktxconv erzeugte KTX2 Datei gleichen Namens,
+ * wird stattdessen diese geladen. DDS Dateien dürfen auch Arrays und Cube
+ * Maps enthalten, die Textur muss dann an das passende Target gebunden werden.
  * 
  * Im Fehlerfall wird immer eine korrekte Textur-ID zurückgegeben. Allerdings
  * fehlen unter umständen die nötigen Bilddaten.
@@ -35,20 +38,62 @@ GLuint texture_loadTexture(const char* filename, GLenum wrapping, GLboolean diff
 void texture_deleteTexture(GLuint textureId);
 
 /**
- * Speichert einen Screenshot in dem Programmverzeichnis.
- * Der Dateiname lautet screenshot_yyyy-MM-dd_hh-mm-ss.png wobei das aktuelle
- * Datum und die aktuelle Uhrzeit eingesetzt wird.
- * Es wird grundsätzlich der aktive Framebuffer ausgelesen.
+ * Meldet, dass eine Textur im aktuellen Frame sichtbar ist und dabei etwa
+ * die angegebene Größe auf dem Bildschirm hat. Daraus wird die größte
+ * benötigte Mipmap bestimmt. Texturen, die nicht gestreamt werden, werden
+ * ignoriert.
  * 
- * @param ctx der aktuelle Programmkontext
+ * @param textureId die Textur
+ * @param pixels die dargestellte Kantenlänge in Pixeln
  */
-void texture_saveScreenshot(ProgContext* ctx);
+void texture_requestSize(GLuint textureId, float pixels);
+
+/**
+ * Aktualisiert die gestreamten Texturen. Fertig gelesene Mipmaps werden
+ * hochgeladen und für angeforderte Texturen die nächstgrößeren Mipmaps im
+ * Hintergrund gelesen. Überschreiten die geladenen Mipmaps das Budget,
+ * werden die am längsten nicht benötigten wieder freigegeben.
+ * Muss einmal pro Frame im Hauptthread nach allen Anforderungen über
+ * texture_requestSize aufgerufen werden.
+ * 
+ * @param budget der Grafikspeicher für gestreamte Texturen in Bytes
+ */
+void texture_updateStreaming(size_t budget);
+
+/**
+ * Liefert den Speicher der gestreamten Texturen bei der letzten
+ * Aktualisierung.
+ * 
+ * @param resident Ziel für den Speicher der geladenen Mipmaps in Bytes
+ * @param requested Ziel für den Speicher der benötigten Mipmaps in Bytes
+ */
+void texture_getStreamingStats(size_t *resident, size_t *requested);
+
+/**
+ * Prüft das Laden von DDS Dateien und gibt das Ergebnis auf der Konsole
+ * aus. Zuerst werden zufällig veränderte Header geprüft, danach wird der
+ * Durchsatz beim Laden einer großen BC7 Textur gemessen. Muss im
+ * Hauptthread mit aktivem OpenGL Kontext aufgerufen werden.
+ */
+void texture_benchmarkDDS(void);
 
 /**
  * Gibt den reservierten Speicher vom Texture Cache wieder frei
  */ 
 void deleteTextureCache();
 
+/**
+ * Legt den Mutex des Texture Cache an und bereitet das Erzeugen der
+ * Mipmaps vor. Muss vor dem ersten Laden einer Textur aufgerufen werden, da
+ * der Cache auch vom Lade-Thread benutzt wird.
+ */
+void texture_initCache(void);
+
+/**
+ * Leert den Texture Cache und löscht seinen Mutex.
+ */
+void texture_cleanupCache(void);
+
 void texture_create_cube_map(
     const char *front,
     const char *back,
@@ -0,0 +1,230 @@
+/**
+ * Modul für plattformunabhängige Threads.
+ * Kapselt POSIX Threads bzw. die Win32 Threads hinter einer gemeinsamen
+ * Schnittstelle.
+ * 
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "thread.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Implementierung der Datenstruktur, die einen Thread repräsentiert.
+struct Thread
+{
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    ThreadFunction func;
+    void* arg;
+};
+
+// Implementierung des Mutex.
+struct Mutex
+{
+#ifdef _WIN32
+    SRWLOCK lock;
+#else
+    pthread_mutex_t lock;
+#endif
+};
+
+// Implementierung der Bedingungsvariable.
+struct Condition
+{
+#ifdef _WIN32
+    CONDITION_VARIABLE cond;
+#else
+    pthread_cond_t cond;
+#endif
+};
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Einstiegspunkt aller Threads, ruft die eigentliche Funktion auf.
+ * 
+ * @param param der zugehörige Thread
+ * @return immer 0
+ */
+#ifdef _WIN32
+static DWORD WINAPI thread_entry(LPVOID param)
+#else
+static void* thread_entry(void* param)
+#endif
+{
+    Thread* thread = param;
+    thread->func(thread->arg);
+    return 0;
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+Thread* thread_create(ThreadFunction func, void* arg)
+{
+    Thread* thread = malloc(sizeof(Thread));
+    thread->func = func;
+    thread->arg = arg;
+
+#ifdef _WIN32
+    thread->handle = CreateThread(NULL, 0, thread_entry, thread, 0, NULL);
+    bool ok = thread->handle != NULL;
+#else
+    bool ok = pthread_create(&thread->handle, NULL, thread_entry, thread) == 0;
+#endif
+
+    if (!ok)
+    {
+        fprintf(stderr, "Error: Could not create thread!\n");
+        free(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+void thread_join(Thread* thread)
+{
+    if (thread == NULL)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+
+    free(thread);
+}
+
+int thread_getProcessorCount(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return count > 0 ? count : 1;
+}
+
+void thread_yield(void)
+{
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+Mutex* thread_createMutex(void)
+{
+    Mutex* mutex = malloc(sizeof(Mutex));
+#ifdef _WIN32
+    InitializeSRWLock(&mutex->lock);
+#else
+    pthread_mutex_init(&mutex->lock, NULL);
+#endif
+    return mutex;
+}
+
+void thread_lockMutex(Mutex* mutex)
+{
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&mutex->lock);
+#else
+    pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+void thread_unlockMutex(Mutex* mutex)
+{
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(&mutex->lock);
+#else
+    pthread_mutex_unlock(&mutex->lock);
+#endif
+}
+
+void thread_deleteMutex(Mutex* mutex)
+{
+    if (mutex == NULL)
+    {
+        return;
+    }
+
+#ifndef _WIN32
+    pthread_mutex_destroy(&mutex->lock);
+#endif
+    free(mutex);
+}
+
+Condition* thread_createCondition(void)
+{
+    Condition* cond = malloc(sizeof(Condition));
+#ifdef _WIN32
+    InitializeConditionVariable(&cond->cond);
+#else
+    pthread_cond_init(&cond->cond, NULL);
+#endif
+    return cond;
+}
+
+void thread_waitCondition(Condition* cond, Mutex* mutex)
+{
+#ifdef _WIN32
+    SleepConditionVariableSRW(&cond->cond, &mutex->lock, INFINITE, 0);
+#else
+    pthread_cond_wait(&cond->cond, &mutex->lock);
+#endif
+}
+
+void thread_broadcastCondition(Condition* cond)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(&cond->cond);
+#else
+    pthread_cond_broadcast(&cond->cond);
+#endif
+}
+
+void thread_deleteCondition(Condition* cond)
+{
+    if (cond == NULL)
+    {
+        return;
+    }
+
+#ifndef _WIN32
+    pthread_cond_destroy(&cond->cond);
+#endif
+    free(cond);
+}
+
+void thread_atomicFence(void)
+{
+#ifdef _MSC_VER
+    MemoryBarrier();
+#else
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
@@ -0,0 +1,321 @@
+/**
+ * Modul für plattformunabhängige Threads.
+ * Kapselt POSIX Threads bzw. die Win32 Threads hinter einer gemeinsamen
+ * Schnittstelle.
+ * 
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "common.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//////////////////////////// ÖFFENTLICHE DATENTYPEN ////////////////////////////
+
+// Datenstruktur, die einen laufenden Thread repräsentiert.
+struct Thread;
+typedef struct Thread Thread;
+
+// Funktion, die in einem neuen Thread ausgeführt wird.
+typedef void (*ThreadFunction)(void* arg);
+
+// Gegenseitiger Ausschluss für kritische Abschnitte.
+struct Mutex;
+typedef struct Mutex Mutex;
+
+// Bedingungsvariable, auf die Threads unter einem Mutex warten können.
+struct Condition;
+typedef struct Condition Condition;
+
+// Atomare Datentypen. Der MSVC unterstützt <stdatomic.h> im C-Modus nicht,
+// daher erfolgen alle Zugriffe über die thread_atomic* Funktionen unten.
+// Lesende und lesend-schreibende Zugriffe sind sequenziell konsistent,
+// reine Schreibzugriffe haben Release-Semantik.
+struct AtomicInt
+{
+#ifdef _MSC_VER
+    volatile long value;
+#else
+    volatile int value;
+#endif
+};
+typedef struct AtomicInt AtomicInt;
+
+struct AtomicInt64
+{
+    volatile long long value;
+};
+typedef struct AtomicInt64 AtomicInt64;
+
+struct AtomicPointer
+{
+    void* volatile value;
+};
+typedef struct AtomicPointer AtomicPointer;
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Startet einen neuen Thread.
+ * 
+ * @param func die im Thread auszuführende Funktion
+ * @param arg das Argument für die Funktion
+ * @return der neue Thread oder NULL, wenn er nicht gestartet werden konnte
+ */
+Thread* thread_create(ThreadFunction func, void* arg);
+
+/**
+ * Wartet auf das Ende eines Threads und gibt ihn anschließend frei.
+ * 
+ * @param thread der Thread, auf den gewartet werden soll
+ */
+void thread_join(Thread* thread);
+
+/**
+ * Liefert die Anzahl der logischen Prozessoren des Systems.
+ * 
+ * @return die Anzahl der Prozessoren, mindestens 1
+ */
+int thread_getProcessorCount(void);
+
+/**
+ * Gibt den Rest der Zeitscheibe des aufrufenden Threads ab.
+ */
+void thread_yield(void);
+
+/**
+ * Erstellt einen neuen Mutex.
+ *
+ * @return der neue Mutex
+ */
+Mutex* thread_createMutex(void);
+
+/**
+ * Sperrt einen Mutex und wartet dafür wenn nötig.
+ *
+ * @param mutex der zu sperrende Mutex
+ */
+void thread_lockMutex(Mutex* mutex);
+
+/**
+ * Gibt einen gesperrten Mutex wieder frei.
+ *
+ * @param mutex der freizugebende Mutex
+ */
+void thread_unlockMutex(Mutex* mutex);
+
+/**
+ * Löscht einen Mutex. Er darf dabei nicht gesperrt sein.
+ *
+ * @param mutex der zu löschende Mutex
+ */
+void thread_deleteMutex(Mutex* mutex);
+
+/**
+ * Erstellt eine neue Bedingungsvariable.
+ *
+ * @return die neue Bedingungsvariable
+ */
+Condition* thread_createCondition(void);
+
+/**
+ * Gibt den Mutex frei und wartet, bis die Bedingungsvariable signalisiert
+ * wird. Der Mutex ist danach wieder gesperrt. Wie üblich kann der Aufruf
+ * auch ohne Signal zurückkehren, die Bedingung muss daher in einer
+ * Schleife geprüft werden.
+ *
+ * @param cond die Bedingungsvariable
+ * @param mutex der vom Aufrufer gesperrte Mutex
+ */
+void thread_waitCondition(Condition* cond, Mutex* mutex);
+
+/**
+ * Weckt alle Threads, die auf die Bedingungsvariable warten.
+ *
+ * @param cond die Bedingungsvariable
+ */
+void thread_broadcastCondition(Condition* cond);
+
+/**
+ * Löscht eine Bedingungsvariable.
+ *
+ * @param cond die zu löschende Bedingungsvariable
+ */
+void thread_deleteCondition(Condition* cond);
+
+/**
+ * Vollständige Speicherbarriere, entspricht
+ * atomic_thread_fence(memory_order_seq_cst).
+ */
+void thread_atomicFence(void);
+
+///////////////////////////// ATOMARE OPERATIONEN //////////////////////////////
+
+// Die Operationen sind inline, da sie in den Deques des Job-Systems auf dem
+// heißen Pfad liegen. Unter dem MSVC haben volatile-Zugriffe auf x86/x64
+// (Standard /volatile:ms) bereits Acquire- bzw. Release-Semantik.
+
+/**
+ * Liest eine atomare Ganzzahl.
+ *
+ * @param atomic die Ganzzahl
+ * @return der aktuelle Wert
+ */
+static inline int thread_atomicLoad(const AtomicInt* atomic)
+{
+#ifdef _MSC_VER
+    int value = (int)atomic->value;
+    _ReadWriteBarrier();
+    return value;
+#else
+    return __atomic_load_n(&atomic->value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * Schreibt eine atomare Ganzzahl.
+ *
+ * @param atomic die Ganzzahl
+ * @param value der neue Wert
+ */
+static inline void thread_atomicStore(AtomicInt* atomic, int value)
+{
+#ifdef _MSC_VER
+    _ReadWriteBarrier();
+    atomic->value = value;
+#else
+    __atomic_store_n(&atomic->value, value, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+ * Addiert einen Wert auf eine atomare Ganzzahl.
+ *
+ * @param atomic die Ganzzahl
+ * @param delta der zu addierende Wert, darf negativ sein
+ * @return der Wert vor der Addition
+ */
+static inline int thread_atomicAdd(AtomicInt* atomic, int delta)
+{
+#ifdef _MSC_VER
+    return (int)_InterlockedExchangeAdd(&atomic->value, delta);
+#else
+    return __atomic_fetch_add(&atomic->value, delta, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * Ersetzt eine atomare Ganzzahl, wenn sie den erwarteten Wert hat.
+ *
+ * @param atomic die Ganzzahl
+ * @param expected der erwartete Wert, enthält bei Misserfolg den aktuellen
+ * @param desired der neue Wert
+ * @return true, wenn der Wert ersetzt wurde
+ */
+static inline bool thread_atomicCompareExchange(AtomicInt* atomic, int* expected, int desired)
+{
+#ifdef _MSC_VER
+    long previous = _InterlockedCompareExchange(&atomic->value, desired, *expected);
+    bool exchanged = previous == *expected;
+    *expected = (int)previous;
+    return exchanged;
+#else
+    return __atomic_compare_exchange_n(&atomic->value, expected, desired, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * Liest eine atomare 64 Bit Ganzzahl.
+ *
+ * @param atomic die Ganzzahl
+ * @return der aktuelle Wert
+ */
+static inline long long thread_atomicLoad64(const AtomicInt64* atomic)
+{
+#ifdef _MSC_VER
+    long long value = atomic->value;
+    _ReadWriteBarrier();
+    return value;
+#else
+    return __atomic_load_n(&atomic->value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * Schreibt eine atomare 64 Bit Ganzzahl.
+ *
+ * @param atomic die Ganzzahl
+ * @param value der neue Wert
+ */
+static inline void thread_atomicStore64(AtomicInt64* atomic, long long value)
+{
+#ifdef _MSC_VER
+    _ReadWriteBarrier();
+    atomic->value = value;
+#else
+    __atomic_store_n(&atomic->value, value, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+ * Ersetzt eine atomare 64 Bit Ganzzahl, wenn sie den erwarteten Wert hat.
+ *
+ * @param atomic die Ganzzahl
+ * @param expected der erwartete Wert, enthält bei Misserfolg den aktuellen
+ * @param desired der neue Wert
+ * @return true, wenn der Wert ersetzt wurde
+ */
+static inline bool thread_atomicCompareExchange64(AtomicInt64* atomic, long long* expected,
+                                                  long long desired)
+{
+#ifdef _MSC_VER
+    long long previous = _InterlockedCompareExchange64(&atomic->value, desired, *expected);
+    bool exchanged = previous == *expected;
+    *expected = previous;
+    return exchanged;
+#else
+    return __atomic_compare_exchange_n(&atomic->value, expected, desired, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * Schreibt einen atomaren Zeiger.
+ *
+ * @param atomic der Zeiger
+ * @param value der neue Wert
+ */
+static inline void thread_atomicStorePointer(AtomicPointer* atomic, void* value)
+{
+#ifdef _MSC_VER
+    _ReadWriteBarrier();
+    atomic->value = value;
+#else
+    __atomic_store_n(&atomic->value, value, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+ * Tauscht einen atomaren Zeiger aus.
+ *
+ * @param atomic der Zeiger
+ * @param value der neue Wert
+ * @return der vorherige Wert
+ */
+static inline void* thread_atomicExchangePointer(AtomicPointer* atomic, void* value)
+{
+#ifdef _MSC_VER
+    return _InterlockedExchangePointer(&atomic->value, value);
+#else
+    return __atomic_exchange_n(&atomic->value, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+#endif // THREAD_H
@@ -14,6 +14,12 @@
 #include "input.h"
 #include "utils.h"
 #include "particles.h"
+#include "instrumentation.h"
+#include "jobs.h"
+#include "bvh.h"
+#include "loader.h"
+#include "texture.h"
+#include "capture.h"
 
 ////////////////////////////////// KONSTANTEN //////////////////////////////////
 
@@ -344,11 +350,18 @@ ProgContext* window_init(const char* title)
     // Diese Ausgabe ist eine Allgemeine Anforderung von SESP.
     printf("OpenGL-Version: %s\n", glGetString(GL_VERSION));
 
+    // Worker-Threads starten, bevor Module Jobs verteilen können.
+    jobs_init(-1);
+    texture_initCache();
+
     // Module initialisieren.
+    instrumentation_init(ctx);
     input_init(ctx);
     rendering_init(ctx);
     particles_init(ctx);
     gui_init(ctx);
+    loader_init(ctx);
+    capture_init(ctx);
 
     return ctx;
 }
@@ -385,15 +398,58 @@ void window_mainloop(ProgContext* ctx)
         // Events abrufen und wenn nötig verarbeiten.
         glfwPollEvents();
 
+        // Messwerte der letzten Frames abholen.
+        instrumentation_beginFrame(ctx);
+
         // Eingaben verarbeiten.
         input_process(ctx);
 
+        // Fertig geladene Szenen übernehmen und alte löschen.
+        loader_update(ctx);
+
+        // Job-Benchmark auf Anfrage ausführen.
+        if (ctx->input->runJobBenchmark)
+        {
+            jobs_benchmark();
+            ctx->input->runJobBenchmark = false;
+        }
+
+        // BVH-Benchmark auf Anfrage ausführen.
+        if (ctx->input->runBvhBenchmark)
+        {
+            bvh_benchmark();
+            ctx->input->runBvhBenchmark = false;
+        }
+
+        // DDS-Benchmark auf Anfrage ausführen.
+        if (ctx->input->runDdsBenchmark)
+        {
+            texture_benchmarkDDS();
+            ctx->input->runDdsBenchmark = false;
+        }
+
+        // Parität der Partikel-Simulationen auf Anfrage prüfen.
+        if (ctx->input->particles.runParityCheck)
+        {
+            ctx->input->particles.parityResult = particles_checkParity(ctx) ? 1 : -1;
+            ctx->input->particles.runParityCheck = false;
+        }
+
+        // Speicher fertiger Frames im Stream Buffer wieder freigeben.
+        streamBuffer_beginFrame(ctx->rendering->streamBuffer);
+
         // Szene zeichnen
         rendering_draw(ctx);
 
         // GUI Zeichnen
         gui_render(ctx);
 
+        // Fence setzen, nach dem die Daten des Frames überschrieben werden dürfen.
+        streamBuffer_endFrame(ctx->rendering->streamBuffer);
+
+        // Fertigen Frame für Screenshots und Aufnahmen auslesen.
+        capture_update(ctx);
+
         // Back- und Frontbuffer tauschen um den neuen Frame anzuzeigen.
         glfwSwapBuffers(ctx->window);
 
@@ -448,9 +504,17 @@ void window_updateFullscreen(ProgContext* ctx)
 
 void window_cleanup(ProgContext* ctx)
 {
-    // Alle Module Stück für Stück löschen.
+    // Alle Module Stück für Stück löschen. Der Lade-Thread muss vor allen
+    // anderen Modulen beendet werden.
+    loader_cleanup(ctx);
+    capture_cleanup(ctx);
     input_cleanup(ctx);
     rendering_cleanup(ctx);
     gui_cleanup(ctx);
+    instrumentation_cleanup(ctx);
+
+    // Gestreamte Texturen warten beim Freigeben noch auf ihre Jobs.
+    texture_cleanupCache();
+    jobs_cleanup();
     common_deleteContext(ctx);
 }
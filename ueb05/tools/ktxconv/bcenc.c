@@ -0,0 +1,608 @@
+/**
+ * Encoder für die Blockkompressionsformate BC1, BC3, BC4, BC5 und BC7.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#include "bcenc.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Anzahl der Texel eines Blocks.
+#define BCENC_TEXELS 16
+
+// Iterationen der Potenzmethode für die Hauptachse.
+#define BCENC_POWER_ITERATIONS 8
+
+// Durchgänge der Verbesserung über kleinste Quadrate.
+#define BCENC_REFINE_ITERATIONS 2
+
+// Gewichte der 16 Paletteneinträge von BC7 mit 4 Bit Indizes.
+static const int g_bc7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30,
+                                     34, 38, 43, 47, 51, 55, 60, 64};
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Ergebnis einer Anpassung der BC1 Endpunkte.
+struct BcencColorFit
+{
+    unsigned short c0;
+    unsigned short c1;
+    unsigned int indices;
+    float error;
+};
+typedef struct BcencColorFit BcencColorFit;
+
+// Ergebnis einer Anpassung der BC7 Endpunkte.
+struct BcencBC7Fit
+{
+    int endpoints[2][4]; // 7 Bit je Kanal
+    int pbits[2];
+    int indices[BCENC_TEXELS];
+    float error;
+};
+typedef struct BcencBC7Fit BcencBC7Fit;
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Begrenzt einen Wert auf einen Bereich.
+ */
+static float bcenc_clamp(float value, float min, float max)
+{
+    return value < min ? min : (value > max ? max : value);
+}
+
+/**
+ * Bestimmt Mittelwert und Hauptachse einer Punktmenge über die
+ * Potenzmethode auf der Kovarianzmatrix.
+ *
+ * @param points die Punkte mit jeweils 4 Komponenten
+ * @param count die Anzahl der Punkte
+ * @param dims die Anzahl der genutzten Komponenten (höchstens 4)
+ * @param mean Ziel für den Mittelwert
+ * @param axis Ziel für die normierte Achse, 0 bei einfarbigen Blöcken
+ */
+static void bcenc_principalAxis(const float (*points)[4], int count, int dims,
+                                float mean[4], float axis[4])
+{
+    memset(mean, 0, sizeof(float) * 4);
+    memset(axis, 0, sizeof(float) * 4);
+    for (int i = 0; i < count; i++)
+    {
+        for (int d = 0; d < dims; d++)
+        {
+            mean[d] += points[i][d] / count;
+        }
+    }
+
+    float cov[4][4] = {{0}};
+    for (int i = 0; i < count; i++)
+    {
+        for (int a = 0; a < dims; a++)
+        {
+            for (int b = 0; b < dims; b++)
+            {
+                cov[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+            }
+        }
+    }
+
+    float v[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (int iter = 0; iter < BCENC_POWER_ITERATIONS; iter++)
+    {
+        float next[4] = {0};
+        float length = 0.0f;
+        for (int a = 0; a < dims; a++)
+        {
+            for (int b = 0; b < dims; b++)
+            {
+                next[a] += cov[a][b] * v[b];
+            }
+            length += next[a] * next[a];
+        }
+
+        length = sqrtf(length);
+        if (length < FLT_EPSILON)
+        {
+            return;
+        }
+        for (int a = 0; a < dims; a++)
+        {
+            v[a] = next[a] / length;
+        }
+    }
+
+    memcpy(axis, v, sizeof(float) * dims);
+}
+
+/**
+ * Legt die Endpunkte an die äußersten Projektionen der Punkte auf die Achse.
+ *
+ * @param points die Punkte mit jeweils 4 Komponenten
+ * @param count die Anzahl der Punkte
+ * @param dims die Anzahl der genutzten Komponenten
+ * @param e0 Ziel für den Endpunkt mit der größten Projektion
+ * @param e1 Ziel für den Endpunkt mit der kleinsten Projektion
+ */
+static void bcenc_axisEndpoints(const float (*points)[4], int count, int dims,
+                                float e0[4], float e1[4])
+{
+    float mean[4], axis[4];
+    bcenc_principalAxis(points, count, dims, mean, axis);
+
+    float tMin = FLT_MAX, tMax = -FLT_MAX;
+    for (int i = 0; i < count; i++)
+    {
+        float t = 0.0f;
+        for (int d = 0; d < dims; d++)
+        {
+            t += (points[i][d] - mean[d]) * axis[d];
+        }
+        tMin = fminf(tMin, t);
+        tMax = fmaxf(tMax, t);
+    }
+
+    for (int d = 0; d < dims; d++)
+    {
+        e0[d] = bcenc_clamp(mean[d] + axis[d] * tMax, 0.0f, 255.0f);
+        e1[d] = bcenc_clamp(mean[d] + axis[d] * tMin, 0.0f, 255.0f);
+    }
+}
+
+/**
+ * Löst die Normalengleichungen der kleinsten Quadrate für zwei Endpunkte,
+ * wenn jeder Punkt als w * e0 + (1 - w) * e1 dargestellt wird.
+ *
+ * @return false, wenn das System singulär ist
+ */
+static bool bcenc_leastSquares(const float (*points)[4], const float *weights, int count,
+                               int dims, float e0[4], float e1[4])
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {0}, bx[4] = {0};
+    for (int i = 0; i < count; i++)
+    {
+        float a = weights[i];
+        float b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int d = 0; d < dims; d++)
+        {
+            ax[d] += a * points[i][d];
+            bx[d] += b * points[i][d];
+        }
+    }
+
+    float det = aa * bb - ab * ab;
+    if (fabsf(det) < FLT_EPSILON)
+    {
+        return false;
+    }
+
+    for (int d = 0; d < dims; d++)
+    {
+        e0[d] = bcenc_clamp((bb * ax[d] - ab * bx[d]) / det, 0.0f, 255.0f);
+        e1[d] = bcenc_clamp((aa * bx[d] - ab * ax[d]) / det, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+/**
+ * Quantisiert eine Farbe nach RGB565.
+ */
+static unsigned short bcenc_to565(const float c[4])
+{
+    int r = (int)roundf(c[0] * 31.0f / 255.0f);
+    int g = (int)roundf(c[1] * 63.0f / 255.0f);
+    int b = (int)roundf(c[2] * 31.0f / 255.0f);
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+/**
+ * Erweitert eine RGB565 Farbe so, wie es die Hardware macht.
+ */
+static void bcenc_from565(unsigned short v, float c[4])
+{
+    int r = (v >> 11) & 31;
+    int g = (v >> 5) & 63;
+    int b = v & 31;
+    c[0] = (float)((r << 3) | (r >> 2));
+    c[1] = (float)((g << 2) | (g >> 4));
+    c[2] = (float)((b << 3) | (b >> 2));
+    c[3] = 255.0f;
+}
+
+/**
+ * Quadratischer Abstand zweier Farben über die ersten Komponenten.
+ */
+static float bcenc_distance(const float *a, const float *b, int dims)
+{
+    float error = 0.0f;
+    for (int d = 0; d < dims; d++)
+    {
+        error += (a[d] - b[d]) * (a[d] - b[d]);
+    }
+    return error;
+}
+
+/**
+ * Quantisiert zwei Endpunkte nach BC1 und wählt für jeden Texel den
+ * nächsten Paletteneintrag.
+ *
+ * @param texels alle 16 Texel des Blocks
+ * @param transparent Texel, die transparent kodiert werden, oder NULL
+ * @param e0 der erste Endpunkt
+ * @param e1 der zweite Endpunkt
+ * @return die Endpunkte, Indizes und der Fehler
+ */
+static BcencColorFit bcenc_fitColor(const float (*texels)[4], const bool *transparent,
+                                    const float e0[4], const float e1[4])
+{
+    BcencColorFit fit = {bcenc_to565(e0), bcenc_to565(e1), 0, 0.0f};
+
+    // Die Reihenfolge der Endpunkte wählt den Modus: c0 > c1 ergibt vier
+    // Farben, c0 <= c1 drei Farben und Transparenz.
+    bool threeColor = transparent != NULL;
+    if ((threeColor && fit.c0 > fit.c1) || (!threeColor && fit.c0 < fit.c1))
+    {
+        unsigned short c = fit.c0;
+        fit.c0 = fit.c1;
+        fit.c1 = c;
+    }
+
+    float palette[4][4];
+    bcenc_from565(fit.c0, palette[0]);
+    bcenc_from565(fit.c1, palette[1]);
+    int paletteSize = 4;
+    for (int d = 0; d < 3; d++)
+    {
+        if (threeColor)
+        {
+            palette[2][d] = (palette[0][d] + palette[1][d]) / 2.0f;
+            paletteSize = 3;
+        }
+        else
+        {
+            palette[2][d] = (2.0f * palette[0][d] + palette[1][d]) / 3.0f;
+            palette[3][d] = (palette[0][d] + 2.0f * palette[1][d]) / 3.0f;
+        }
+    }
+
+    // Bei gleichen Endpunkten liefern alle Einträge dieselbe Farbe.
+    if (!threeColor && fit.c0 == fit.c1)
+    {
+        paletteSize = 1;
+    }
+
+    for (int i = 0; i < BCENC_TEXELS; i++)
+    {
+        unsigned int index = 3;
+        if (!transparent || !transparent[i])
+        {
+            float best = FLT_MAX;
+            for (int p = 0; p < paletteSize; p++)
+            {
+                float error = bcenc_distance(texels[i], palette[p], 3);
+                if (error < best)
+                {
+                    best = error;
+                    index = (unsigned int)p;
+                }
+            }
+            fit.error += best;
+        }
+        fit.indices |= index << (2 * i);
+    }
+
+    return fit;
+}
+
+/**
+ * Komprimiert die Farben eines Blocks nach BC1.
+ *
+ * @param rgba die Texel des Blocks
+ * @param alpha true, wenn Transparenz über den Modus mit drei Farben
+ *        kodiert werden darf
+ * @param out Ziel für die 8 Byte des Farbblocks
+ */
+static void bcenc_encodeColor(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], bool alpha,
+                              unsigned char out[8])
+{
+    float texels[BCENC_TEXELS][4];
+    float opaque[BCENC_TEXELS][4];
+    bool transparent[BCENC_TEXELS];
+    bool anyTransparent = false;
+    int opaqueCount = 0;
+    for (int i = 0; i < BCENC_TEXELS; i++)
+    {
+        for (int d = 0; d < 4; d++)
+        {
+            texels[i][d] = rgba[i * 4 + d];
+        }
+        transparent[i] = alpha && rgba[i * 4 + 3] < 128;
+        anyTransparent |= transparent[i];
+        if (!transparent[i])
+        {
+            memcpy(opaque[opaqueCount++], texels[i], sizeof(texels[i]));
+        }
+    }
+
+    BcencColorFit fit = {0, 0, 0xFFFFFFFFu, 0.0f};
+    if (opaqueCount > 0)
+    {
+        const bool *mask = anyTransparent ? transparent : NULL;
+        float e0[4], e1[4];
+        bcenc_axisEndpoints((const float(*)[4])opaque, opaqueCount, 3, e0, e1);
+        fit = bcenc_fitColor((const float(*)[4])texels, mask, e0, e1);
+
+        // Mit den gewählten Indizes die Endpunkte nachbessern.
+        for (int iter = 0; iter < BCENC_REFINE_ITERATIONS; iter++)
+        {
+            const float fourColor[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+            const float threeColorW[4] = {1.0f, 0.0f, 0.5f, 0.0f};
+            float weights[BCENC_TEXELS];
+            int count = 0;
+            for (int i = 0; i < BCENC_TEXELS; i++)
+            {
+                if (!transparent[i])
+                {
+                    unsigned int index = (fit.indices >> (2 * i)) & 3;
+                    weights[count++] = mask ? threeColorW[index] : fourColor[index];
+                }
+            }
+
+            if (!bcenc_leastSquares((const float(*)[4])opaque, weights, count, 3, e0, e1))
+            {
+                break;
+            }
+            BcencColorFit refined = bcenc_fitColor((const float(*)[4])texels, mask, e0, e1);
+            if (refined.error >= fit.error)
+            {
+                break;
+            }
+            fit = refined;
+        }
+    }
+
+    out[0] = (unsigned char)(fit.c0 & 0xFF);
+    out[1] = (unsigned char)(fit.c0 >> 8);
+    out[2] = (unsigned char)(fit.c1 & 0xFF);
+    out[3] = (unsigned char)(fit.c1 >> 8);
+    for (int i = 0; i < 4; i++)
+    {
+        out[4 + i] = (unsigned char)(fit.indices >> (8 * i));
+    }
+}
+
+/**
+ * Komprimiert einen Kanal eines Blocks nach BC4.
+ *
+ * @param rgba die Texel des Blocks
+ * @param channel der zu komprimierende Kanal
+ * @param out Ziel für die 8 Byte des Blocks
+ */
+static void bcenc_encodeChannel(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], int channel,
+                                unsigned char out[8])
+{
+    int min = 255, max = 0;
+    for (int i = 0; i < BCENC_TEXELS; i++)
+    {
+        int v = rgba[i * 4 + channel];
+        min = v < min ? v : min;
+        max = v > max ? v : max;
+    }
+
+    // Mit e0 > e1 gibt es acht Werte zwischen den Endpunkten.
+    out[0] = (unsigned char)max;
+    out[1] = (unsigned char)min;
+
+    int palette[8] = {max, min};
+    for (int i = 1; i < 7; i++)
+    {
+        palette[i + 1] = ((7 - i) * max + i * min) / 7;
+    }
+
+    unsigned long long indices = 0;
+    for (int i = 0; i < BCENC_TEXELS && max > min; i++)
+    {
+        int v = rgba[i * 4 + channel];
+        int best = 0;
+        for (int p = 1; p < 8; p++)
+        {
+            if (abs(palette[p] - v) < abs(palette[best] - v))
+            {
+                best = p;
+            }
+        }
+        indices |= (unsigned long long)best << (3 * i);
+    }
+
+    for (int i = 0; i < 6; i++)
+    {
+        out[2 + i] = (unsigned char)(indices >> (8 * i));
+    }
+}
+
+/**
+ * Quantisiert zwei RGBA Endpunkte nach BC7 Modus 6 mit festen P-Bits und
+ * wählt für jeden Texel den nächsten Paletteneintrag.
+ */
+static BcencBC7Fit bcenc_fitBC7(const float (*texels)[4], const float e0[4], const float e1[4],
+                                int p0, int p1)
+{
+    BcencBC7Fit fit;
+    fit.pbits[0] = p0;
+    fit.pbits[1] = p1;
+    fit.error = 0.0f;
+
+    float endpoints[2][4];
+    for (int d = 0; d < 4; d++)
+    {
+        fit.endpoints[0][d] = (int)bcenc_clamp(roundf((e0[d] - p0) / 2.0f), 0.0f, 127.0f);
+        fit.endpoints[1][d] = (int)bcenc_clamp(roundf((e1[d] - p1) / 2.0f), 0.0f, 127.0f);
+        endpoints[0][d] = (float)(fit.endpoints[0][d] * 2 + p0);
+        endpoints[1][d] = (float)(fit.endpoints[1][d] * 2 + p1);
+    }
+
+    float palette[16][4];
+    for (int p = 0; p < 16; p++)
+    {
+        for (int d = 0; d < 4; d++)
+        {
+            int w = g_bc7Weights[p];
+            palette[p][d] = (float)(((64 - w) * (int)endpoints[0][d] + w * (int)endpoints[1][d] + 32) >> 6);
+        }
+    }
+
+    for (int i = 0; i < BCENC_TEXELS; i++)
+    {
+        float best = FLT_MAX;
+        for (int p = 0; p < 16; p++)
+        {
+            float error = bcenc_distance(texels[i], palette[p], 4);
+            if (error < best)
+            {
+                best = error;
+                fit.indices[i] = p;
+            }
+        }
+        fit.error += best;
+    }
+
+    return fit;
+}
+
+/**
+ * Probiert alle Kombinationen der P-Bits und liefert die beste Anpassung.
+ */
+static BcencBC7Fit bcenc_fitBC7Best(const float (*texels)[4], const float e0[4], const float e1[4])
+{
+    BcencBC7Fit best = bcenc_fitBC7(texels, e0, e1, 0, 0);
+    for (int p = 1; p < 4; p++)
+    {
+        BcencBC7Fit fit = bcenc_fitBC7(texels, e0, e1, p & 1, p >> 1);
+        if (fit.error < best.error)
+        {
+            best = fit;
+        }
+    }
+    return best;
+}
+
+/**
+ * Schreibt Bits in einen Block, beginnend beim niederwertigsten Bit.
+ */
+static void bcenc_writeBits(unsigned char out[16], int *position, unsigned int value, int count)
+{
+    for (int i = 0; i < count; i++, (*position)++)
+    {
+        if (value & (1u << i))
+        {
+            out[*position / 8] |= (unsigned char)(1u << (*position % 8));
+        }
+    }
+}
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+void bcenc_encodeBC1(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], bool alpha,
+                     unsigned char out[8])
+{
+    bcenc_encodeColor(rgba, alpha, out);
+}
+
+void bcenc_encodeBC3(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], unsigned char out[16])
+{
+    // Der Farbblock von BC3 kennt nur den Modus mit vier Farben.
+    bcenc_encodeChannel(rgba, 3, out);
+    bcenc_encodeColor(rgba, false, out + 8);
+}
+
+void bcenc_encodeBC4(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], unsigned char out[8])
+{
+    bcenc_encodeChannel(rgba, 0, out);
+}
+
+void bcenc_encodeBC5(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], unsigned char out[16])
+{
+    bcenc_encodeChannel(rgba, 0, out);
+    bcenc_encodeChannel(rgba, 1, out + 8);
+}
+
+void bcenc_encodeBC7(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], unsigned char out[16])
+{
+    float texels[BCENC_TEXELS][4];
+    for (int i = 0; i < BCENC_TEXELS; i++)
+    {
+        for (int d = 0; d < 4; d++)
+        {
+            texels[i][d] = rgba[i * 4 + d];
+        }
+    }
+
+    float e0[4], e1[4];
+    bcenc_axisEndpoints((const float(*)[4])texels, BCENC_TEXELS, 4, e0, e1);
+    BcencBC7Fit fit = bcenc_fitBC7Best((const float(*)[4])texels, e0, e1);
+
+    for (int iter = 0; iter < BCENC_REFINE_ITERATIONS; iter++)
+    {
+        float weights[BCENC_TEXELS];
+        for (int i = 0; i < BCENC_TEXELS; i++)
+        {
+            weights[i] = 1.0f - g_bc7Weights[fit.indices[i]] / 64.0f;
+        }
+
+        if (!bcenc_leastSquares((const float(*)[4])texels, weights, BCENC_TEXELS, 4, e0, e1))
+        {
+            break;
+        }
+        BcencBC7Fit refined = bcenc_fitBC7Best((const float(*)[4])texels, e0, e1);
+        if (refined.error >= fit.error)
+        {
+            break;
+        }
+        fit = refined;
+    }
+
+    // Das höchste Bit des ersten Index wird nicht gespeichert und muss 0
+    // sein. Sonst werden die Endpunkte getauscht und die Indizes gespiegelt.
+    if (fit.indices[0] >= 8)
+    {
+        for (int d = 0; d < 4; d++)
+        {
+            int e = fit.endpoints[0][d];
+            fit.endpoints[0][d] = fit.endpoints[1][d];
+            fit.endpoints[1][d] = e;
+        }
+        int p = fit.pbits[0];
+        fit.pbits[0] = fit.pbits[1];
+        fit.pbits[1] = p;
+        for (int i = 0; i < BCENC_TEXELS; i++)
+        {
+            fit.indices[i] = 15 - fit.indices[i];
+        }
+    }
+
+    memset(out, 0, 16);
+    int position = 0;
+    bcenc_writeBits(out, &position, 1u << 6, 7);
+    for (int d = 0; d < 4; d++)
+    {
+        bcenc_writeBits(out, &position, (unsigned int)fit.endpoints[0][d], 7);
+        bcenc_writeBits(out, &position, (unsigned int)fit.endpoints[1][d], 7);
+    }
+    bcenc_writeBits(out, &position, (unsigned int)fit.pbits[0], 1);
+    bcenc_writeBits(out, &position, (unsigned int)fit.pbits[1], 1);
+    for (int i = 0; i < BCENC_TEXELS; i++)
+    {
+        bcenc_writeBits(out, &position, (unsigned int)fit.indices[i], i == 0 ? 3 : 4);
+    }
+}
@@ -0,0 +1,71 @@
+/**
+ * Encoder für die Blockkompressionsformate BC1, BC3, BC4, BC5 und BC7.
+ * Alle Funktionen komprimieren einen Block aus 4x4 Texeln, die zeilenweise
+ * als RGBA mit 8 Bit je Kanal übergeben werden.
+ *
+ * Die Encoder bestimmen die Endpunkte über die Hauptachse der Farben und
+ * verbessern sie anschließend über kleinste Quadrate. Das ist deutlich
+ * langsamer als die Dekompression, aber für einen Offline-Konverter schnell
+ * genug und liefert eine Qualität nahe an gängigen Werkzeugen.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#ifndef BCENC_H
+#define BCENC_H
+
+#include <stdbool.h>
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Anzahl der Bytes der Texel eines Blocks.
+#define BCENC_BLOCK_TEXEL_BYTES (4 * 4 * 4)
+
+//////////////////////////// ÖFFENTLICHE FUNKTIONEN ////////////////////////////
+
+/**
+ * Komprimiert einen Block nach BC1 (8 Byte).
+ *
+ * @param rgba die Texel des Blocks
+ * @param alpha true, wenn Texel mit Alpha unter 128 transparent werden sollen
+ * @param out Ziel für den komprimierten Block
+ */
+void bcenc_encodeBC1(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], bool alpha,
+                     unsigned char out[8]);
+
+/**
+ * Komprimiert einen Block nach BC3 (16 Byte): Alpha wie BC4, Farbe wie BC1.
+ *
+ * @param rgba die Texel des Blocks
+ * @param out Ziel für den komprimierten Block
+ */
+void bcenc_encodeBC3(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], unsigned char out[16]);
+
+/**
+ * Komprimiert den Rotkanal eines Blocks nach BC4 (8 Byte).
+ *
+ * @param rgba die Texel des Blocks
+ * @param out Ziel für den komprimierten Block
+ */
+void bcenc_encodeBC4(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], unsigned char out[8]);
+
+/**
+ * Komprimiert Rot- und Grünkanal eines Blocks nach BC5 (16 Byte).
+ *
+ * @param rgba die Texel des Blocks
+ * @param out Ziel für den komprimierten Block
+ */
+void bcenc_encodeBC5(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], unsigned char out[16]);
+
+/**
+ * Komprimiert einen Block nach BC7 (16 Byte). Verwendet wird nur Modus 6
+ * (eine Partition, RGBA Endpunkte mit 7 Bit plus P-Bit, 4 Bit Indizes),
+ * der für die meisten Farb- und Alphatexturen bereits besser als BC3 ist.
+ *
+ * @param rgba die Texel des Blocks
+ * @param out Ziel für den komprimierten Block
+ */
+void bcenc_encodeBC7(const unsigned char rgba[BCENC_BLOCK_TEXEL_BYTES], unsigned char out[16]);
+
+#endif // BCENC_H
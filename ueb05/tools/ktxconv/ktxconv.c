@@ -0,0 +1,555 @@
+/**
+ * Offline-Konverter, der Bilddateien in blockkomprimierte KTX2 Texturen
+ * mit vorberechneten Mipmaps umwandelt. Die Ergebnisse werden vom Programm
+ * bevorzugt geladen, wenn sie neben der ursprünglichen Bilddatei liegen
+ * (z.B. "wall.ktx2" neben "wall.png").
+ *
+ * Aufruf: ktxconv [-f bc1|bc3|bc4|bc5|bc7] [--linear] [--no-mips] <eingabe> <ausgabe.ktx2>
+ *
+ * Ohne -f richtet sich das Format nach der Anzahl der Kanäle: BC4 für
+ * Graustufen, BC5 für zwei Kanäle (z.B. Normal Maps), BC1 für RGB und BC7
+ * für RGBA. Farbformate werden als sRGB behandelt, solange nicht --linear
+ * angegeben ist, d.h. die Mipmaps werden im linearen Farbraum gefiltert.
+ *
+ * Copyright (C) 2020, FH Wedel
+ * Autor: Nicolas Hollmann
+ */
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <sesp/stb_image.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ktx.h"
+#include "bcenc.h"
+
+////////////////////////////////// KONSTANTEN //////////////////////////////////
+
+// Werte des Data Format Descriptors (Khronos Data Format Specification).
+#define KTXCONV_DFD_VERSION 2
+#define KTXCONV_DFD_MODEL_BC1A 128
+#define KTXCONV_DFD_MODEL_BC3 130
+#define KTXCONV_DFD_MODEL_BC4 131
+#define KTXCONV_DFD_MODEL_BC5 132
+#define KTXCONV_DFD_MODEL_BC7 134
+#define KTXCONV_DFD_PRIMARIES_BT709 1
+#define KTXCONV_DFD_TRANSFER_LINEAR 1
+#define KTXCONV_DFD_TRANSFER_SRGB 2
+#define KTXCONV_DFD_QUALIFIER_LINEAR 0x10
+
+// Maximale Anzahl an Samples im Data Format Descriptor.
+#define KTXCONV_MAX_SAMPLES 2
+
+////////////////////////////// LOKALE DATENTYPEN ///////////////////////////////
+
+// Die unterstützten Zielformate.
+enum KtxconvFormat
+{
+    KTXCONV_BC1,
+    KTXCONV_BC3,
+    KTXCONV_BC4,
+    KTXCONV_BC5,
+    KTXCONV_BC7
+};
+typedef enum KtxconvFormat KtxconvFormat;
+
+// Ein Sample des Data Format Descriptors.
+struct KtxconvSample
+{
+    int channel;
+    int bitOffset;
+    int bitLength;
+    bool linear; // Alpha bleibt auch bei sRGB Texturen linear
+};
+typedef struct KtxconvSample KtxconvSample;
+
+// Ein Bild mit 8 Bit RGBA je Texel.
+struct KtxconvImage
+{
+    int width;
+    int height;
+    unsigned char *rgba;
+};
+typedef struct KtxconvImage KtxconvImage;
+
+////////////////////////////// LOKALE FUNKTIONEN ///////////////////////////////
+
+/**
+ * Gibt die Aufrufsyntax aus.
+ */
+static void ktxconv_usage(void)
+{
+    fprintf(stderr,
+            "Usage: ktxconv [-f bc1|bc3|bc4|bc5|bc7] [--linear] [--no-mips] <input> <output.ktx2>\n");
+}
+
+/**
+ * Lädt ein Bild und erweitert es auf RGBA. Ein und zwei Kanäle landen wie
+ * beim Laden im Programm in Rot bzw. Rot und Grün.
+ *
+ * @param filename der Pfad zum Bild
+ * @param image Ziel für das Bild
+ * @param channels Ziel für die ursprüngliche Anzahl der Kanäle
+ * @return false, wenn das Bild nicht gelesen werden konnte
+ */
+static bool ktxconv_loadImage(const char *filename, KtxconvImage *image, int *channels)
+{
+    // Das Programm lädt Bilder gespiegelt, damit sie zu den Texturkoordinaten
+    // passen. Die Blöcke müssen dieselbe Zeilenreihenfolge haben.
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char *data = stbi_load(filename, &image->width, &image->height, channels, 0);
+    if (!data)
+    {
+        fprintf(stderr, "Error: Could not read image file \"%s\"!\n", filename);
+        return false;
+    }
+
+    size_t count = (size_t)image->width * image->height;
+    image->rgba = malloc(count * 4);
+    for (size_t i = 0; i < count; i++)
+    {
+        const unsigned char *src = data + i * *channels;
+        unsigned char *dst = image->rgba + i * 4;
+        dst[0] = src[0];
+        dst[1] = *channels >= 2 ? src[1] : 0;
+        dst[2] = *channels >= 3 ? src[2] : 0;
+        dst[3] = *channels == 4 ? src[3] : 255;
+    }
+
+    stbi_image_free(data);
+    return true;
+}
+
+/**
+ * Wandelt einen sRGB Wert in einen linearen Wert zwischen 0 und 1 um.
+ */
+static float ktxconv_srgbToLinear(unsigned char value)
+{
+    float c = value / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+/**
+ * Wandelt einen linearen Wert zwischen 0 und 1 in einen sRGB Wert um.
+ */
+static unsigned char ktxconv_linearToSrgb(float value)
+{
+    float c = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+    return (unsigned char)(fminf(fmaxf(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+/**
+ * Erzeugt die nächstkleinere Mipmap über einen 2x2 Boxfilter. Bei
+ * ungeraden Größen wird der Rand wiederholt. Farben in sRGB werden vor dem
+ * Mitteln linearisiert, sonst würden die Mipmaps zu dunkel.
+ *
+ * @param src die größere Mipmap
+ * @param srgb true, wenn RGB in sRGB vorliegt
+ * @return die kleinere Mipmap
+ */
+static KtxconvImage ktxconv_downsample(const KtxconvImage *src, bool srgb)
+{
+    KtxconvImage dst;
+    dst.width = src->width > 1 ? src->width / 2 : 1;
+    dst.height = src->height > 1 ? src->height / 2 : 1;
+    dst.rgba = malloc((size_t)dst.width * dst.height * 4);
+
+    for (int y = 0; y < dst.height; y++)
+    {
+        for (int x = 0; x < dst.width; x++)
+        {
+            int x0 = x * 2, x1 = x * 2 + 1 < src->width ? x * 2 + 1 : x * 2;
+            int y0 = y * 2, y1 = y * 2 + 1 < src->height ? y * 2 + 1 : y * 2;
+            const unsigned char *texels[4] = {
+                src->rgba + ((size_t)y0 * src->width + x0) * 4,
+                src->rgba + ((size_t)y0 * src->width + x1) * 4,
+                src->rgba + ((size_t)y1 * src->width + x0) * 4,
+                src->rgba + ((size_t)y1 * src->width + x1) * 4};
+
+            unsigned char *out = dst.rgba + ((size_t)y * dst.width + x) * 4;
+            for (int c = 0; c < 4; c++)
+            {
+                float sum = 0.0f;
+                for (int t = 0; t < 4; t++)
+                {
+                    sum += srgb && c < 3 ? ktxconv_srgbToLinear(texels[t][c]) : texels[t][c] / 255.0f;
+                }
+                out[c] = srgb && c < 3 ? ktxconv_linearToSrgb(sum / 4.0f)
+                                       : (unsigned char)(sum / 4.0f * 255.0f + 0.5f);
+            }
+        }
+    }
+
+    return dst;
+}
+
+/**
+ * Liefert die Anzahl der Bytes eines Blocks im Zielformat.
+ */
+static int ktxconv_blockBytes(KtxconvFormat format)
+{
+    return format == KTXCONV_BC1 || format == KTXCONV_BC4 ? 8 : 16;
+}
+
+/**
+ * Komprimiert ein Bild blockweise. Blöcke über den Rand hinaus wiederholen
+ * die letzte Zeile bzw. Spalte.
+ *
+ * @param image das Bild
+ * @param format das Zielformat
+ * @param alpha true, wenn BC1 Transparenz kodieren soll
+ * @param size Ziel für die Größe der Daten
+ * @return die komprimierten Daten
+ */
+static unsigned char *ktxconv_compress(const KtxconvImage *image, KtxconvFormat format,
+                                       bool alpha, size_t *size)
+{
+    int blocksX = (image->width + 3) / 4;
+    int blocksY = (image->height + 3) / 4;
+    int blockBytes = ktxconv_blockBytes(format);
+    *size = (size_t)blocksX * blocksY * blockBytes;
+    unsigned char *data = malloc(*size);
+
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            unsigned char block[BCENC_BLOCK_TEXEL_BYTES];
+            for (int y = 0; y < 4; y++)
+            {
+                for (int x = 0; x < 4; x++)
+                {
+                    int sx = bx * 4 + x < image->width ? bx * 4 + x : image->width - 1;
+                    int sy = by * 4 + y < image->height ? by * 4 + y : image->height - 1;
+                    memcpy(block + (y * 4 + x) * 4,
+                           image->rgba + ((size_t)sy * image->width + sx) * 4, 4);
+                }
+            }
+
+            unsigned char *out = data + ((size_t)by * blocksX + bx) * blockBytes;
+            switch (format)
+            {
+            case KTXCONV_BC1:
+                bcenc_encodeBC1(block, alpha, out);
+                break;
+            case KTXCONV_BC3:
+                bcenc_encodeBC3(block, out);
+                break;
+            case KTXCONV_BC4:
+                bcenc_encodeBC4(block, out);
+                break;
+            case KTXCONV_BC5:
+                bcenc_encodeBC5(block, out);
+                break;
+            case KTXCONV_BC7:
+                bcenc_encodeBC7(block, out);
+                break;
+            }
+        }
+    }
+
+    return data;
+}
+
+/**
+ * Bestimmt das VkFormat und die Samples des Data Format Descriptors.
+ *
+ * @param format das Zielformat
+ * @param srgb true für sRGB Farben
+ * @param alpha true, wenn BC1 Transparenz enthält
+ * @param model Ziel für das Farbmodell
+ * @param samples Ziel für die Samples
+ * @param sampleCount Ziel für die Anzahl der Samples
+ * @return das VkFormat
+ */
+static uint32_t ktxconv_describeFormat(KtxconvFormat format, bool srgb, bool alpha, int *model,
+                                       KtxconvSample samples[KTXCONV_MAX_SAMPLES], int *sampleCount)
+{
+    *sampleCount = 1;
+    samples[0] = (KtxconvSample){0, 0, 64, false};
+    switch (format)
+    {
+    case KTXCONV_BC1:
+        *model = KTXCONV_DFD_MODEL_BC1A;
+        samples[0].channel = alpha ? 1 : 0;
+        return alpha ? (srgb ? KTX2_FORMAT_BC1_RGBA_SRGB : KTX2_FORMAT_BC1_RGBA_UNORM)
+                     : (srgb ? KTX2_FORMAT_BC1_RGB_SRGB : KTX2_FORMAT_BC1_RGB_UNORM);
+
+    case KTXCONV_BC3:
+        *model = KTXCONV_DFD_MODEL_BC3;
+        *sampleCount = 2;
+        samples[0] = (KtxconvSample){15, 0, 64, srgb};
+        samples[1] = (KtxconvSample){0, 64, 64, false};
+        return srgb ? KTX2_FORMAT_BC3_SRGB : KTX2_FORMAT_BC3_UNORM;
+
+    case KTXCONV_BC4:
+        *model = KTXCONV_DFD_MODEL_BC4;
+        return KTX2_FORMAT_BC4_UNORM;
+
+    case KTXCONV_BC5:
+        *model = KTXCONV_DFD_MODEL_BC5;
+        *sampleCount = 2;
+        samples[1] = (KtxconvSample){1, 64, 64, false};
+        return KTX2_FORMAT_BC5_UNORM;
+
+    case KTXCONV_BC7:
+    default:
+        *model = KTXCONV_DFD_MODEL_BC7;
+        samples[0].bitLength = 128;
+        return srgb ? KTX2_FORMAT_BC7_SRGB : KTX2_FORMAT_BC7_UNORM;
+    }
+}
+
+/**
+ * Baut den Data Format Descriptor mit einem Basic Descriptor Block.
+ *
+ * @param words Ziel für den Descriptor, mindestens 7 + 4 * Samples Worte
+ * @return die Größe in Bytes
+ */
+static uint32_t ktxconv_buildDfd(uint32_t *words, int model, bool srgb, int blockBytes,
+                                 const KtxconvSample *samples, int sampleCount)
+{
+    uint32_t blockSize = 24 + 16 * (uint32_t)sampleCount;
+    words[0] = 4 + blockSize;
+    words[1] = 0; // Vendor Khronos, Typ Basic
+    words[2] = KTXCONV_DFD_VERSION | (blockSize << 16);
+    words[3] = (uint32_t)model | (KTXCONV_DFD_PRIMARIES_BT709 << 8) |
+               ((srgb ? KTXCONV_DFD_TRANSFER_SRGB : KTXCONV_DFD_TRANSFER_LINEAR) << 16);
+    words[4] = 3 | (3 << 8); // Blöcke aus 4x4 Texeln
+    words[5] = (uint32_t)blockBytes;
+    words[6] = 0;
+
+    for (int i = 0; i < sampleCount; i++)
+    {
+        uint32_t *sample = words + 7 + i * 4;
+        uint32_t qualifiers = samples[i].linear ? KTXCONV_DFD_QUALIFIER_LINEAR : 0;
+        sample[0] = (uint32_t)samples[i].bitOffset | ((uint32_t)(samples[i].bitLength - 1) << 16) |
+                    (((uint32_t)samples[i].channel | qualifiers) << 24);
+        sample[1] = 0;
+        sample[2] = 0;
+        sample[3] = 0xFFFFFFFFu;
+    }
+
+    return words[0];
+}
+
+/**
+ * Hängt ein Key/Value-Paar an die Key/Value-Daten an.
+ *
+ * @param kvd Ziel, groß genug für das Paar
+ * @param length die bisherige Länge, wird erhöht
+ */
+static void ktxconv_appendKeyValue(unsigned char *kvd, uint32_t *length,
+                                   const char *key, const char *value)
+{
+    uint32_t pairLength = (uint32_t)(strlen(key) + 1 + strlen(value) + 1);
+    memcpy(kvd + *length, &pairLength, 4);
+    memcpy(kvd + *length + 4, key, strlen(key) + 1);
+    memcpy(kvd + *length + 4 + strlen(key) + 1, value, strlen(value) + 1);
+    *length += 4 + pairLength;
+    while (*length % 4)
+    {
+        kvd[(*length)++] = 0;
+    }
+}
+
+/**
+ * Schreibt Nullbytes, bis die Position ein Vielfaches der Ausrichtung ist.
+ */
+static void ktxconv_pad(FILE *f, uint64_t *position, uint64_t alignment)
+{
+    while (*position % alignment)
+    {
+        fputc(0, f);
+        (*position)++;
+    }
+}
+
+//////////////////////////////////// MAIN /////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+    // Argumente auswerten.
+    int format = -1;
+    bool linear = false;
+    bool mips = true;
+    const char *input = NULL;
+    const char *output = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            const char *names[] = {"bc1", "bc3", "bc4", "bc5", "bc7"};
+            const char *name = argv[++i];
+            for (int n = 0; n < 5; n++)
+            {
+                format = strcmp(name, names[n]) == 0 ? n : format;
+            }
+            if (format < 0)
+            {
+                fprintf(stderr, "Error: Unknown format \"%s\"!\n", name);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "--linear") == 0)
+        {
+            linear = true;
+        }
+        else if (strcmp(argv[i], "--no-mips") == 0)
+        {
+            mips = false;
+        }
+        else if (!input)
+        {
+            input = argv[i];
+        }
+        else if (!output)
+        {
+            output = argv[i];
+        }
+        else
+        {
+            ktxconv_usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (!input || !output)
+    {
+        ktxconv_usage();
+        return EXIT_FAILURE;
+    }
+
+    KtxconvImage image;
+    int channels;
+    if (!ktxconv_loadImage(input, &image, &channels))
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Ohne Vorgabe entscheidet die Anzahl der Kanäle.
+    if (format < 0)
+    {
+        const KtxconvFormat byChannels[] = {KTXCONV_BC4, KTXCONV_BC5, KTXCONV_BC1, KTXCONV_BC7};
+        format = byChannels[channels - 1];
+    }
+
+    // BC4 und BC5 speichern Daten, keine Farben.
+    bool srgb = !linear && format != KTXCONV_BC4 && format != KTXCONV_BC5;
+    bool alpha = format == KTXCONV_BC1 && channels == 4;
+    int blockBytes = ktxconv_blockBytes(format);
+
+    // Alle Mipmaps bis 1x1 erzeugen und komprimieren.
+    int levelCount = 1;
+    if (mips)
+    {
+        int size = image.width > image.height ? image.width : image.height;
+        while (size > 1)
+        {
+            size /= 2;
+            levelCount++;
+        }
+    }
+
+    unsigned char **levelData = malloc(sizeof(unsigned char *) * levelCount);
+    Ktx2Level *levels = malloc(sizeof(Ktx2Level) * levelCount);
+    KtxconvImage level = image;
+    for (int l = 0; l < levelCount; l++)
+    {
+        size_t size;
+        levelData[l] = ktxconv_compress(&level, format, alpha, &size);
+        levels[l].byteLength = size;
+        levels[l].uncompressedByteLength = size;
+
+        if (l + 1 < levelCount)
+        {
+            KtxconvImage next = ktxconv_downsample(&level, srgb);
+            if (level.rgba != image.rgba)
+            {
+                free(level.rgba);
+            }
+            level = next;
+        }
+    }
+    if (level.rgba != image.rgba)
+    {
+        free(level.rgba);
+    }
+
+    // Data Format Descriptor und Key/Value-Daten aufbauen.
+    KtxconvSample samples[KTXCONV_MAX_SAMPLES];
+    int sampleCount, model;
+    uint32_t vkFormat = ktxconv_describeFormat(format, srgb, alpha, &model, samples, &sampleCount);
+    uint32_t dfd[7 + 4 * KTXCONV_MAX_SAMPLES];
+    uint32_t dfdLength = ktxconv_buildDfd(dfd, model, srgb, blockBytes, samples, sampleCount);
+
+    // Die Zeilen liegen von unten nach oben, wie OpenGL sie erwartet.
+    unsigned char kvd[64];
+    uint32_t kvdLength = 0;
+    ktxconv_appendKeyValue(kvd, &kvdLength, "KTXorientation", "ru");
+    ktxconv_appendKeyValue(kvd, &kvdLength, "KTXwriter", "ktxconv");
+
+    Ktx2Header header = {vkFormat, 1, (uint32_t)image.width, (uint32_t)image.height,
+                         0, 0, 1, (uint32_t)levelCount, KTX2_SUPERCOMPRESSION_NONE};
+    Ktx2Index index;
+    index.dfdByteOffset = KTX2_IDENTIFIER_SIZE + sizeof(Ktx2Header) + sizeof(Ktx2Index) +
+                          sizeof(Ktx2Level) * levelCount;
+    index.dfdByteLength = dfdLength;
+    index.kvdByteOffset = index.dfdByteOffset + dfdLength;
+    index.kvdByteLength = kvdLength;
+    index.sgdByteOffset = 0;
+    index.sgdByteLength = 0;
+
+    // Die kleinste Mipmap liegt vorne, jede an der Blockgröße ausgerichtet.
+    uint64_t position = index.kvdByteOffset + kvdLength;
+    for (int l = levelCount - 1; l >= 0; l--)
+    {
+        position = (position + blockBytes - 1) / blockBytes * blockBytes;
+        levels[l].byteOffset = position;
+        position += levels[l].byteLength;
+    }
+
+    FILE *f = fopen(output, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "Error: Could not open \"%s\" for writing!\n", output);
+        return EXIT_FAILURE;
+    }
+
+    const unsigned char identifier[KTX2_IDENTIFIER_SIZE] = KTX2_IDENTIFIER;
+    fwrite(identifier, 1, sizeof(identifier), f);
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(&index, sizeof(index), 1, f);
+    fwrite(levels, sizeof(Ktx2Level), levelCount, f);
+    fwrite(dfd, 1, dfdLength, f);
+    fwrite(kvd, 1, kvdLength, f);
+
+    position = index.kvdByteOffset + kvdLength;
+    for (int l = levelCount - 1; l >= 0; l--)
+    {
+        ktxconv_pad(f, &position, (uint64_t)blockBytes);
+        fwrite(levelData[l], 1, levels[l].byteLength, f);
+        position += levels[l].byteLength;
+        free(levelData[l]);
+    }
+
+    bool ok = !ferror(f);
+    fclose(f);
+    if (!ok)
+    {
+        fprintf(stderr, "Error: Could not write \"%s\"!\n", output);
+        return EXIT_FAILURE;
+    }
+
+    const char *names[] = {"BC1", "BC3", "BC4", "BC5", "BC7"};
+    printf("%s: %dx%d, %d levels, %s%s, %.1f KiB (RGBA8 with mips: %.1f KiB)\n",
+           output, image.width, image.height, levelCount, names[format], srgb ? " sRGB" : "",
+           position / 1024.0, image.width * image.height * 4 * (mips ? 4.0 / 3.0 : 1.0) / 1024.0);
+
+    free(levelData);
+    free(levels);
+    free(image.rgba);
+    return EXIT_SUCCESS;
+}